@@ -149,7 +149,8 @@ def createMakefile():
     LINK_FLAGS    = LDFLAGS.split()   # accumulate the linker flags that will be put to Makefile.local
     COMPILE_FLAGS = CFLAGS. split()   # same for the compilation of the shared library only
     # default compilation flags for both the shared library and all example programs that use it
-    CXXFLAGS = ['-fPIC', '-Wall', '-O2']
+    # (-fno-math-errno allows the compiler to vectorize loops containing sqrt and other math functions)
+    CXXFLAGS = ['-fPIC', '-Wall', '-O2', '-fno-math-errno']
     # additional compilation/linking flags for example programs
     EXE_FLAGS = []
 
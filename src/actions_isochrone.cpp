@@ -1,6 +1,7 @@
 #include "actions_isochrone.h"
 #include "math_core.h"
 #include "math_specfunc.h"
+#include "utils_counters.h"
 #include <stdexcept>
 #include <cmath>
 
@@ -10,6 +11,7 @@ Actions actionsIsochrone(
     const double M, const double b,
     const coord::PosVelCyl& point)
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     double L = Ltotal(point);
     double E = -M / (b + sqrt(b*b + pow_2(point.R) + pow_2(point.z))) +
         0.5 * (pow_2(point.vR) + pow_2(point.vz) + pow_2(point.vphi));
@@ -26,6 +28,7 @@ ActionAngles actionAnglesIsochrone(
     const coord::PosVelCyl& pointCyl,
     Frequencies* freq)
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     coord::PosVelSph point(toPosVelSph(pointCyl));
     ActionAngles aa;
     double rb   = sqrt(b*b +pow_2(point.r));
@@ -66,6 +69,7 @@ coord::PosVelCyl mapIsochrone(
     const double M, const double b,
     const ActionAngles& aa, Frequencies* freq)
 {
+    COUNTER_TIMER(CNT_ACTION_MAP);
     return toPosVelCyl(ToyMapIsochrone(M, b).map(aa, freq));
 }
 
@@ -2,6 +2,7 @@
 #include "potential_utils.h"
 #include "math_core.h"
 #include "utils.h"
+#include "utils_counters.h"
 #include <string>
 #include <stdexcept>
 #include <algorithm>
@@ -25,6 +26,12 @@ static const double ACCURACY_INTERP2 = 1e-4;
 /// size of the interpolation grid in the dimension corresponding to relative angular momentum
 static const unsigned int GRID_SIZE_L = 25;
 
+/// initial and maximum size of this grid when it is refined adaptively
+static const unsigned int GRID_SIZE_L_MIN = 13, GRID_SIZE_L_MAX = 49;
+
+/// stride of the grid in energy at which the interpolation error is checked before a refinement
+static const int CHECK_STRIDE = 3;
+
 /// minimum order of Gauss-Legendre quadrature for actions, frequencies and angles
 static const unsigned int INTEGR_ORDER = 10;
 
@@ -387,202 +394,349 @@ coord::PosVelSphMod derivPointFromActions(
     return p;
 }
 
-/// construct the interpolating spline for scaled radial action W = Jr / (Lcirc-L)
-/// as a function of E and L/Lcirc
-math::QuinticSpline2d createActionInterpolator(const potential::Interpolator2d& pot)
-{
-    const double invPhi0 = 1. / pot.value(0);
-    std::vector<double> gridR = potential::createInterpolationGrid(
-        potential::FunctionToPotentialWrapper(pot), ACCURACY_INTERP2);
-    // extend the grid a little bit at large radii
-    gridR.push_back( exp(2.5 * log(gridR[gridR.size()-1]) - 1.5 * log(gridR[gridR.size()-2])) );
-
-    // interpolation grid in scaled variables: X = scaledE = log(1/Phi(0)-1/E), Y = L / Lcirc(E)
-    const int sizeE = gridR.size();
-    const int sizeL = GRID_SIZE_L;
-    std::vector<double> gridX(sizeE), gridY(sizeL);
-
-    // create a non-uniform grid in Y = L/Lcirc(E), using a transformation of interval [0:1]
-    // onto itself that places more grid points near the edges:
-    // a function with zero 1st and 2nd derivs at x=0 and x=1
-    math::ScalingQui scaling(0, 1);
-    for(int i=0; i<sizeL; i++)
-        gridY[i] = math::unscale(scaling, i / (sizeL-1.));
+/** A column of the 2d interpolation table (a fixed value of the second coordinate y)
+    containing the values of the interpolated function and its derivatives at all nodes
+    of the grid in the first coordinate x */
+struct TableColumn {
+    double y;                         ///< the second coordinate
+    std::vector<double> f, fdx, fdy;  ///< values of function and its derivatives by x and y
+};
 
-    // value of W=Jr/(Lcirc-L) and its derivatives w.r.t. X=scaledE and Y=L/Lcirc
-    math::Matrix<double> gridW(sizeE, sizeL), gridWdX(sizeE, sizeL), gridWdY(sizeE, sizeL);
-    std::vector<double> gridWatY1(sizeE);  // last column of the W matrix (values at Y=1 and any X)
+/** Interface for computing the values of a function at the nodes of a 2d interpolation table */
+class TableNodeFnc {
+public:
+    virtual ~TableNodeFnc() {}
+    /// compute the function and its derivatives at the given index of the x-grid and the value of y
+    virtual void eval(int indexX, double y,
+        /*output*/ double& f, double& fdx, double& fdy) const = 0;
+    /// fill in the missing values in the columns (e.g. those that depend on the adjacent columns)
+    virtual void finalize(const std::vector<double>& /*gridX*/,
+        std::vector<TableColumn>& /*columns*/) const {}
+};
 
+/** compute the table values in the given columns, parallelized over all nodes.
+    Only the nodes that have not been computed yet (contain NAN) are evaluated;
+    if strideX>1, only every strideX-th node of the x-grid starting from the second one
+    is computed, and the remaining ones may be filled in by a subsequent call with strideX=1.
+*/
+void computeTableColumns(const std::vector<double>& gridX, const TableNodeFnc& fnc,
+    std::vector<TableColumn>& columns, int strideX=1)
+{
+    const int sizeX = gridX.size(), numCol = columns.size();
+    std::vector<int> nodes;  // combined indices of nodes that need to be computed
+    for(int c=0; c<numCol; c++) {
+        if(columns[c].f.empty()) {
+            columns[c].f.  assign(sizeX, NAN);
+            columns[c].fdx.assign(sizeX, NAN);
+            columns[c].fdy.assign(sizeX, NAN);
+        }
+        for(int ix=0; ix<sizeX; ix++)
+            if(ix % strideX == 1 % strideX && columns[c].f[ix] != columns[c].f[ix])
+                nodes.push_back(c * sizeX + ix);
+    }
+    const int numNodes = nodes.size();
     std::string errorMessage;  // store the error text in case of an exception in the openmp block
+    utils::CtrlBreakHandler cbrk;  // catch Ctrl-Break keypress
+    bool stop = false;
+    // loop over all nodes with a combined index: the cost of a node varies strongly
+    // across the table, so the work is distributed dynamically between threads
 #ifdef _OPENMP
-#pragma omp parallel for schedule(static)
+#pragma omp parallel for schedule(dynamic)
 #endif
-    for(int iE=0; iE<sizeE; iE++) {
+    for(int n=0; n<numNodes; n++) {
+        if(stop) continue;
+        if(cbrk.triggered()) stop = true;
+        const int ix = nodes[n] % sizeX, c = nodes[n] / sizeX;
         try{
-            double Rc = gridR[iE];
-            double Phi, dPhi, d2Phi;
-            pot.evalDeriv(Rc, &Phi, &dPhi, &d2Phi);
-            double E  = Phi + 0.5 * Rc * dPhi;   // energy of a circular orbit at this radius
-            double Lc = Rc  * sqrt( Rc * dPhi);  // angular momentum of a circular orbit
-            double dEdX;                         // dE / d scaledE
-            gridX[iE] = scaleE(E, invPhi0, /*output*/ &dEdX);
-            double dLcdE = Rc*Rc/Lc;
-            for(int iL=0; iL<sizeL-1; iL++) {
-                double L = Lc * gridY[iL];
-                double R1, R2;
-                pot.findPlanarOrbitExtent(E, L, R1, R2);
-                double Jr    = integr<MODE_JR>    (pot, E, L, R1, R2) / M_PI;
-                double dJrdE = integr<MODE_OMEGAR>(pot, E, L, R1, R2) / M_PI;
-                double dJrdL =-integr<MODE_OMEGAZ>(pot, E, L, R1, R2) / M_PI;
-                gridW  (iE, iL) = Jr / (Lc - L);
-                gridWdX(iE, iL) = (dJrdE + (L * dJrdL - Jr) * dLcdE / Lc) / (Lc - L) * dEdX;
-                gridWdY(iE, iL) = (dJrdL + Jr / (Lc - L)) / (1 - gridY[iL]);
-            }
-            // limiting value for a nearly circular orbit (Y=1): Jr / (Lcirc-L) = Omega/kappa
-            gridW  (iE, sizeL-1) = gridWatY1[iE] = sqrt(dPhi / (d2Phi * Rc + 3 * dPhi));
-            // derivative w.r.t. Y is obtained by quardatic interpolation of finite-differences,
-            // using value at the boundary node, and value+deriv at the next-to-boundary node
-            gridWdY(iE, sizeL-1) = -gridWdY(iE, sizeL-2) +
-                2 * (gridW(iE, sizeL-1) - gridW(iE, sizeL-2)) / (gridY[sizeL-1] - gridY[sizeL-2]);
-            // derivative w.r.t. X will be obtained from 1d spline after all W values are computed
+            fnc.eval(ix, columns[c].y, columns[c].f[ix], columns[c].fdx[ix], columns[c].fdy[ix]);
         }
         catch(std::exception& e) {
             errorMessage = e.what();
+            stop = true;
         }
     }
+    if(cbrk.triggered())
+        throw std::runtime_error("Keyboard interrupt");
+    if(!errorMessage.empty())
+        throw std::runtime_error("ActionFinderSpherical: "+errorMessage);
+}
 
-    // derivative dW/dX at Y=1 is computed by constructing an auxiliary 1d spline for W(X)|Y=1
-    // and differentiating it
-    try{
-        math::CubicSpline intWatY1(gridX, gridWatY1);
-        for(int iE=0; iE<sizeE; iE++)
-            intWatY1.evalDeriv(gridX[iE], NULL, &gridWdX(iE, sizeL-1));
-    }
-    catch(std::exception& e) {
-        errorMessage = e.what();
+/// construct a 2d quintic spline from the columns of the table
+math::QuinticSpline2d makeTableSpline(const std::vector<double>& gridX,
+    const std::vector<TableColumn>& columns)
+{
+    const int sizeX = gridX.size(), sizeY = columns.size();
+    std::vector<double> gridY(sizeY);
+    math::Matrix<double> f(sizeX, sizeY), fdx(sizeX, sizeY), fdy(sizeX, sizeY);
+    for(int c=0; c<sizeY; c++) {
+        gridY[c] = columns[c].y;
+        for(int ix=0; ix<sizeX; ix++) {
+            f  (ix, c) = columns[c].f  [ix];
+            fdx(ix, c) = columns[c].fdx[ix];
+            fdy(ix, c) = columns[c].fdy[ix];
+        }
     }
+    return math::QuinticSpline2d(gridX, gridY, f, fdx, fdy);
+}
 
-    if(utils::verbosityLevel >= utils::VL_VERBOSE) {   // debugging output
-        std::ofstream strm("ActionFinderSpherical.log");
-        strm << "# X=scaledE    \tY=L/Lcirc      \tW=Jr/(Lcirc-L) \tdW/dX          \tdW/dY          \n";
-        for(int iE=0; iE<sizeE; iE++) {
-            for(int iL=0; iL<sizeL; iL++) {
-                strm << 
-                utils::pp(gridX  [iE],     15) + "\t" +
-                utils::pp(gridY  [iL],     15) + "\t" +
-                utils::pp(gridW  (iE, iL), 15) + "\t" +
-                utils::pp(gridWdX(iE, iL), 15) + "\t" +
-                utils::pp(gridWdY(iE, iL), 15) + "\n";
+/** Construct a 2d interpolation table on the domain  x in gridX,  0 <= y <= 1.
+    The grid in y places more nodes near the edges of the interval, using a transformation
+    of [0:1] onto itself with zero 1st and 2nd derivatives at both ends; the nodes are uniformly
+    spaced in the scaled variable.  If the accuracy is not positive, the grid has GRID_SIZE_L nodes;
+    otherwise it starts from GRID_SIZE_L_MIN nodes and is refined by halving the spacing everywhere
+    (refining only a part of the grid makes the quintic spline unstable), until the estimated
+    interpolation error drops below the required accuracy or the grid reaches GRID_SIZE_L_MAX nodes.
+    The error is estimated before each refinement: the function is computed at the midpoints of
+    the current grid in y, but only at every CHECK_STRIDE-th node in x, and compared with the spline
+    constructed from the current grid.  The deviations of derivatives are multiplied by the local
+    grid spacing and take part in the estimate on equal footing with the deviation of the value.
+    The two outermost nodes in x are not checked: the errors there are dominated by the derivatives
+    in x, which do not improve with the refinement in y.  If the grid is not accepted,
+    the midpoints are computed at the remaining nodes in x and added to the grid, so that
+    no evaluation is wasted.
+*/
+math::QuinticSpline2d createTable(const std::vector<double>& gridX, const TableNodeFnc& fnc,
+    const double accuracy)
+{
+    const math::ScalingQui scaling(0, 1);
+    const int sizeX = gridX.size();
+    const unsigned int initSizeY = accuracy>0 ? GRID_SIZE_L_MIN : GRID_SIZE_L;
+    std::vector<TableColumn> columns(initSizeY);
+    for(unsigned int c=0; c<initSizeY; c++)
+        columns[c].y = math::unscale(scaling, c / (initSizeY-1.));
+    computeTableColumns(gridX, fnc, columns);
+    fnc.finalize(gridX, columns);
+    while(accuracy>0 && columns.size() < GRID_SIZE_L_MAX) {
+        // the function at the midpoints of the current grid in y, computed on a sparse grid in x
+        const int sizeY = columns.size();
+        std::vector<TableColumn> midpoints(sizeY-1);
+        for(int c=0; c<sizeY-1; c++)
+            midpoints[c].y = math::unscale(scaling, (c+0.5) / (sizeY-1));
+        computeTableColumns(gridX, fnc, midpoints, CHECK_STRIDE);
+        const math::QuinticSpline2d spl = makeTableSpline(gridX, columns);
+        double error = 0;
+        for(int c=0; c<sizeY-1; c++) {
+            double hy = columns[c+1].y - columns[c].y;
+            for(int ix=1; ix<sizeX-1; ix++) {
+                if(midpoints[c].f[ix] != midpoints[c].f[ix])
+                    continue;   // this node was not computed
+                double hx = fmax(gridX[ix] - gridX[ix-1], gridX[ix+1] - gridX[ix]);
+                double f, fdx, fdy;
+                spl.evalDeriv(gridX[ix], midpoints[c].y, &f, &fdx, &fdy);
+                error = fmax(error, fmax(fabs(f - midpoints[c].f[ix]), fmax(
+                    fabs(fdx - midpoints[c].fdx[ix]) * hx,
+                    fabs(fdy - midpoints[c].fdy[ix]) * hy)));
             }
-            strm<<"\n";
         }
+        utils::msg(utils::VL_DEBUG, "ActionFinderSpherical", "Interpolation error with " +
+            utils::toString(sizeY) + " nodes in L: " + utils::toString(error));
+        if(error <= accuracy)
+            break;
+        // complete the midpoint columns and interleave them with the existing ones
+        computeTableColumns(gridX, fnc, midpoints);
+        std::vector<TableColumn> refined(2*sizeY-1);
+        for(int c=0; c<sizeY; c++) {
+            refined[2*c] = columns[c];
+            if(c<sizeY-1)
+                refined[2*c+1] = midpoints[c];
+        }
+        columns.swap(refined);
+        fnc.finalize(gridX, columns);
     }
+    return makeTableSpline(gridX, columns);
+}
 
-    if(!errorMessage.empty())
-        throw std::runtime_error("ActionFinderSpherical: "+errorMessage);
-
-    return math::QuinticSpline2d(gridX, gridY, gridW, gridWdX, gridWdY);
+/// write the nodes of the interpolation table to a text file (for debugging)
+void writeTable(const char* fileName, const char* header, const math::QuinticSpline2d& spl)
+{
+    std::ofstream strm(fileName);
+    strm << header;
+    const std::vector<double>& gridX = spl.xvalues(), gridY = spl.yvalues();
+    for(size_t ix=0; ix<gridX.size(); ix++) {
+        for(size_t iy=0; iy<gridY.size(); iy++) {
+            double val, derX, derY;
+            spl.evalDeriv(gridX[ix], gridY[iy], &val, &derX, &derY);
+            strm <<
+            utils::pp(gridX[ix], 15) + "\t" +
+            utils::pp(gridY[iy], 15) + "\t" +
+            utils::pp(val,       15) + "\t" +
+            utils::pp(derX,      15) + "\t" +
+            utils::pp(derY,      15) + "\n";
+        }
+        strm<<"\n";
+    }
 }
 
-/// construct the interpolating spline for scaled energy X as a function of log(Jr+L), L/(Jr+L)
-math::QuinticSpline2d createEnergyInterpolator(const potential::Interpolator2d& pot,
-    const math::BaseInterpolator2d& intJr)
+/// return the grid in radius used for both interpolation tables
+std::vector<double> createRadialGrid(const potential::Interpolator2d& pot)
 {
-    const double Phi0 = pot.value(0), invPhi0 = 1. / Phi0;
     std::vector<double> gridR = potential::createInterpolationGrid(
         potential::FunctionToPotentialWrapper(pot), ACCURACY_INTERP2);
-    // extend the grid a little
+    // extend the grid a little bit at large radii
     gridR.push_back( exp(2.5 * log(gridR[gridR.size()-1]) - 1.5 * log(gridR[gridR.size()-2])) );
+    return gridR;
+}
 
-    // interpolation grid for X = scaledE = log(1/Phi(0)-1/E) in scaled variables:
-    // P = log(L+Jr), Q = L/(L+Jr)
-    const int sizeP = gridR.size();
-    const int sizeQ = GRID_SIZE_L;
-    std::vector<double> gridP(sizeP), gridQ(sizeQ);
-
-    // create a non-uniform grid in Q = Jr/(L+Jr), using a transformation of interval [0:1]
-    // onto itself that places more grid points near the edges:
-    // a function with zero 1st and 2nd derivs at x=0 and x=1
-    math::ScalingQui scaling(0, 1);
-    for(int i=0; i<sizeQ; i++)
-        gridQ[i] = math::unscale(scaling, i / (sizeQ-1.));
+/** Values of scaled radial action  W = Jr / (Lcirc-L)  and its derivatives w.r.t.
+    X = scaledE = log(1/Phi(0)-1/E)  and  Y = L / Lcirc(E),
+    for the nodes of the radial grid that correspond to the radii of circular orbits */
+class ActionTableNodeFnc: public TableNodeFnc {
+    const potential::Interpolator2d& pot;
+    const std::vector<double>& gridR;
+    const double invPhi0;
+public:
+    ActionTableNodeFnc(const potential::Interpolator2d& _pot, const std::vector<double>& _gridR) :
+        pot(_pot), gridR(_gridR), invPhi0(1. / pot.value(0)) {}
+
+    virtual void eval(int iE, double Y, double& W, double& WdX, double& WdY) const
+    {
+        double Rc = gridR[iE];
+        double Phi, dPhi, d2Phi;
+        pot.evalDeriv(Rc, &Phi, &dPhi, &d2Phi);
+        if(Y==1) {
+            // limiting value for a nearly circular orbit (Y=1): Jr / (Lcirc-L) = Omega/kappa;
+            // the derivatives are computed in finalize()
+            W = sqrt(dPhi / (d2Phi * Rc + 3 * dPhi));
+            return;
+        }
+        double E  = Phi + 0.5 * Rc * dPhi;   // energy of a circular orbit at this radius
+        double Lc = Rc  * sqrt( Rc * dPhi);  // angular momentum of a circular orbit
+        double dEdX;                         // dE / d scaledE
+        scaleE(E, invPhi0, /*output*/ &dEdX);
+        double dLcdE = Rc*Rc/Lc;
+        double L = Lc * Y;
+        double R1, R2;
+        pot.findPlanarOrbitExtent(E, L, R1, R2);
+        double Jr    = integr<MODE_JR>    (pot, E, L, R1, R2) / M_PI;
+        double dJrdE = integr<MODE_OMEGAR>(pot, E, L, R1, R2) / M_PI;
+        double dJrdL =-integr<MODE_OMEGAZ>(pot, E, L, R1, R2) / M_PI;
+        W   = Jr / (Lc - L);
+        WdX = (dJrdE + (L * dJrdL - Jr) * dLcdE / Lc) / (Lc - L) * dEdX;
+        WdY = (dJrdL + Jr / (Lc - L)) / (1 - Y);
+    }
 
-    // value of X=scaledE and its derivatives w.r.t. P and Q
-    math::Matrix<double> gridX(sizeP, sizeQ), gridXdP(sizeP, sizeQ), gridXdQ(sizeP, sizeQ);
+    virtual void finalize(const std::vector<double>& gridX, std::vector<TableColumn>& columns) const
+    {
+        TableColumn& last = columns[columns.size()-1];
+        const TableColumn& prev = columns[columns.size()-2];
+        // derivative w.r.t. Y is obtained by quardatic interpolation of finite-differences,
+        // using value at the boundary node, and value+deriv at the next-to-boundary node
+        for(size_t iE=0; iE<gridX.size(); iE++)
+            last.fdy[iE] = -prev.fdy[iE] + 2 * (last.f[iE] - prev.f[iE]) / (last.y - prev.y);
+        // derivative dW/dX at Y=1 is computed by constructing an auxiliary 1d spline for W(X)|Y=1
+        // and differentiating it
+        math::CubicSpline intWatY1(gridX, last.f);
+        for(size_t iE=0; iE<gridX.size(); iE++)
+            intWatY1.evalDeriv(gridX[iE], NULL, &last.fdx[iE]);
+    }
+};
 
-    std::string errorMessage;  // store the error text in case of an exception in the openmp block
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static)
-#endif
-    for(int iP=0; iP<sizeP; iP++) {
-        try{
-            double Rc = gridR[iP];
-            double Phi, dPhi, d2Phi;
-            pot.evalDeriv(Rc, &Phi, &dPhi, &d2Phi);
-            double Lc = Rc  * sqrt( Rc * dPhi);  // exp(P) = Jr+L
-            gridP[iP] = log(Lc);
-            for(int iQ=0; iQ<sizeQ; iQ++) {
-                double L = Lc * gridQ[iQ], Jr = Lc * (1-gridQ[iQ]);                
-                // radius of a circular orbit with angular momentum equal to L
-                double Rcirc = iQ<sizeQ-1 ? pot.R_from_Lz(L) : Rc;
-                // initial guess (more precisely, lower bound) for Hamiltonian
-                double Elow  = pot.value(Rcirc) + (L>0 ? 0.5 * pow_2(L/Rcirc) : 0);
-                double dEdX,X= scaleE(Elow, invPhi0, /*output*/ &dEdX);
-                double dEdJr = sqrt(d2Phi + 3*dPhi/Rc);  // kappa - epicyclic frequency (when Jr=0)
-                double dEdL  = sqrt(dPhi/Rc);            // Omega --"--
-                // if the radial action Jr is zero, Elow = Ecirc is the correct result,
-                // otherwise need to find E such that Jr(E, L) equals the target value
-                if(Jr>0) {
-                    HamiltonianFinderFncInterpolated fnc(pot, Jr, L, invPhi0, intJr);
-                    // find E such that Jr(E, L) equals the target value.
-                    // We use logarithmically-scaled variable X=scaledE, which technically may range
-                    // from -inf to +inf, but in practice is likely to be within a range of +-few tens.
-                    // Since this is still an unbound range, in the root-finder we employ another
-                    // scaling transformation X <-> z, with 0<z<1.
-                    math::ScalingInf scaling;
-                    double zroot = math::findRoot(
-                        math::ScaledFnc<math::ScalingInf>(scaling, fnc),
-                        /*lower limit is Elow, which translates to*/ math::scale(scaling, X),
-                        /*upper limit on scaledE is infinity, which corresponds to*/ 1, ACCURACY_JR);
-                    if(zroot==zroot) {
-                        // only if the root-finder was successful, otherwise leave Elow=Ecirc as for Jr=0
-                        X = math::unscale(scaling, zroot);
-                        double E = unscaleE(X, invPhi0, /*output*/ &dEdX);
-                        // once again compute the radial action _and_frequencies_ for the given energy
-                        // (return value is ignored because we assume that it is equal to Jr)
-                        computeJr(E, X, dEdX, L, pot, intJr, /*output*/&dEdJr, &dEdL);
-                    }
-                }
-                gridX  (iP, iQ) = X;
-                gridXdP(iP, iQ) = (dEdJr * Jr + dEdL * L) / dEdX;
-                gridXdQ(iP, iQ) = (Jr+L) * (dEdL - dEdJr) / dEdX;
-            }
-        }
-        catch(std::exception& e) {
-            errorMessage = e.what();
-        }
+/// construct the interpolating spline for scaled radial action W = Jr / (Lcirc-L)
+/// as a function of E and L/Lcirc
+math::QuinticSpline2d createActionInterpolator(const potential::Interpolator2d& pot,
+    bool singlePrecision, double accuracy)
+{
+    const double invPhi0 = 1. / pot.value(0);
+    const std::vector<double> gridR = createRadialGrid(pot);
+    // interpolation grid in scaled variable X = scaledE = log(1/Phi(0)-1/E)
+    std::vector<double> gridX(gridR.size());
+    for(size_t iE=0; iE<gridR.size(); iE++) {
+        double Phi, dPhi;
+        pot.evalDeriv(gridR[iE], &Phi, &dPhi);
+        gridX[iE] = scaleE(Phi + 0.5 * gridR[iE] * dPhi, invPhi0);
     }
-    if(!errorMessage.empty())
-        throw std::runtime_error("ActionFinderSpherical: "+errorMessage);
+    // the grid in Y = L/Lcirc(E) is fixed or adaptively refined
+    math::QuinticSpline2d result = createTable(gridX, ActionTableNodeFnc(pot, gridR), accuracy);
+    if(utils::verbosityLevel >= utils::VL_VERBOSE)   // debugging output
+        writeTable("ActionFinderSpherical.log",
+            "# X=scaledE    \tY=L/Lcirc      \tW=Jr/(Lcirc-L) \tdW/dX          \tdW/dY          \n",
+            result);
+    if(singlePrecision)
+        utils::msg(utils::VL_DEBUG, "ActionFinderSpherical",
+            "Single-precision storage of coefficients: max relative error=" +
+            utils::toString(result.reducePrecision()));
+    return result;
+}
 
-    if(utils::verbosityLevel >= utils::VL_VERBOSE) {   // debugging output
-        std::ofstream strm("ActionFinderSphericalEnergy.log");
-        strm << "# P=ln(Jr+L)   \tQ=L/(Jr+L)     \tX=scaledE      \tdX/dP          \tdX/dQ          \n";
-        for(int iP=0; iP<sizeP; iP++) {
-            for(int iQ=0; iQ<sizeQ; iQ++) {
-                strm << 
-                utils::pp(gridP  [iP],     15) + "\t" +
-                utils::pp(gridQ  [iQ],     15) + "\t" +
-                utils::pp(gridX  (iP, iQ), 15) + "\t" +
-                utils::pp(gridXdP(iP, iQ), 15) + "\t" +
-                utils::pp(gridXdQ(iP, iQ), 15) + "\n";
+/** Values of scaled energy  X = scaledE = log(1/Phi(0)-1/E)  and its derivatives w.r.t.
+    P = log(L+Jr)  and  Q = L/(L+Jr), for the nodes of the radial grid that correspond to
+    the radii of circular orbits with angular momentum exp(P) */
+class EnergyTableNodeFnc: public TableNodeFnc {
+    const potential::Interpolator2d& pot;
+    const math::BaseInterpolator2d& intJr;
+    const std::vector<double>& gridR;
+    const double invPhi0;
+public:
+    EnergyTableNodeFnc(const potential::Interpolator2d& _pot,
+        const math::BaseInterpolator2d& _intJr, const std::vector<double>& _gridR) :
+        pot(_pot), intJr(_intJr), gridR(_gridR), invPhi0(1. / pot.value(0)) {}
+
+    virtual void eval(int iP, double Q, double& X, double& XdP, double& XdQ) const
+    {
+        double Rc = gridR[iP];
+        double Phi, dPhi, d2Phi;
+        pot.evalDeriv(Rc, &Phi, &dPhi, &d2Phi);
+        double Lc = Rc  * sqrt( Rc * dPhi);  // exp(P) = Jr+L
+        double L = Lc * Q, Jr = Lc * (1-Q);
+        // radius of a circular orbit with angular momentum equal to L
+        double Rcirc = Q<1 ? pot.R_from_Lz(L) : Rc;
+        // initial guess (more precisely, lower bound) for Hamiltonian
+        double Elow  = pot.value(Rcirc) + (L>0 ? 0.5 * pow_2(L/Rcirc) : 0);
+        double dEdX;
+        X = scaleE(Elow, invPhi0, /*output*/ &dEdX);
+        double dEdJr = sqrt(d2Phi + 3*dPhi/Rc);  // kappa - epicyclic frequency (when Jr=0)
+        double dEdL  = sqrt(dPhi/Rc);            // Omega --"--
+        // if the radial action Jr is zero, Elow = Ecirc is the correct result,
+        // otherwise need to find E such that Jr(E, L) equals the target value
+        if(Jr>0) {
+            HamiltonianFinderFncInterpolated fnc(pot, Jr, L, invPhi0, intJr);
+            // find E such that Jr(E, L) equals the target value.
+            // We use logarithmically-scaled variable X=scaledE, which technically may range
+            // from -inf to +inf, but in practice is likely to be within a range of +-few tens.
+            // Since this is still an unbound range, in the root-finder we employ another
+            // scaling transformation X <-> z, with 0<z<1.
+            math::ScalingInf scaling;
+            double zroot = math::findRoot(
+                math::ScaledFnc<math::ScalingInf>(scaling, fnc),
+                /*lower limit is Elow, which translates to*/ math::scale(scaling, X),
+                /*upper limit on scaledE is infinity, which corresponds to*/ 1, ACCURACY_JR);
+            if(zroot==zroot) {
+                // only if the root-finder was successful, otherwise leave Elow=Ecirc as for Jr=0
+                X = math::unscale(scaling, zroot);
+                double E = unscaleE(X, invPhi0, /*output*/ &dEdX);
+                // once again compute the radial action _and_frequencies_ for the given energy
+                // (return value is ignored because we assume that it is equal to Jr)
+                computeJr(E, X, dEdX, L, pot, intJr, /*output*/&dEdJr, &dEdL);
             }
-            strm<<"\n";
         }
+        XdP = (dEdJr * Jr + dEdL * L) / dEdX;
+        XdQ = (Jr+L) * (dEdL - dEdJr) / dEdX;
     }
+};
 
-    //return math::CubicSpline2d(gridP, gridQ, gridX);
-    return math::QuinticSpline2d(gridP, gridQ, gridX, gridXdP, gridXdQ);
+/// construct the interpolating spline for scaled energy X as a function of log(Jr+L), L/(Jr+L)
+math::QuinticSpline2d createEnergyInterpolator(const potential::Interpolator2d& pot,
+    const math::BaseInterpolator2d& intJr, bool singlePrecision, double accuracy)
+{
+    const std::vector<double> gridR = createRadialGrid(pot);
+    // interpolation grid in scaled variable P = log(L+Jr)
+    std::vector<double> gridP(gridR.size());
+    for(size_t iP=0; iP<gridR.size(); iP++) {
+        double dPhi;
+        pot.evalDeriv(gridR[iP], NULL, &dPhi);
+        gridP[iP] = log(gridR[iP] * sqrt(gridR[iP] * dPhi));
+    }
+    // the grid in Q = L/(L+Jr) is fixed or adaptively refined
+    math::QuinticSpline2d result = createTable(gridP, EnergyTableNodeFnc(pot, intJr, gridR), accuracy);
+    if(utils::verbosityLevel >= utils::VL_VERBOSE)   // debugging output
+        writeTable("ActionFinderSphericalEnergy.log",
+            "# P=ln(Jr+L)   \tQ=L/(Jr+L)     \tX=scaledE      \tdX/dP          \tdX/dQ          \n",
+            result);
+    if(singlePrecision)
+        utils::msg(utils::VL_DEBUG, "ActionFinderSpherical",
+            "Single-precision storage of coefficients: max relative error=" +
+            utils::toString(result.reducePrecision()));
+    return result;
 }
 
 }  //internal namespace
@@ -618,6 +772,7 @@ coord::PosVelCyl mapSpherical(
     const potential::BasePotential &pot,
     const ActionAngles &aa, Frequencies* freqout)
 {
+    COUNTER_TIMER(CNT_ACTION_MAP);
     if(!isSpherical(pot))
         throw std::invalid_argument("mapSpherical: potential must be spherically symmetric");
     if(aa.Jr<0 || aa.Jz<0)
@@ -640,6 +795,7 @@ coord::PosVelCyl mapSpherical(
 Actions actionsSpherical(
     const potential::BasePotential& potential, const coord::PosVelCyl& point)
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     double E, L, R1, R2;
     return computeActions(point, potential, E, L, R1, R2);
 }
@@ -647,6 +803,7 @@ Actions actionsSpherical(
 ActionAngles actionAnglesSpherical(
     const potential::BasePotential& pot, const coord::PosVelCyl& point, Frequencies* freqout)
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     double E, L, R1, R2;
     Actions acts = computeActions(point, pot, E, L, R1, R2);
     if(!isFinite(acts.Jr)) { // E>=0
@@ -666,12 +823,13 @@ ActionAngles actionAnglesSpherical(
 }
 
 
-ActionFinderSpherical::ActionFinderSpherical(const potential::BasePotential& potential) :
+ActionFinderSpherical::ActionFinderSpherical(const potential::BasePotential& potential,
+    bool singlePrecision, double accuracy) :
     invPhi0(1. / potential.value(coord::PosCyl(0,0,0))),
     pot(potential),
-    intJr(createActionInterpolator(pot))
+    intJr(createActionInterpolator(pot, singlePrecision, accuracy))
 #ifdef INTERPOLATE_ENERGY
-    ,intE(createEnergyInterpolator(pot, intJr))
+    ,intE(createEnergyInterpolator(pot, intJr, singlePrecision, accuracy))
 #endif
 {}
 
@@ -684,6 +842,7 @@ double ActionFinderSpherical::Jr(double E, double L, double *Omegar, double *Ome
 
 Actions ActionFinderSpherical::actions(const coord::PosVelCyl& point) const
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     Actions acts;
     double E  = pot.value(sqrt(pow_2(point.R) + pow_2(point.z))) + 
         0.5 * (pow_2(point.vR) + pow_2(point.vz) + pow_2(point.vphi));
@@ -697,6 +856,7 @@ Actions ActionFinderSpherical::actions(const coord::PosVelCyl& point) const
 ActionAngles ActionFinderSpherical::actionAngles(
     const coord::PosVelCyl& point, Frequencies* freq) const
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     Actions acts;
     double E  = pot.value(sqrt(pow_2(point.R) + pow_2(point.z))) + 
         0.5 * (pow_2(point.vR) + pow_2(point.vz) + pow_2(point.vphi));
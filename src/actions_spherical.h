@@ -61,8 +61,21 @@ coord::PosVelCyl mapSpherical(
     an arbitrary spherical potential, using 2d interpolation tables */
 class ActionFinderSpherical: public BaseActionFinder, public BaseToyMap<coord::SphMod> {
 public:
-    /// Initialize the internal interpolation tables; the potential itself is not used later on
-    explicit ActionFinderSpherical(const potential::BasePotential& potential);
+    /** Initialize the internal interpolation tables; the potential itself is not used later on.
+        \param[in]  potential  is the spherical potential;
+        \param[in]  singlePrecision  (optional, default false) whether to store the coefficients
+        of interpolation tables in single precision, halving their memory footprint
+        (the introduced relative error, typically ~1e-7, is reported in the debug log);
+        \param[in]  accuracy  (optional, default 0) if positive, the grid of interpolation tables
+        in the dimension of relative angular momentum is refined adaptively, starting from 13 nodes
+        and halving the spacing between them (up to 49 nodes) until the estimated interpolation
+        error of the scaled quantities and their derivatives drops below this value; thus a looser
+        accuracy (e.g. 1e-2) gives faster construction at the expense of ~1e-3 relative errors in
+        actions, and a tighter one (e.g. 1e-3) improves the accuracy at a higher cost.
+        Otherwise a fixed grid of 25 nodes is used, giving ~1e-4 relative errors in actions.
+    */
+    explicit ActionFinderSpherical(const potential::BasePotential& potential,
+        bool singlePrecision=false, double accuracy=0);
 
     virtual Actions actions(const coord::PosVelCyl& point) const;
     virtual ActionAngles actionAngles(const coord::PosVelCyl& point, Frequencies* freq=NULL) const;
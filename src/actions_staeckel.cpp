@@ -3,6 +3,7 @@
 #include "math_core.h"
 #include "math_fit.h"
 #include "utils.h"
+#include "utils_counters.h"
 #include <stdexcept>
 #include <algorithm>
 #include <cassert>
@@ -252,73 +253,99 @@ void AxisymFunctionFudge::evalDeriv(const double tau,
 }
 
 // -------- COMMON routines for Staeckel and Fudge action finders --------
-/** parameters for the function that computes actions and angles
-    by integrating an auxiliary function "fnc" as follows:
-    the canonical momentum is   p^2(tau) = fnc(tau) / [2 (tau-delta)^2 tau ];
-    the integrand is given by   p^n * (tau-delta)^a * tau^c  if p^2>0, otherwise 0.
+/** Integrals of the four functions of canonical momentum that enter the expressions for
+    actions and their derivatives (e.g.Sanders 2012, eqs. A1, A4-A12), taken over the same interval:
+    the canonical momentum is   p^2(tau) = fnc(tau) / [2 (tau-delta)^2 tau ],
+    and the integrands are  p,  1/[p (tau-delta)],  1/[p (tau-delta) tau]  and  1/[p (tau-delta)^2]
+    (if p^2<0, they are all zero).
 */
-class AxisymIntegrand: public math::IFunctionNoDeriv {
+struct AxisymIntegrals {
+    double p;        ///< integral of p  (actions)
+    double pinv;     ///< integral of 1/[p (tau-delta)]  (derivatives w.r.t. E)
+    double pinvtau;  ///< integral of 1/[p (tau-delta) tau]  (derivatives w.r.t. I3)
+    double pinv2;    ///< integral of 1/[p (tau-delta)^2]  (derivatives w.r.t. Lz)
+    AxisymIntegrals() : p(0), pinv(0), pinvtau(0), pinv2(0) {}
+};
+
+/** The class that computes all four integrals for actions, their derivatives, and derivatives
+    of the generating function at once, using the Gauss-Legendre quadrature in the scaled variable.
+    The auxiliary function (and hence the potential in the case of Fudge) is evaluated only once
+    at each node, and this value is shared by all integrands.
+*/
+class AxisymIntegrand {
 public:
     const AxisymFunctionBase& fnc;      ///< parameters of aux.fnc. (Staeckel or Fudge)
-    enum { nplus1, nminus1 } n;         ///< power of p: +1 or -1
-    enum { azero, aminus1, aminus2 } a; ///< power of (tau-delta): 0, -1, -2
-    enum { czero, cminus1 } c;          ///< power of tau: 0 or -1
     double nu_max, dfdnu_at_nu_max;     ///< upper limit for nu and the fnc derivative at this point
-    explicit AxisymIntegrand(const AxisymFunctionBase& d, double _nu_max) : fnc(d), nu_max(_nu_max)
+    AxisymIntegrand(const AxisymFunctionBase& d, double _nu_max) : fnc(d), nu_max(_nu_max)
     {
         fnc.evalDeriv(nu_max, NULL, &dfdnu_at_nu_max);
     }
 
-    /** integrand for the expressions for actions and their derivatives 
-        (e.g.Sanders 2012, eqs. A1, A4-A12).  It uses the auxiliary function to compute momentum,
+    /** add the values of all integrands at the point tau, multiplied by the given weight,
+        to the corresponding integrals. It uses the auxiliary function to compute momentum,
         and multiplies it by some powers of (tau-delta) and tau.
     */
-    virtual double value(const double tau) const {
+    void addValues(const double tau, const double weight, AxisymIntegrals& result) const
+    {
         assert(tau>=0);
         const coord::ProlSph& CS = fnc.point.coordsys;
         const double tauminusdelta = tau - CS.Delta2;
         const double ft = fnc(tau), p2 = ft / (2*pow_2(tauminusdelta)*tau);
-        if(p2<0)
-            return 0;
-        double result = sqrt(p2);
-        if(n==nminus1)
-            result = 1/result;
-        if(a==aminus1)
-            result /= tauminusdelta;
-        else if(a==aminus2) {
-            result /= pow_2(tauminusdelta);
-            if(tauminusdelta<0)
-                // subtract the singular component that will be integrated analytically and added later
-                result += sqrt(2 * nu_max / dfdnu_at_nu_max / (tau-nu_max)) / tauminusdelta;
+        if(!(p2>=0))
+            return;
+        const double p = sqrt(p2), pinv = 1 / (p * tauminusdelta);
+        double pinv2 = pinv / tauminusdelta;
+        if(tauminusdelta<0)
+            // subtract the singular component that will be integrated analytically and added later
+            pinv2 += sqrt(2 * nu_max / dfdnu_at_nu_max / (tau-nu_max)) / tauminusdelta;
+        // ad hoc fix to avoid problems at the boundaries of integration interval:
+        // non-finite values are replaced by zeros
+        if(isFinite(p))
+            result.p       += weight * p;
+        if(isFinite(pinv))
+            result.pinv    += weight * pinv;
+        if(isFinite(pinv / tau))
+            result.pinvtau += weight * pinv / tau;
+        if(isFinite(pinv2))
+            result.pinv2   += weight * pinv2;
+    }
+
+    /** compute the integrals on the interval  [uleft .. u]  of the original variable tau,
+        where the scaled variable y=scale(scaling, u) is in the range [0..1],
+        using the Gauss-Legendre quadrature of the given order in the scaled variable */
+    AxisymIntegrals integrate(const math::ScalingCub& scaling, const double y, int order) const
+    {
+        AxisymIntegrals result;
+        if(y==0)
+            return result;
+        // take the closest pre-computed table with at least the requested number of points
+        while(math::GLPOINTS[order] == NULL) order++;
+        double nodes[math::MAX_GL_ORDER], weights[math::MAX_GL_ORDER];
+        math::prepareIntegrationTableGL(0, y, order, nodes, weights);
+        for(int i=0; i<order; i++) {
+            double duds, tau = math::unscale(scaling, nodes[i], &duds);
+            addValues(tau, weights[i] * duds, result);
         }
-        if(c==cminus1)
-            result /= tau;
-        if(!isFinite(result))
-            result=0;  // ad hoc fix to avoid problems at the boundaries of integration interval
         return result;
     }
 
     /** limiting case of the integration interval collapsing to a single point tau,
         i.e. f(tau)~=0, f'(tau)~=0, and f''(tau)<0 (downward-curving parabola).
-        In this case, if f(tau) is in the numerator, the integral is assumed to be zero,
-        while if the integrand contains f(tau)^(-1/2), then the limiting value of the integral
-        is computed from the second derivative of f(tau) at the (single) point.
+        In this case, the integral of p is assumed to be zero, while the integrals
+        containing f(tau)^(-1/2) are computed from the second derivative of f(tau) at the point.
     */
-    double limitingIntegralValue(const double tau) const {
-        if(n==nplus1)
-            return 0;
+    AxisymIntegrals limitingIntegralValues(const double tau) const
+    {
         assert(tau>=0);
         const coord::ProlSph& CS = fnc.point.coordsys;
         const double tauminusdelta = tau - CS.Delta2;
         double fncder2;
         fnc.evalDeriv(tau, NULL, NULL, &fncder2);  // ignore f(tau) and f'(tau), only take f''(tau)
-        double result = 2*M_PI * sqrt(-tau/fncder2) * fabs(tauminusdelta);
-        if(a==aminus1)
-            result /= tauminusdelta;
-        else if(a==aminus2)
-            result /= pow_2(tauminusdelta);
-        if(c==cminus1)
-            result /= tau;
+        const double val = 2*M_PI * sqrt(-tau/fncder2) * fabs(tauminusdelta);
+        AxisymIntegrals result;
+        result.pinv    = val / tauminusdelta;
+        result.pinvtau = val / tauminusdelta / tau;
+        result.pinv2   = val / pow_2(tauminusdelta);
         return result;
     }
 };
@@ -482,46 +509,67 @@ AxisymIntLimits findIntegrationLimitsAxisym(const AxisymFunctionBase& fnc)
     return lim;
 }
 
+/** Compute the integrals over the entire range of lambda and nu, which are shared
+    between the actions and their derivatives w.r.t. integrals of motion.
+    \param[in]  integrand  is the instance of integrand class bound to the auxiliary function;
+    \param[in]  lim  are the limits of motion in auxiliary coordinate system;
+    \param[in]  useLimiting  whether to use the limiting values for the derivatives
+    if the range of lambda has collapsed to a single point (not needed if only the actions are computed);
+    \param[out] intl, intn  are the integrals over the lambda and nu ranges.
+*/
+void computeFullIntegrals(const AxisymIntegrand& integrand, const AxisymIntLimits& lim,
+    bool useLimiting, AxisymIntegrals& intl, AxisymIntegrals& intn)
+{
+    intl = useLimiting && lim.lambda_min==lim.lambda_max ?
+        integrand.limitingIntegralValues(lim.lambda_min) :
+        integrand.integrate(math::ScalingCub(lim.lambda_min, lim.lambda_max), 1, lim.integrOrder);
+    intn = integrand.integrate(math::ScalingCub(lim.nu_min, lim.nu_max), 1, lim.integrOrder);
+}
+
+/** Compute actions from the integrals of momentum over the range of tau on which it is positive,
+    separately for the "nu" and "lambda" branches (equation A1 in Sanders 2012). */
+Actions computeActions(const AxisymFunctionBase& fnc,
+    const AxisymIntegrals& intl, const AxisymIntegrals& intn)
+{
+    Actions acts;
+    acts.Jr = intl.p / M_PI;
+    // factor of 2 in Jz because we only integrate over half of the orbit (z>=0)
+    acts.Jz = intn.p / M_PI * 2;
+    acts.Jphi = fnc.Lz;
+    return acts;
+}
+
+/** Compute actions only (the most common case) */
+Actions computeActions(const AxisymFunctionBase& fnc, const AxisymIntLimits& lim)
+{
+    AxisymIntegrals intl, intn;
+    computeFullIntegrals(AxisymIntegrand(fnc, lim.nu_max), lim, false, intl, intn);
+    return computeActions(fnc, intl, intn);
+}
+
 /** Compute the derivatives of actions (Jr, Jz, Jphi) over integrals of motion (E, Lz, I3),
-    using the expressions A4-A9 in Sanders(2012).
-    A possible improvement in efficiency may be obtained by saving the values of potential
-    taken along the same integration path when computing the actions, and re-using them in this routine.
+    using the expressions A4-A9 in Sanders(2012), from the integrals over the entire range
+    of lambda and nu that are computed together with the actions themselves.
 */
-AxisymActionDerivatives computeActionDerivatives(
-    const AxisymFunctionBase& fnc, const AxisymIntLimits& lim)
+AxisymActionDerivatives computeActionDerivatives(const AxisymFunctionBase& fnc,
+    const AxisymIntLimits& lim, const AxisymIntegrand& integrand,
+    const AxisymIntegrals& intl, const AxisymIntegrals& intn)
 {
     AxisymActionDerivatives der;
-    AxisymIntegrand integrand(fnc, lim.nu_max);
-    math::ScaledIntegrand<math::ScalingCub>
-        transf_l(math::ScalingCub(lim.lambda_min, lim.lambda_max), integrand),
-        transf_n(math::ScalingCub(lim.nu_min,     lim.nu_max),     integrand);
-    integrand.n = AxisymIntegrand::nminus1;  // momentum goes into the denominator
     // derivatives w.r.t. E
-    integrand.a = AxisymIntegrand::aminus1;
-    integrand.c = AxisymIntegrand::czero;
-    der.dJrdE = (lim.lambda_min==lim.lambda_max ? 
-        integrand.limitingIntegralValue(lim.lambda_min) :
-        math::integrateGL(transf_l, 0, 1, lim.integrOrder) ) / (4*M_PI);
-    der.dJzdE = math::integrateGL(transf_n, 0, 1, lim.integrOrder) / (2*M_PI);
+    der.dJrdE  = intl.pinv / (4*M_PI);
+    der.dJzdE  = intn.pinv / (2*M_PI);
     // derivatives w.r.t. I3
-    integrand.a = AxisymIntegrand::aminus1;
-    integrand.c = AxisymIntegrand::cminus1;
-    der.dJrdI3 = - (lim.lambda_min==lim.lambda_max ? 
-        integrand.limitingIntegralValue(lim.lambda_min) :
-        math::integrateGL(transf_l, 0, 1, lim.integrOrder) ) / (4*M_PI);
-    der.dJzdI3 = -math::integrateGL(transf_n, 0, 1, lim.integrOrder) / (2*M_PI);
+    der.dJrdI3 =-intl.pinvtau / (4*M_PI);
+    der.dJzdI3 =-intn.pinvtau / (2*M_PI);
     // derivatives w.r.t. Lz
-    integrand.a = AxisymIntegrand::aminus2;
-    integrand.c = AxisymIntegrand::czero;
-    der.dJrdLz = -fnc.Lz * (lim.lambda_min==lim.lambda_max ? 
-        integrand.limitingIntegralValue(lim.lambda_min) :
-        math::integrateGL(transf_l, 0, 1, lim.integrOrder) ) / (4*M_PI);
+    der.dJrdLz =-fnc.Lz * intl.pinv2 / (4*M_PI);
     // the following integral is split into the analytically computed singular part
     // and the remaining regular part integrated numerically
     double delta_minus_nu_max = fnc.point.coordsys.Delta2 - lim.nu_max;
     double singpart = 2 * sqrt(-2 * lim.nu_max / integrand.dfdnu_at_nu_max / delta_minus_nu_max ) *
         atan(sqrt(lim.nu_max / delta_minus_nu_max));
-    der.dJzdLz = -fnc.Lz * (math::integrateGL(transf_n, 0, 1, lim.integrOrder) + singpart) / (2*M_PI);
+    der.dJzdLz = -fnc.Lz * (intn.pinv2 + singpart) / (2*M_PI);
     return der;
 }
 
@@ -529,9 +577,8 @@ AxisymActionDerivatives computeActionDerivatives(
     the matrix of action derivatives by integrals.  These quantities are independent of angles,
     and in particular, the derivatives of energy w.r.t. the three actions are the frequencies. */
 AxisymIntDerivatives computeIntDerivatives(
-    const AxisymFunctionBase& fnc, const AxisymIntLimits& lim)
+    const AxisymActionDerivatives& dJ, const AxisymIntLimits& lim)
 {
-    AxisymActionDerivatives dJ = computeActionDerivatives(fnc, lim);
     AxisymIntDerivatives der;
     // invert the matrix of derivatives
     double det  = dJ.dJrdE * dJ.dJzdI3 - dJ.dJrdI3 * dJ.dJzdE;
@@ -556,37 +603,28 @@ AxisymIntDerivatives computeIntDerivatives(
 
 /** Compute the derivatives of generating function S over integrals of motion (E, Lz, I3),
     using the expressions A10-A12 in Sanders(2012).  These quantities do depend on angles.
-    A possible improvement is to compute all three integrals for each of two directions at once,
-    saving on repetitive potential evaluations along the same paths.
+    All three integrals for each of two directions are computed at once,
+    sharing the potential evaluations along the same path.
 */
-AxisymGenFuncDerivatives computeGenFuncDerivatives(
-    const AxisymFunctionBase& fnc, const AxisymIntLimits& lim)
+AxisymGenFuncDerivatives computeGenFuncDerivatives(const AxisymFunctionBase& fnc,
+    const AxisymIntLimits& lim, const AxisymIntegrand& integrand)
 {
     const double signldot = fnc.point.lambdadot >= 0 ? +1 : -1;
     const double signndot = fnc.point.nudot * fnc.point.nu >= 0 ? +1 : -1;
+    const math::ScalingCub
+        scaling_l(lim.lambda_min, lim.lambda_max),
+        scaling_n(lim.nu_min,     lim.nu_max);
+    const double yl = math::scale(scaling_l, fnc.point.lambda);
+    const double yn = lim.nu_min==lim.nu_max ? 0 : math::scale(scaling_n, fabs(fnc.point.nu));
+    const AxisymIntegrals
+        intl = integrand.integrate(scaling_l, yl, lim.integrOrder),
+        intn = integrand.integrate(scaling_n, yn, lim.integrOrder);
     AxisymGenFuncDerivatives der;
-    AxisymIntegrand integrand(fnc, lim.nu_max);
-    math::ScaledIntegrand<math::ScalingCub>
-        transf_l(math::ScalingCub(lim.lambda_min, lim.lambda_max), integrand),
-        transf_n(math::ScalingCub(lim.nu_min,     lim.nu_max),     integrand);
-    const double yl = math::scale(transf_l.scaling, fnc.point.lambda);
-    const double yn = lim.nu_min==lim.nu_max ? 0 : math::scale(transf_n.scaling, fabs(fnc.point.nu));
-    integrand.n = AxisymIntegrand::nminus1;  // momentum goes into the denominator
     // derivatives w.r.t. E
-    integrand.a = AxisymIntegrand::aminus1;
-    integrand.c = AxisymIntegrand::czero;
-    der.dSdE =
-        signldot * math::integrateGL(transf_l, 0, yl, lim.integrOrder) / 4
-      + signndot * math::integrateGL(transf_n, 0, yn, lim.integrOrder) / 4;
+    der.dSdE  = signldot * intl.pinv / 4 + signndot * intn.pinv / 4;
     // derivatives w.r.t. I3
-    integrand.a = AxisymIntegrand::aminus1;
-    integrand.c = AxisymIntegrand::cminus1;
-    der.dSdI3 = 
-        signldot * -math::integrateGL(transf_l, 0, yl, lim.integrOrder) / 4
-      + signndot * -math::integrateGL(transf_n, 0, yn, lim.integrOrder) / 4;
-    // derivatives w.r.t. Lz
-    integrand.a = AxisymIntegrand::aminus2;
-    integrand.c = AxisymIntegrand::czero;
+    der.dSdI3 = signldot * -intl.pinvtau / 4 + signndot * -intn.pinvtau / 4;
+    // derivatives w.r.t. Lz:
     // the integral over nu is split into the analytically computed singular part
     // and the remaining regular part integrated numerically
     double delta_minus_nu_max = fnc.point.coordsys.Delta2 - lim.nu_max;
@@ -594,30 +632,11 @@ AxisymGenFuncDerivatives computeGenFuncDerivatives(
         (atan(sqrt( lim.nu_max / delta_minus_nu_max)) -
          atan(sqrt((lim.nu_max - fabs(fnc.point.nu)) / delta_minus_nu_max)));
     der.dSdLz = fnc.Lz==0 ? 0 : fnc.point.phi +
-        signldot * -fnc.Lz *  math::integrateGL(transf_l, 0, yl, lim.integrOrder) / 4
-      + signndot * -fnc.Lz * (math::integrateGL(transf_n, 0, yn, lim.integrOrder) + singpart) / 4;
+        signldot * -fnc.Lz *  intl.pinv2 / 4
+      + signndot * -fnc.Lz * (intn.pinv2 + singpart) / 4;
     return der;
 }
 
-/** Compute actions by integrating the momentum over the range of tau on which it is positive,
-    separately for the "nu" and "lambda" branches (equation A1 in Sanders 2012). */
-Actions computeActions(const AxisymFunctionBase& fnc, const AxisymIntLimits& lim)
-{
-    Actions acts;
-    AxisymIntegrand integrand(fnc, lim.nu_max);
-    math::ScaledIntegrand<math::ScalingCub>
-        transf_l(math::ScalingCub(lim.lambda_min, lim.lambda_max), integrand),
-        transf_n(math::ScalingCub(lim.nu_min,     lim.nu_max),     integrand);
-    integrand.n = AxisymIntegrand::nplus1;  // momentum goes into the numerator
-    integrand.a = AxisymIntegrand::azero;
-    integrand.c = AxisymIntegrand::czero;
-    acts.Jr = math::integrateGL(transf_l, 0, 1, lim.integrOrder) / M_PI;
-    // factor of 2 in Jz because we only integrate over half of the orbit (z>=0)
-    acts.Jz = math::integrateGL(transf_n, 0, 1, lim.integrOrder) / M_PI * 2;
-    acts.Jphi = fnc.Lz;
-    return acts;
-}
-
 /** Compute angles from the derivatives of integrals of motion and the generating function
     (equation A3 in Sanders 2012). */
 Angles computeAngles(const AxisymIntDerivatives& derI, const AxisymGenFuncDerivatives& derS,
@@ -634,6 +653,10 @@ Angles computeAngles(const AxisymIntDerivatives& derI, const AxisymGenFuncDeriva
 }
 
 /** The sequence of operations needed to compute both actions and angles.
+    The auxiliary function is evaluated only once at each node of the quadrature over the entire
+    range of lambda and nu, and these values are used for the actions and for their derivatives
+    (hence the frequencies); the integrals for the generating function, which go from the
+    pericenter to the current point, are computed in one more pass over each of the two ranges.
     Note that for a given orbit, only the derivatives of the generating function depend
     on the angles (assuming that the actions are constant); in principle, this may be used
     to skip the computation of the matrix of integral derivatives (not presently implemented).
@@ -644,9 +667,13 @@ Angles computeAngles(const AxisymIntDerivatives& derI, const AxisymGenFuncDeriva
 ActionAngles computeActionAngles(
     const AxisymFunctionBase& fnc, const AxisymIntLimits& lim, Frequencies* freq)
 {
-    Actions acts = computeActions(fnc, lim);
-    AxisymIntDerivatives derI = computeIntDerivatives(fnc, lim);
-    AxisymGenFuncDerivatives derS = computeGenFuncDerivatives(fnc, lim);
+    const AxisymIntegrand integrand(fnc, lim.nu_max);
+    AxisymIntegrals intl, intn;
+    computeFullIntegrals(integrand, lim, true, intl, intn);
+    Actions acts = computeActions(fnc, intl, intn);
+    AxisymIntDerivatives derI = computeIntDerivatives(
+        computeActionDerivatives(fnc, lim, integrand, intl, intn), lim);
+    AxisymGenFuncDerivatives derS = computeGenFuncDerivatives(fnc, lim, integrand);
     bool addPiToThetaZ = fnc.point.nudot<0 && acts.Jz!=0;
     Angles angs = computeAngles(derI, derS, addPiToThetaZ);
     if(freq!=NULL)
@@ -661,6 +688,7 @@ ActionAngles computeActionAngles(
 Actions actionsAxisymStaeckel(const potential::OblatePerfectEllipsoid& potential,
     const coord::PosVelCyl& point)
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     const AxisymFunctionStaeckel fnc = findIntegralsOfMotionOblatePerfectEllipsoid(potential, point);
     if(!isFinite(fnc.E+fnc.I3+fnc.Lz) || fnc.E>=0)
         return Actions(NAN, NAN, fnc.Lz);
@@ -671,6 +699,7 @@ Actions actionsAxisymStaeckel(const potential::OblatePerfectEllipsoid& potential
 ActionAngles actionAnglesAxisymStaeckel(const potential::OblatePerfectEllipsoid& potential,
     const coord::PosVelCyl& point, Frequencies* freq)
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     const AxisymFunctionStaeckel fnc = findIntegralsOfMotionOblatePerfectEllipsoid(potential, point);
     if(!isFinite(fnc.E+fnc.I3+fnc.Lz) || fnc.E>=0)
         return ActionAngles(Actions(NAN, NAN, fnc.Lz), Angles(NAN, NAN, NAN));
@@ -681,6 +710,7 @@ ActionAngles actionAnglesAxisymStaeckel(const potential::OblatePerfectEllipsoid&
 Actions actionsAxisymFudge(const potential::BasePotential& potential,
     const coord::PosVelCyl& point, double focalDistance)
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     if(!isAxisymmetric(potential))
         throw std::invalid_argument("Fudge approximation only works for axisymmetric potentials");
     if(focalDistance<=0)
@@ -696,6 +726,7 @@ Actions actionsAxisymFudge(const potential::BasePotential& potential,
 ActionAngles actionAnglesAxisymFudge(const potential::BasePotential& potential, 
     const coord::PosVelCyl& point, double focalDistance, Frequencies* freq)
 {
+    COUNTER_TIMER(CNT_ACTIONS);
     if(!isAxisymmetric(potential))
         throw std::invalid_argument("Fudge approximation only works for axisymmetric potentials");
     if(focalDistance<=0)
@@ -990,8 +1021,10 @@ Actions ActionFinderAxisymFudge::actions(const coord::PosVelCyl& point) const
     double fd    = fmax(0, interpD.value(xi, chi));   // focal distance
 
     // if we are not using the 3d interpolation, then compute the actions by the direct method
+    // (it is counted by the instrumentation counters there, otherwise counted here)
     if(intJr.empty())
         return actionsAxisymFudge(*pot, point, fd);
+    COUNTER_TIMER(CNT_ACTIONS);
 
     // step 2. find the third (approximate) integral of motion
     double Rcirc = interp.R_from_Lz(Lcirc);   // radius of a circular orbit with the given E
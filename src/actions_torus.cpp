@@ -2,9 +2,12 @@
 #include "math_core.h"
 #include "potential_utils.h"
 #include "utils.h"
+#include "utils_counters.h"
 #include "torus/Torus.h"
 #include "torus/Potential.h"
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
 
 namespace actions{
 
@@ -43,30 +46,341 @@ private:
     const potential::BasePotential& poten;
 };
 
-ActionMapperTorus::ActionMapperTorus(const potential::BasePotential& poten, const Actions& acts, double tol)
+namespace {
+
+/// number of tori fitted in parallel in each round when constructing a torus library;
+/// the initial guesses are taken only from tori converged in previous rounds
+static const size_t TORUS_ROUND_SIZE = 64;
+
+/// the first round of a torus library, fitted from scratch, contains one point
+/// for every so many input points (but no more than TORUS_ROUND_SIZE)
+static const size_t TORUS_POINTS_PER_SEED = 8;
+
+/// maximum relative distance in action space between the target torus and the one used
+/// as an initial guess for the fit (otherwise the fit starts from scratch)
+static const double WARM_START_MAX_DISTANCE = 0.5;
+
+/// check that the potential and the actions are suitable for constructing a torus
+void checkTorusInput(const potential::BasePotential& poten, const Actions& acts)
 {
     if(!isAxisymmetric(poten))
         throw std::invalid_argument("ActionMapperTorus only works for axisymmetric potentials");
     if(!(acts.Jr>=0 && acts.Jz>=0 && isFinite(acts.Jr+acts.Jz+acts.Jphi)))
         throw std::invalid_argument("ActionMapperTorus: invalid actions");
-    torus = torus::PtrTorus(new torus::Torus(true));
+}
+
+/** fit a torus for the given actions, either from scratch or starting from the parameters
+    of another torus (if guess is not NULL), and return the result code of the fit */
+int fitTorus(const potential::BasePotential& poten, const Actions& acts, double tol,
+    const torus::Torus* guess, torus::Torus& torus)
+{
     // the actual potential is used only during torus fitting, but not required 
     // later in angle mapping - so we create a temporary object
+    // (also it is modified during the fit, so each thread should have its own instance)
     TorusPotentialWrapper potwrap(poten);
     torus::Actions act;
     act[0] = acts.Jr;
     act[1] = acts.Jz;
     act[2] = acts.Jphi;
-    int result = torus->AutoFit(act, &potwrap, tol, 600, 150, 12, 3, 16, 200, 12,
-        utils::verbosityLevel >= utils::VL_VERBOSE);
+    const bool verbose = utils::verbosityLevel >= utils::VL_VERBOSE;
+    return guess ?
+        torus.WarmFit(act, &potwrap, *guess, tol, 600, 150, 12, 3, 16, 200, 12, verbose) :
+        torus.AutoFit(act, &potwrap, tol, 600, 150, 12, 3, 16, 200, 12, verbose);
+}
+
+/// relative distance between two points in action space, normalized by the magnitude of the first one
+inline double actionDistance(const Actions& a, const Actions& b)
+{
+    return sqrt(pow_2(a.Jr-b.Jr) + pow_2(a.Jz-b.Jz) + pow_2(fabs(a.Jphi)-fabs(b.Jphi))) /
+        (a.Jr + a.Jz + fabs(a.Jphi));
+}
+
+/// order of action magnitudes used to sort the input points
+class ActionMagnitudeComparator {
+    const std::vector<Actions>& acts;
+public:
+    explicit ActionMagnitudeComparator(const std::vector<Actions>& _acts) : acts(_acts) {}
+    bool operator()(size_t i, size_t j) const {
+        double mi = acts[i].Jr + acts[i].Jz + fabs(acts[i].Jphi);
+        double mj = acts[j].Jr + acts[j].Jz + fabs(acts[j].Jphi);
+        return mi < mj || (mi == mj && i < j);
+    }
+};
+
+/** fit tori for an array of actions in parallel, using warm starts from converged neighbours
+    (the algorithm is described in the documentation of `createTorusLibrary`);
+    the result codes of all fits are stored in the output array `status` */
+std::vector<torus::PtrTorus> fitTorusLibrary(const potential::BasePotential& poten,
+    const std::vector<Actions>& acts, double tol, /*output*/ std::vector<int>& status)
+{
+    const size_t npoints = acts.size();
+    for(size_t i=0; i<npoints; i++)
+        checkTorusInput(poten, acts[i]);
+
+    // order of processing: the first round contains points spread evenly in the sorted list
+    // of action magnitudes, and the remaining ones follow in the order of increasing magnitude,
+    // so that each subsequent torus is likely to have a converged neighbour
+    std::vector<size_t> sorted(npoints), order;
+    for(size_t i=0; i<npoints; i++)
+        sorted[i] = i;
+    std::sort(sorted.begin(), sorted.end(), ActionMagnitudeComparator(acts));
+    std::vector<bool> taken(npoints, false);
+    const size_t numFirst = std::min(TORUS_ROUND_SIZE,
+        (npoints + TORUS_POINTS_PER_SEED - 1) / TORUS_POINTS_PER_SEED);
+    for(size_t k=0; k<numFirst; k++) {
+        size_t i = (2*k+1) * npoints / (2*numFirst);
+        order.push_back(sorted[i]);
+        taken[i] = true;
+    }
+    for(size_t i=0; i<npoints; i++)
+        if(!taken[i])
+            order.push_back(sorted[i]);
+
+    std::vector<torus::PtrTorus> tori(npoints);
+    status.assign(npoints, 0);
+    std::vector<size_t> converged;   // indices of converged tori available as initial guesses
+    std::string errorMsg;
+    utils::CtrlBreakHandler cbrk;  // catch Ctrl-Break keypress
+    bool stop = false;
+    for(size_t start=0, size=numFirst; start<npoints && !stop; start+=size, size=TORUS_ROUND_SIZE) {
+        const int end = (int)std::min(npoints, start+size);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for(int k=(int)start; k<end; k++) {
+            if(stop) continue;
+            if(cbrk.triggered()) stop = true;
+            try{
+                const size_t index = order[k];
+                // find the nearest torus among those converged in previous rounds
+                const torus::Torus* guess = NULL;
+                double minDistance = WARM_START_MAX_DISTANCE;
+                for(size_t c=0; c<converged.size(); c++) {
+                    double distance = actionDistance(acts[index], acts[converged[c]]);
+                    if(distance < minDistance) {
+                        minDistance = distance;
+                        guess = tori[converged[c]].get();
+                    }
+                }
+                torus::PtrTorus tor(new torus::Torus(true));
+                status[index] = fitTorus(poten, acts[index], tol, guess, *tor);
+                tori[index] = tor;
+            }
+            catch(std::exception& e) {
+                errorMsg = e.what();
+                stop = true;
+            }
+        }
+        for(int k=(int)start; k<end; k++)
+            if(status[order[k]] == 0 && tori[order[k]])
+                converged.push_back(order[k]);
+    }
+    if(cbrk.triggered())
+        throw std::runtime_error("Keyboard interrupt");
+    if(!errorMsg.empty())
+        throw std::runtime_error("Error in fitTorusLibrary: "+errorMsg);
+    if(converged.size() < npoints)
+        utils::msg(utils::VL_WARNING, "fitTorusLibrary",
+            utils::toString(npoints-converged.size())+" out of "+utils::toString(npoints)+
+            " tori not converged");
+    return tori;
+}
+
+}  // internal namespace
+
+ActionMapperTorus::ActionMapperTorus(const potential::BasePotential& poten, const Actions& acts, double tol)
+{
+    checkTorusInput(poten, acts);
+    torus = torus::PtrTorus(new torus::Torus(true));
+    int result = fitTorus(poten, acts, tol, NULL, *torus);
     if(result!=0) {
         utils::msg(utils::VL_WARNING, "Torus", "Not converged: "+utils::toString(result));
         //torus->show(std::cout);
     }
 }
 
+ActionMapperTorus::ActionMapperTorus(const torus::PtrTorus& _torus) : torus(_torus)
+{
+    if(!torus)
+        throw std::invalid_argument("ActionMapperTorus: empty torus");
+}
+
+std::vector<PtrActionMapper> createTorusLibrary(const potential::BasePotential& poten,
+    const std::vector<Actions>& acts, double tol, std::vector<int>* status)
+{
+    std::vector<int> result;
+    std::vector<torus::PtrTorus> tori = fitTorusLibrary(poten, acts, tol, result);
+    std::vector<PtrActionMapper> mappers(tori.size());
+    for(size_t i=0; i<tori.size(); i++)
+        mappers[i] = PtrActionMapper(new ActionMapperTorus(tori[i]));
+    if(status)
+        *status = result;
+    return mappers;
+}
+
+/// parameters of a fitted torus that are interpolated between the nodes of a grid in action space
+struct TorusParams {
+    torus::vec4 TP;           ///< parameters of the toy map
+    torus::GenPar SN;         ///< coefficients of the generating function
+    torus::AngPar AP;         ///< derivatives of the generating function w.r.t. actions
+    torus::Frequencies Om;    ///< frequencies
+    std::vector<double> PP;   ///< parameters of the point transform (empty if it is not used)
+    explicit TorusParams(torus::Torus& tor) :
+        TP(tor.TP()), SN(tor.SN()), AP(tor.AP()), Om(tor.omega()),
+        PP(tor.canmap().NumberofParameters())
+    {
+        if(!PP.empty())
+            tor.canmap().parameters(&PP[0]);
+    }
+};
+
+ActionMapperTorusGrid::ActionMapperTorusGrid(const potential::BasePotential& poten,
+    const std::vector<double>& _gridJr, const std::vector<double>& _gridJz,
+    const std::vector<double>& _gridJphi, double tol) :
+    gridJr(_gridJr), gridJz(_gridJz), gridJphi(_gridJphi), numFailed(0)
+{
+    const size_t sizeR = gridJr.size(), sizez = gridJz.size(), sizep = gridJphi.size();
+    if(sizeR<2 || sizez<2 || sizep<2)
+        throw std::invalid_argument("ActionMapperTorusGrid: each grid must have at least two nodes");
+    for(size_t i=1; i<sizeR; i++)
+        if(!(gridJr[i] > gridJr[i-1]))
+            throw std::invalid_argument("ActionMapperTorusGrid: gridJr must be monotonically increasing");
+    for(size_t i=1; i<sizez; i++)
+        if(!(gridJz[i] > gridJz[i-1]))
+            throw std::invalid_argument("ActionMapperTorusGrid: gridJz must be monotonically increasing");
+    for(size_t i=1; i<sizep; i++)
+        if(!(gridJphi[i] > gridJphi[i-1]))
+            throw std::invalid_argument("ActionMapperTorusGrid: gridJphi must be monotonically increasing");
+    std::vector<Actions> acts(sizeR * sizez * sizep);
+    for(size_t ip=0; ip<sizep; ip++)
+        for(size_t iz=0; iz<sizez; iz++)
+            for(size_t iR=0; iR<sizeR; iR++)
+                acts[(ip * sizez + iz) * sizeR + iR] = Actions(gridJr[iR], gridJz[iz], gridJphi[ip]);
+    std::vector<int> status;
+    std::vector<torus::PtrTorus> tori = fitTorusLibrary(poten, acts, tol, status);
+    nodes.resize(tori.size());
+    for(size_t i=0; i<tori.size(); i++) {
+        nodes[i].reset(new TorusParams(*tori[i]));
+        numFailed += status[i] != 0;
+    }
+}
+
+coord::PosVelCyl ActionMapperTorusGrid::map(const ActionAngles& actAng, Frequencies* freq) const
+{
+    COUNTER_TIMER(CNT_ACTION_MAP);
+    const size_t sizeR = gridJr.size(), sizez = gridJz.size(), sizep = gridJphi.size();
+    const ptrdiff_t
+        iR = math::binSearch(actAng.Jr,   &gridJr  [0], sizeR),
+        iz = math::binSearch(actAng.Jz,   &gridJz  [0], sizez),
+        ip = math::binSearch(actAng.Jphi, &gridJphi[0], sizep);
+    if(iR<0 || iR>=(ptrdiff_t)sizeR-1 || iz<0 || iz>=(ptrdiff_t)sizez-1 ||
+       ip<0 || ip>=(ptrdiff_t)sizep-1)
+    {   // outside the grid (or NAN)
+        if(freq)
+            freq->Omegar = freq->Omegaz = freq->Omegaphi = NAN;
+        return coord::PosVelCyl(NAN, NAN, NAN, NAN, NAN, NAN);
+    }
+    // relative offsets of the point within the grid cell in each dimension
+    const double
+        offR = (actAng.Jr   - gridJr  [iR]) / (gridJr  [iR+1] - gridJr  [iR]),
+        offz = (actAng.Jz   - gridJz  [iz]) / (gridJz  [iz+1] - gridJz  [iz]),
+        offp = (actAng.Jphi - gridJphi[ip]) / (gridJphi[ip+1] - gridJphi[ip]);
+    // weights and parameters of tori at the 8 corners of the cell
+    double weights[8];
+    const TorusParams* corners[8];
+    int nearest = 0;
+    for(int c=0; c<8; c++) {
+        const int dR = c&1, dz = (c>>1)&1, dp = (c>>2)&1;
+        weights[c] = (dR ? offR : 1-offR) * (dz ? offz : 1-offz) * (dp ? offp : 1-offp);
+        corners[c] = nodes[((ip+dp) * sizez + iz+dz) * sizeR + iR+dR].get();
+        if(weights[c] > weights[nearest])
+            nearest = c;
+    }
+    // interpolate the parameters using only the corners with the same type of point transform
+    const size_t numPP = corners[nearest]->PP.size();
+    torus::vec4 TP(0.);
+    torus::GenPar SN;
+    torus::AngPar AP;
+    torus::Frequencies Om(0.);
+    std::vector<double> PP(numPP, 0.);
+    double sumWeights = 0;
+    for(int c=0; c<8; c++) {
+        if(weights[c] == 0 || corners[c]->PP.size() != numPP)
+            continue;
+        sumWeights += weights[c];
+        TP += corners[c]->TP * weights[c];
+        SN += corners[c]->SN * weights[c];
+        torus::AngPar ap(corners[c]->AP);
+        ap *= weights[c];
+        AP += ap;
+        Om += corners[c]->Om * weights[c];
+        for(size_t k=0; k<numPP; k++)
+            PP[k] += corners[c]->PP[k] * weights[c];
+    }
+    TP *= 1/sumWeights;
+    SN *= 1/sumWeights;
+    AP *= 1/sumWeights;
+    Om *= 1/sumWeights;
+    for(size_t k=0; k<numPP; k++)
+        PP[k] /= sumWeights;
+
+    // assemble the torus with the interpolated parameters and perform the mapping
+    torus::Torus tor(true);
+    tor.SetTP(TP);
+    tor.SetSN(SN);
+    tor.SetAP(AP);
+    if(numPP == 0)
+        tor.SetPP();
+    else
+        tor.SetPP(&PP[0]);
+    torus::Actions J;
+    J[0] = actAng.Jr;
+    J[1] = actAng.Jz;
+    J[2] = actAng.Jphi;
+    tor.SetActions(J);
+    tor.SetFrequencies(Om);
+    if(freq!=NULL) {
+        freq->Omegar   = Om[0];
+        freq->Omegaz   = Om[1];
+        freq->Omegaphi = Om[2];
+    }
+    torus::Angles ang;
+    ang[0] = actAng.thetar;
+    ang[1] = actAng.thetaz;
+    ang[2] = actAng.thetaphi;
+    torus::PSPT xv = tor.Map3D(ang);
+    return coord::PosVelCyl(xv[0], xv[1], xv[2], xv[3], xv[4], xv[5]);
+}
+
+void ActionMapperTorusGrid::mapMany(const size_t npoints, const ActionAngles actAng[],
+    coord::PosVelCyl result[], Frequencies freq[]) const
+{
+    std::string errorMsg;
+    utils::CtrlBreakHandler cbrk;  // catch Ctrl-Break keypress
+    bool stop = false;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for(int i=0; i<(int)npoints; i++) {
+        if(stop) continue;
+        if(cbrk.triggered()) stop = true;
+        try{
+            result[i] = map(actAng[i], freq ? &freq[i] : NULL);
+        }
+        catch(std::exception& e) {
+            errorMsg = e.what();
+            stop = true;
+        }
+    }
+    if(cbrk.triggered())
+        throw std::runtime_error("Keyboard interrupt");
+    if(!errorMsg.empty())
+        throw std::runtime_error("Error in ActionMapperTorusGrid: "+errorMsg);
+}
+
 coord::PosVelCyl ActionMapperTorus::map(const ActionAngles& actAng, Frequencies* freq) const
 {
+    COUNTER_TIMER(CNT_ACTION_MAP);
     // make sure that the input actions are the same as in the Torus object
     if( math::fcmp(actAng.Jr,   torus->action(0)) != 0 ||
         math::fcmp(actAng.Jz,   torus->action(1)) != 0 ||
@@ -8,6 +8,7 @@
 #include "actions_base.h"
 #include "potential_base.h"
 #include "smart.h"
+#include <vector>
 
 namespace actions {
 
@@ -18,6 +19,9 @@ public:
         the potential is not subsequently used. */
     ActionMapperTorus(const potential::BasePotential& poten, const Actions& acts, double tol=0.003);
 
+    /** Construct the mapper from an already fitted torus (e.g., one created by `createTorusLibrary`) */
+    explicit ActionMapperTorus(const torus::PtrTorus& _torus);
+
     /** Map a point in action/angle space to a position/velocity in physical space.
         Note that for this class, the values of actions are set at the constructor;
         an attempt to call this function with different set of actions will result in 
@@ -27,4 +31,80 @@ private:
     torus::PtrTorus torus;  ///< hidden implementation details
 };
 
+/// parameters of a fitted torus stored at each node of the grid in `ActionMapperTorusGrid`
+struct TorusParams;
+
+/** Interpolated torus mapper that can be used for arbitrary actions within a given range.
+    It holds a grid of tori fitted at the nodes of a rectangular grid in (Jr, Jz, Jphi),
+    and for the given actions, it linearly interpolates the parameters of the toy map,
+    the coefficients of the generating function and its derivatives w.r.t. actions, and
+    the frequencies from the 8 nodes of the grid cell containing this point (terms of the generating
+    function that are present only at some of the nodes are treated as zero at the other ones).
+    The accuracy of the mapping is thus determined by the spacing of the grid in addition to the
+    accuracy of each torus fit.  If some of the nodes use a point transform while others don't,
+    only the nodes with the same type of transform as the nearest one are used in the interpolation.
+    The tori are constructed in parallel with `createTorusLibrary`.
+*/
+class ActionMapperTorusGrid: public BaseActionMapper{
+public:
+    /** Construct the grid of tori for the given axisymmetric potential.
+        \param[in]  poten  is the potential (not used after the tori have been fitted);
+        \param[in]  gridJr, gridJz, gridJphi  are the grids in each action, which must be sorted
+        in increasing order and contain at least two nodes each (the fit fails for Jr=0,
+        so gridJr should start from a small positive value);
+        \param[in]  tol  is the required accuracy of each torus fit.
+        \throw  std::invalid_argument if the grids are incorrect or the potential is not axisymmetric.
+    */
+    ActionMapperTorusGrid(const potential::BasePotential& poten,
+        const std::vector<double>& gridJr,
+        const std::vector<double>& gridJz,
+        const std::vector<double>& gridJphi,
+        double tol=0.003);
+
+    /** Map a point in action/angle space to a position/velocity in physical space.
+        If the actions are outside the range of the grid, the output contains NAN. */
+    virtual coord::PosVelCyl map(const ActionAngles& actAng, Frequencies* freq=NULL) const;
+
+    /** Map many points in action/angle space in parallel.
+        \param[in]  npoints  is the number of points;
+        \param[in]  actAng   is the array of action/angle points of length npoints;
+        \param[out] result   is the array of position/velocity points, which must be
+        allocated by the caller and have the same length;
+        \param[out] freq  if not NULL, the frequencies are stored in this array of the same length.
+    */
+    void mapMany(const size_t npoints, const ActionAngles actAng[],
+        coord::PosVelCyl result[], Frequencies freq[]=NULL) const;
+
+    /// number of grid nodes where the torus fit has not converged
+    unsigned int numNotConverged() const { return numFailed; }
+
+private:
+    const std::vector<double> gridJr, gridJz, gridJphi;  ///< grids in each action
+    /// parameters of tori at grid nodes, ordered with Jr being the fastest-varying index
+    std::vector<shared_ptr<const TorusParams> > nodes;
+    unsigned int numFailed;  ///< number of nodes where the fit has not converged
+};
+
+/** Construct a library of tori for an array (e.g., a grid) of actions in the given potential.
+    The tori are fitted in parallel with dynamic load balancing between threads.
+    Each fit starts from the generating function, toy map parameters and frequencies of
+    the nearest (in action space) torus that has already converged, which substantially reduces
+    the number of iterations compared to a fit from scratch; if no converged torus is close enough,
+    or if the fit from this initial guess fails, the torus is fitted from scratch.
+    To make the result independent of the number of threads, the tori are processed in rounds
+    of a fixed size, and the initial guesses are taken only from tori converged in previous rounds;
+    the first round is fitted from scratch and consists of a fraction of points spread evenly
+    across the range of action magnitudes.
+    \param[in]  poten  is the axisymmetric potential (only used during the fit);
+    \param[in]  acts   is the array of actions;
+    \param[in]  tol    is the required accuracy of the fit;
+    \param[out] status if not NULL, will contain the result code of each fit (0 means success);
+    \return  the array of action mappers (instances of `ActionMapperTorus`)
+    in the same order as the input actions.
+    \throw  std::invalid_argument if the potential is not axisymmetric or some actions are invalid,
+    std::runtime_error in case of keyboard interrupt or other errors during the fit.
+*/
+std::vector<PtrActionMapper> createTorusLibrary(const potential::BasePotential& poten,
+    const std::vector<Actions>& acts, double tol=0.003, std::vector<int>* status=NULL);
+
 }  // namespace actions
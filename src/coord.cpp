@@ -3,6 +3,7 @@
 #include <cmath>
 #include <cassert>
 #include <stdexcept>
+#include <algorithm>
 
 namespace coord{
 
@@ -878,6 +879,396 @@ void evalAndConvertSph(const math::IFunction& F,
 }
 
 
+//------ batched conversion of arrays of points ------//
+
+namespace {
+
+/// number of points processed in one block in batched conversions: the scalar fix-up pass for
+/// degenerate points is performed on the same block while it is still in the cache
+static const size_t BLOCK_SIZE = 256;
+
+/// angles larger than this in absolute value are passed to the scalar sincos routine,
+/// since the quadrant index computed in the vectorized version is a 32-bit integer
+static const double SINCOS_MAX_ARG = 1e9;
+
+/// the loops over arrays of points in batched conversions have no dependencies between iterations,
+/// and the input and output arrays do not overlap, which allows the compiler to vectorize them
+#ifdef _OPENMP
+#define SIMD_LOOP _Pragma("omp simd")
+#else
+#define SIMD_LOOP
+#endif
+
+/// the difference between pi/2 and its closest double-precision value
+static const double PIO2_LOW = 6.123233995736765886130e-17;
+
+/** branch-free version of math::sincos, producing identical results for |x| < SINCOS_MAX_ARG,
+    suitable for use in vectorized loops */
+inline void sincosVec(double x, double& s, double& c)
+{
+    double y = fabs(x);
+    double z = x>=0 ? 1 : -1;
+    int quad = (int(4/M_PI * y) + 1) >> 1;
+    y -= M_PI/2 * quad;
+    double y2 = y * y;
+    double sy = y + y * (((((
+        +1.5896230157654657e-10 * y2
+        -2.5050747762857807e-8) * y2
+        +2.7557313621385725e-6) * y2
+        -1.9841269829589539e-4) * y2
+        +8.3333333333221186e-3) * y2
+        -0.1666666666666663073) * y2;
+    double cy = 1.0 + (((((
+        +2.064357075039214e-09  * y2
+        -2.755549453909573e-07) * y2
+        +2.480158051577225e-05) * y2
+        -0.0013888888877062660) * y2
+        +0.0416666666665909000) * y2
+        -0.5000000000000000000) * y2;
+    // select the output values depending on the quadrant without branches
+    double sq = quad & 1 ? cy : sy, cq = quad & 1 ? -sy : cy, sign = quad & 2 ? -1 : 1;
+    s = sq * sign * z;
+    c = cq * sign;
+}
+
+/** branch-free version of atan2 for finite arguments, suitable for use in vectorized loops;
+    uses the rational approximation from the Cephes library, accurate to ~1 ulp */
+inline double atan2Vec(double y, double x)
+{
+    double ax = fabs(x), ay = fabs(y);
+    bool swap = ay > ax;
+    double num = swap ? ax : ay, den = swap ? ay : ax;
+    double t = den > 0 ? num / den : 0;   // 0 <= t <= 1
+    // reduce the argument to |u| <= tan(pi/8)
+    bool shift = t > 0.66;
+    double u = shift ? (t-1) / (t+1) : t, u2 = u * u;
+    double p = (((
+        -8.750608600031904122785e-1 * u2
+        -1.615753718733365076637e1) * u2
+        -7.500855792314704667340e1) * u2
+        -1.228866684490136173410e2) * u2
+        -6.485021904942025371773e1;
+    double q = ((((u2
+        +2.485846490142306297962e1) * u2
+        +1.650270098316988542046e2) * u2
+        +4.328810604912902668951e2) * u2
+        +4.853903996359136964868e2) * u2
+        +1.945506571482613964425e2;
+    double a = u * u2 * p / q + u;
+    a = shift ? M_PI/4 + (a + 0.5*PIO2_LOW) : a;  // now a = atan(t), 0 <= a <= pi/4
+    a = swap  ? (M_PI/2 - a) + PIO2_LOW : a;      // angle between the vector and the x axis
+    a = std::copysign(1., x) < 0 ? (M_PI - a) + 2*PIO2_LOW : a;   // also for x=-0
+    return std::copysign(1., y) < 0 ? -a : a;
+}
+
+/// multiply two numbers, replacing {anything including INFINITY} * 0 with 0 (branch-free version)
+inline double mulVec(double x, double y) { return y==0 ? 0 : x*y; }
+
+/// scalar conversion of a single point from the array (used for degenerate cases),
+/// using toPosVel or toPos depending on whether the velocity arrays are provided
+template<typename srcCS, typename destCS>
+void convertPointScalar(size_t i, const double* const src[6], double* const dest[6])
+{
+    const bool vel = src[3] != NULL;
+    double input[6] = { src[0][i], src[1][i], src[2][i],
+        vel ? src[3][i] : 0, vel ? src[4][i] : 0, vel ? src[5][i] : 0 }, output[6];
+    if(vel)
+        toPosVel<srcCS, destCS>(PosVelT<srcCS>(input)).unpack_to(output);
+    else
+        PosVelT<destCS>(toPos<srcCS, destCS>(PosT<srcCS>(input[0], input[1], input[2])),
+            VelT<destCS>(0, 0, 0)).unpack_to(output);
+    for(int k=0; k<(vel ? 6 : 3); k++)
+        dest[k][i] = output[k];
+}
+
+}  // internal namespace
+
+template<> void toPosVelArray<Car, Cyl>(size_t npoints, const double* const src[6], double* const dest[6])
+{
+    const double *x = src[0], *y = src[1], *z = src[2], *vx = src[3], *vy = src[4], *vz = src[5];
+    double *R = dest[0], *zo = dest[1], *phi = dest[2], *vR = dest[3], *vzo = dest[4], *vphi = dest[5];
+    for(size_t start=0; start<npoints; start+=BLOCK_SIZE) {
+        const size_t end = std::min(start+BLOCK_SIZE, npoints);
+        if(vx) {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double Rc = sqrt(pow_2(x[i]) + pow_2(y[i])), invR = 1 / Rc;
+                double cosphi = x[i] * invR, sinphi = y[i] * invR;
+                R[i]    = Rc;
+                zo[i]   = z[i];
+                phi[i]  = atan2Vec(y[i], x[i]);
+                vR[i]   = vx[i] * cosphi + vy[i] * sinphi;
+                vzo[i]  = vz[i];
+                vphi[i] =-vx[i] * sinphi + vy[i] * cosphi;
+            }
+        } else {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                R[i]    = sqrt(pow_2(x[i]) + pow_2(y[i]));
+                zo[i]   = z[i];
+                phi[i]  = atan2Vec(y[i], x[i]);
+            }
+        }
+        for(size_t i=start; i<end; i++)
+            if(!(R[i] > 0 && isFinite(R[i])))
+                convertPointScalar<Car, Cyl>(i, src, dest);
+    }
+}
+
+template<> void toPosVelArray<Cyl, Car>(size_t npoints, const double* const src[6], double* const dest[6])
+{
+    const double *R = src[0], *z = src[1], *phi = src[2], *vR = src[3], *vz = src[4], *vphi = src[5];
+    double *x = dest[0], *y = dest[1], *zo = dest[2], *vx = dest[3], *vy = dest[4], *vzo = dest[5];
+    for(size_t start=0; start<npoints; start+=BLOCK_SIZE) {
+        const size_t end = std::min(start+BLOCK_SIZE, npoints);
+        if(vR) {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double sinphi, cosphi;
+                sincosVec(phi[i], sinphi, cosphi);
+                x[i]   = R[i] * cosphi;
+                y[i]   = R[i] * sinphi;
+                zo[i]  = z[i];
+                vx[i]  = vR[i] * cosphi - vphi[i] * sinphi;
+                vy[i]  = vR[i] * sinphi + vphi[i] * cosphi;
+                vzo[i] = vz[i];
+            }
+        } else {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double sinphi, cosphi;
+                sincosVec(phi[i], sinphi, cosphi);
+                x[i]   = mulVec(R[i], cosphi);
+                y[i]   = mulVec(R[i], sinphi);
+                zo[i]  = z[i];
+            }
+        }
+        for(size_t i=start; i<end; i++)
+            if(!(fabs(phi[i]) < SINCOS_MAX_ARG))
+                convertPointScalar<Cyl, Car>(i, src, dest);
+    }
+}
+
+template<> void toPosVelArray<Car, Sph>(size_t npoints, const double* const src[6], double* const dest[6])
+{
+    const double *x = src[0], *y = src[1], *z = src[2], *vx = src[3], *vy = src[4], *vz = src[5];
+    double *r = dest[0], *theta = dest[1], *phi = dest[2], *vr = dest[3], *vtheta = dest[4], *vphi = dest[5];
+    for(size_t start=0; start<npoints; start+=BLOCK_SIZE) {
+        const size_t end = std::min(start+BLOCK_SIZE, npoints);
+        if(vx) {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double R = sqrt(pow_2(x[i]) + pow_2(y[i])), rc = sqrt(pow_2(R) + pow_2(z[i]));
+                double invr = 1 / rc, temp = x[i] * vx[i] + y[i] * vy[i];
+                r[i]      = rc;
+                theta[i]  = atan2Vec(R, z[i]);
+                phi[i]    = atan2Vec(y[i], x[i]);
+                vr[i]     = (temp + z[i] * vz[i]) * invr;
+                vtheta[i] = (temp * z[i] / R - vz[i] * R) * invr;
+                vphi[i]   = (x[i] * vy[i] - y[i] * vx[i]) / R;
+            }
+        } else {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double R = sqrt(pow_2(x[i]) + pow_2(y[i]));
+                r[i]      = sqrt(pow_2(x[i]) + pow_2(y[i]) + pow_2(z[i]));
+                theta[i]  = atan2Vec(R, z[i]);
+                phi[i]    = atan2Vec(y[i], x[i]);
+            }
+        }
+        for(size_t i=start; i<end; i++)
+            if(!(x[i] != 0 || y[i] != 0) || !isFinite(r[i]))
+                convertPointScalar<Car, Sph>(i, src, dest);
+    }
+}
+
+template<> void toPosVelArray<Sph, Car>(size_t npoints, const double* const src[6], double* const dest[6])
+{
+    const double *r = src[0], *theta = src[1], *phi = src[2], *vr = src[3], *vtheta = src[4], *vphi = src[5];
+    double *x = dest[0], *y = dest[1], *z = dest[2], *vx = dest[3], *vy = dest[4], *vz = dest[5];
+    for(size_t start=0; start<npoints; start+=BLOCK_SIZE) {
+        const size_t end = std::min(start+BLOCK_SIZE, npoints);
+        if(vr) {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double sintheta, costheta, sinphi, cosphi;
+                sincosVec(theta[i], sintheta, costheta);
+                sincosVec(phi[i], sinphi, cosphi);
+                double R = r[i] * sintheta, vR = vr[i] * sintheta + vtheta[i] * costheta;
+                x[i]  = R * cosphi;
+                y[i]  = R * sinphi;
+                z[i]  = r[i] * costheta;
+                vx[i] = vR * cosphi - vphi[i] * sinphi;
+                vy[i] = vR * sinphi + vphi[i] * cosphi;
+                vz[i] = vr[i] * costheta - vtheta[i] * sintheta;
+            }
+        } else {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double sintheta, costheta, sinphi, cosphi;
+                sincosVec(theta[i], sintheta, costheta);
+                sincosVec(phi[i], sinphi, cosphi);
+                x[i]  = mulVec(r[i], sintheta * cosphi);
+                y[i]  = mulVec(r[i], sintheta * sinphi);
+                z[i]  = mulVec(r[i], costheta);
+            }
+        }
+        for(size_t i=start; i<end; i++)
+            if(!(fabs(theta[i]) < SINCOS_MAX_ARG && fabs(phi[i]) < SINCOS_MAX_ARG))
+                convertPointScalar<Sph, Car>(i, src, dest);
+    }
+}
+
+template<> void toPosVelArray<Cyl, Sph>(size_t npoints, const double* const src[6], double* const dest[6])
+{
+    const double *R = src[0], *z = src[1], *phi = src[2], *vR = src[3], *vz = src[4], *vphi = src[5];
+    double *r = dest[0], *theta = dest[1], *phio = dest[2], *vr = dest[3], *vtheta = dest[4], *vphio = dest[5];
+    for(size_t start=0; start<npoints; start+=BLOCK_SIZE) {
+        const size_t end = std::min(start+BLOCK_SIZE, npoints);
+        if(vR) {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double rc = sqrt(pow_2(R[i]) + pow_2(z[i])), invr = 1 / rc;
+                double costheta = z[i] * invr, sintheta = R[i] * invr;
+                r[i]      = rc;
+                theta[i]  = atan2Vec(R[i], z[i]);
+                phio[i]   = phi[i];
+                vr[i]     = vR[i] * sintheta + vz[i] * costheta;
+                vtheta[i] = vR[i] * costheta - vz[i] * sintheta;
+                vphio[i]  = vphi[i];
+            }
+        } else {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                r[i]      = sqrt(pow_2(R[i]) + pow_2(z[i]));
+                theta[i]  = atan2Vec(R[i], z[i]);
+                phio[i]   = phi[i];
+            }
+        }
+        for(size_t i=start; i<end; i++)
+            if(!(r[i] > 0 && isFinite(r[i])))
+                convertPointScalar<Cyl, Sph>(i, src, dest);
+    }
+}
+
+template<> void toPosVelArray<Sph, Cyl>(size_t npoints, const double* const src[6], double* const dest[6])
+{
+    const double *r = src[0], *theta = src[1], *phi = src[2], *vr = src[3], *vtheta = src[4], *vphi = src[5];
+    double *R = dest[0], *z = dest[1], *phio = dest[2], *vR = dest[3], *vz = dest[4], *vphio = dest[5];
+    for(size_t start=0; start<npoints; start+=BLOCK_SIZE) {
+        const size_t end = std::min(start+BLOCK_SIZE, npoints);
+        if(vr) {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double sintheta, costheta;
+                sincosVec(theta[i], sintheta, costheta);
+                R[i]     = r[i] * sintheta;
+                z[i]     = r[i] * costheta;
+                phio[i]  = phi[i];
+                vR[i]    = vr[i] * sintheta + vtheta[i] * costheta;
+                vz[i]    = vr[i] * costheta - vtheta[i] * sintheta;
+                vphio[i] = vphi[i];
+            }
+        } else {
+            SIMD_LOOP
+            for(size_t i=start; i<end; i++) {
+                double sintheta, costheta;
+                sincosVec(theta[i], sintheta, costheta);
+                R[i]     = mulVec(r[i], sintheta);
+                z[i]     = mulVec(r[i], costheta);
+                phio[i]  = phi[i];
+            }
+        }
+        for(size_t i=start; i<end; i++)
+            if(!(fabs(theta[i]) < SINCOS_MAX_ARG))
+                convertPointScalar<Sph, Cyl>(i, src, dest);
+    }
+}
+
+namespace {
+/// the loop of toPosProlSphArray, with or without computing the derivatives;
+/// return true if the derivatives were requested but cannot be computed for some point
+template<bool DERIV>
+bool toPosProlSphLoop(size_t npoints, const double R[], const double z[], const double phi[],
+    double D2, double lambda[], double nu[], double phio[],
+    double dlambdadR[], double dlambdadz[], double dnudR[], double dnudz[])
+{
+    int degenerate = 0;
+    // same expressions as in toPosDeriv<Cyl,ProlSph>, with branches replaced by selects
+#ifdef _OPENMP
+#pragma omp simd reduction(|:degenerate)
+#endif
+    for(size_t i=0; i<npoints; i++) {
+        double R2     = pow_2(R[i]), z2 = pow_2(z[i]);
+        double signz  = z[i]>=0 ? 1 : -1;
+        double sum    = R2+z2+D2;
+        double dif    = R2+z2-D2;
+        double sqD    = sqrt(pow_2(dif) + 4*R2*D2);
+        sqD           = z2==0 ? sum : R2==0 ? fabs(dif) : sqD;
+        double half   = 0.5 * (sqD + fabs(dif));   // lambda-Delta^2 if dif>=0, else Delta^2-|nu|
+        double other  = half>0 ? D2 * R2 / half : 0;
+        double lmd    = dif >= 0 ? half  : other;
+        double dmn    = dif >= 0 ? other : half;
+        double absnu  = 2 * D2 / (sum + sqD) * z2;
+        bool   big    = absnu*2 > D2;
+        absnu         = big ? D2 - dmn : absnu;
+        dmn           = big ? dmn : D2 - absnu;
+        lambda[i]     = D2 + lmd;
+        nu[i]         = absnu * signz;
+        phio[i]       = phi[i];
+        if(DERIV) {
+            degenerate   |= sqD==0;
+            dlambdadR[i]  = R[i] * 2*(D2 + lmd) / sqD;
+            dlambdadz[i]  = z[i] * 2*lmd        / sqD;
+            dnudR[i]      = R[i] * 2*-absnu     / sqD * signz;
+            dnudz[i]      = z[i] * 2*dmn        / sqD * signz;
+        }
+    }
+    return degenerate != 0;
+}
+}  // internal namespace
+
+void toPosProlSphArray(size_t npoints, const double* const src[3], const ProlSph& cs,
+    double* const dest[3], double* const deriv[4])
+{
+    if(deriv ?
+        toPosProlSphLoop<true >(npoints, src[0], src[1], src[2], cs.Delta2, dest[0], dest[1], dest[2],
+            deriv[0], deriv[1], deriv[2], deriv[3]) :
+        toPosProlSphLoop<false>(npoints, src[0], src[1], src[2], cs.Delta2, dest[0], dest[1], dest[2],
+            NULL, NULL, NULL, NULL) )
+        throw std::runtime_error("Error in coordinate conversion Cyl=>ProlSph: "
+            "the special case lambda = nu = Delta^2 is not implemented");
+}
+
+void Orientation::toRotated(size_t npoints, const double* const src[3], double* const dest[3]) const
+{
+    const double *x = src[0], *y = src[1], *z = src[2];
+    double *X = dest[0], *Y = dest[1], *Z = dest[2];
+    const double m0=mat[0], m1=mat[1], m2=mat[2], m3=mat[3], m4=mat[4], m5=mat[5],
+        m6=mat[6], m7=mat[7], m8=mat[8];
+    SIMD_LOOP
+    for(size_t i=0; i<npoints; i++) {
+        X[i] = m0 * x[i] + m1 * y[i] + m2 * z[i];
+        Y[i] = m3 * x[i] + m4 * y[i] + m5 * z[i];
+        Z[i] = m6 * x[i] + m7 * y[i] + m8 * z[i];
+    }
+}
+
+void Orientation::fromRotated(size_t npoints, const double* const src[3], double* const dest[3]) const
+{
+    const double *X = src[0], *Y = src[1], *Z = src[2];
+    double *x = dest[0], *y = dest[1], *z = dest[2];
+    const double m0=mat[0], m1=mat[1], m2=mat[2], m3=mat[3], m4=mat[4], m5=mat[5],
+        m6=mat[6], m7=mat[7], m8=mat[8];
+    SIMD_LOOP
+    for(size_t i=0; i<npoints; i++) {
+        x[i] = m0 * X[i] + m3 * Y[i] + m6 * Z[i];
+        y[i] = m1 * X[i] + m4 * Y[i] + m7 * Z[i];
+        z[i] = m2 * X[i] + m5 * Y[i] + m8 * Z[i];
+    }
+}
+
+
 //------ 3x3 matrix representing a [passive] rotation specified by Euler angles ------//
 
 Orientation::Orientation(double alpha, double beta, double gamma)
@@ -929,6 +929,39 @@ template<typename CoordT> double Ltotal(const PosVelT<CoordT> &p);
 /// compute the z-component of angular momentum for a point in the given coordinate system CoordT
 template<typename CoordT> double Lz(const PosVelT<CoordT> &p);
 
+///@}
+/// \name   Batched conversion of arrays of points
+///@{
+
+/** Conversion of an array of points between coordinate systems, with the data stored in
+    the structure-of-arrays layout: src[k] and dest[k], k=0..5, are arrays of length npoints
+    containing the k-th component of position/velocity in the same order as in PosVelT<CoordT>
+    (e.g., R, z, phi, vR, vz, vphi for cylindrical coordinates).
+    If only the positions need to be converted, src[3..5] and dest[3..5] should be NULL.
+    The result is the same as from toPosVel<srcCS,destCS> (or toPos<srcCS,destCS>) applied to each
+    point separately, up to roundoff errors, but the loops contain no branches or library calls,
+    so that the compiler may vectorize them (this requires OpenMP and the flag -fno-math-errno);
+    sine, cosine and atan2 are computed by polynomial approximations accurate to machine precision.
+    The few degenerate points (e.g., on the z axis or with non-finite coordinates) are converted by
+    the scalar routine. Template parameters may be any two different systems among Car, Cyl, Sph;
+    input and output arrays should not overlap. The routine is not parallelized internally,
+    and should be called from each thread for its own portion of the data.
+*/
+template<typename srcCS, typename destCS>
+void toPosVelArray(size_t npoints, const double* const src[6], double* const dest[6]);
+
+/** Batched conversion of positions from cylindrical to prolate spheroidal coordinates,
+    optionally computing the derivatives of transformation (the Jacobian matrix).
+    \param[in]  npoints  is the number of points;
+    \param[in]  src  are the three arrays with R, z, phi;
+    \param[in]  coordsys  is the prolate spheroidal coordinate system;
+    \param[out] dest  are the three arrays that receive lambda, nu, phi;
+    \param[out] deriv  if not NULL, should contain four arrays that receive
+    dlambda/dR, dlambda/dz, dnu/dR, dnu/dz  (as in PosDerivT<Cyl, ProlSph>).
+*/
+void toPosProlSphArray(size_t npoints, const double* const src[3], const ProlSph& coordsys,
+    double* const dest[3], double* const deriv[4]=NULL);
+
 ///@}
 /// \section 3d rotations
 ///@{
@@ -987,6 +1020,14 @@ public:
         result[2] = mat[2] * vec[0] + mat[5] * vec[1] + mat[8] * vec[2];
     }
 
+    /** transform an array of points stored in the structure-of-arrays layout (src[0..2] are
+        the arrays of x,y,z coordinates of length npoints, and the same for dest) from the 'original'
+        to the 'rotated' frame; the input and output arrays should not overlap */
+    void toRotated(size_t npoints, const double* const src[3], double* const dest[3]) const;
+
+    /** transform an array of points from the 'rotated' to the 'original' frame (same conventions) */
+    void fromRotated(size_t npoints, const double* const src[3], double* const dest[3]) const;
+
     /** transform the position in cartesian coordinates from the 'original' to the 'rotated' frame
         (convenience overload for PosCar) */
     PosCar toRotated(const PosCar& pos) const
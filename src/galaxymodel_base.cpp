@@ -1135,8 +1135,14 @@ void computeTotalMass(
 }
 
 
-particles::ParticleArrayCar sampleActions(
-    const GalaxyModel& model, const size_t nSamp, std::vector<actions::Actions>* actsOutput)
+namespace {
+
+/// number of particles in each chunk produced by the streaming variant of sampleActions
+static const size_t SAMPLE_CHUNK_SIZE = 65536;
+
+/// common implementation of both variants of sampleActions
+void sampleActionsImpl(const GalaxyModel& model, const size_t nSamp,
+    particles::IParticleSink<coord::PosVelCar>& output, std::vector<actions::Actions>* actsOutput)
 {
     // first sample points from the action space:
     // we use nAct << nSamp  distinct values for actions, and construct tori for these actions;
@@ -1150,74 +1156,185 @@ particles::ParticleArrayCar sampleActions(
     std::vector<actions::Actions> actions = df::sampleActions(
         model.distrFunc, nAct, &totalMass);
     assert(nAct == actions.size());
-    double pointMass = totalMass / (nAct*nAng);
-
-    // next sample angles from each torus
-    particles::ParticleArrayCar points;
-    if(actsOutput!=NULL)
-        actsOutput->clear();
-    for(size_t t=0; t<nAct && points.size()<nSamp; t++) {
-        actions::ActionMapperTorus torus(model.potential, actions[t]);
-        for(size_t a=0; a<nAng; a++) {
-            actions::Angles ang;
-            ang.thetar   = 2*M_PI*math::random();
-            ang.thetaz   = 2*M_PI*math::random();
-            ang.thetaphi = 2*M_PI*math::random();
-            coord::PosVelCar point = toPosVelCar(torus.map(actions::ActionAngles(actions[t], ang)));
-            points.add(point, pointMass * model.selFunc.value(point));
-            if(actsOutput!=NULL)
-                actsOutput->push_back(actions[t]);
+    // the last torus may be sampled with fewer than nAng points, so that the total number is nSamp
+    double pointMass = totalMass / nSamp;
+    if(actsOutput!=NULL) {
+        actsOutput->resize(nSamp);
+        for(size_t p=0; p<nSamp; p++)
+            (*actsOutput)[p] = actions[p / nAng];
+    }
+
+    // next sample angles from each torus: the tori are processed in chunks,
+    // and the tori within each chunk are constructed in parallel
+    const uint64_t seed = math::randomSeed();
+    const ptrdiff_t nActChunk = std::max<size_t>(SAMPLE_CHUNK_SIZE / nAng, 1);
+    particles::ParticleArrayCar chunk;
+    std::string errorMsg;
+    utils::CtrlBreakHandler cbrk;  // catch Ctrl-Break keypress
+    for(size_t pointBegin=0; pointBegin<nSamp; pointBegin += nActChunk * nAng) {
+        const size_t actBegin = pointBegin / nAng;
+        const size_t chunkSize = std::min(nActChunk * nAng, nSamp - pointBegin);
+        const ptrdiff_t nActThisChunk = (chunkSize - 1) / nAng + 1;
+        chunk.data.resize(chunkSize);
+        bool stop = false;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for(ptrdiff_t ta=0; ta<nActThisChunk; ta++) {
+            if(stop) continue;
+            if(cbrk.triggered()) stop = true;
+            const size_t t = actBegin + ta;
+            try{
+                actions::ActionMapperTorus torus(model.potential, actions[t]);
+                math::RandomStream rng(seed, t);  // a separate random stream for each torus
+                for(size_t a=0, p=ta*nAng; a<nAng && p<chunkSize; a++, p++) {
+                    actions::Angles ang;
+                    ang.thetar   = 2*M_PI*rng.next();
+                    ang.thetaz   = 2*M_PI*rng.next();
+                    ang.thetaphi = 2*M_PI*rng.next();
+                    coord::PosVelCar point = toPosVelCar(torus.map(actions::ActionAngles(actions[t], ang)));
+                    chunk[p] = particles::ParticleArrayCar::ElemType(
+                        point, pointMass * model.selFunc.value(point));
+                }
+            }
+            catch(std::exception& e) {
+                errorMsg = e.what();
+                stop = true;
+            }
         }
+        if(cbrk.triggered())
+            throw std::runtime_error("Keyboard interrupt");
+        if(!errorMsg.empty())
+            throw std::runtime_error("Error in sampleActions: " + errorMsg);
+        output.add(chunk);
     }
-    return points;
 }
 
+/// converts the scaled 6d samples produced by sampleNdim into position/velocity particles
+class PosVelSampleConverter: public math::ISampleSink {
+    const DFIntegrand6dim& fnc;
+    particles::IParticleSink<coord::PosVelCar>& output;
+    const size_t numSamples;
+    double pointMass;
+public:
+    PosVelSampleConverter(const DFIntegrand6dim& _fnc, size_t _numSamples,
+        particles::IParticleSink<coord::PosVelCar>& _output) :
+        fnc(_fnc), output(_output), numSamples(_numSamples), pointMass(0) {}
+    virtual void start(double integral, double /*interror*/) {
+        pointMass = integral / numSamples;
+    }
+    virtual void add(const math::Matrix<double>& samples) {
+        const ptrdiff_t size = samples.rows();
+        particles::ParticleArrayCar chunk;
+        chunk.data.resize(size);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(ptrdiff_t i=0; i<size; i++) {
+            double jac;  // not used
+            // transform from scaled vars (array of 6 numbers) to real pos/vel
+            chunk[i] = particles::ParticleArrayCar::ElemType(fnc.unscaleVars(&samples(i,0), jac), pointMass);
+        }
+        output.add(chunk);
+    }
+};
 
-particles::ParticleArrayCar samplePosVel(
-    const GalaxyModel& model, const size_t numSamples)
+/// converts the scaled 3d or 2d samples produced by sampleNdim into positions
+class DensitySampleConverter: public math::ISampleSink {
+    const potential::DensityIntegrandNdim& fnc;
+    particles::IParticleSink<coord::PosCyl>& output;
+    const size_t numSamples;
+    double pointMass;
+    /// source of random values of phi if the system is axisymmetric
+    const math::RandomStream rng;
+    /// index of the first sample in the next chunk
+    size_t numProcessed;
+public:
+    DensitySampleConverter(const potential::DensityIntegrandNdim& _fnc, size_t _numSamples,
+        particles::IParticleSink<coord::PosCyl>& _output) :
+        fnc(_fnc), output(_output), numSamples(_numSamples), pointMass(0),
+        rng(math::randomSeed()), numProcessed(0) {}
+    virtual void start(double integral, double /*interror*/) {
+        pointMass = integral / numSamples;
+    }
+    virtual void add(const math::Matrix<double>& samples) {
+        const ptrdiff_t size = samples.rows();
+        particles::ParticleArray<coord::PosCyl> chunk;
+        chunk.data.resize(size);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(ptrdiff_t i=0; i<size; i++) {
+            // if the system is axisymmetric, phi is not provided by the sampling routine
+            double scaledvars[3] = {samples(i,0), samples(i,1),
+                fnc.axisym ? rng.uniform(numProcessed + i) : samples(i,2)};
+            // transform from scaled coordinates to the real ones, and store the point into the array
+            chunk[i] = particles::ParticleArray<coord::PosCyl>::ElemType(
+                potential::unscaleCoords(scaledvars), pointMass);
+        }
+        numProcessed += size;
+        output.add(chunk);
+    }
+};
+
+}  // internal namespace
+
+particles::ParticleArrayCar sampleActions(
+    const GalaxyModel& model, const size_t numPoints, std::vector<actions::Actions>* actsOutput)
+{
+    particles::ParticleCollector<coord::PosVelCar> collector;
+    collector.particles.data.reserve(numPoints);
+    sampleActionsImpl(model, numPoints, collector, actsOutput);
+    return collector.particles;
+}
+
+void sampleActions(
+    const GalaxyModel& model, const size_t numPoints, particles::IParticleSink<coord::PosVelCar>& output)
+{
+    sampleActionsImpl(model, numPoints, output, NULL);
+}
+
+
+void samplePosVel(
+    const GalaxyModel& model, const size_t numSamples, particles::IParticleSink<coord::PosVelCar>& output)
 {
     DFIntegrand6dim fnc(model, /*separate*/ false);
-    math::Matrix<double> result;      // sampled scaled coordinates/velocities
-    double totalMass, errorMass, tmp; // total normalization of the DF and its estimated error
     double xlower[6] = {0,0,0,0,0,0}; // boundaries of sampling region in scaled coordinates
     double xupper[6] = {1,1,1,1,1,1};
-    math::sampleNdim(fnc, xlower, xupper, numSamples, result, NULL, &totalMass, &errorMass);
-    const double pointMass = totalMass / result.rows();
-    particles::ParticleArrayCar points;
-    points.data.reserve(result.rows());
-    for(size_t i=0; i<result.rows(); i++) {
-        double scaledvars[6] = {
-            result(i,0), result(i,1), result(i,2),
-            result(i,3), result(i,4), result(i,5)};
-        // transform from scaled vars (array of 6 numbers) to real pos/vel
-        points.add(fnc.unscaleVars(scaledvars, tmp), pointMass);
-    }
-    return points;
+    PosVelSampleConverter converter(fnc, numSamples, output);
+    math::sampleNdim(fnc, xlower, xupper, numSamples, converter);
 }
 
+particles::ParticleArrayCar samplePosVel(
+    const GalaxyModel& model, const size_t numSamples)
+{
+    particles::ParticleCollector<coord::PosVelCar> collector;
+    collector.particles.data.reserve(numSamples);
+    samplePosVel(model, numSamples, collector);
+    return collector.particles;
+}
 
-particles::ParticleArray<coord::PosCyl> sampleDensity(
-    const potential::BaseDensity& dens, const size_t numPoints)
+
+void sampleDensity(
+    const potential::BaseDensity& dens, const size_t numPoints,
+    particles::IParticleSink<coord::PosCyl>& output)
 {
     if(!isFinite(dens.totalMass()))   // safety precautions
         throw std::runtime_error("sampleDensity: model has infinite mass");
     potential::DensityIntegrandNdim fnc(dens, /*require the values of density to be non-negative*/true);
-    math::Matrix<double> result;      // sampled scaled coordinates
-    double totalMass, errorMass;      // total mass and its estimated error
     double xlower[3] = {0,0,0};       // boundaries of sampling region in scaled coordinates
     double xupper[3] = {1,1,1};
-    math::sampleNdim(fnc, xlower, xupper, numPoints, result, NULL, &totalMass, &errorMass);
-    const double pointMass = totalMass / result.rows();
-    particles::ParticleArray<coord::PosCyl> points;
-    points.data.reserve(result.rows());
-    for(size_t i=0; i<result.rows(); i++) {
-        // if the system is axisymmetric, phi is not provided by the sampling routine
-        double scaledvars[3] = {result(i,0), result(i,1), 
-            fnc.axisym ? math::random() : result(i,2)};
-        // transform from scaled coordinates to the real ones, and store the point into the array
-        points.add(potential::unscaleCoords(scaledvars), pointMass);
-    }
-    return points;
+    DensitySampleConverter converter(fnc, numPoints, output);
+    math::sampleNdim(fnc, xlower, xupper, numPoints, converter);
+}
+
+particles::ParticleArray<coord::PosCyl> sampleDensity(
+    const potential::BaseDensity& dens, const size_t numPoints)
+{
+    particles::ParticleCollector<coord::PosCyl> collector;
+    collector.particles.data.reserve(numPoints);
+    sampleDensity(dens, numPoints, collector);
+    return collector.particles;
 }
 
 }  // namespace
@@ -368,6 +368,18 @@ particles::ParticleArrayCar sampleActions(
     const GalaxyModel& model, const size_t numPoints,
     std::vector<actions::Actions>* actions=NULL);
 
+/** Streaming variant of the above routine: the particles are generated in chunks
+    (the tori in each chunk are constructed in parallel) and passed to the output sink,
+    so that the peak memory usage is determined by the chunk size and the list of sampled actions
+    (which is ~16 times shorter than the number of particles), rather than by the number of particles.
+    \param[in]  model  is the galaxy model;
+    \param[in]  numPoints  is the required number of samples;
+    \param[in,out]  output  is the sink receiving the particles.
+*/
+void sampleActions(
+    const GalaxyModel& model, const size_t numPoints,
+    particles::IParticleSink<coord::PosVelCar>& output);
+
 
 /** Generate N-body samples of the distribution function multiplied by the selection function
     by sampling in position/velocity space:
@@ -382,6 +394,14 @@ particles::ParticleArrayCar sampleActions(
 particles::ParticleArrayCar samplePosVel(
     const GalaxyModel& model, const size_t numPoints);
 
+/** Streaming variant of the above routine: the particles are passed to the output sink in chunks
+    as they are produced by sampleNdim, instead of being collected into a single array
+    (the memory used internally by the sampling procedure still scales with the number of points).
+*/
+void samplePosVel(
+    const GalaxyModel& model, const size_t numPoints,
+    particles::IParticleSink<coord::PosVelCar>& output);
+
 
 /** Sample the density profile by discrete points.
     \param[in]  dens  is the density model;
@@ -391,6 +411,15 @@ particles::ParticleArrayCar samplePosVel(
 particles::ParticleArray<coord::PosCyl> sampleDensity(
     const potential::BaseDensity& dens, const size_t numPoints);
 
+/** Streaming variant of the above routine: the particles are passed to the output sink in chunks.
+    To generate an N-body model with velocities, the sink may be an instance of VelocityAssigner
+    (see galaxymodel_velocitysampler.h), which in turn passes the particles to another sink,
+    e.g., particles::SnapshotStreamWriter.
+*/
+void sampleDensity(
+    const potential::BaseDensity& dens, const size_t numPoints,
+    particles::IParticleSink<coord::PosCyl>& output);
+
 
 /// Helper class for providing a BaseDensity interface to a density computed via integration over DF
 class DensityFromDF: public potential::BaseDensity{
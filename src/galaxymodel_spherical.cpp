@@ -136,11 +136,13 @@ particles::ParticleArraySph samplePosVel(
     const double pointMass = totalMass / result.rows();
     particles::ParticleArraySph points;
     points.data.reserve(result.rows());
+    const uint64_t seed = math::randomSeed();
     for(unsigned int i=0; i<result.rows(); i++) {
+        math::RandomStream rng(seed, i);  // a separate random stream for each point
         double r, v, Phi, vdir[3],
-        rtheta = acos(math::random()*2-1),
-        rphi   = 2*M_PI * math::random();
-        math::getRandomUnitVector(vdir);
+        rtheta = acos(rng.next()*2-1),
+        rphi   = 2*M_PI * rng.next();
+        math::getRandomUnitVector(vdir, rng);
         fnc.unscalerv(result(i, 0), result(i, 1), r, v, Phi);
         points.add(coord::PosVelSph(r, rtheta, rphi, v*vdir[0], v*vdir[1], v*vdir[2]), pointMass);
     }
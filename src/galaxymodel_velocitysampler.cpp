@@ -123,8 +123,65 @@ particles::ParticleArrayCar assignVelocityJeansAxi(
     return result;
 }
 
-particles::ParticleArrayCar assignVelocity(
-    const particles::ParticleArray<coord::PosCyl>& pointCoords,
+/// the velocity model used by VelocityAssigner
+class BaseVelocityModel {
+public:
+    virtual ~BaseVelocityModel() {}
+    /// assign velocities to an array of particle positions
+    virtual particles::ParticleArrayCar assign(
+        const particles::ParticleArray<coord::PosCyl>& pointCoords) const = 0;
+};
+
+namespace {
+
+/// velocities drawn from the Eddington DF
+class VelocityModelEdd: public BaseVelocityModel {
+    const potential::BasePotential& pot;
+    const potential::PhaseVolume phasevol;
+    const math::LogLogSpline df;
+    const SphericalIsotropicModelLocal model;
+public:
+    VelocityModelEdd(const math::IFunction& sphDens, const math::IFunction& sphPot,
+        const potential::BasePotential& _pot) :
+        pot(_pot), phasevol(sphPot), df(df::createSphericalIsotropicDF(sphDens, sphPot)),
+        model(phasevol, df, df) {}
+    virtual particles::ParticleArrayCar assign(
+        const particles::ParticleArray<coord::PosCyl>& pointCoords) const {
+        return assignVelocityEdd(pointCoords, pot, model);
+    }
+};
+
+/// velocities drawn from a spherical Jeans model
+class VelocityModelJeansSph: public BaseVelocityModel {
+    const potential::BasePotential& pot;
+    const math::LogLogSpline model;
+    const double beta;
+public:
+    VelocityModelJeansSph(const math::IFunction& sphDens, const math::IFunction& sphPot,
+        const potential::BasePotential& _pot, double _beta) :
+        pot(_pot), model(createJeansSphModel(sphDens, sphPot, _beta)), beta(_beta) {}
+    virtual particles::ParticleArrayCar assign(
+        const particles::ParticleArray<coord::PosCyl>& pointCoords) const {
+        return assignVelocityJeansSph(pointCoords, pot, model, beta);
+    }
+};
+
+/// velocities drawn from an axisymmetric Jeans model
+class VelocityModelJeansAxi: public BaseVelocityModel {
+    const potential::BasePotential& pot;
+    const JeansAxi model;
+public:
+    VelocityModelJeansAxi(const potential::BaseDensity& dens,
+        const potential::BasePotential& _pot, double beta, double kappa) :
+        pot(_pot), model(dens, pot, beta, kappa) {}
+    virtual particles::ParticleArrayCar assign(
+        const particles::ParticleArray<coord::PosCyl>& pointCoords) const {
+        return assignVelocityJeansAxi(pointCoords, pot, model);
+    }
+};
+
+/// construct the velocity model using one of the three methods, depending on input arguments
+shared_ptr<const BaseVelocityModel> createVelocityModel(
     const potential::BaseDensity& dens,
     const potential::BasePotential& pot,
     const double beta, const double kappa)
@@ -170,21 +227,37 @@ particles::ParticleArrayCar assignVelocity(
                 /*lmax*/0, /*mmax*/0, /*gridSizeR*/50, rmin, rmax);
             fncDens.reset(new potential::DensityWrapper(*sphDens));
         }
-        if(method == SD_EDDINGTON) {
-            const potential::PhaseVolume phasevol(*fncPot);
-            const math::LogLogSpline df = df::createSphericalIsotropicDF(*fncDens, *fncPot);
-            const SphericalIsotropicModelLocal model(phasevol, df, df);
-            return assignVelocityEdd(pointCoords, pot, model);
-        } else if(method == SD_JEANSSPH) {
-            math::LogLogSpline model = createJeansSphModel(*fncDens, *fncPot, beta);
-            return assignVelocityJeansSph(pointCoords, pot, model, beta);
-        }
-    } else if(method == SD_JEANSAXI) {
-        JeansAxi model(dens, pot, beta, kappa);
-        return assignVelocityJeansAxi(pointCoords, pot, model);
-    }
-    assert(!"assignVelocity: unknown method");
-    return particles::ParticleArrayCar();
+        if(method == SD_EDDINGTON)
+            return shared_ptr<const BaseVelocityModel>(new VelocityModelEdd(*fncDens, *fncPot, pot));
+        else
+            return shared_ptr<const BaseVelocityModel>(new VelocityModelJeansSph(*fncDens, *fncPot, pot, beta));
+    } else
+        return shared_ptr<const BaseVelocityModel>(new VelocityModelJeansAxi(dens, pot, beta, kappa));
+}
+
+}  // internal namespace
+
+particles::ParticleArrayCar assignVelocity(
+    const particles::ParticleArray<coord::PosCyl>& pointCoords,
+    const potential::BaseDensity& dens,
+    const potential::BasePotential& pot,
+    const double beta, const double kappa)
+{
+    return createVelocityModel(dens, pot, beta, kappa)->assign(pointCoords);
+}
+
+VelocityAssigner::VelocityAssigner(
+    const potential::BaseDensity& dens,
+    const potential::BasePotential& pot,
+    particles::IParticleSink<coord::PosVelCar>& _output,
+    const double beta, const double kappa)
+:
+    output(_output), model(createVelocityModel(dens, pot, beta, kappa))
+{}
+
+void VelocityAssigner::add(const particles::ParticleArray<coord::PosCyl>& chunk)
+{
+    output.add(model->assign(chunk));
 }
 
 }
@@ -19,10 +19,13 @@
     Another routine `assignVelocity()` presents a higher-level interface that automatically
     chooses between the three methods based on the provided arguments, and constructs
     the respective velocity generators internally.
+    The class `VelocityAssigner` does the same for particles arriving in chunks, e.g., from
+    the streaming variant of `sampleDensity()`.
 */
 #pragma once
 #include "potential_base.h"
 #include "particles_base.h"
+#include "smart.h"
 
 namespace galaxymodel{
 
@@ -113,4 +116,33 @@ particles::ParticleArrayCar assignVelocity(
     const potential::BasePotential& pot,
     const double beta=NAN, const double kappa=NAN);
 
+class BaseVelocityModel;  // opaque implementation of VelocityAssigner
+
+/** A particle sink that assigns velocities to the incoming particle positions, using the same
+    methods as assignVelocity(), and passes the particles with velocities to another sink.
+    The velocity model is constructed once, and the velocities for each chunk are assigned
+    in parallel. Combined with the streaming variant of sampleDensity() and a SnapshotStreamWriter,
+    this allows to create N-body initial conditions without keeping all particles in memory.
+    The density, potential and output sink must remain alive during the lifetime of this object.
+*/
+class VelocityAssigner: public particles::IParticleSink<coord::PosCyl> {
+public:
+    /** construct the velocity model.
+        \param[in]  dens, pot, beta, kappa  have the same meaning as in assignVelocity();
+        \param[in,out]  output  is the sink receiving the particles with assigned velocities.
+    */
+    VelocityAssigner(
+        const potential::BaseDensity& dens,
+        const potential::BasePotential& pot,
+        particles::IParticleSink<coord::PosVelCar>& output,
+        const double beta=NAN, const double kappa=NAN);
+
+    /// assign velocities to a chunk of particles and pass them to the output sink
+    virtual void add(const particles::ParticleArray<coord::PosCyl>& chunk);
+
+private:
+    particles::IParticleSink<coord::PosVelCar>& output;
+    shared_ptr<const BaseVelocityModel> model;
+};
+
 }
@@ -1,6 +1,7 @@
 #include "math_core.h"
 #include "math_glquadrature.h"
 #include "utils.h"
+#include "utils_counters.h"
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_min.h>
 #include <gsl/gsl_integration.h>
@@ -988,6 +989,7 @@ int integrandNdimWrapperCuba(const int *ndim, const double xscaled[],
                 xval[s] = param->xlower[d] * (1-xscaled[s]) + param->xupper[d] * xscaled[s];
         }
         param->F.evalmany(*npoints, xval, fval);
+        COUNTER_ADD(CNT_INTEGRATE_NDIM_EVAL, *npoints);
         // check if the result is not finite (not performed unless in debug mode)
         if(utils::verbosityLevel >= utils::VL_WARNING) {
             for(int i=0; i< *npoints; i++)
@@ -1027,6 +1029,7 @@ int integrandNdimWrapperCubature(unsigned int ndim, unsigned int npoints, const
     try {
         param->F.evalmany(npoints, xval, fval);
         param->numEval += npoints;
+        COUNTER_ADD(CNT_INTEGRATE_NDIM_EVAL, npoints);
         // check if the result is not finite (only performed in debug mode)
         if(utils::verbosityLevel >= utils::VL_WARNING) {
             for(unsigned int i=0; i<npoints; i++)
@@ -1053,6 +1056,7 @@ void integrateNdim(const IFunctionNdim& F, const double xlower[], const double x
     const double relToler, const unsigned int maxNumEval, 
     double result[], double outError[], int* numEval)
 {
+    COUNTER_TIMER(CNT_INTEGRATE_NDIM);
     const unsigned int numVars = F.numVars();
     const unsigned int numValues = F.numValues();
     if(numVars==0)
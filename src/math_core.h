@@ -70,6 +70,35 @@ void sincos(double x, double& s, double& c);
 template<typename NumT>
 ptrdiff_t binSearch(const NumT x, const NumT arr[], const size_t size);
 
+/** Locality-aware variant of binSearch that first checks the bin given by the hint,
+    and then its immediate neighbours, before resorting to the full binary search.
+    This is beneficial when consecutive calls are likely to land in the same or adjacent bins,
+    as happens e.g. when evaluating a spline along an orbit.
+    \param[in]  x, arr, size  are the same as in binSearch;
+    \param[in,out]  hint  is the index of the bin found in the previous call (may be arbitrary,
+    e.g., -1 initially); on output, it contains the index of the bin containing x, if the point
+    is inside the grid, otherwise it is left unchanged.
+    \returns  the same value as binSearch.
+*/
+template<typename NumT>
+inline ptrdiff_t binSearch(const NumT x, const NumT arr[], const size_t size, ptrdiff_t& hint)
+{
+    const ptrdiff_t i = hint;
+    if(i >= 0 && i+1 < static_cast<ptrdiff_t>(size)) {
+        if(x >= arr[i]) {
+            if(x < arr[i+1])
+                return i;
+            if(i+2 < static_cast<ptrdiff_t>(size) && x < arr[i+2])
+                return hint = i+1;
+        } else if(i > 0 && x >= arr[i-1])
+            return hint = i-1;
+    }
+    const ptrdiff_t index = binSearch(x, arr, size);
+    if(index >= 0 && index+1 < static_cast<ptrdiff_t>(size))
+        hint = index;
+    return index;
+}
+
 /** linearly interpolate the value y(x) between y1 and y2, for x between x1 and x2 */
 inline double linearInterp(double x, double x1, double x2, double y1, double y2) {
     return ((x-x1)*y2 + (x2-x)*y1) / (x2-x1); }
@@ -95,6 +124,16 @@ public:
         ssq += diff * (value-avg); // for computing mean and variance of weighted function values
         num++;
     }
+    /** Add all elements collected by another Averager (equivalent to adding them one by one,
+        up to roundoff errors); this may be used to combine the results of parallel computations */
+    void add(const Averager& other) {
+        if(other.num == 0) return;
+        double diff  = other.avg - avg;
+        unsigned int sum = num + other.num;
+        avg += diff * other.num / sum;
+        ssq += other.ssq + diff * diff * (1. * num * other.num / sum);
+        num  = sum;
+    }
     /** Return the mean value of all elements added so far: 
         \f$  < x > = (1/N) \sum_{i=1}^N  x_i  \f$.  */
     double mean() const { return avg; }
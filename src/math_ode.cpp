@@ -1,4 +1,5 @@
 #include "math_ode.h"
+#include "utils_counters.h"
 #include <cmath>
 #include <stdexcept>
 #include <alloca.h>
@@ -340,8 +341,10 @@ double OdeSolverDOP853::doStep(double dt)
             preverr = err;
             // if the step is rejected, make it smaller
             timeStep *= fmax(fdec, safe/fac);
+            COUNTER_ADD(CNT_ODE_REJECTED, 1);
         }
     }
+    COUNTER_ADD(CNT_ODE_STEP, 1);
 
     // make the full step, finally:
     // xt and k13 contain the solution x and its derivative at the end of the current timestep
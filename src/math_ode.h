@@ -119,6 +119,8 @@ public:
         timePrev(time), nextTimeStep(0),
         state(NDIM * 10)  // storage for the current values and derivs of x and for 8 interpolation coefs
     {}
+    /// (re-)initialize the state; the estimate of the next timestep is computed only on the first call,
+    /// and subsequent calls retain the timestep determined in the last accepted step
     virtual void init(const double stateNew[], double timeNew=NAN);
     virtual double doStep(double dt = 0);
     virtual double getSol(double t, unsigned int ind) const;
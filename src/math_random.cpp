@@ -71,6 +71,44 @@ inline uint64_t splitmix64_next(uint64_t *state) {
     return z ^ (z >> 31);
 }
 
+/// the counter-based PRNG Philox4x32-10 (Salmon, Moraes, Dror, Shaw 2011)
+static const uint32_t PHILOX_M0 = 0xD2511F53, PHILOX_M1 = 0xCD9E8D57;  // multipliers
+static const uint32_t PHILOX_W0 = 0x9E3779B9, PHILOX_W1 = 0xBB67AE85;  // Weyl sequence for the key
+static const int PHILOX_ROUNDS = 10;
+
+/// number of counters processed simultaneously in the block version (chosen to fill SIMD registers)
+static const int PHILOX_BLOCK = 8;
+
+/// apply the Philox bijection to NB counters at once: ctr[i][k] is the i-th 32-bit word of k-th counter;
+/// the loops over k are independent and are vectorized by the compiler
+template<int NB>
+inline void philoxBlock(uint32_t ctr[4][NB], const uint32_t key[2])
+{
+    uint32_t k0 = key[0], k1 = key[1];
+    for(int r=0; r<PHILOX_ROUNDS; r++) {
+        for(int k=0; k<NB; k++) {
+            uint64_t p0 = static_cast<uint64_t>(PHILOX_M0) * ctr[0][k];
+            uint64_t p1 = static_cast<uint64_t>(PHILOX_M1) * ctr[2][k];
+            uint32_t c1 = ctr[1][k], c3 = ctr[3][k];
+            ctr[0][k] = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            ctr[1][k] = static_cast<uint32_t>(p1);
+            ctr[2][k] = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            ctr[3][k] = static_cast<uint32_t>(p0);
+        }
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+/// 2^-53, conversion factor from 53-bit integer to double random numbers
+static const double TWOMINUS53 = 1./9007199254740992.;
+
+/// convert two 32-bit words into a double in [0,1) using the upper 53 bits
+inline double toDouble(uint32_t hi, uint32_t lo)
+{
+    return ((static_cast<uint64_t>(hi) << 21) ^ (lo >> 11)) * TWOMINUS53;
+}
+
 /// storage for state vectors of PRNGs (separately for each thread)
 struct RandGenStorage{
     // in the case of OpenMP, we have as many independent pseudo-random number generators
@@ -118,12 +156,99 @@ void randomize(unsigned int seed)
     randgen.randomize(seed);
 }
 
+uint64_t randomSeed()
+{
+#ifdef _OPENMP
+    uint64_t* state = &randgen.state[2 * std::min(omp_get_thread_num(), randgen.maxThreads-1)];
+#else
+    uint64_t* state = &randgen.state[0];
+#endif
+    return xoroshiro128plus_next(state);
+}
+
+//----- counter-based PRNG -----//
+
+RandomStream::RandomStream(uint64_t seed, uint64_t streamIndex) :
+    position(0)
+{
+    key[0]    = static_cast<uint32_t>(seed);
+    key[1]    = static_cast<uint32_t>(seed >> 32);
+    stream[0] = static_cast<uint32_t>(streamIndex);
+    stream[1] = static_cast<uint32_t>(streamIndex >> 32);
+}
+
+double RandomStream::uniform(uint64_t index) const
+{
+    // each counter value (index/2) produces two numbers, the parity of index selects one of them
+    uint64_t block = index >> 1;
+    uint32_t ctr[4][1] = { {static_cast<uint32_t>(block)}, {static_cast<uint32_t>(block >> 32)},
+        {stream[0]}, {stream[1]} };
+    philoxBlock<1>(ctr, key);
+    return index & 1 ? toDouble(ctr[2][0], ctr[3][0]) : toDouble(ctr[0][0], ctr[1][0]);
+}
+
+void RandomStream::uniform(uint64_t index, size_t count, double output[]) const
+{
+    size_t i = 0;
+    if(count > 0 && (index & 1)) {  // an unpaired number at the beginning
+        output[i++] = uniform(index);
+    }
+    // the remaining numbers start at an even position, and are produced in blocks
+    uint64_t block = (index + i) >> 1;
+    while(i < count) {
+        uint32_t ctr[4][PHILOX_BLOCK];
+        for(int k=0; k<PHILOX_BLOCK; k++) {
+            ctr[0][k] = static_cast<uint32_t>(block + k);
+            ctr[1][k] = static_cast<uint32_t>((block + k) >> 32);
+            ctr[2][k] = stream[0];
+            ctr[3][k] = stream[1];
+        }
+        philoxBlock<PHILOX_BLOCK>(ctr, key);
+        for(int k=0; k<PHILOX_BLOCK && i < count; k++) {
+            output[i++] = toDouble(ctr[0][k], ctr[1][k]);
+            if(i < count)
+                output[i++] = toDouble(ctr[2][k], ctr[3][k]);
+        }
+        block += PHILOX_BLOCK;
+    }
+}
+
+void RandomStream::normal(uint64_t index, size_t count, double output[]) const
+{
+    // the Box-Muller transform operates on pairs of uniform numbers starting at even positions,
+    // so we generate the enclosing range of pairs and pick up the requested elements
+    uint64_t first = index & ~static_cast<uint64_t>(1);
+    size_t offset = index - first;
+    const size_t CHUNK = 2 * PHILOX_BLOCK;
+    double buffer[CHUNK];
+    for(size_t i=0; i<count; ) {
+        size_t num = std::min(CHUNK, (offset + count - i + 1) & ~static_cast<size_t>(1));
+        uniform(first, num, buffer);
+        for(size_t k=0; k<num; k+=2) {
+            double r = sqrt(-2 * log(1 - buffer[k])), s, c;  // 1-u is in (0,1]
+            sincos(2*M_PI * buffer[k+1], s, c);
+            buffer[k]   = r * c;
+            buffer[k+1] = r * s;
+        }
+        for(size_t k=offset; k<num && i<count; k++)
+            output[i++] = buffer[k];
+        first += num;
+        offset = 0;
+    }
+}
+
+namespace {
+// the routines below are written as templates operating on either kind of generator
+inline double draw(PRNGState* state) { return random(state); }
+inline double draw(RandomStream* rng) { return rng->next(); }
+}  // internal namespace
+
 double random(PRNGState* state)
 {
     if(state == NULL) {
         // use a thread-local state vector
 #ifdef _OPENMP
-        state = &randgen.state[std::min(omp_get_thread_num(), randgen.maxThreads-1)];
+        state = &randgen.state[2 * std::min(omp_get_thread_num(), randgen.maxThreads-1)];
 #else
         state = &randgen.state[0];
 #endif
@@ -133,10 +258,13 @@ double random(PRNGState* state)
     }
 }
 
+namespace {
+
 // generate 2 random numbers with normal distribution, using the Box-Muller approach
-void getNormalRandomNumbers(double& num1, double& num2, PRNGState* state)
+template<typename RNG>
+void getNormalRandomNumbersImpl(double& num1, double& num2, RNG state)
 {
-    double u, v, p1 = random(state), p2 = random(state);
+    double u, v, p1 = draw(state), p2 = draw(state);
     if(p1>0)
         p1 = sqrt(-2*log(p1));
     sincos(2*M_PI * p2, u, v);
@@ -144,19 +272,21 @@ void getNormalRandomNumbers(double& num1, double& num2, PRNGState* state)
     num2 = p1 * v;
 }
 
-void getRandomUnitVector(double vec[3], PRNGState* state)
+template<typename RNG>
+void getRandomUnitVectorImpl(double vec[3], RNG state)
 {
-    double costh =  random(state) * 2 - 1;
+    double costh =  draw(state) * 2 - 1;
     double sinth = sqrt(1 - pow_2(costh)), sinphi, cosphi;
-    sincos(2*M_PI * random(state), sinphi, cosphi);
+    sincos(2*M_PI * draw(state), sinphi, cosphi);
     vec[0] = sinth * cosphi;
     vec[1] = sinth * sinphi;
     vec[2] = costh;
 }
 
-double getRandomPerpendicularVector(const double vec[3], double vper[3], PRNGState* state)
+template<typename RNG>
+double getRandomPerpendicularVectorImpl(const double vec[3], double vper[3], RNG state)
 {
-    double phi = random(state), sinphi, cosphi;
+    double phi = draw(state), sinphi, cosphi;
     sincos(2*M_PI * phi, sinphi, cosphi);
     if(vec[1] != 0 || vec[2] != 0) {  // input vector has a nontrivial projection in the y-z plane
         // a combination of two steps:
@@ -174,7 +304,7 @@ double getRandomPerpendicularVector(const double vec[3], double vper[3], PRNGSta
         vper[2] = sinphi;
         return fabs(vec[0]);
     } else {  // even more degenerate case of a null vector - create a random isotropic vector
-        double costh = random(state)*2-1;
+        double costh = draw(state)*2-1;
         double sinth = sqrt(1-pow_2(costh));
         vper[0] = sinth * cosphi;
         vper[1] = sinth * sinphi;
@@ -183,14 +313,15 @@ double getRandomPerpendicularVector(const double vec[3], double vper[3], PRNGSta
     }
 }
 
-void getRandomRotationMatrix(double mat[9], PRNGState* state)
+template<typename RNG>
+void getRandomRotationMatrixImpl(double mat[9], RNG state)
 {
     // the algorithm of Arvo(1992)
     double sinth, costh, sinphi, cosphi;
-    sincos(2*M_PI * random(state), sinth,  costh );
-    sincos(2*M_PI * random(state), sinphi, cosphi);
+    sincos(2*M_PI * draw(state), sinth,  costh );
+    sincos(2*M_PI * draw(state), sinphi, cosphi);
     double
-    mu = random(state) * 2,
+    mu = draw(state) * 2,
     nu = sqrt(mu),
     vx = sinphi * nu,
     vy = cosphi * nu,
@@ -210,16 +341,49 @@ void getRandomRotationMatrix(double mat[9], PRNGState* state)
     mat[8] = 1-mu;
 }
 
-void getRandomPermutation(size_t count, size_t output[], PRNGState* state)
+template<typename RNG>
+void getRandomPermutationImpl(size_t count, size_t output[], RNG state)
 {
     // Fisher-Yates algo
     for(size_t i=0; i<count; i++) {
-        size_t j = std::min(static_cast<size_t>(random(state) * (i+1)), i);
+        size_t j = std::min(static_cast<size_t>(draw(state) * (i+1)), i);
         output[i] = output[j];
         output[j] = i;
     }
 }
 
+}  // internal namespace
+
+void getNormalRandomNumbers(double& num1, double& num2, PRNGState* state) {
+    getNormalRandomNumbersImpl(num1, num2, state); }
+
+void getNormalRandomNumbers(double& num1, double& num2, RandomStream& rng) {
+    getNormalRandomNumbersImpl(num1, num2, &rng); }
+
+void getRandomUnitVector(double vec[3], PRNGState* state) {
+    getRandomUnitVectorImpl(vec, state); }
+
+void getRandomUnitVector(double vec[3], RandomStream& rng) {
+    getRandomUnitVectorImpl(vec, &rng); }
+
+double getRandomPerpendicularVector(const double vec[3], double vper[3], PRNGState* state) {
+    return getRandomPerpendicularVectorImpl(vec, vper, state); }
+
+double getRandomPerpendicularVector(const double vec[3], double vper[3], RandomStream& rng) {
+    return getRandomPerpendicularVectorImpl(vec, vper, &rng); }
+
+void getRandomRotationMatrix(double mat[9], PRNGState* state) {
+    getRandomRotationMatrixImpl(mat, state); }
+
+void getRandomRotationMatrix(double mat[9], RandomStream& rng) {
+    getRandomRotationMatrixImpl(mat, &rng); }
+
+void getRandomPermutation(size_t count, size_t output[], PRNGState* state) {
+    getRandomPermutationImpl(count, output, state); }
+
+void getRandomPermutation(size_t count, size_t output[], RandomStream& rng) {
+    getRandomPermutationImpl(count, output, &rng); }
+
 double quasiRandomHalton(size_t ind, unsigned int base)
 {
     double val = 0, fac = 1., invbase = 1./base;
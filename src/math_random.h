@@ -2,6 +2,16 @@
     \brief  pseudo- and quasi-random number generators
     \date   2015-2019
     \author Eugene Vasiliev
+
+    There are two kinds of pseudo-random number generators.
+    The first one (`random()` and related routines) is a traditional sequential PRNG,
+    whose state is either provided by the caller or is kept separately for each OpenMP thread;
+    in the latter case the output depends on the assignment of work between threads.
+    The second one (`RandomStream`) is a counter-based generator: each number is a pure function
+    of the seed, the stream index and its position (counter) in the stream. Assigning a separate
+    stream to each independent work unit (e.g., a particle) makes the results bit-for-bit identical
+    regardless of the number of threads or the order of execution, and the numbers may be produced
+    in blocks of arbitrary length with random access into the sequence.
 */
 #pragma once
 #include <cstddef>    // for NULL
@@ -69,6 +79,67 @@ void getRandomRotationMatrix(/*output*/ double mat[9], /*input/output*/ PRNGStat
 */
 void getRandomPermutation(size_t count, size_t output[], /*input/output*/ PRNGState* state=NULL);
 
+/** Counter-based pseudo-random number generator Philox4x32-10 (Salmon et al. 2011).
+    The generator is defined by a 64-bit seed (key) and a 64-bit stream index, and produces
+    a sequence of 2^64 uniformly distributed numbers for each stream; the n-th element of
+    the sequence is computed directly from (seed, stream, n), without any intermediate state.
+    Each application of the Philox bijection produces 128 random bits, which are converted into
+    two double-precision numbers with 53 bits of randomness each.
+    The block-generation routines process several counters at once in a way that allows
+    the compiler to vectorize the computation.
+*/
+class RandomStream {
+public:
+    /// create the stream with the given seed and stream index
+    explicit RandomStream(uint64_t seed=0, uint64_t stream=0);
+
+    /// return the number at the given position in the stream, uniformly distributed in [0,1)
+    double uniform(uint64_t index) const;
+
+    /// fill the output array with `count` numbers uniformly distributed in [0,1),
+    /// taken from the positions [index .. index+count-1] of the stream
+    void uniform(uint64_t index, size_t count, /*output*/ double output[]) const;
+
+    /// fill the output array with `count` numbers from the standard normal distribution,
+    /// taken from the positions [index .. index+count-1] of the stream
+    /// (each pair of consecutive uniform numbers starting at an even position
+    /// is transformed into a pair of normal numbers by the Box-Muller method)
+    void normal(uint64_t index, size_t count, /*output*/ double output[]) const;
+
+    /// return the next uniform number in the stream and advance the position
+    double next() { return uniform(position++); }
+
+    /// index of the number returned by the next call to next()
+    uint64_t position;
+
+private:
+    uint32_t key[2];     ///< two halves of the seed
+    uint32_t stream[2];  ///< two halves of the stream index (upper half of the 128-bit counter)
+};
+
+/** return a 64-bit number from the thread-local sequential PRNG (the same one as used by
+    random() without arguments), suitable as the seed for RandomStream.
+    The typical usage pattern is to obtain the seed once in the serial part of a routine,
+    and then create a separate RandomStream for each work unit in a parallel loop.
+*/
+uint64_t randomSeed();
+
+/// same as getNormalRandomNumbers, but taking the numbers from the given RandomStream
+void getNormalRandomNumbers(/*output*/ double& num1, double& num2, /*input/output*/ RandomStream& rng);
+
+/// same as getRandomUnitVector, but taking the numbers from the given RandomStream
+void getRandomUnitVector(/*output*/ double vec[3], /*input/output*/ RandomStream& rng);
+
+/// same as getRandomPerpendicularVector, but taking the numbers from the given RandomStream
+double getRandomPerpendicularVector(const double vec[3], /*output*/ double vper[3],
+    /*input/output*/ RandomStream& rng);
+
+/// same as getRandomRotationMatrix, but taking the numbers from the given RandomStream
+void getRandomRotationMatrix(/*output*/ double mat[9], /*input/output*/ RandomStream& rng);
+
+/// same as getRandomPermutation, but taking the numbers from the given RandomStream
+void getRandomPermutation(size_t count, size_t output[], /*input/output*/ RandomStream& rng);
+
 /** return a quasirandom number from the Halton sequence.
     \param[in]  index  is the index of the number (should be >0, or better > ~10-20);
     \param[in]  base   is the base of the sequence, must be a prime number;
@@ -2,12 +2,16 @@
 #include "math_core.h"  // for Averager
 #include "math_random.h"
 #include "utils.h"
+#include "utils_counters.h"
 #include <stdexcept>
 #include <cassert>
 #include <cmath>
 #include <map>
 #include <algorithm>
 #include <alloca.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace math{
 
@@ -30,6 +34,83 @@ static const int numBinsEntropy = 16;
 /// limit the number of iterations in the recursive refinement loop
 static const int maxNumIter = 50;
 
+/// number of output samples passed to ISampleSink in one chunk
+static const size_t outputChunkSize = 65536;
+
+/// minimum size of an array for which the prefix sum is computed in parallel
+static const ptrdiff_t minParallelScanSize = 65536;
+
+/// index of the random stream that provides the offset of the quasi-random sequence;
+/// distinct from stream 0 (shuffling of output samples) and from the streams identified
+/// by point indices (assignment of point coordinates in addPointsToCell)
+static const uint64_t qrngOffsetStream = static_cast<uint64_t>(-1);
+
+/** Replace each element of an integer array by the sum of all preceding elements
+    (exclusive prefix sum), and return the total sum of all elements.
+    For large arrays, the computation is OpenMP-parallelized: each thread sums up a contiguous
+    segment of the array, then the offsets of all segments are accumulated, and finally each thread
+    adds the offset to its segment. Since the elements are integers, the result does not depend
+    on the number of threads.
+*/
+template<typename T>
+T exclusiveScan(std::vector<T>& array)
+{
+    const ptrdiff_t size = array.size();
+#ifdef _OPENMP
+    if(size >= minParallelScanSize && omp_get_max_threads() > 1) {
+        std::vector<T> segmentSum(omp_get_max_threads() + 1, 0);
+        int numThreads = 1;
+#pragma omp parallel
+        {
+            const int thread = omp_get_thread_num();
+#pragma omp single
+            numThreads = omp_get_num_threads();  // implicit barrier at the end of the single block
+            const ptrdiff_t begin = size * thread / numThreads, end = size * (thread+1) / numThreads;
+            T sum = 0;
+            for(ptrdiff_t i=begin; i<end; i++)
+                sum += array[i];
+            segmentSum[thread+1] = sum;
+#pragma omp barrier
+#pragma omp single
+            for(int t=1; t<=numThreads; t++)
+                segmentSum[t] += segmentSum[t-1];
+            sum = segmentSum[thread];
+            for(ptrdiff_t i=begin; i<end; i++) {
+                T val = array[i];
+                array[i] = sum;
+                sum += val;
+            }
+        }
+        return segmentSum[numThreads];
+    }
+#endif
+    T sum = 0;
+    for(ptrdiff_t i=0; i<size; i++) {
+        T val = array[i];
+        array[i] = sum;
+        sum += val;
+    }
+    return sum;
+}
+
+/// a sink that collects all output samples into a single matrix
+class MatrixSampleSink: public ISampleSink {
+    Matrix<double>& samples;
+    size_t numRows;  ///< number of samples collected so far
+public:
+    MatrixSampleSink(Matrix<double>& _samples, size_t numSamples, size_t numDim) :
+        samples(_samples), numRows(0)
+    {
+        samples = Matrix<double>(numSamples, numDim);
+    }
+    virtual void add(const Matrix<double>& chunk)
+    {
+        assert(chunk.cols() == samples.cols() && numRows + chunk.rows() <= samples.rows());
+        std::copy(chunk.data(), chunk.data() + chunk.size(), samples.data() + numRows * samples.cols());
+        numRows += chunk.rows();
+    }
+};
+
 class Sampler {
 public:
     /** Construct an N-dimensional sampler object */
@@ -39,8 +120,9 @@ public:
     /** Create the internal array of sampling points sufficiently large for the requested output size */
     void run();
 
-    /** Draw a requested number of output samples from the array of internal samples */
-    void drawSamples(Matrix<double>& samples) const;
+    /** Draw a requested number of output samples from the array of internal samples,
+        and pass them to the output sink in chunks */
+    void drawSamples(ISampleSink& output) const;
 
     /** Return the integral of F over the entire volume, and its error estimate */
     void integral(double& value, double& error) const {
@@ -81,6 +163,20 @@ private:
             headPointIndex(-1), parentIndex(-1), childIndex(-1), splitDim(-1), weight(0) {}
     };
 
+    /// the action to be performed on a cell during refinement, determined by processCell()
+    struct CellAction {
+        /// the dimension along which the cell should be split, or -1 if it is not split
+        int splitDim;
+
+        /// the coordinate of the boundary between the two child cells (if the cell is split)
+        double boundary;
+
+        /// the number of points to be added to the cell (0 if none)
+        PointEnum numNewPoints;
+
+        CellAction() : splitDim(-1), boundary(NAN), numNewPoints(0) {}
+    };
+
     /// the N-dimensional function to work with
     const IFunctionNdim& fnc;
 
@@ -118,6 +214,15 @@ private:
     /// estimate of the error in the integral, divided by the volume
     double integError;
 
+    /// cumulative sum of weights of sample points in all cells preceding the given one
+    /// (size: Ncells+1, the last element is equal to integValue), computed in computeResult()
+    std::vector<double> cumulWeight;
+
+    /// seed of the counter-based random streams used in this instance of the sampler,
+    /// drawn once at construction; all random numbers are taken from streams derived from it,
+    /// so that the result does not depend on the number of threads
+    const uint64_t seed;
+
     /// offset (seed value) of the quasi-random number generator,
     /// assigned randomly to avoid repetition when the same sampling routine is called twice
     const size_t qrngOffset;
@@ -135,22 +240,22 @@ private:
     /** split a cell and repartition the existing sampling points in this cell between
         its children, keeping track of all associated indices/pointers.
         \param[in]  cellIndex  is the cell to split;
+        \param[in]  childIndex is the index of the first of the two child cells,
+        which must have been already allocated in the array of cells;
         \param[in]  splitDim   is the index of dimension along which to split;
         \param[in]  boundary   is the absolute coordinate along the selected dimension
         that will be the new boundary between the two child cells, used to split the list
         of points between the child cells.
+        May be called in parallel for many cells.
     */
-    void splitCell(CellEnum cellIndex, int splitDim, double boundary);
+    void splitCell(CellEnum cellIndex, CellEnum childIndex, int splitDim, double boundary);
 
-    /** choose the best dimension and boundary to split a given cell and perform the division;
+    /** choose the best dimension and boundary to split a given cell;
         the dimension along which the function varies most significantly will be split.
+        \param[in]  cellIndex  is the cell to analyze;
+        \param[out] action  will contain the split dimension and the boundary coordinate.
     */
-    void decideHowToSplitCell(CellEnum cellIndex);
-
-    /** append the given cell to the queue of cells that will be populated with new points;
-        the number of points in this cell will be doubled.
-    */
-    void addCellToQueue(CellEnum cellIndex);
+    void decideHowToSplitCell(CellEnum cellIndex, CellAction& action) const;
 
     /** determine the cell boundaries by recursively traversing the tree upwards.
         \param[in]  cellIndex is the index of the cell;
@@ -171,15 +276,26 @@ private:
     */
     void addPointsToCell(CellEnum cellIndex, PointEnum firstPointIndex, PointEnum lastPointIndex);
 
-    /** analyze the given cell and perform some action (only for leaf cells that have no child cells
+    /** analyze the given cell and decide on the action (only for leaf cells that have no child cells
         but contain some points):
         compute the maximum weight of all points belonging to this cell, and if it exceeds
-        the weight of one output sample, then either split this cell in a suitable place,
-        while repartitioning its existing points among the two child cells
+        the weight of one output sample, then either split this cell in a suitable place
         (if it contained enough points already to make a motivated choice),
-        or add this cell to the queue of cells that will be populated with new points.
+        or double the number of points in this cell.
+        Does not modify the cell, and may be called in parallel for many cells.
+    */
+    CellAction processCell(CellEnum cellIndex) const;
+
+    /** examine all cells and split or schedule for adding new points those that need refinement.
+        The child cells created by splitting are appended to the end of the cell list and are
+        examined in the next round, until no more cells are split; the list of cells that
+        will be populated with new points is stored in cellsQueue.
+        Each round proceeds in three stages: first the actions for all cells are determined
+        in parallel, then the indices of new child cells and the numbers of new points are
+        assigned by prefix sums, and finally the cells are split in parallel.
+        The outcome is identical to a sequential scan through the growing list of cells.
     */
-    void processCell(CellEnum cellIndex);
+    void refineCells();
 
     /** evaluate the value of function f(x) for the points whose coordinates are stored 
         in the pointCoords array, parallelizing the loop and guarding against exceptions.
@@ -187,6 +303,12 @@ private:
     */
     void evalFncLoop(PointEnum firstPointIndex, PointEnum lastPointIndex);
 
+    /** compute the sum of weights of all points in the given cell, and optionally
+        collect their statistics (the Averager and the maximum weight).
+        The summation order is fixed by the linked list of points in the cell.
+    */
+    double sumCellWeights(CellEnum cellIndex, Averager* avg=NULL, double* maxWeight=NULL) const;
+
     /** update the estimate of integral and its error, using all collected samples;
         return refineFactor (the ratio between maximum sample weight and the output sample weight)
     */
@@ -201,7 +323,8 @@ Sampler::Sampler(const IFunctionNdim& _fnc, const double _xlower[], const double
     xupper(_xupper, _xupper+Ndim),
     numOutputSamples(_numOutputSamples),
     cells(1),  // create the root cell
-    qrngOffset(random() * 1e6)  // starting value for the quasi-random number sequence
+    seed(randomSeed()),
+    qrngOffset(RandomStream(seed, qrngOffsetStream).uniform(0) * 1e6)  // starting value for the quasi-random number sequence
 {
 #ifdef USE_QRNG
     if(Ndim > MAX_PRIMES)  // this is only a limitation of the quasi-random number generator
@@ -218,27 +341,50 @@ Sampler::Sampler(const IFunctionNdim& _fnc, const double _xlower[], const double
     }
 }
 
+double Sampler::sumCellWeights(CellEnum cellIndex, Averager* avg, double* maxWeight) const
+{
+    // declare the accumulator variable as volatile to prevent any compiler optimizations
+    // (e.g. fused multiply-add) that may change the result between different calls:
+    // the cumulative sums must be exactly the same here and in drawSamples()
+    volatile double sum = 0;
+    for(PointEnum pointIndex = cells[cellIndex].headPointIndex;
+        pointIndex >= 0;
+        pointIndex = nextPoint[pointIndex])
+    {
+        double sampleWeight = fncValues[pointIndex] * cells[cellIndex].weight;
+        sum += sampleWeight;
+        if(avg)
+            avg->add(sampleWeight);
+        if(maxWeight)
+            *maxWeight = std::max(*maxWeight, sampleWeight);
+    }
+    return sum;
+}
+
 double Sampler::computeResult()
 {
+    // collect the statistics separately in each cell (in parallel), then combine them sequentially
+    const CellEnum numCells = cells.size();
+    std::vector<Averager> avgCells(numCells);
+    std::vector<double> maxWeightCells(numCells, 0.);
+    cumulWeight.resize(numCells+1);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for(CellEnum cellIndex = 0; cellIndex < numCells; cellIndex++)
+        cumulWeight[cellIndex+1] =
+            sumCellWeights(cellIndex, &avgCells[cellIndex], &maxWeightCells[cellIndex]);
     Averager avg;
-    // declare the accumulator variable as volatile to PREVENT auto-vectorization:
-    // the summation needs to be done exactly in the same order here and in drawSamples()
-    volatile double integ  = 0;
     double maxSampleWeight = 0;
-    for(CellEnum cellIndex = 0; cellIndex < static_cast<CellEnum>(cells.size()); cellIndex++) {
-        for(PointEnum pointIndex = cells[cellIndex].headPointIndex;
-            pointIndex >= 0;
-            pointIndex = nextPoint[pointIndex])
-        {
-            double sampleWeight = fncValues[pointIndex] * cells[cellIndex].weight;
-            avg.add(sampleWeight);
-            integ += sampleWeight;
-            maxSampleWeight = std::max(maxSampleWeight, sampleWeight);
-        }
+    cumulWeight[0] = 0;
+    for(CellEnum cellIndex = 0; cellIndex < numCells; cellIndex++) {
+        cumulWeight[cellIndex+1] += cumulWeight[cellIndex];
+        avg.add(avgCells[cellIndex]);
+        maxSampleWeight = std::max(maxSampleWeight, maxWeightCells[cellIndex]);
     }
     const size_t numPoints = fncValues.size();
     assert(numPoints == avg.count());
-    integValue = integ;  // equal to avg.mean() * numPoints to within roundoff errors
+    integValue = cumulWeight[numCells];  // equal to avg.mean() * numPoints to within roundoff errors
     integError = sqrt(avg.disp() * numPoints);
     // maximum allowed value of f(x)*w(x) is the weight of one output sample
     // (integValue/numOutputSamples); if it is larger, we need to do another iteration
@@ -274,6 +420,7 @@ void Sampler::evalFncLoop(PointEnum firstPointIndex, PointEnum lastPointIndex)
         PointEnum npoints = std::min<PointEnum>(block, lastPointIndex - pointIndex);
         try {
             fnc.evalmany(npoints, &pointCoords[pointIndex * Ndim], &fncValues[pointIndex]);
+            COUNTER_ADD(CNT_SAMPLE_NDIM_POINT, npoints);
         }
         // guard against possible exceptions, since they must not leave the OpenMP parallel section
         catch(std::exception& e) {
@@ -323,29 +470,14 @@ void Sampler::getCellBoundaries(CellEnum cellIndex, double cellXlower[], double
     }
 }
 
-void Sampler::addCellToQueue(CellEnum cellIndex)
-{
-    // get the number of samples in the cell (same number of new samples will be added)
-    double numPoints = 1. / cells[cellIndex].weight;
-    for(CellEnum index = cellIndex; index>0; index = cells[index].parentIndex)
-        numPoints *= 0.5;   // each division halves the cell volume and hence the number of points
-
-    // halve the weight of each sample point in this cell
-    cells[cellIndex].weight *= 0.5;
-
-    // schedule this cell for adding more points in the next iteration;
-    // the coordinates of these new points will be assigned later, once this queue is completed.
-    PointEnum numPrev = cellsQueue.empty() ? 0 : cellsQueue.back().second;
-    cellsQueue.push_back(std::pair<CellEnum, PointEnum>(cellIndex,
-        static_cast<PointEnum>(numPoints) + numPrev));
-}
-
 void Sampler::addPointsToCell(CellEnum cellIndex, PointEnum firstPointIndex, PointEnum lastPointIndex)
 {
     // obtain the cell boundaries into a temporary stack-allocated array
     double *cellXlower = static_cast<double*>(alloca(2*Ndim * sizeof(double)));
     double *cellXupper = cellXlower+Ndim;
     getCellBoundaries(cellIndex, cellXlower, cellXupper);
+    // the random stream is uniquely identified by the range of point indices added to this cell
+    RandomStream rng(seed, lastPointIndex);
 #ifdef USE_QRNG
     // Assign point coordinates using quasi-random numbers, but randomize the sequence of these numbers.
     // These quasi-random numbers, or low-discrepancy sequences, have a property that each element of
@@ -373,8 +505,7 @@ void Sampler::addPointsToCell(CellEnum cellIndex, PointEnum firstPointIndex, Poi
         // the permutation list is small enough to be allocated on the stack (no need to free explicitly)
         // (should be the case for all subsequent calls to this routine)
         perm = static_cast<size_t*>(alloca(count * sizeof(size_t)));
-    math::PRNGState state = lastPointIndex;     // initial seed for the PRNG
-    getRandomPermutation(count, perm, &state);  // assign the actual permutation list, no matter where it's stored
+    getRandomPermutation(count, perm, rng);  // assign the actual permutation list, no matter where it's stored
 #endif
     PointEnum nextPointInList = cells[cellIndex].headPointIndex;  // or -1 if the cell was empty
     for(PointEnum pointIndex = firstPointIndex; pointIndex < lastPointIndex; pointIndex++) {
@@ -385,7 +516,7 @@ void Sampler::addPointsToCell(CellEnum cellIndex, PointEnum firstPointIndex, Poi
 #ifdef USE_QRNG
                 quasiRandomHalton(firstPointIndex + perm[pointIndex-firstPointIndex] + qrngOffset, PRIMES[d]);
 #else
-                random(&state);
+                rng.next();
 #endif
         }
         // update the linked list of points in the cell
@@ -395,10 +526,8 @@ void Sampler::addPointsToCell(CellEnum cellIndex, PointEnum firstPointIndex, Poi
     cells[cellIndex].headPointIndex = nextPointInList;  // store the new head of the list for this cell
 }
 
-void Sampler::splitCell(CellEnum cellIndex, int splitDim, const double boundary)
+void Sampler::splitCell(CellEnum cellIndex, CellEnum childIndex, int splitDim, const double boundary)
 {
-    CellEnum childIndex = cells.size();  // the two new cells will be added at the end of the existing list
-    cells.resize(childIndex + 2);
     cells[childIndex  ].parentIndex = cellIndex;
     cells[childIndex+1].parentIndex = cellIndex;
     cells[childIndex  ].weight      = cells[cellIndex].weight;
@@ -432,7 +561,7 @@ void Sampler::splitCell(CellEnum cellIndex, int splitDim, const double boundary)
     } while(pointIndex>=0);
 }
 
-void Sampler::decideHowToSplitCell(CellEnum cellIndex)
+void Sampler::decideHowToSplitCell(CellEnum cellIndex, CellAction& action) const
 {
     // allocate temporary array on stack, to store the cell boundaries
     // and the histogram of the projection of the function in each dimension
@@ -475,12 +604,13 @@ void Sampler::decideHowToSplitCell(CellEnum cellIndex)
     assert(splitDim>=0);
 
     // split in the given direction into two equal halves
-    double coord = 0.5 * (cellXlower[splitDim] + cellXupper[splitDim]);
-    splitCell(cellIndex, splitDim, coord);
+    action.splitDim = splitDim;
+    action.boundary = 0.5 * (cellXlower[splitDim] + cellXupper[splitDim]);
 }
 
-void Sampler::processCell(CellEnum cellIndex)
+Sampler::CellAction Sampler::processCell(CellEnum cellIndex) const
 {
+    CellAction action;
     double maxFncValueCell = 0;
     size_t numPointsInCell = 0;
     for(PointEnum pointIndex = cells[cellIndex].headPointIndex;
@@ -491,17 +621,72 @@ void Sampler::processCell(CellEnum cellIndex)
         maxFncValueCell = std::max(maxFncValueCell, fncValues[pointIndex]);
     }
     if(numPointsInCell==0)
-        return;  // this is a non-leaf cell
+        return action;  // this is a non-leaf cell
 
     double refineFactor = maxFncValueCell * cells[cellIndex].weight * numOutputSamples / integValue;
 
     if(refineFactor < 1)
-        return;
+        return action;
 
     if(numPointsInCell > 2*minNumPointsInCell)
-        decideHowToSplitCell(cellIndex);
-    else
-        addCellToQueue(cellIndex);
+        decideHowToSplitCell(cellIndex, action);
+    else {
+        // get the number of samples in the cell (same number of new samples will be added)
+        double numPoints = 1. / cells[cellIndex].weight;
+        for(CellEnum index = cellIndex; index>0; index = cells[index].parentIndex)
+            numPoints *= 0.5;   // each division halves the cell volume and hence the number of points
+        action.numNewPoints = static_cast<PointEnum>(numPoints);
+    }
+    return action;
+}
+
+void Sampler::refineCells()
+{
+    cellsQueue.clear();
+    CellEnum roundBegin = 0, roundEnd = cells.size();
+    while(roundBegin < roundEnd) {
+        const CellEnum numCells = roundEnd - roundBegin;
+        std::vector<CellAction> actions(numCells);
+        // offsets of child cells, of entries in the queue, and of new points for each examined cell
+        std::vector<CellEnum> childOffset(numCells), queueOffset(numCells);
+        std::vector<PointEnum> pointOffset(numCells);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+        for(CellEnum i=0; i<numCells; i++) {
+            actions[i]     = processCell(roundBegin + i);
+            childOffset[i] = actions[i].splitDim >= 0 ? 2 : 0;
+            queueOffset[i] = actions[i].numNewPoints > 0 ? 1 : 0;
+            pointOffset[i] = actions[i].numNewPoints;
+        }
+        const CellEnum numChildren = exclusiveScan(childOffset);
+        const CellEnum numQueued   = exclusiveScan(queueOffset);
+        exclusiveScan(pointOffset);
+        const PointEnum numPrev = cellsQueue.empty() ? 0 : cellsQueue.back().second;
+        const CellEnum queueSize = cellsQueue.size();
+        // the new child cells are appended to the end of the existing list
+        cells.resize(roundEnd + numChildren);
+        cellsQueue.resize(queueSize + numQueued);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+        for(CellEnum i=0; i<numCells; i++) {
+            const CellEnum cellIndex = roundBegin + i;
+            if(actions[i].splitDim >= 0)
+                splitCell(cellIndex, roundEnd + childOffset[i], actions[i].splitDim, actions[i].boundary);
+            else if(actions[i].numNewPoints > 0) {
+                // halve the weight of each sample point in this cell
+                cells[cellIndex].weight *= 0.5;
+                // schedule this cell for adding more points in the next iteration;
+                // the coordinates of these new points will be assigned later, once this queue is completed.
+                cellsQueue[queueSize + queueOffset[i]] = std::pair<CellEnum, PointEnum>(cellIndex,
+                    numPrev + pointOffset[i] + actions[i].numNewPoints);
+            }
+        }
+        // the next round examines the newly created child cells
+        roundBegin = roundEnd;
+        roundEnd   = cells.size();
+    }
 }
 
 void Sampler::run()
@@ -527,11 +712,7 @@ void Sampler::run()
             throw std::runtime_error("Keyboard interrupt");
         // Loop over all cells and check if there are enough sample points in the cell;
         // if not, either split the cell in two halves or schedule this cell for adding more points later.
-        // The newly added cells (after splitting) are appended to the end of the cell list,
-        // therefore the list is gradually growing, and this loop must be done sequentially.
-        cellsQueue.clear();
-        for(CellEnum cellIndex=0; cellIndex < static_cast<CellEnum>(cells.size()); cellIndex++)
-            processCell(cellIndex);
+        refineCells();
         assert(!cellsQueue.empty());
         // find out how many new samples do we need to add, and extend the relevant arrays
         PointEnum numPointsExisting = fncValues.size();
@@ -563,56 +744,115 @@ void Sampler::run()
         "Error in sampleNdim: refinement procedure did not converge");
 }
 
-void Sampler::drawSamples(Matrix<double>& outputSamples) const
+/// number of output samples whose threshold of cumulative weight, (k+0.5) * outputSampleWeight,
+/// does not exceed the given value (but no more than maxCount)
+inline size_t numThresholdsBelow(double cumulWeight, double outputSampleWeight, size_t maxCount)
+{
+    // initial guess, which is then corrected to agree exactly with the comparison used in drawSamples
+    size_t count = static_cast<size_t>(std::max(0., cumulWeight / outputSampleWeight + 0.5));
+    while(count > 0 && ((count-1)+0.5) * outputSampleWeight > cumulWeight)
+        count--;
+    while(count < maxCount && (count+0.5) * outputSampleWeight <= cumulWeight)
+        count++;
+    return std::min(count, maxCount);
+}
+
+void Sampler::drawSamples(ISampleSink& output) const
 {
     // number of internal samples already taken
     const size_t numPoints = fncValues.size();
     assert(pointCoords.size() == numPoints * Ndim);
+    const CellEnum numCells = cells.size();
+    assert(cumulWeight.size() == cells.size() + 1);
     const double outputSampleWeight = integValue / numOutputSamples;
-    volatile double partialSum = 0;  // accumulates the sum of f(x_i) w(x_i) for i=0..{current value}
-    size_t outputIndex = 0;
-    outputSamples = math::Matrix<double>(numOutputSamples, Ndim);
-    // construct a random permutation of internal samples to erase the original order
-    std::vector<size_t> permutation(numOutputSamples);
-    getRandomPermutation(numOutputSamples, &permutation.front());
-    // loop over internal samples and pick up some of them for output
-    for(CellEnum cellIndex = 0; cellIndex < static_cast<CellEnum>(cells.size()); cellIndex++) {
-        PointEnum pointIndex = cells[cellIndex].headPointIndex;
-        while(pointIndex >= 0) {
+    // Pick up internal samples for output: consider the cumulative sum of f(x_i) w(x_i) for all points
+    // in the order of the cells and the points in each cell, and select the points at which
+    // it crosses the values (k+0.5) * outputSampleWeight, k=0..numOutputSamples-1.
+    // The cumulative sums at the cell boundaries have been computed in computeResult(),
+    // hence the indices of output samples in each cell are known in advance,
+    // and the cells may be processed in parallel.
+    std::vector<PointEnum> selected(numOutputSamples);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for(CellEnum cellIndex = 0; cellIndex < numCells; cellIndex++) {
+        size_t outputIndex = numThresholdsBelow(cumulWeight[cellIndex],   outputSampleWeight, numOutputSamples);
+        size_t outputEnd   = numThresholdsBelow(cumulWeight[cellIndex+1], outputSampleWeight, numOutputSamples);
+        if(outputIndex == outputEnd)
+            continue;   // no output samples in this cell
+        // accumulate the partial sum in the same order and in the same way as in sumCellWeights()
+        volatile double partialSum = 0;
+        for(PointEnum pointIndex = cells[cellIndex].headPointIndex;
+            pointIndex >= 0;
+            pointIndex = nextPoint[pointIndex])
+        {
             double sampleWeight = fncValues[pointIndex] * cells[cellIndex].weight;
             assert(sampleWeight <= outputSampleWeight);  // has been guaranteed by run()
             partialSum += sampleWeight;
-            if(partialSum >= (outputIndex+0.5) * outputSampleWeight) {
-                for(int d=0; d<Ndim; d++)
-                    outputSamples(permutation[outputIndex], d) = pointCoords[pointIndex * Ndim + d];
-                outputIndex++;
-            }
-            pointIndex = nextPoint[pointIndex];
+            double sum = cumulWeight[cellIndex] + partialSum;
+            while(outputIndex < outputEnd && (outputIndex+0.5) * outputSampleWeight <= sum)
+                selected[outputIndex++] = pointIndex;
         }
+        assert(outputIndex == outputEnd);
+    }
+    assert(numThresholdsBelow(integValue, outputSampleWeight, numOutputSamples) == numOutputSamples);
+
+    // shuffle the selected samples to erase the original order (Fisher-Yates algorithm)
+    RandomStream rng(seed, 0);
+    const size_t numRandom = 1024;
+    double randoms[numRandom];
+    for(size_t i=1; i<numOutputSamples; i++) {
+        size_t k = (i-1) % numRandom;
+        if(k == 0)  // generate the next block of random numbers
+            rng.uniform(i, numRandom, randoms);
+        size_t j = std::min(static_cast<size_t>(randoms[k] * (i+1)), i);
+        std::swap(selected[i], selected[j]);
+    }
+
+    // pass the coordinates of selected samples to the output in chunks
+    for(size_t chunkBegin = 0; chunkBegin < numOutputSamples; chunkBegin += outputChunkSize) {
+        const ptrdiff_t chunkSize = std::min(outputChunkSize, numOutputSamples - chunkBegin);
+        Matrix<double> chunk(chunkSize, Ndim);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(ptrdiff_t i=0; i<chunkSize; i++)
+            std::copy(&pointCoords[selected[chunkBegin+i] * Ndim],
+                &pointCoords[selected[chunkBegin+i] * Ndim] + Ndim, &chunk(i, 0));
+        output.add(chunk);
     }
-    assert(outputIndex == numOutputSamples);
 }
 
 }  // unnamed namespace
 
 void sampleNdim(const IFunctionNdim& fnc, const double xlower[], const double xupper[], 
     const size_t numSamples,
-    Matrix<double>& samples, size_t* numTrialPoints, double* integral, double* interror)
+    ISampleSink& output, size_t* numTrialPoints, double* integral, double* interror)
 {
+    COUNTER_TIMER(CNT_SAMPLE_NDIM);
     if(fnc.numValues() != 1)
         throw std::invalid_argument("sampleNdim: function must provide one value");
     Sampler sampler(fnc, xlower, xupper, numSamples);
     sampler.run();
-    sampler.drawSamples(samples);
+    double value, error;
+    sampler.integral(value, error);
+    output.start(value, error);
+    sampler.drawSamples(output);
     // statistics
     if(numTrialPoints!=NULL)
         *numTrialPoints = sampler.numCalls();
-    if(integral!=NULL) {
-        double err;
-        sampler.integral(*integral, err);
-        if(interror!=NULL)
-            *interror = err;
-    }
+    if(integral!=NULL)
+        *integral = value;
+    if(interror!=NULL)
+        *interror = error;
+}
+
+void sampleNdim(const IFunctionNdim& fnc, const double xlower[], const double xupper[], 
+    const size_t numSamples,
+    Matrix<double>& samples, size_t* numTrialPoints, double* integral, double* interror)
+{
+    MatrixSampleSink output(samples, numSamples, fnc.numVars());
+    sampleNdim(fnc, xlower, xupper, numSamples, output, numTrialPoints, integral, interror);
 }
 
 }  // namespace
@@ -36,4 +36,31 @@ void sampleNdim(const IFunctionNdim& F, const double xlower[], const double xupp
     const size_t numSamples,
     Matrix<double>& samples, size_t* numTrialPoints=NULL, double* integral=NULL, double* interror=NULL);
 
+/** Interface for receiving the output of sampleNdim in chunks (streaming mode) */
+class ISampleSink {
+public:
+    virtual ~ISampleSink() {}
+    /** Called once before the first chunk of samples, providing the Monte Carlo estimate of
+        the integral of F over the region and its error (the same values that are returned by
+        sampleNdim); each sample carries an equal fraction of the integral.
+        The default implementation does nothing. */
+    virtual void start(double /*integral*/, double /*interror*/) {}
+    /** Receive the next chunk of samples: a matrix with N columns and a number of rows
+        (at most 65536) that sum up to the total number of samples over all calls.
+        The calls are made sequentially (not from a parallel section). */
+    virtual void add(const Matrix<double>& samples) = 0;
+};
+
+/** Sample points from an N-dimensional probability distribution function F, same as above,
+    but pass the output samples to the sink in chunks instead of returning a single matrix.
+    This reduces the peak memory usage when the number of samples is very large.
+    The samples are produced in the same (random) order as in the other variant of this routine.
+    \param[in]  F, xlower, xupper, numSamples  are the same as above;
+    \param[in,out] output  is the sink receiving the samples;
+    \param[out] numTrialPoints, integral, interror  are the same as above.
+*/
+void sampleNdim(const IFunctionNdim& F, const double xlower[], const double xupper[],
+    const size_t numSamples,
+    ISampleSink& output, size_t* numTrialPoints=NULL, double* integral=NULL, double* interror=NULL);
+
 }  // namespace
\ No newline at end of file
@@ -667,9 +667,166 @@ inline void checkFinite2d(const std::vector<double>& arr, const size_t ysize,
                 utils::toString(arr[k]) + ")\n" + utils::stacktrace());
 }
 
+/// concatenate several arrays of spline coefficients of equal length into a single-precision array,
+/// and release the memory occupied by the original double-precision arrays
+void storeCoefsAsFloat(std::vector<double>* arrays[], int numArrays, std::vector<float>& result)
+{
+    const size_t size = arrays[0]->size();
+    result.resize(size * numArrays);
+    for(int k=0; k<numArrays; k++) {
+        assert(arrays[k]->size() == size);
+        for(size_t i=0; i<size; i++)
+            result[k * size + i] = static_cast<float>((*arrays[k])[i]);
+        std::vector<double>().swap(*arrays[k]);
+    }
+}
+
 }  // internal namespace
 
 
+// ------ Grid cell locator ------ //
+
+namespace {
+/// check that the transformed grid nodes u_k are approximately equal to k (within a fraction of cell)
+bool isUnitSpaced(const std::vector<double>& u)
+{
+    for(size_t k=0; k<u.size(); k++)
+        if(!(fabs(u[k] - k) < 0.25))   // also catches NAN
+            return false;
+    return true;
+}
+}  // internal namespace
+
+GridLocator::GridLocator(const std::vector<double>& grid) :
+    law(GL_GENERIC), mirrored(false), center(0), x0(0), A(0), B(0)
+{
+    const size_t size = grid.size();
+    if(size < 3)
+        return;
+    std::vector<double> u(size);
+    // uniform grid
+    A = (size-1) / (grid.back() - grid.front());
+    x0 = grid.front();
+    for(size_t k=0; k<size; k++)
+        u[k] = (grid[k] - x0) * A;
+    if(isUnitSpaced(u)) {
+        law = GL_UNIFORM;
+        return;
+    }
+    // exponentially spaced grid
+    if(grid.front() > 0) {
+        A  = (size-1) / log(grid.back() / grid.front());
+        x0 = 1 / grid.front();
+        for(size_t k=0; k<size; k++)
+            u[k] = log(grid[k] * x0) * A;
+        if(isUnitSpaced(u)) {
+            law = GL_EXP;
+            return;
+        }
+    }
+    // grid starting from zero (or symmetric about zero) with nearly uniform spacing near zero,
+    // turning into nearly exponential spacing at large x
+    ptrdiff_t zero = size/2;
+    if(grid.front() == 0)
+        zero = 0;
+    else if(size%2 == 1 && grid[zero] == 0) {
+        for(size_t k=1; k<=size/2; k++)
+            if(grid[zero-k] != -grid[zero+k])
+                return;
+    } else
+        return;
+    const size_t half = size - zero;
+    if(half < 3)
+        return;
+    // x_k = (exp(k/A) - 1) / B  =>  x_2 / x_1 = exp(1/A) + 1
+    double ratio = grid[zero+2] / grid[zero+1] - 1;
+    if(!(ratio > 1))
+        return;
+    A = 1 / log(ratio);
+    B = (ratio - 1) / grid[zero+1];
+    u.resize(half);
+    for(size_t k=0; k<half; k++)
+        u[k] = log1p(grid[zero+k] * B) * A;
+    if(isUnitSpaced(u)) {
+        law      = GL_NONUNIF;
+        mirrored = zero > 0;
+        center   = zero;
+    }
+}
+
+ptrdiff_t GridLocator::operator()(const double x, const double grid[], const size_t size) const
+{
+    if(law == GL_GENERIC)
+        return binSearch(x, grid, size);
+    if(!(x >= grid[0]))
+        return -1;
+    const ptrdiff_t last = size-2;
+    if(x > grid[last+1])
+        return last+1;
+    double k;  // continuous index of the point in the grid
+    if(law == GL_UNIFORM)
+        k = (x - x0) * A;
+    else if(law == GL_EXP)
+        k = log(x * x0) * A;
+    else {
+        k = log1p((mirrored ? fabs(x) : x) * B) * A;
+        if(mirrored)
+            k = x >= 0 ? center + k : center - k;
+    }
+    ptrdiff_t i = static_cast<ptrdiff_t>(k);
+    i = i < 0 ? 0 : i > last ? last : i;
+    // correction step: in most cases it does not need to move at all
+    while(i > 0 && x < grid[i])
+        i--;
+    while(i < last && x >= grid[i+1])
+        i++;
+    return i;
+}
+
+ptrdiff_t GridLocator::operator()(const double x, const double grid[], const size_t size,
+    ptrdiff_t& hint) const
+{
+    return law == GL_GENERIC ? binSearch(x, grid, size, hint) : operator()(x, grid, size);
+}
+
+
+namespace {
+#ifdef _MSC_VER
+__declspec(thread)
+#else
+__thread
+#endif
+CellHintCache* activeCellHintCache = NULL;  ///< the cache made active in the current thread
+}  // internal namespace
+
+CellHintCache::CellHintCache() : next(0)
+{
+    for(int i=0; i<SIZE; i++)
+        keys[i] = NULL;
+}
+
+CellHint2d& CellHintCache::get(const void* key)
+{
+    for(int i=0; i<SIZE; i++)
+        if(keys[i] == key)
+            return hints[i];
+    const int i = next;
+    next = (next+1) % SIZE;
+    keys [i] = key;
+    hints[i] = CellHint2d();
+    return hints[i];
+}
+
+CellHintCache* CellHintCache::active() { return activeCellHintCache; }
+
+CellHintScope::CellHintScope(CellHintCache& cache) : prev(activeCellHintCache)
+{
+    activeCellHintCache = &cache;
+}
+
+CellHintScope::~CellHintScope() { activeCellHintCache = prev; }
+
+
 BaseInterpolator1d::BaseInterpolator1d(
     const std::vector<double>& xvalues, const std::vector<double>& fvalues)
 :
@@ -679,6 +836,7 @@ BaseInterpolator1d::BaseInterpolator1d(
         throw std::length_error("BaseInterpolator1d: number of nodes should be >=2");
     checkFiniteAndMonotonic(xval, "BaseInterpolator1d", "x");
     checkFinite1d(fval, "BaseInterpolator1d", "fvalues");
+    xloc = GridLocator(xval);
 }
 
 LinearInterpolator::LinearInterpolator(
@@ -692,7 +850,7 @@ LinearInterpolator::LinearInterpolator(
 
 void LinearInterpolator::evalDeriv(const double x, double* value, double* deriv, double* deriv2) const
 {
-    int i = std::max<int>(0, std::min<int>(xval.size()-2, binSearch(x, &xval[0], xval.size())));
+    int i = std::max<int>(0, std::min<int>(xval.size()-2, xloc(x, &xval[0], xval.size())));
     if(value)
         *value = linearInterp(x, xval[i], xval[i+1], fval[i], fval[i+1]);
     if(deriv)
@@ -759,7 +917,7 @@ void CubicSpline::evalDeriv(const double x, double* val, double* deriv, double*
     int size = xval.size();
     if(size == 0)
         throw std::length_error("Empty spline");
-    int index = binSearch(x, &xval[0], size);
+    int index = xloc(x, &xval[0], size);
     if(index < 0) {
         if(val)
             *val   = fval[0] + (fder[0]==0 ? 0 : fder[0] * (x-xval[0]));
@@ -888,7 +1046,7 @@ void QuinticSpline::evalDeriv(const double x, double* val, double* deriv, double
     int size = xval.size();
     if(size == 0)
         throw std::length_error("Empty spline");
-    int index = binSearch(x, &xval[0], size);
+    int index = xloc(x, &xval[0], size);
     if(index < 0) {
         if(val)
             *val   = fval[0] + (fder[0]==0 ? 0 : fder[0] * (x-xval[0]));
@@ -1077,7 +1235,7 @@ void LogLogSpline::evalDeriv(const double x, double* value, double* deriv, doubl
     int size = xval.size();
     if(size == 0)
         throw std::length_error("Empty spline");
-    int index = binSearch(x, &xval[0], size);
+    int index = xloc(x, &xval[0], size);
     double logx = log(x);
 
     if(index < 0 || index >= size-1) {
@@ -1521,6 +1679,31 @@ BaseInterpolator2d::BaseInterpolator2d(
     checkFiniteAndMonotonic(yval, "BaseInterpolator2d", "y");
     checkSizes2d(fvalues, xsize, ysize, "BaseInterpolator2d", "fvalues");
     checkFinite2d(fval, ysize, "BaseInterpolator2d", "fvalues");
+    xloc = GridLocator(xval);
+    yloc = GridLocator(yval);
+}
+
+double BaseInterpolator2d::reducePrecision()
+{
+    if(empty() || singlePrecision())
+        return 0;
+    double fmax = 0;
+    for(size_t i=0; i<fval.size(); i++)
+        fmax = std::max(fmax, fabs(fval[i]));
+    // values at the centres of grid cells before the conversion
+    const size_t nx = xval.size()-1, ny = yval.size()-1;
+    std::vector<double> orig(nx * ny);
+    for(size_t i=0; i<nx; i++)
+        for(size_t j=0; j<ny; j++)
+            orig[i * ny + j] = value(0.5 * (xval[i] + xval[i+1]), 0.5 * (yval[j] + yval[j+1]));
+    if(!storeSinglePrecision())
+        return 0;
+    double maxdiff = 0;
+    for(size_t i=0; i<nx; i++)
+        for(size_t j=0; j<ny; j++)
+            maxdiff = std::max(maxdiff, fabs(orig[i * ny + j] -
+                value(0.5 * (xval[i] + xval[i+1]), 0.5 * (yval[j] + yval[j+1]))));
+    return fmax>0 ? maxdiff / fmax : 0;
 }
 
 // ------- Bilinear interpolation in 2d ------- //
@@ -1540,8 +1723,8 @@ void LinearInterpolator2d::evalDeriv(const double x, const double y,
     const int
         nx  = xval.size(),
         ny  = yval.size(),
-        xi  = binSearch(x, &xval.front(), nx),
-        yi  = binSearch(y, &yval.front(), ny),
+        xi  = xloc(x, &xval.front(), nx),
+        yi  = yloc(y, &yval.front(), ny),
         // indices of corner nodes in the flattened 2d array
         ill = xi * ny + yi, // xlow,ylow
         ilu = ill + 1,      // xlow,yupp
@@ -1641,18 +1824,16 @@ CubicSpline2d::CubicSpline2d(
     }
 }
 
-void CubicSpline2d::evalDeriv(const double x, const double y,
+template<typename NumT>
+void CubicSpline2d::evalDerivImpl(const NumT* const coefs[4], const ptrdiff_t xi, const ptrdiff_t yi,
+    const double x, const double y,
     double *z, double *z_x, double *z_y, double *z_xx, double *z_xy, double *z_yy) const
 {
-    if(fval.empty())
-        throw std::length_error("Empty 2d spline");
+    const NumT *f = coefs[0], *fx = coefs[1], *fy = coefs[2], *fxy = coefs[3];
     const int
         nx = xval.size(),
         ny = yval.size(),
-        // indices of grid cell in x and y
-        xi = binSearch(x, &xval.front(), nx),
-        yi = binSearch(y, &yval.front(), ny),
-        // indices in flattened 2d arrays:
+        // indices in flattened 2d arrays (xi, yi are the indices of grid cell in x and y):
         ill = xi * ny + yi, // xlow,ylow
         ilu = ill + 1,      // xlow,yupp
         iul = ill + ny,     // xupp,ylow
@@ -1680,11 +1861,11 @@ void CubicSpline2d::evalDeriv(const double x, const double y,
         yupp = yval[yi+1],
         // shift the four corner points by the same offset (pick up one of the four corner values),
         // to avoid roundoff errors in intermediate calculations; add it back to final output
-        f_offset = x==xupp ? (y==yupp ? fval[iuu] : fval[iul]) : (y==yupp ? fval[ilu] : fval[ill]),
-        fval_ill = fval[ill] - f_offset,
-        fval_iul = fval[iul] - f_offset,
-        fval_ilu = fval[ilu] - f_offset,
-        fval_iuu = fval[iuu] - f_offset,
+        f_offset = x==xupp ? (y==yupp ? f[iuu] : f[iul]) : (y==yupp ? f[ilu] : f[ill]),
+        fval_ill = f[ill] - f_offset,
+        fval_iul = f[iul] - f_offset,
+        fval_ilu = f[ilu] - f_offset,
+        fval_iuu = f[iuu] - f_offset,
         // values and derivatives for the intermediate Hermite splines
         flow  [4] = { fval_ill , fval_iul , fx [ill], fx [iul] },
         fupp  [4] = { fval_ilu , fval_iuu , fx [ilu], fx [iuu] },
@@ -1711,6 +1892,47 @@ void CubicSpline2d::evalDeriv(const double x, const double y,
             /*output*/ z_yy, NULL, NULL);
 }
 
+void CubicSpline2d::evalDeriv(const double x, const double y,
+    double *z, double *z_x, double *z_y, double *z_xx, double *z_xy, double *z_yy) const
+{
+    if(empty())
+        throw std::length_error("Empty 2d spline");
+    const ptrdiff_t xi = xloc(x, &xval.front(), xval.size()), yi = yloc(y, &yval.front(), yval.size());
+    if(coef32.empty()) {
+        const double* coefs[4] = { &fval[0], &fx[0], &fy[0], &fxy[0] };
+        evalDerivImpl(coefs, xi, yi, x, y, z, z_x, z_y, z_xx, z_xy, z_yy);
+    } else {
+        const size_t n = coef32.size() / 4;
+        const float* coefs[4] = { &coef32[0], &coef32[n], &coef32[2*n], &coef32[3*n] };
+        evalDerivImpl(coefs, xi, yi, x, y, z, z_x, z_y, z_xx, z_xy, z_yy);
+    }
+}
+
+void CubicSpline2d::evalDeriv(const double x, const double y, CellHint2d& hint,
+    double *z, double *z_x, double *z_y, double *z_xx, double *z_xy, double *z_yy) const
+{
+    if(empty())
+        throw std::length_error("Empty 2d spline");
+    const ptrdiff_t
+        xi = xloc(x, &xval.front(), xval.size(), hint.ix),
+        yi = yloc(y, &yval.front(), yval.size(), hint.iy);
+    if(coef32.empty()) {
+        const double* coefs[4] = { &fval[0], &fx[0], &fy[0], &fxy[0] };
+        evalDerivImpl(coefs, xi, yi, x, y, z, z_x, z_y, z_xx, z_xy, z_yy);
+    } else {
+        const size_t n = coef32.size() / 4;
+        const float* coefs[4] = { &coef32[0], &coef32[n], &coef32[2*n], &coef32[3*n] };
+        evalDerivImpl(coefs, xi, yi, x, y, z, z_x, z_y, z_xx, z_xy, z_yy);
+    }
+}
+
+bool CubicSpline2d::storeSinglePrecision()
+{
+    std::vector<double>* arrays[4] = { &fval, &fx, &fy, &fxy };
+    storeCoefsAsFloat(arrays, 4, coef32);
+    return true;
+}
+
 
 //------------ 2D QUINTIC SPLINE -------------//
 
@@ -1928,19 +2150,18 @@ void QuinticSpline2d::setupWithMixedDeriv(const size_t xsize, const size_t ysize
     }
 }
 
-void QuinticSpline2d::evalDeriv(const double x, const double y,
+template<typename NumT>
+void QuinticSpline2d::evalDerivImpl(const NumT* const coefs[9], const ptrdiff_t xi, const ptrdiff_t yi,
+    const double x, const double y,
     double* z, double* z_x, double* z_y,
     double* z_xx, double* z_xy, double* z_yy) const
 {
-    if(fval.empty())
-        throw std::length_error("Empty 2d spline");
+    const NumT *f = coefs[0], *fx = coefs[1], *fy = coefs[2], *fxx = coefs[3], *fxy = coefs[4],
+        *fyy = coefs[5], *fxxy = coefs[6], *fxyy = coefs[7], *fxxyy = coefs[8];
     const int
         nx = xval.size(),
         ny = yval.size(),
-        // indices of grid cell in x and y
-        xi = binSearch(x, &xval.front(), nx),
-        yi = binSearch(y, &yval.front(), ny),
-        // indices in flattened 2d arrays:
+        // indices in flattened 2d arrays (xi, yi are the indices of grid cell in x and y):
         ill = xi * ny + yi, // xlow,ylow
         ilu = ill + 1,      // xlow,yupp
         iul = ill + ny,     // xupp,ylow
@@ -1970,11 +2191,11 @@ void QuinticSpline2d::evalDeriv(const double x, const double y,
         yupp = yval[yi+1],
         // shift the four corner points by the same offset (pick up one of the four corner values),
         // to avoid roundoff errors in intermediate calculations; add it back to final output
-        f_offset = x==xupp ? (y==yupp ? fval[iuu] : fval[iul]) : (y==yupp ? fval[ilu] : fval[ill]),
-        fval_ill = fval[ill] - f_offset,
-        fval_iul = fval[iul] - f_offset,
-        fval_ilu = fval[ilu] - f_offset,
-        fval_iuu = fval[iuu] - f_offset,
+        f_offset = x==xupp ? (y==yupp ? f[iuu] : f[iul]) : (y==yupp ? f[ilu] : f[ill]),
+        fval_ill = f[ill] - f_offset,
+        fval_iul = f[iul] - f_offset,
+        fval_ilu = f[ilu] - f_offset,
+        fval_iuu = f[iuu] - f_offset,
         // values and derivatives for the intermediate splines
         fl [6] = { fval_ill , fval_iul , fx  [ill], fx  [iul], fxx  [ill], fxx  [iul] },
         fu [6] = { fval_ilu , fval_iuu , fx  [ilu], fx  [iuu], fxx  [ilu], fxx  [iuu] },
@@ -2002,6 +2223,54 @@ void QuinticSpline2d::evalDeriv(const double x, const double y,
             /*output*/ z_yy, NULL, NULL);
 }
 
+void QuinticSpline2d::evalDeriv(const double x, const double y,
+    double* z, double* z_x, double* z_y,
+    double* z_xx, double* z_xy, double* z_yy) const
+{
+    if(empty())
+        throw std::length_error("Empty 2d spline");
+    const ptrdiff_t xi = xloc(x, &xval.front(), xval.size()), yi = yloc(y, &yval.front(), yval.size());
+    if(coef32.empty()) {
+        const double* coefs[9] = { &fval[0], &fx[0], &fy[0], &fxx[0], &fxy[0],
+            &fyy[0], &fxxy[0], &fxyy[0], &fxxyy[0] };
+        evalDerivImpl(coefs, xi, yi, x, y, z, z_x, z_y, z_xx, z_xy, z_yy);
+    } else {
+        const size_t n = coef32.size() / 9;
+        const float* coefs[9] = { &coef32[0], &coef32[n], &coef32[2*n], &coef32[3*n], &coef32[4*n],
+            &coef32[5*n], &coef32[6*n], &coef32[7*n], &coef32[8*n] };
+        evalDerivImpl(coefs, xi, yi, x, y, z, z_x, z_y, z_xx, z_xy, z_yy);
+    }
+}
+
+void QuinticSpline2d::evalDeriv(const double x, const double y, CellHint2d& hint,
+    double* z, double* z_x, double* z_y,
+    double* z_xx, double* z_xy, double* z_yy) const
+{
+    if(empty())
+        throw std::length_error("Empty 2d spline");
+    const ptrdiff_t
+        xi = xloc(x, &xval.front(), xval.size(), hint.ix),
+        yi = yloc(y, &yval.front(), yval.size(), hint.iy);
+    if(coef32.empty()) {
+        const double* coefs[9] = { &fval[0], &fx[0], &fy[0], &fxx[0], &fxy[0],
+            &fyy[0], &fxxy[0], &fxyy[0], &fxxyy[0] };
+        evalDerivImpl(coefs, xi, yi, x, y, z, z_x, z_y, z_xx, z_xy, z_yy);
+    } else {
+        const size_t n = coef32.size() / 9;
+        const float* coefs[9] = { &coef32[0], &coef32[n], &coef32[2*n], &coef32[3*n], &coef32[4*n],
+            &coef32[5*n], &coef32[6*n], &coef32[7*n], &coef32[8*n] };
+        evalDerivImpl(coefs, xi, yi, x, y, z, z_x, z_y, z_xx, z_xy, z_yy);
+    }
+}
+
+bool QuinticSpline2d::storeSinglePrecision()
+{
+    std::vector<double>* arrays[9] = { &fval, &fx, &fy, &fxx, &fxy, &fyy, &fxxy, &fxyy, &fxxyy };
+    storeCoefsAsFloat(arrays, 9, coef32);
+    return true;
+}
+
+
 
 // ------- Interpolation in 3d ------- //
 
@@ -2021,6 +2290,9 @@ LinearInterpolator3d::LinearInterpolator3d(
     checkFiniteAndMonotonic(yval, "LinearInterpolator3d", "y");
     checkFiniteAndMonotonic(zval, "LinearInterpolator3d", "z");
     checkFinite1d(fval, "LinearInterpolator3d", "function values");
+    xloc = GridLocator(xval);
+    yloc = GridLocator(yval);
+    zloc = GridLocator(zval);
 }
 
 double LinearInterpolator3d::value(double x, double y, double z) const
@@ -2030,9 +2302,9 @@ double LinearInterpolator3d::value(double x, double y, double z) const
     ny = yval.size(),
     nz = zval.size(),
     // indices of grid cell in x, y and z
-    xi = binSearch(x, &xval.front(), nx),
-    yi = binSearch(y, &yval.front(), ny),
-    zi = binSearch(z, &zval.front(), nz),
+    xi = xloc(x, &xval.front(), nx),
+    yi = yloc(y, &yval.front(), ny),
+    zi = zloc(z, &zval.front(), nz),
     il = (xi * ny + yi) * nz + zi,
     iu = il + ny * nz;
     if(xi<0 || xi>=nx-1 || yi<0 || yi>=ny-1 || zi<0 || zi>=nz-1)
@@ -2077,6 +2349,9 @@ CubicSpline3d::CubicSpline3d(
     checkFiniteAndMonotonic(yval, "CubicSpline3d", "y");
     checkFiniteAndMonotonic(zval, "CubicSpline3d", "z");
     checkFinite1d(fval, "CubicSpline3d", "function values");
+    xloc = GridLocator(xval);
+    yloc = GridLocator(yval);
+    zloc = GridLocator(zval);
     fx  .assign(nval,0.0);
     fy  .assign(nval,0.0);
     fz  .assign(nval,0.0);
@@ -2230,16 +2505,34 @@ CubicSpline3d::CubicSpline3d(
 
 double CubicSpline3d::value(const double x, const double y, const double z) const
 {
+    double val;
+    evalDeriv(x, y, z, &val);
+    return val;
+}
+
+template<typename NumT>
+void CubicSpline3d::evalDerivImpl(const NumT* const coefs[8], const double x, const double y, const double z,
+    double* val, double deriv[3], double deriv2[6]) const
+{
+    const NumT *f = coefs[0], *fx = coefs[1], *fy = coefs[2], *fz = coefs[3],
+        *fxy = coefs[4], *fxz = coefs[5], *fyz = coefs[6], *fxyz = coefs[7];
     const int
     nx = xval.size(),
     ny = yval.size(),
     nz = zval.size(),
     // indices of grid cell in x, y and z
-    xi = binSearch(x, &xval.front(), nx),
-    yi = binSearch(y, &yval.front(), ny),
-    zi = binSearch(z, &zval.front(), nz);
-    if(xi<0 || xi>=nx-1 || yi<0 || yi>=ny-1 || zi<0 || zi>=nz-1)
-        return NAN;
+    xi = xloc(x, &xval.front(), nx),
+    yi = yloc(y, &yval.front(), ny),
+    zi = zloc(z, &zval.front(), nz);
+    if(xi<0 || xi>=nx-1 || yi<0 || yi>=ny-1 || zi<0 || zi>=nz-1) {
+        if(val)
+            *val = NAN;
+        if(deriv)
+            std::fill(deriv, deriv+3, NAN);
+        if(deriv2)
+            std::fill(deriv2, deriv2+6, NAN);
+        return;
+    }
     const int
     // indices in flattened 3d arrays:
     illl = (xi * ny + yi) * nz + zi, // xlow,ylow,zlow
@@ -2259,12 +2552,12 @@ double CubicSpline3d::value(const double x, const double y, const double z) cons
     zlow = zval[zi],
     zupp = zval[zi+1],
     // 1st stage: interpolate along x axis to obtain  f, f_y, f_z, f_yz  at four corners of the y-z cell
-    fl [16] = { fval[illl], fval[illu], fz  [illl], fz  [illu],
-                fval[ilul], fval[iluu], fz  [ilul], fz  [iluu],
+    fl [16] = { f   [illl], f   [illu], fz  [illl], fz  [illu],
+                f   [ilul], f   [iluu], fz  [ilul], fz  [iluu],
                 fy  [illl], fy  [illu], fyz [illl], fyz [illu],
                 fy  [ilul], fy  [iluu], fyz [ilul], fyz [iluu] },
-    fu [16] = { fval[iull], fval[iulu], fz  [iull], fz  [iulu],
-                fval[iuul], fval[iuuu], fz  [iuul], fz  [iuuu],
+    fu [16] = { f   [iull], f   [iulu], fz  [iull], fz  [iulu],
+                f   [iuul], f   [iuuu], fz  [iuul], fz  [iuuu],
                 fy  [iull], fy  [iulu], fyz [iull], fyz [iulu],
                 fy  [iuul], fy  [iuuu], fyz [iuul], fyz [iuuu] },
     fxl[16] = { fx  [illl], fx  [illu], fxz [illl], fxz [illu],
@@ -2275,15 +2568,88 @@ double CubicSpline3d::value(const double x, const double y, const double z) cons
                 fx  [iuul], fx  [iuuu], fxz [iuul], fxz [iuuu],
                 fxy [iull], fxy [iulu], fxyz[iull], fxyz[iulu],
                 fxy [iuul], fxy [iuuu], fxyz[iuul], fxyz[iuuu] };
-    double F[16];
-    evalCubicSplines<16>(x, xlow, xupp, fl, fu, fxl, fxu, /*output*/ F, NULL, NULL);
+    // the same sequence of steps is applied to the x-derivatives of the intermediate quantities,
+    // if the derivatives of the interpolant are needed
+    const bool der = deriv || deriv2;
+    double F[16], Fx[16], Fxx[16];
+    evalCubicSplines<16>(x, xlow, xupp, fl, fu, fxl, fxu,
+        /*output*/ F, der ? Fx : NULL, deriv2 ? Fxx : NULL);
     // 2nd stage: interpolate along y axis to obtain f(x,y,zlow), f(x,y,zupp), fz(x,y,zlow), fz(x,y,zupp)
-    double FF[4];
-    evalCubicSplines<4> (y, ylow, yupp, F+0,  F+4,  F+8,  F+12, /*output*/ FF, NULL, NULL);
+    // and optionally their derivatives by x and y
+    double FF[4], FFy[4], FFyy[4], FFx[4], FFxy[4], FFxx[4];
+    evalCubicSplines<4> (y, ylow, yupp, F+0,  F+4,  F+8,  F+12,
+        /*output*/ FF, der ? FFy : NULL, deriv2 ? FFyy : NULL);
+    if(der)
+        evalCubicSplines<4> (y, ylow, yupp, Fx+0, Fx+4, Fx+8, Fx+12,
+            /*output*/ FFx, deriv2 ? FFxy : NULL, NULL);
+    if(deriv2)
+        evalCubicSplines<4> (y, ylow, yupp, Fxx+0, Fxx+4, Fxx+8, Fxx+12,
+            /*output*/ FFxx, NULL, NULL);
     // 3rd stage: interpolate along z axis
-    double val;
-    evalCubicSplines<1> (z, zlow, zupp, FF+0, FF+1, FF+2, FF+3, /*output*/ &val, NULL, NULL);
-    return val;
+    evalCubicSplines<1> (z, zlow, zupp, FF+0, FF+1, FF+2, FF+3,
+        /*output*/ val, deriv ? deriv+2 : NULL, deriv2 ? deriv2+2 : NULL);
+    if(der) {
+        double dx = 0, dy = 0, dxz = 0, dyz = 0;
+        evalCubicSplines<1> (z, zlow, zupp, FFx+0, FFx+1, FFx+2, FFx+3,
+            /*output*/ &dx, deriv2 ? &dxz : NULL, NULL);
+        evalCubicSplines<1> (z, zlow, zupp, FFy+0, FFy+1, FFy+2, FFy+3,
+            /*output*/ &dy, deriv2 ? &dyz : NULL, NULL);
+        if(deriv) {
+            deriv[0] = dx;
+            deriv[1] = dy;
+        }
+        if(deriv2) {
+            evalCubicSplines<1> (z, zlow, zupp, FFxx+0, FFxx+1, FFxx+2, FFxx+3,
+                /*output*/ deriv2+0, NULL, NULL);
+            evalCubicSplines<1> (z, zlow, zupp, FFyy+0, FFyy+1, FFyy+2, FFyy+3,
+                /*output*/ deriv2+1, NULL, NULL);
+            evalCubicSplines<1> (z, zlow, zupp, FFxy+0, FFxy+1, FFxy+2, FFxy+3,
+                /*output*/ deriv2+3, NULL, NULL);
+            deriv2[4] = dyz;
+            deriv2[5] = dxz;
+        }
+    }
+}
+
+void CubicSpline3d::evalDeriv(const double x, const double y, const double z,
+    double* val, double deriv[3], double deriv2[6]) const
+{
+    if(coef32.empty()) {
+        const double* coefs[8] = { &fval[0], &fx[0], &fy[0], &fz[0], &fxy[0], &fxz[0], &fyz[0], &fxyz[0] };
+        evalDerivImpl(coefs, x, y, z, val, deriv, deriv2);
+    } else {
+        const size_t n = coef32.size() / 8;
+        const float* coefs[8] = { &coef32[0], &coef32[n], &coef32[2*n], &coef32[3*n],
+            &coef32[4*n], &coef32[5*n], &coef32[6*n], &coef32[7*n] };
+        evalDerivImpl(coefs, x, y, z, val, deriv, deriv2);
+    }
+}
+
+double CubicSpline3d::reducePrecision()
+{
+    if(empty() || singlePrecision())
+        return 0;
+    double fmax = 0;
+    for(size_t i=0; i<fval.size(); i++)
+        fmax = std::max(fmax, fabs(fval[i]));
+    // values at the centres of grid cells before the conversion
+    const size_t nx = xval.size()-1, ny = yval.size()-1, nz = zval.size()-1;
+    std::vector<double> orig(nx * ny * nz);
+    for(size_t i=0; i<nx; i++)
+        for(size_t j=0; j<ny; j++)
+            for(size_t k=0; k<nz; k++)
+                orig[(i * ny + j) * nz + k] = value(0.5 * (xval[i] + xval[i+1]),
+                    0.5 * (yval[j] + yval[j+1]), 0.5 * (zval[k] + zval[k+1]));
+    std::vector<double>* arrays[8] = { &fval, &fx, &fy, &fz, &fxy, &fxz, &fyz, &fxyz };
+    storeCoefsAsFloat(arrays, 8, coef32);
+    double maxdiff = 0;
+    for(size_t i=0; i<nx; i++)
+        for(size_t j=0; j<ny; j++)
+            for(size_t k=0; k<nz; k++)
+                maxdiff = std::max(maxdiff, fabs(orig[(i * ny + j) * nz + k] -
+                    value(0.5 * (xval[i] + xval[i+1]),
+                    0.5 * (yval[j] + yval[j+1]), 0.5 * (zval[k] + zval[k+1]))));
+    return fmax>0 ? maxdiff / fmax : 0;
 }
 
 
@@ -2568,11 +2934,12 @@ public:
     double sumWeights;
 private:
     const std::vector<double> knots;   ///< b-spline knots  X[k], k=0..numKnots-1
-    const std::vector<double> xvalues; ///< x[i], i=0..numDataPoints-1
-    const std::vector<double> weights; ///< w[i], i=0..numDataPoints-1
+    const std::vector<double> xvalues; ///< x[i], i=0..numDataPoints-1 (empty if using accumulated data)
+    const std::vector<double> weights; ///< w[i], i=0..numDataPoints-1 (empty if using accumulated data)
 
     /// sparse matrix  B  containing the values of each basis function at each data point:
-    /// (size: numDataPoints rows, numBasisFnc columns, with only 4 nonzero values in each row)
+    /// (size: numDataPoints rows, numBasisFnc columns, with only 4 nonzero values in each row;
+    /// zero rows if the object was constructed from accumulated data)
     SparseMatrixSpecial<4> BMatrix;
 
     /// an intermediate matrix  B^T W B  describes the system of normal equations (where W=diag(w)),
@@ -2598,6 +2965,10 @@ public:
         double ynorm2;             ///< weighted norm of the vector y (= y^T W y )
     };
 
+    /// pre-initialized fitting data for each data set, if the object was constructed
+    /// from accumulated data (otherwise empty)
+    std::vector<FitData> dataSets;
+
     /** Prepare internal tables for fitting the data points at the given set of x-coordinates
         and the given array of knots which determine the basis functions */
     Impl(
@@ -2605,27 +2976,37 @@ public:
         const std::vector<double>& xvalues,
         const std::vector<double>& weights);
 
+    /** Prepare internal tables from the sufficient statistics accumulated over all data points */
+    explicit Impl(const SplineApproxData& data);
+
+    /** Initialize temporary arrays used in the fitting process for the provided data vector y,
+        in the case that the normal equations are not singular.
+        \param[in]  yvalues is the vector of data values `y` at each data point;
+        \returns    the data structure used by other methods later in the fitting process
+    */
+    FitData initFit(const std::vector<double>& yvalues) const;
+
     /** find the amplitudes of basis functions that provide the best fit to the data points `y`
         for the given value of smoothing parameter `lambda`, determined indirectly by EDF.
-        \param[in]  yvalues  are the data values corresponding to x-coordinates
-        that were provided to the constructor;
+        \param[in]  fitData  contains the pre-initialized auxiliary arrays for the data values
+        (constructed by `initFit()` or taken from `dataSets`);
         \param[in]  EDF  is the equivalent number of degrees of freedom (2<=EDF<=numBasisFnc);
         \param[out] ampl  will contain the computed amplitudes of basis functions;
         \param[out] RSS  will contain the residual sum of squared differences between data and appxox;
     */
-    void solveForAmplitudesWithEDF(const std::vector<double>& yvalues, double EDF,
+    void solveForAmplitudesWithEDF(const FitData& fitData, double EDF,
         std::vector<double>& ampl, double& RSS) const;
 
     /** find the amplitudes of basis functions that provide the best fit to the data points `y`
         with the logarithm of the generalized cross-validation score (GCV) being larger
         than its minimum value (corresponding to the case of optimal smoothing) by deltaSmoothing.
-        \param[in]  yvalues  are the data values;
+        \param[in]  fitData  contains the pre-initialized auxiliary arrays for the data values;
         \param[in]  deltaSmoothing is the offset of ln(GCV) from its minimum
         (0 means the optimally smoothed spline);
         \param[out] ampl  will contain the computed amplitudes of basis functions;
         \param[out] RSS,EDF  same as in the previous function;
     */
-    void solveForAmplitudesWithGCV(const std::vector<double>& yvalues, double deltaSmoothing,
+    void solveForAmplitudesWithGCV(const FitData& fitData, double deltaSmoothing,
         std::vector<double>& ampl, double& RSS, double& EDF) const;
 
     /** Obtain the best-fit solution for the given value of smoothing parameter lambda
@@ -2639,12 +3020,9 @@ public:
         std::vector<double>& ampl, double& RSS, double& EDF) const;
 
 private:
-    /** Initialize temporary arrays used in the fitting process for the provided data vector y,
-        in the case that the normal equations are not singular.
-        \param[in]  yvalues is the vector of data values `y` at each data point;
-        \returns    the data structure used by other methods later in the fitting process
-    */
-    FitData initFit(const std::vector<double>& yvalues) const;
+    /** Construct the remaining internal tables from the matrix of normal equations C
+        (which is modified in the process) */
+    void init(Matrix<double>& CMatrix);
 };
 
 SplineApprox::Impl::Impl(const std::vector<double> &_knots,
@@ -2690,7 +3068,41 @@ SplineApprox::Impl::Impl(const std::vector<double> &_knots,
 
     // compute the symmetric matrix  C = B^T diag(w) B
     Matrix<double> CMatrix(BMatrix.multiplyByTransposed(weights));
+    init(CMatrix);
+}
 
+SplineApprox::Impl::Impl(const SplineApproxData& data) :
+    numKnots(data.grid.size()),
+    numDataPoints(data.numDataPoints),
+    sumWeights(data.sumWeights),
+    knots(data.grid),
+    BMatrix(0, numKnots)
+{
+    if(numKnots <= 1 || numDataPoints < 4)
+        throw std::invalid_argument("SplineApprox: incorrect size of the problem");
+    if(sumWeights == 0)
+        throw std::invalid_argument("SplineApprox: sum of all weights must positive");
+    checkFiniteAndMonotonic(knots, "splineApprox", "x");
+
+    // unpack the symmetric matrix  C = B^T diag(w) B  from the banded storage
+    Matrix<double> CMatrix(numKnots, numKnots, 0.);
+    for(unsigned int k=0; k<numKnots; k++)
+        for(unsigned int d=0; d<4 && k+d<numKnots; d++)
+            CMatrix(k, k+d) = CMatrix(k+d, k) = data.normalMatrix[k*4+d];
+    init(CMatrix);
+
+    // precompute the auxiliary arrays for each data set
+    dataSets.resize(data.numDataSets);
+    for(unsigned int s=0; s<data.numDataSets; s++) {
+        dataSets[s].ynorm2 = data.ynorm2[s];
+        dataSets[s].zRHS.assign(data.rhs.begin() + s*numKnots, data.rhs.begin() + (s+1)*numKnots);
+        dataSets[s].MTz.resize(numKnots);
+        blas_dgemv(CblasTrans, 1, MMatrix, dataSets[s].zRHS, 0, dataSets[s].MTz);
+    }
+}
+
+void SplineApprox::Impl::init(Matrix<double>& CMatrix)
+{
     // compute the roughness matrix R (integrals over products of second derivatives of basis functions)
     //Matrix<double> RMatrix(computeOverlapMatrix<3,2>(knots));
     Matrix<double> RMatrix(computeOverlapMatrix<3>(knots, /*numBasisFnc*/ numKnots, /*GLORDER*/ 2,
@@ -2738,7 +3150,7 @@ SplineApprox::Impl::Impl(const std::vector<double> &_knots,
 // initialize the temporary arrays used in the fitting process for the given vector of values 'y'
 SplineApprox::Impl::FitData SplineApprox::Impl::initFit(const std::vector<double> &yvalues) const
 {
-    if(yvalues.size() != (size_t)numDataPoints)
+    if(yvalues.size() != (size_t)numDataPoints || BMatrix.nRows != (size_t)numDataPoints)
         throw std::length_error("SplineApprox: input array sizes do not match");
     FitData fitData;
     fitData.ynorm2 = 0;
@@ -2853,7 +3265,7 @@ void SplineApprox::Impl::computeAmplitudes(const FitData &fitData, double lambda
     blas_dgemv(CblasNoTrans, 1, AMatrix, ampl, 0, result);
 }
 
-void SplineApprox::Impl::solveForAmplitudesWithEDF(const std::vector<double> &yvalues, double EDF,
+void SplineApprox::Impl::solveForAmplitudesWithEDF(const FitData &fitData, double EDF,
     std::vector<double> &ampl, double &RSS) const
 {
     if(EDF==0)
@@ -2863,15 +3275,14 @@ void SplineApprox::Impl::solveForAmplitudesWithEDF(const std::vector<double> &yv
             "(requested "+utils::toString(EDF)+", valid range is 2-"+utils::toString(numKnots)+")");
     // find root using a log-scaling for lambda
     double lambda = findRoot(SplineEDFRootFinder(singValues, EDF), ScalingSemiInf(), EPS_LAMBDA);
-    computeAmplitudes(initFit(yvalues), lambda, ampl, RSS, EDF);
+    computeAmplitudes(fitData, lambda, ampl, RSS, EDF);
 }
 
-void SplineApprox::Impl::solveForAmplitudesWithGCV(const std::vector<double> &yvalues, double smoothing,
+void SplineApprox::Impl::solveForAmplitudesWithGCV(const FitData &fitData, double smoothing,
     std::vector<double> &ampl, double &RSS, double &EDF) const
 {
     if(smoothing < 0)
         throw std::invalid_argument("SplineApprox: smoothing must be non-negative");
-    FitData fitData = initFit(yvalues);
     ScalingSemiInf scaling;
     // find the value of lambda corresponding to the optimal fit
     double lambda = findMin(SplineGCVRootFinder(*this, fitData, 0),
@@ -2903,6 +3314,9 @@ SplineApprox::SplineApprox(const std::vector<double> &grid,
     const std::vector<double> &xvalues, const std::vector<double> &weights) :
     impl(new Impl(grid, xvalues, weights)) {}
 
+SplineApprox::SplineApprox(const SplineApproxData& data) :
+    impl(new Impl(data)) {}
+
 SplineApprox::~SplineApprox()
 {
     delete impl;
@@ -2914,7 +3328,7 @@ std::vector<double> SplineApprox::fit(
 {
     std::vector<double> ampl;
     double RSS;
-    impl->solveForAmplitudesWithEDF(yvalues, edf, ampl, RSS);
+    impl->solveForAmplitudesWithEDF(impl->initFit(yvalues), edf, ampl, RSS);
     if(rms)
         *rms = sqrt(RSS / impl->sumWeights);
     return ampl;
@@ -2926,7 +3340,7 @@ std::vector<double> SplineApprox::fitOversmooth(
 {
     std::vector<double> ampl;
     double RSS, EDF;
-    impl->solveForAmplitudesWithGCV(yvalues, smoothing, ampl, RSS, EDF);
+    impl->solveForAmplitudesWithGCV(impl->initFit(yvalues), smoothing, ampl, RSS, EDF);
     if(rms)
         *rms = sqrt(RSS / impl->sumWeights);
     if(edf)
@@ -2934,6 +3348,86 @@ std::vector<double> SplineApprox::fitOversmooth(
     return ampl;
 }
 
+std::vector<double> SplineApprox::fit(
+    const unsigned int dataSet, const double edf,
+    double *rms) const
+{
+    if(dataSet >= impl->dataSets.size())
+        throw std::out_of_range("SplineApprox: invalid index of data set");
+    std::vector<double> ampl;
+    double RSS;
+    impl->solveForAmplitudesWithEDF(impl->dataSets[dataSet], edf, ampl, RSS);
+    if(rms)
+        *rms = sqrt(RSS / impl->sumWeights);
+    return ampl;
+}
+
+std::vector<double> SplineApprox::fitOversmooth(
+    const unsigned int dataSet, const double smoothing,
+    double *rms, double* edf) const
+{
+    if(dataSet >= impl->dataSets.size())
+        throw std::out_of_range("SplineApprox: invalid index of data set");
+    std::vector<double> ampl;
+    double RSS, EDF;
+    impl->solveForAmplitudesWithGCV(impl->dataSets[dataSet], smoothing, ampl, RSS, EDF);
+    if(rms)
+        *rms = sqrt(RSS / impl->sumWeights);
+    if(edf)
+        *edf = EDF;
+    return ampl;
+}
+
+//----------- ACCUMULATED DATA FOR PENALIZED SPLINE APPROXIMATION ------------//
+
+SplineApproxData::SplineApproxData(const std::vector<double>& _grid, unsigned int _numDataSets) :
+    grid(_grid),
+    numDataSets(_numDataSets),
+    numDataPoints(0),
+    sumWeights(0),
+    normalMatrix(grid.size() * 4, 0.),
+    rhs(grid.size() * numDataSets, 0.),
+    ynorm2(numDataSets, 0.)
+{
+    if(grid.size() <= 1)
+        throw std::invalid_argument("SplineApproxData: incorrect size of the problem");
+}
+
+void SplineApproxData::add(double x, double weight, const double yvalues[])
+{
+    if(!(weight >= 0))
+        throw std::invalid_argument("SplineApprox: weights must be non-negative");
+    numDataPoints++;
+    sumWeights += weight;
+    double Bspl[4];
+    unsigned int numKnots = grid.size();
+    unsigned int ind = bsplineNaturalCubicValues(x, &grid[0], numKnots, Bspl);
+    unsigned int nvals = std::min<unsigned int>(4, numKnots-ind);
+    for(unsigned int i=0; i<nvals; i++)
+        for(unsigned int j=i; j<nvals; j++)
+            normalMatrix[(ind+i)*4+j-i] += weight * Bspl[i] * Bspl[j];
+    for(unsigned int s=0; s<numDataSets; s++) {
+        double wy = weight * yvalues[s];
+        ynorm2[s] += wy * yvalues[s];
+        for(unsigned int i=0; i<nvals; i++)
+            rhs[s*numKnots+ind+i] += wy * Bspl[i];
+    }
+}
+
+void SplineApproxData::add(const SplineApproxData& other)
+{
+    if(other.grid != grid || other.numDataSets != numDataSets)
+        throw std::invalid_argument("SplineApproxData: incompatible objects");
+    numDataPoints += other.numDataPoints;
+    sumWeights    += other.sumWeights;
+    for(size_t i=0; i<normalMatrix.size(); i++)
+        normalMatrix[i] += other.normalMatrix[i];
+    for(size_t i=0; i<rhs.size(); i++)
+        rhs[i] += other.rhs[i];
+    for(unsigned int s=0; s<numDataSets; s++)
+        ynorm2[s] += other.ynorm2[s];
+}
+
 
 //------------ LOG-SPLINE DENSITY ESTIMATOR ------------//
 namespace {
@@ -3011,10 +3505,7 @@ struct SplineLogFitParams {
 template<int N>
 class SplineLogDensityFitter: public IFunctionNdimDeriv {
 public:
-    SplineLogDensityFitter(
-        const std::vector<double>& xvalues, const std::vector<double>& weights,
-        const std::vector<double>& grid, FitOptions options,
-        SplineLogFitParams& params);
+    SplineLogDensityFitter(const SplineLogDensityData<N>& data, SplineLogFitParams& params);
 
     /** Return the array of interpolated function values, properly normalized,
         such that the integral of P(x) over the entire domain is equal to the sum of sample weights M.
@@ -3089,34 +3580,26 @@ private:
 
 template<int N>
 SplineLogDensityFitter<N>::SplineLogDensityFitter(
-    const std::vector<double>& _grid,
-    const std::vector<double>& xvalues,
-    const std::vector<double>& weights,
-    FitOptions _options,
+    const SplineLogDensityData<N>& data,
     SplineLogFitParams& _params) :
-    grid(_grid),
+    grid(data.grid),
     numNodes(grid.size()),
     numBasisFnc(numNodes),
     numAmpl(numBasisFnc - 1),
-    numData(xvalues.size()),
-    options(_options),
+    numData(data.numData),
+    options(data.options),
     params(_params),
-    sumWeights(0),
+    sumWeights(data.sumWeights),
     logSumWeights(0)
 {
     if(numData <= 0)
         throw std::length_error("splineLogDensity: no data");
-    if(numData != (ptrdiff_t)weights.size())
-        throw std::length_error("splineLogDensity: sizes of input arrays are not equal");
     bool infLeft  = (options & FO_INFINITE_LEFT)  == FO_INFINITE_LEFT;
     bool infRight = (options & FO_INFINITE_RIGHT) == FO_INFINITE_RIGHT;
     if(infLeft && infRight && numNodes<3)
         throw std::invalid_argument("splineLogDensity: grid size should be at least 3 "
             "when extrapolating beyond both endpoints of the interval "
             "(function must be declining at both endpoints, hence cannot be a straight line)");
-    if(numNodes<2)
-        throw std::invalid_argument("splineLogDensity: grid size should be at least 2");
-    checkFiniteAndMonotonic(grid, "splineLogDensity", "x");
     double xmin = grid[0], xmax = grid[numNodes-1];
 
     // prepare the roughness penalty matrix
@@ -3143,67 +3626,24 @@ SplineLogDensityFitter<N>::SplineLogDensityFitter(
         blas_dmul((xmax-xmin) * numNodes / numData, roughnessMatrix);
     }
 
-    // quick scan to analyze the weights
-    double minWeight = INFINITY;
-    double avgx = 0, avgx2 = 0;
-    for(ptrdiff_t p=0; p<numData; p++) {
-        double xval = xvalues[p], weight = weights[p];
-        if(!(weight >= 0))
-            throw std::invalid_argument("splineLogDensity: sample weights may not be negative");
-        // if the interval is (semi-)finite, samples beyond its boundaries are ignored
-        if( (xval < xmin && !infLeft)  ||
-            (xval > xmax && !infRight) ||
-            !isFinite(xval) || weight == 0)
-            continue;
-        sumWeights += weight;
-        avgx       += weight * xval;
-        avgx2      += weight * pow_2(xval);
-        minWeight   = std::min(minWeight, weight);
-    }
-
     // sanity check
     if(!(sumWeights>0))
         throw std::invalid_argument("splineLogDensity: sum of sample weights should be positive");
 
     // compute the mean and dispersion of input samples
-    avgx /= sumWeights;
-    avgx2/= sumWeights;
+    double avgx = data.sumWeightsX / sumWeights, avgx2 = data.sumWeightsX2 / sumWeights;
     double dispx = fmax(avgx2 - pow_2(avgx), 0.01 * pow_2(xmax-xmin));
     avgx  = clip(avgx, xmin, xmax);
 
-    // compute the values of all nontrivial basis functions for each point,
-    // multiplied by the point weight, and store them in this matrix
-    SparseMatrixSpecial<N+1> Bmatrix(numData, numAmpl);
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static)
-#endif
-    for(ptrdiff_t p=0; p<numData; p++) {
-        double xval = xvalues[p], weight = weights[p] / sumWeights;
-        // if the interval is (semi-)finite, samples beyond its boundaries are ignored
-        if( (xval < xmin && !infLeft)  ||
-            (xval > xmax && !infRight) ||
-            !isFinite(xval) || weight == 0)
-            continue;
-        double Bspl[N+1];
-        int ind = N==1 ?
-            bsplineValuesExtrapolated<1>(xval, &grid[0], numNodes, Bspl) :
-            bsplineNaturalCubicValues   (xval, &grid[0], numNodes, Bspl);
-        for(int b=0; b<=N; b++)
-            Bspl[b] *= weight;
-        Bmatrix.assignRow(p, ind, Bspl);
-    }
-
-    // prepare the log-likelihoods of each basis fnc and other useful arrays
-    Vbasis.assign(numBasisFnc, 0.);
-    Wbasis.assign(numBasisFnc, 0.);
-    for(ptrdiff_t p=0; p<numData; p++) {
-        unsigned int ind = Bmatrix.indcol[p];
-        for(int b=0; b <= std::min<int>(N, numBasisFnc-ind-1); b++) {
-            double weight = weights[p] / sumWeights;
-            Vbasis.at(ind+b) += Bmatrix.values.at(p*(N+1)+b);
-            Wbasis.at(ind+b) += Bmatrix.values.at(p*(N+1)+b) * weight;
-        }
+    // the accumulated sums of basis functions (and their products) weighted by the sample weights
+    // are converted to the normalized weights w_i / M
+    Vbasis.resize(numBasisFnc);
+    Wbasis.resize(numBasisFnc);
+    for(unsigned int k=0; k<numBasisFnc; k++) {
+        Vbasis[k] = data.Vbasis[k] / sumWeights;
+        Wbasis[k] = data.Wbasis[k] / pow_2(sumWeights);
     }
+    double minWeight = data.minWeight;
 
     // normalize the sum of weights to unity (this is necessary for numerical stability),
     // but remember the log of the original sum of weights that will be added to amplitudes on output
@@ -3239,7 +3679,11 @@ SplineLogDensityFitter<N>::SplineLogDensityFitter(
     Wbasis.resize(numAmpl);
 
     // construct the matrix C = B^T B that is used in cross-validation
-    BTBmatrix = Matrix<double>(Bmatrix.multiplyByTransposed());
+    // (excluding the last basis function, similarly to V and W)
+    BTBmatrix = Matrix<double>(numAmpl, numAmpl, 0.);
+    for(unsigned int k=0; k<numAmpl; k++)
+        for(unsigned int d=0; d<=N && k+d<numAmpl; d++)
+            BTBmatrix(k, k+d) = BTBmatrix(k+d, k) = data.BTB[k*(N+1)+d] / pow_2(data.sumWeights);
 
     // assign the initial guess for amplitudes using a Gaussian density distribution
     params.ampl.assign(numBasisFnc, 0);
@@ -3563,15 +4007,93 @@ private:
 };
 }  // internal namespace
 
+//------------ ACCUMULATED DATA FOR LOG-SPLINE DENSITY ESTIMATOR ------------//
+
+template<int N>
+SplineLogDensityData<N>::SplineLogDensityData(const std::vector<double>& _grid, FitOptions _options) :
+    grid(_grid),
+    options(_options),
+    numData(0),
+    sumWeights(0),
+    sumWeightsX(0),
+    sumWeightsX2(0),
+    minWeight(INFINITY),
+    Vbasis(grid.size(), 0.),
+    Wbasis(grid.size(), 0.),
+    BTB(grid.size() * (N+1), 0.)
+{
+    if(grid.size()<2)
+        throw std::invalid_argument("splineLogDensity: grid size should be at least 2");
+    checkFiniteAndMonotonic(grid, "splineLogDensity", "x");
+}
+
+template<int N>
+void SplineLogDensityData<N>::add(double xval, double weight)
+{
+    if(!(weight >= 0))
+        throw std::invalid_argument("splineLogDensity: sample weights may not be negative");
+    numData++;
+    // if the interval is (semi-)finite, samples beyond its boundaries are ignored
+    unsigned int numNodes = grid.size();
+    if( (xval < grid[0]          && (options & FO_INFINITE_LEFT)  != FO_INFINITE_LEFT)  ||
+        (xval > grid[numNodes-1] && (options & FO_INFINITE_RIGHT) != FO_INFINITE_RIGHT) ||
+        !isFinite(xval) || weight == 0)
+        return;
+    sumWeights  += weight;
+    sumWeightsX += weight * xval;
+    sumWeightsX2+= weight * pow_2(xval);
+    minWeight    = std::min(minWeight, weight);
+    // compute the values of all nontrivial basis functions at this point
+    double Bspl[N+1];
+    unsigned int ind = N==1 ?
+        bsplineValuesExtrapolated<1>(xval, &grid[0], numNodes, Bspl) :
+        bsplineNaturalCubicValues   (xval, &grid[0], numNodes, Bspl);
+    unsigned int nvals = std::min<unsigned int>(N+1, numNodes-ind);
+    for(unsigned int i=0; i<nvals; i++) {
+        Vbasis[ind+i] += weight * Bspl[i];
+        Wbasis[ind+i] += pow_2(weight) * Bspl[i];
+        for(unsigned int j=i; j<nvals; j++)
+            BTB[(ind+i)*(N+1)+j-i] += pow_2(weight) * Bspl[i] * Bspl[j];
+    }
+}
+
+template<int N>
+void SplineLogDensityData<N>::add(const SplineLogDensityData<N>& other)
+{
+    if(other.grid != grid || other.options != options)
+        throw std::invalid_argument("splineLogDensity: incompatible objects");
+    numData     += other.numData;
+    sumWeights  += other.sumWeights;
+    sumWeightsX += other.sumWeightsX;
+    sumWeightsX2+= other.sumWeightsX2;
+    minWeight    = std::min(minWeight, other.minWeight);
+    for(size_t k=0; k<Vbasis.size(); k++) {
+        Vbasis[k] += other.Vbasis[k];
+        Wbasis[k] += other.Wbasis[k];
+    }
+    for(size_t k=0; k<BTB.size(); k++)
+        BTB[k] += other.BTB[k];
+}
+
 template<int N>
 std::vector<double> splineLogDensity(const std::vector<double> &grid,
     const std::vector<double> &xvalues, const std::vector<double> &weights,
     FitOptions options, double smoothing)
+{
+    ptrdiff_t numData = xvalues.size();
+    if(!weights.empty() && numData != (ptrdiff_t)weights.size())
+        throw std::length_error("splineLogDensity: sizes of input arrays are not equal");
+    SplineLogDensityData<N> data(grid, options);
+    for(ptrdiff_t p=0; p<numData; p++)
+        data.add(xvalues[p], weights.empty() ? 1./numData : weights[p]);
+    return splineLogDensity<N>(data, smoothing);
+}
+
+template<int N>
+std::vector<double> splineLogDensity(const SplineLogDensityData<N>& data, double smoothing)
 {
     SplineLogFitParams params;
-    const SplineLogDensityFitter<N> fitter(grid, xvalues,
-        weights.empty()? std::vector<double>(xvalues.size(), 1./xvalues.size()) : weights,
-        options, params);
+    const SplineLogDensityFitter<N> fitter(data, params);
     // Find the value of lambda and corresponding amplitudes that maximize the cross-validation score.
     // Normally lambda is a small number ( << 1), but it ranges from 0 to infinity,
     // so the root-finder uses a scaling transformation, such that scaledLambda=1
@@ -3602,6 +4124,10 @@ template std::vector<double> splineLogDensity<1>(
     const std::vector<double>&, const std::vector<double>&, const std::vector<double>&, FitOptions, double);
 template std::vector<double> splineLogDensity<3>(
     const std::vector<double>&, const std::vector<double>&, const std::vector<double>&, FitOptions, double);
+template std::vector<double> splineLogDensity<1>(const SplineLogDensityData<1>&, double);
+template std::vector<double> splineLogDensity<3>(const SplineLogDensityData<3>&, double);
+template class SplineLogDensityData<1>;
+template class SplineLogDensityData<3>;
 
 //------------ GENERATION OF UNEQUALLY SPACED GRIDS ------------//
 
@@ -87,6 +87,47 @@ In the 3d case, the amplitudes are directly used with a cubic (N=3) 3d B-spline
 
 namespace math{
 
+/** Helper class for locating the grid cell that contains a given point.
+    At construction, it checks whether the grid nodes follow one of the analytic laws produced
+    by the standard grid-generation routines:  uniform (createUniformGrid),  exponential
+    (createExpGrid),  or  x_k = B (exp(A k) - 1)  (createNonuniformGrid, possibly mirrored about
+    zero as in createSymmetricGrid).
+    In these cases the index is computed directly from the inverse of the generating law,
+    followed by a correction step to account for roundoff errors; this is O(1) and branch-free
+    in the common case. For other grids, including the asinh-scaled grids of CylSpline, whose
+    inverse law is more expensive than the binary search itself, it falls back to binSearch.
+    The result is identical to that of binSearch for the same grid.
+*/
+class GridLocator {
+public:
+    GridLocator() : law(GL_GENERIC), mirrored(false), center(0), x0(0), A(0), B(0) {}
+
+    /// analyze the grid (it must be sorted in increasing order and contain at least two nodes)
+    explicit GridLocator(const std::vector<double>& grid);
+
+    /** return the index of the grid cell containing the point x, or -1 or N-1 if the point
+        is outside the grid (same convention as binSearch);
+        the grid must be the same as the one passed to the constructor */
+    ptrdiff_t operator()(const double x, const double grid[], const size_t size) const;
+
+    /** same as above, but for a generic grid the search starts from the cell given by the hint
+        (see the hinted variant of binSearch), which is updated on output;
+        for grids with an analytic law the hint is not needed and is left unchanged */
+    ptrdiff_t operator()(const double x, const double grid[], const size_t size,
+        ptrdiff_t& hint) const;
+
+private:
+    enum {
+        GL_GENERIC,  ///< arbitrary grid - use binary search
+        GL_UNIFORM,  ///< x_k = x0 + k / A
+        GL_EXP,      ///< x_k = exp(k / A) / x0
+        GL_NONUNIF   ///< x_k = (exp(k / A) - 1) / B
+    } law;
+    bool mirrored;   ///< whether the grid is symmetric about zero (for GL_NONUNIF only)
+    ptrdiff_t center;///< index of the zero node in a mirrored grid
+    double x0, A, B; ///< parameters of the generating law (stored in the form used in the inverse law)
+};
+
 ///@{
 /// \name One-dimensional interpolation
 
@@ -119,6 +160,7 @@ public:
 protected:
     std::vector<double> xval;  ///< grid nodes
     std::vector<double> fval;  ///< values of function at grid nodes
+    GridLocator xloc;          ///< locator of grid cells
 };
 
 
@@ -598,6 +640,52 @@ InterpT constantInterp(double val) {
 /// \name Two-dimensional interpolation
 ///@{
 
+/** Indices of the grid cell found in the previous evaluation of a 2d interpolator.
+    When passed to evalDeriv, the search for the cell containing the next point starts from this
+    cell and its neighbours, which is faster when consecutive points are close to each other
+    (e.g., along an orbit); on output, it contains the cell of the current point.
+    The same instance may be used with several interpolators defined on the same grid,
+    but must not be shared between threads.
+*/
+struct CellHint2d {
+    ptrdiff_t ix, iy;  ///< indices of the cell in x and y (-1 if unknown)
+    CellHint2d() : ix(-1), iy(-1) {}
+};
+
+/** A small collection of cell hints for several groups of 2d interpolators, keyed by an arbitrary
+    address (e.g., of the object owning the interpolators), with round-robin replacement.
+    An instance of this class is owned by a client that evaluates a sequence of nearby points
+    (e.g., an orbit integrator), and is made visible to the interpolators deep down the call chain
+    by a CellHintScope object; it must not be shared between threads.
+*/
+class CellHintCache {
+public:
+    CellHintCache();
+
+    /// return the hint associated with the given key, or a fresh one if it is not in the cache
+    CellHint2d& get(const void* key);
+
+    /// return the cache made active in the current thread by CellHintScope, or NULL if none
+    static CellHintCache* active();
+private:
+    static const int SIZE = 8;
+    const void* keys[SIZE];
+    CellHint2d hints[SIZE];
+    int next;  ///< index of the slot to be replaced next
+};
+
+/** Makes the given cache active in the current thread during the lifetime of this object,
+    and restores the previously active one (if any) upon destruction */
+class CellHintScope {
+public:
+    explicit CellHintScope(CellHintCache& cache);
+    ~CellHintScope();
+private:
+    CellHintCache* prev;
+    CellHintScope(const CellHintScope&);
+    CellHintScope& operator=(const CellHintScope&);
+};
+
 /** Generic two-dimensional interpolator class */
 class BaseInterpolator2d: public IFunctionNdim {
 public:
@@ -626,6 +714,14 @@ public:
         double* value=NULL, double* deriv_x=NULL, double* deriv_y=NULL,
         double* deriv_xx=NULL, double* deriv_xy=NULL, double* deriv_yy=NULL) const = 0;
 
+    /** same as above, using and updating the hint for the location of the grid cell;
+        the default implementation ignores the hint */
+    virtual void evalDeriv(const double x, const double y, CellHint2d& /*hint*/,
+        double* value=NULL, double* deriv_x=NULL, double* deriv_y=NULL,
+        double* deriv_xx=NULL, double* deriv_xy=NULL, double* deriv_yy=NULL) const {
+        evalDeriv(x, y, value, deriv_x, deriv_y, deriv_xx, deriv_xy, deriv_yy);
+    }
+
     /** shortcut for computing the value of spline */
     double value(const double x, const double y) const {
         double v;
@@ -647,7 +743,7 @@ public:
     double ymax() const { return yval.size()? yval.back() : NAN; }
 
     /** check if the interpolator is initialized */
-    bool empty() const { return fval.empty(); }
+    bool empty() const { return xval.empty(); }
 
     /** return the array of grid nodes in x-coordinate */
     const std::vector<double>& xvalues() const { return xval; }
@@ -655,9 +751,26 @@ public:
     /** return the array of grid nodes in y-coordinate */
     const std::vector<double>& yvalues() const { return yval; }
 
+    /** Convert the stored coefficients to single precision, halving the memory footprint of
+        the interpolator (the evaluation is still carried out in double precision).
+        This is supported by cubic and quintic splines, and does nothing for other interpolators.
+        \return  the maximum deviation of the interpolated values from the original ones,
+        measured at the centres of grid cells and normalized by the maximum absolute value
+        of the function at grid nodes (zero if the conversion did not take place).
+    */
+    double reducePrecision();
+
+    /** check if the coefficients are stored in single precision */
+    bool singlePrecision() const { return !empty() && fval.empty(); }
+
 protected:
     std::vector<double> xval, yval;  ///< grid nodes in x and y directions
-    std::vector<double> fval;        ///< flattened row-major 2d array of f values
+    std::vector<double> fval;        ///< flattened row-major 2d array of f values (empty if stored as float)
+    GridLocator xloc, yloc;          ///< locators of grid cells in x and y directions
+
+    /** convert the coefficients to single precision and release the double-precision arrays;
+        return false if this is not supported by the derived class */
+    virtual bool storeSinglePrecision() { return false; }
 };
 
 
@@ -682,6 +795,8 @@ public:
     :
         BaseInterpolator2d(xvalues, yvalues, fvalues) {}
 
+    using BaseInterpolator2d::evalDeriv;
+
     /** Compute the value and/or derivatives of the interpolator;
         note that for the linear interpolator the 2nd derivatives are always zero. */
     virtual void evalDeriv(double x, double y,
@@ -726,9 +841,22 @@ public:
         double* value=NULL, double* deriv_x=NULL, double* deriv_y=NULL,
         double* deriv_xx=NULL, double* deriv_xy=NULL, double* deriv_yy=NULL) const;
 
+    /** same as above, starting the search of the grid cell from the one given by the hint */
+    virtual void evalDeriv(double x, double y, CellHint2d& hint,
+        double* value=NULL, double* deriv_x=NULL, double* deriv_y=NULL,
+        double* deriv_xx=NULL, double* deriv_xy=NULL, double* deriv_yy=NULL) const;
+
 private:
     /// flattened 2d arrays of derivatives in x and y directions, and mixed 2nd derivatives
     std::vector<double> fx, fy, fxy;
+    /// the same four arrays (f, fx, fy, fxy) concatenated and stored in single precision
+    std::vector<float> coef32;
+    virtual bool storeSinglePrecision();
+    template<typename NumT>
+    void evalDerivImpl(const NumT* const coefs[4], ptrdiff_t xi, ptrdiff_t yi,
+        double x, double y,
+        double* value, double* deriv_x, double* deriv_y,
+        double* deriv_xx, double* deriv_xy, double* deriv_yy) const;
 };
 
 
@@ -762,9 +890,22 @@ public:
         double* value=NULL, double* deriv_x=NULL, double* deriv_y=NULL,
         double* deriv_xx=NULL, double* deriv_xy=NULL, double* deriv_yy=NULL) const;
 
+    /** same as above, starting the search of the grid cell from the one given by the hint */
+    virtual void evalDeriv(double x, double y, CellHint2d& hint,
+        double* value=NULL, double* deriv_x=NULL, double* deriv_y=NULL,
+        double* deriv_xx=NULL, double* deriv_xy=NULL, double* deriv_yy=NULL) const;
+
 private:
     /// flattened 2d arrays of various derivatives
     std::vector<double> fx, fy, fxx, fxy, fyy, fxxy, fxyy, fxxyy;
+    /// the nine arrays (f, fx, fy, fxx, fxy, fyy, fxxy, fxyy, fxxyy) stored in single precision
+    std::vector<float> coef32;
+    virtual bool storeSinglePrecision();
+    template<typename NumT>
+    void evalDerivImpl(const NumT* const coefs[9], ptrdiff_t xi, ptrdiff_t yi,
+        double x, double y,
+        double* value, double* deriv_x, double* deriv_y,
+        double* deriv_xx, double* deriv_xy, double* deriv_yy) const;
     void setupWoutMixedDeriv(size_t xsize, size_t ysize);
     void setupWithMixedDeriv(size_t xsize, size_t ysize);
 };
@@ -812,6 +953,7 @@ public:
 private:
     std::vector<double> xval, yval, zval;  ///< grid nodes in x, y and z directions
     std::vector<double> fval;              ///< flattened 3d array of function values at 3d grid nodes
+    GridLocator xloc, yloc, zloc;          ///< locators of grid cells in x, y and z directions
 };
 
 
@@ -848,8 +990,39 @@ public:
     */
     double value(double x, double y, double z) const;
 
+    /** Compute the value of the interpolator and optionally its first and second derivatives
+        at the given point; if it is outside the grid boundaries, all outputs are NAN.
+        \param[in]  x,y,z  are the coordinates of the point;
+        \param[out] val  will contain the value of the interpolator (if not NULL);
+        \param[out] deriv  will contain three first derivatives by x, y, z (if not NULL);
+        \param[out] deriv2  will contain six second derivatives in the order
+        xx, yy, zz, xy, yz, xz (if not NULL).
+    */
+    void evalDeriv(double x, double y, double z,
+        double* val, double deriv[3]=NULL, double deriv2[6]=NULL) const;
+
     /** check if the interpolator is initialized */
-    bool empty() const { return fval.empty(); }
+    bool empty() const { return xval.empty(); }
+
+    /** return the array of grid nodes in x-coordinate */
+    const std::vector<double>& xvalues() const { return xval; }
+
+    /** return the array of grid nodes in y-coordinate */
+    const std::vector<double>& yvalues() const { return yval; }
+
+    /** return the array of grid nodes in z-coordinate */
+    const std::vector<double>& zvalues() const { return zval; }
+
+    /** Convert the stored coefficients to single precision, halving the memory footprint
+        (the evaluation is still carried out in double precision).
+        \return  the maximum deviation of the interpolated values from the original ones,
+        measured at the centres of grid cells and normalized by the maximum absolute value
+        of the function at grid nodes (zero if the coefficients were already converted).
+    */
+    double reducePrecision();
+
+    /** check if the coefficients are stored in single precision */
+    bool singlePrecision() const { return !coef32.empty(); }
 
     // IFunctionNdim interface
     virtual void eval(const double point[3], double *val) const {
@@ -862,6 +1035,12 @@ private:
     std::vector<double> xval, yval, zval;  ///< grid nodes in x, y and z directions
     /// values and various derivatives of the function at 3d grid nodes
     std::vector<double> fval, fx, fy, fz, fxy, fxz, fyz, fxyz;
+    /// the same eight arrays concatenated and stored in single precision (if requested)
+    std::vector<float> coef32;
+    GridLocator xloc, yloc, zloc;          ///< locators of grid cells in x, y and z directions
+    template<typename NumT>
+    void evalDerivImpl(const NumT* const coefs[8], double x, double y, double z,
+        double* val, double deriv[3], double deriv2[6]) const;
 };
 
 
@@ -1114,7 +1293,12 @@ std::vector<double> createBsplineInterpolator3dArrayFromSamples(
     z = B^T W y, where y[i] is the vector of original data points;
     R is the roughness penalty matrix:  \f$ R_pq = \int B''_p(x) B''_q(x) dx \f$.
 
+    The input data may be provided either as arrays of x, w (and later y), or in the form of
+    sufficient statistics C, z and y^T W y accumulated in a `SplineApproxData` object;
+    the latter option allows to fit arbitrarily large datasets with a fixed amount of memory.
 */
+class SplineApproxData;
+
 class SplineApprox {
 public:
     /** construct the object for grid=X, xvalues=x, weights=w in the above formulation.
@@ -1127,6 +1311,12 @@ public:
         const std::vector<double>& xvalues,
         const std::vector<double>& weights = std::vector<double>());
 
+    /** construct the object from the sufficient statistics accumulated over all data points;
+        in this case the y values are also taken from the accumulated data,
+        and fitting is performed by the methods taking the index of the data set as the first argument.
+    */
+    explicit SplineApprox(const SplineApproxData& data);
+
     ~SplineApprox();
 
     /** perform actual fitting for the array of y values with the given smoothing parameter.
@@ -1161,6 +1351,21 @@ public:
         return fitOversmooth(yvalues, 0., rmserror, edf);
     }
 
+    /** same as `fit()`, but for the data set with the given index
+        from the SplineApproxData object that was provided to the constructor */
+    std::vector<double> fit(
+        const unsigned int dataSet,
+        const double edf=0,
+        double *rmserror=NULL) const;
+
+    /** same as `fitOversmooth()`, but for the data set with the given index
+        from the SplineApproxData object that was provided to the constructor */
+    std::vector<double> fitOversmooth(
+        const unsigned int dataSet,
+        const double smoothing,
+        double *rmserror=NULL,
+        double* edf=NULL) const;
+
     /** perform an 'oversmooth' fitting with adaptive choice of smoothing parameter.
         smoothing>=0 determines the difference in ln(GCV) between the solution with
         optimal smoothing (lowest GCV) and the returned solution which is smoothed more than
@@ -1180,6 +1385,39 @@ private:
     SplineApprox(const SplineApprox&);              ///< copy constructor forbidden
 };
 
+/** Sufficient statistics for the penalized spline fitting problem (SplineApprox):
+    the matrix of normal equations  C = B^T W B,  and for each of several data sets y
+    sharing the same x-coordinates and weights, the vector  z = B^T W y  and the norm  y^T W y.
+    All these quantities are sums over data points, so they may be accumulated from a stream
+    of points arriving in blocks, and objects filled independently (e.g., by different threads)
+    can be merged; the memory usage depends only on the grid size and the number of data sets.
+*/
+class SplineApproxData {
+public:
+    /** create an empty object for the given grid (must be sorted in increasing order)
+        and the given number of data sets (y values associated with each point) */
+    explicit SplineApproxData(const std::vector<double>& grid, unsigned int numDataSets=1);
+
+    /** add one data point.
+        \param[in]  x  is the coordinate of the point;
+        \param[in]  weight  is its weight (non-negative);
+        \param[in]  yvalues  is the array of numDataSets values of the point in each data set.
+        \throw  std::invalid_argument if the weight is negative.
+    */
+    void add(double x, double weight, const double yvalues[]);
+
+    /** add the statistics accumulated in another object with the same grid and number of data sets */
+    void add(const SplineApproxData& other);
+
+    std::vector<double> grid;         ///< grid nodes defining the basis functions
+    unsigned int numDataSets;         ///< number of data sets (y arrays)
+    ptrdiff_t numDataPoints;          ///< number of data points added so far
+    double sumWeights;                ///< sum of weights of all points
+    std::vector<double> normalMatrix; ///< C, banded storage: C(k,k+d) = normalMatrix[k*4+d], d=0..3
+    std::vector<double> rhs;          ///< z for each data set: z_k = rhs[dataSet*grid.size()+k]
+    std::vector<double> ynorm2;       ///< y^T W y for each data set
+};
+
 
 /** Parameters of penalized log-density fit */
 enum FitOptions {
@@ -1256,6 +1494,45 @@ std::vector<double> splineLogDensity(
     FitOptions options=FitOptions(),
     double smoothing=0);
 
+/** Sufficient statistics of the samples used in the penalized log-spline density estimate
+    (the sums over samples of basis functions and of their products, weighted with the sample weights).
+    As in SplineApproxData, the samples may be added in blocks, and several objects may be merged,
+    so that the memory usage of the density estimation is independent of the number of samples.
+    \tparam  N is the degree of B-splines (1 or 3), the same as in `splineLogDensity()`.
+*/
+template<int N>
+class SplineLogDensityData {
+public:
+    /** create an empty object for the given grid and fitting options (same as in `splineLogDensity`) */
+    SplineLogDensityData(const std::vector<double>& grid, FitOptions options=FitOptions());
+
+    /** add one sample with coordinate x and weight w.
+        \throw  std::invalid_argument if the weight is negative. */
+    void add(double x, double weight);
+
+    /** add the statistics accumulated in another object with the same grid and options */
+    void add(const SplineLogDensityData& other);
+
+    std::vector<double> grid;     ///< grid nodes defining the basis functions
+    FitOptions options;           ///< fitting options
+    ptrdiff_t numData;            ///< total number of samples, including those outside the domain
+    double sumWeights;            ///< sum of weights of samples within the domain
+    double sumWeightsX;           ///< sum of w*x
+    double sumWeightsX2;          ///< sum of w*x^2
+    double minWeight;             ///< smallest nonzero weight of samples
+    std::vector<double> Vbasis;   ///< V_k = \sum_i w_i B_k(x_i)
+    std::vector<double> Wbasis;   ///< W_k = \sum_i w_i^2 B_k(x_i)
+    std::vector<double> BTB;      ///< \sum_i w_i^2 B_k(x_i) B_l(x_i), banded: (k,k+d) -> [k*(N+1)+d]
+};
+
+/** Penalized log-spline density estimate from the sufficient statistics of samples
+    accumulated in a SplineLogDensityData object; the grid and options are taken from this object,
+    and the meaning of the smoothing parameter and the output are the same as in the other variant
+    of this routine (which just accumulates the statistics for the input arrays and calls this one).
+*/
+template<int N>
+std::vector<double> splineLogDensity(const SplineLogDensityData<N>& data, double smoothing=0);
+
 ///@}
 /// \name Auxiliary routines for grid generation
 ///@{
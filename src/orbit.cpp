@@ -174,6 +174,7 @@ void OrbitIntegrator<coord::Car>::eval(const double time, const double x[], doub
     // it appears to be more efficient to perform the integration in an inertial frame,
     // and rotate the potential instead
     coord::GradCar grad;
+    math::CellHintScope scope(cellHints);
     potential.eval(coord::PosCar(x[0]*ca + x[1]*sa, x[1]*ca - x[0]*sa, x[2]), NULL, &grad, NULL, time);
     // time derivative of position
     dxdt[0] = x[3];
@@ -194,6 +195,7 @@ void OrbitIntegrator<coord::Cyl>::eval(const double time, const double x[], doub
         p.phi += M_PI;
     }
     coord::GradCyl grad;
+    math::CellHintScope scope(cellHints);
     potential.eval(p, NULL, &grad, NULL, time);
     double Rinv = p.R!=0 ? 1/p.R : 0;  // avoid NAN in degenerate cases
     if(x[0]<0)
@@ -232,6 +234,7 @@ void OrbitIntegrator<coord::Sph>::eval(const double time, const double x[], doub
         phi += M_PI;
     const coord::PosVelSph p(r, theta, phi, x[3], x[4], x[5]);
     coord::GradSph grad;
+    math::CellHintScope scope(cellHints);
     potential.eval(p, NULL, &grad, NULL, time);
     double rinv = r!=0 ? 1/r : 0, sintheta, costheta;
     math::sincos(theta, sintheta, costheta);
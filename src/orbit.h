@@ -34,6 +34,7 @@
 #include "smart.h"
 #include "potential_base.h"
 #include "math_ode.h"
+#include "math_spline.h"
 #include <vector>
 #include <utility>
 
@@ -157,6 +158,9 @@ class BaseOrbitIntegrator: public math::IOdeSystem {
     std::vector<PtrRuntimeFnc> fncs; ///< list of runtime functions attached to the given orbit
 protected:
     math::OdeSolverDOP853 solver;    ///< the actual ODE integrator
+    /// hints for the location of grid cells in the interpolators of the potential, kept between
+    /// consecutive evaluations of the right-hand side of the ODE which are close to each other
+    mutable math::CellHintCache cellHints;
 public:
     /// gravitational potential in which the orbit is computed (accessible to runtime functions)
     const potential::BasePotential& potential;
@@ -115,6 +115,34 @@ typedef ParticleArray<coord::PosVelCyl>  ParticleArrayCyl;
 typedef ParticleArray<coord::PosVelSph>  ParticleArraySph;
 typedef ParticleArray<ParticleAux> ParticleArrayAux;
 
+/** Interface for receiving particles in chunks from routines that produce a large number of them
+    (e.g., the streaming variants of sampling routines in galaxymodel), so that the entire array
+    need not be kept in memory. A derived class may store the particles, write them to a file,
+    or process them in any other way.
+    \tparam  ParticleT  is the particle type
+*/
+template<typename ParticleT>
+class IParticleSink {
+public:
+    virtual ~IParticleSink() {}
+
+    /** receive the next chunk of particles; the calls are made sequentially (not from
+        a parallel section), and the chunk is not retained by the caller after the call */
+    virtual void add(const ParticleArray<ParticleT>& chunk) = 0;
+};
+
+/// a trivial sink that collects all particles into a single array
+template<typename ParticleT>
+class ParticleCollector: public IParticleSink<ParticleT> {
+public:
+    /// all particles received so far
+    ParticleArray<ParticleT> particles;
+
+    virtual void add(const ParticleArray<ParticleT>& chunk) {
+        particles.data.insert(particles.data.end(), chunk.data.begin(), chunk.data.end());
+    }
+};
+
 
 /// specializations of conversion operator for the case that both SrcT and DestT
 /// are pos/vel/mass particle types in possibly different coordinate systems
@@ -4,8 +4,18 @@
 #endif
 #include <fstream>
 #include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <clocale>
+#include <algorithm>
 #include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
 #include "utils.h"
+#include "smart.h"
 
 namespace particles {
 
@@ -13,6 +23,15 @@ namespace{  // internal
 
 //----- text file format -----//
 
+/// number of particles formatted by a single thread when writing a text snapshot
+static const ptrdiff_t TEXT_BLOCK_SIZE = 16384;
+
+/// number of blocks formatted in parallel before writing them to the file
+static const int TEXT_BLOCKS_PER_ROUND = 64;
+
+/// size of a chunk of the file (in bytes) that is parsed by a single thread when reading a text snapshot
+static const size_t TEXT_CHUNK_BYTES = 4194304;
+
 template<typename ParticleT>
 const char* formatHeader();
 
@@ -32,42 +51,64 @@ template<> inline const char* formatHeader<ParticleAux>() {
     return "#x\ty\tz\tvx\tvy\tvz\tparticleMass\tstellarMass\tstellarRadius\n";
 }
 
+// each value is printed with 8 significant digits (same as utils::toString(value, 8)),
+// using a single call to snprintf per particle
 template<> inline std::string formatParticle<coord::PosCar>(
     const ParticleArray<coord::PosCar>::ElemType& point, const units::ExternalUnits& conv)
 {
-    return
-    utils::toString(point.first.x  / conv.lengthUnit, 8) + '\t' +
-    utils::toString(point.first.y  / conv.lengthUnit, 8) + '\t' +
-    utils::toString(point.first.z  / conv.lengthUnit, 8) + '\t' +
-    utils::toString(point.second   / conv.massUnit  , 8) + '\n';
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf), "%.8g\t%.8g\t%.8g\t%.8g\n",
+        point.first.x  / conv.lengthUnit,
+        point.first.y  / conv.lengthUnit,
+        point.first.z  / conv.lengthUnit,
+        point.second   / conv.massUnit);
+    return std::string(buf, std::min<int>(len, sizeof(buf)-1));
 }
 
 template<> inline std::string formatParticle<coord::PosVelCar>(
     const ParticleArray<coord::PosVelCar>::ElemType& point, const units::ExternalUnits& conv)
 {
-    return
-    utils::toString(point.first.x  / conv.lengthUnit  , 8) + '\t' +
-    utils::toString(point.first.y  / conv.lengthUnit  , 8) + '\t' +
-    utils::toString(point.first.z  / conv.lengthUnit  , 8) + '\t' +
-    utils::toString(point.first.vx / conv.velocityUnit, 8) + '\t' +
-    utils::toString(point.first.vy / conv.velocityUnit, 8) + '\t' +
-    utils::toString(point.first.vz / conv.velocityUnit, 8) + '\t' +
-    utils::toString(point.second   / conv.massUnit    , 8) + '\n';
+    char buf[256];
+    int len = snprintf(buf, sizeof(buf), "%.8g\t%.8g\t%.8g\t%.8g\t%.8g\t%.8g\t%.8g\n",
+        point.first.x  / conv.lengthUnit,
+        point.first.y  / conv.lengthUnit,
+        point.first.z  / conv.lengthUnit,
+        point.first.vx / conv.velocityUnit,
+        point.first.vy / conv.velocityUnit,
+        point.first.vz / conv.velocityUnit,
+        point.second   / conv.massUnit);
+    return std::string(buf, std::min<int>(len, sizeof(buf)-1));
 }
 
 template<> inline std::string formatParticle<ParticleAux>(
     const ParticleArray<ParticleAux>::ElemType& point, const units::ExternalUnits& conv)
 {
-    return
-    utils::toString(point.first.x  / conv.lengthUnit  , 8) + '\t' +
-    utils::toString(point.first.y  / conv.lengthUnit  , 8) + '\t' +
-    utils::toString(point.first.z  / conv.lengthUnit  , 8) + '\t' +
-    utils::toString(point.first.vx / conv.velocityUnit, 8) + '\t' +
-    utils::toString(point.first.vy / conv.velocityUnit, 8) + '\t' +
-    utils::toString(point.first.vz / conv.velocityUnit, 8) + '\t' +
-    utils::toString(point.second   / conv.massUnit    , 8) + '\t' +
-    utils::toString(point.first.stellarMass   / conv.massUnit  , 8) + '\t' +
-    utils::toString(point.first.stellarRadius / conv.lengthUnit, 8) + '\n';
+    char buf[256];
+    int len = snprintf(buf, sizeof(buf), "%.8g\t%.8g\t%.8g\t%.8g\t%.8g\t%.8g\t%.8g\t%.8g\t%.8g\n",
+        point.first.x  / conv.lengthUnit,
+        point.first.y  / conv.lengthUnit,
+        point.first.z  / conv.lengthUnit,
+        point.first.vx / conv.velocityUnit,
+        point.first.vy / conv.velocityUnit,
+        point.first.vz / conv.velocityUnit,
+        point.second   / conv.massUnit,
+        point.first.stellarMass   / conv.massUnit,
+        point.first.stellarRadius / conv.lengthUnit);
+    return std::string(buf, std::min<int>(len, sizeof(buf)-1));
+}
+
+/// write the header lines of a text snapshot
+template<typename ParticleT>
+void writeTextHeader(std::ostream& strm,
+    const units::ExternalUnits& conv,
+    const std::string& header,
+    const double time)
+{
+    if(!header.empty())
+        strm << "#" << header << "\n";
+    if(isFinite(time))
+        strm << "#time: " << time / conv.timeUnit << "\n";
+    strm << formatHeader<ParticleT>();
 }
 
 template<typename ParticleT>
@@ -81,52 +122,256 @@ void writeSnapshotText(
     std::ofstream strm(fileName.c_str(), std::ios::out);
     if(!strm) 
         throw std::runtime_error("writeSnapshotText: cannot write to file "+fileName);
-    if(!header.empty())
-        strm << "#" << header << "\n";
-    if(isFinite(time))
-        strm << "#time: " << time / conv.timeUnit << "\n";
-    strm << formatHeader<ParticleT>();
-    for(size_t indx=0; indx<points.size(); indx++)
-        strm << formatParticle<ParticleT>(points[indx], conv);
+    writeTextHeader<ParticleT>(strm, conv, header, time);
+    // particles are formatted in parallel into separate buffers for each block,
+    // which are then written sequentially; this is repeated for groups of blocks
+    const ptrdiff_t nbody = points.size();
+    std::vector<std::string> buffers(TEXT_BLOCKS_PER_ROUND);
+    for(ptrdiff_t roundStart=0; roundStart<nbody && strm.good();
+        roundStart += TEXT_BLOCK_SIZE * TEXT_BLOCKS_PER_ROUND)
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for(int b=0; b<TEXT_BLOCKS_PER_ROUND; b++) {
+            ptrdiff_t ibegin = std::min(nbody, roundStart + b * TEXT_BLOCK_SIZE),
+            iend = std::min(nbody, ibegin + TEXT_BLOCK_SIZE);
+            buffers[b].clear();
+            for(ptrdiff_t indx=ibegin; indx<iend; indx++)
+                buffers[b] += formatParticle<ParticleT>(points[indx], conv);
+        }
+        for(int b=0; b<TEXT_BLOCKS_PER_ROUND; b++)
+            strm.write(buffers[b].data(), buffers[b].size());
+    }
     if(!strm.good())
         throw std::runtime_error("writeSnapshotText: cannot write to file "+fileName);
 }
 
+/// powers of ten that are exactly representable in double precision
+static const double EXACT_POWERS_OF_10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/** Locale-independent parser of a floating-point number at the beginning of a character range.
+    Numbers with at most 15 significant digits and a moderate decimal exponent (the common case)
+    are converted exactly by a single multiplication or division;
+    other cases (including inf/nan) are delegated to strtod, with the decimal point replaced
+    by the one of the current C locale, so that the result does not depend on the locale.
+    \param[in]  begin, end  is the range of characters (not necessarily null-terminated);
+    \param[out] result  will contain the parsed number;
+    \return  the pointer to the first character after the number, or `begin` if no number was found.
+*/
+const char* parseDouble(const char* begin, const char* end, double& result)
+{
+    const char* p = begin;
+    bool negative = false;
+    if(p<end && (*p=='+' || *p=='-'))
+        negative = *p++ == '-';
+    uint64_t mantissa = 0;
+    int numDigits = 0, exponent = 0;
+    bool anyDigits = false;
+    for(; p<end && *p>='0' && *p<='9'; p++) {
+        anyDigits = true;
+        if(numDigits < 19 && (mantissa > 0 || *p != '0')) {
+            mantissa = mantissa * 10 + (*p - '0');
+            numDigits++;
+        } else if(mantissa > 0)
+            exponent++;   // extra digits beyond the precision of the mantissa
+    }
+    if(p<end && *p=='.') {
+        for(p++; p<end && *p>='0' && *p<='9'; p++) {
+            anyDigits = true;
+            if(numDigits < 19 && (mantissa > 0 || *p != '0')) {
+                mantissa = mantissa * 10 + (*p - '0');
+                numDigits++;
+                exponent--;
+            } else if(mantissa == 0)
+                exponent--;   // leading zeros after the decimal point
+        }
+    }
+    if(anyDigits && p<end && (*p=='e' || *p=='E')) {
+        const char* q = p+1;
+        bool negexp = false;
+        if(q<end && (*q=='+' || *q=='-'))
+            negexp = *q++ == '-';
+        if(q<end && *q>='0' && *q<='9') {   // otherwise 'e' is not a part of the number
+            int exp = 0;
+            for(; q<end && *q>='0' && *q<='9'; q++)
+                exp = std::min(exp * 10 + (*q - '0'), 100000);
+            exponent += negexp ? -exp : exp;
+            p = q;
+        }
+    }
+    if(anyDigits && mantissa == 0) {
+        result = negative ? -0. : 0.;
+        return p;
+    }
+    if(anyDigits && numDigits <= 15 && exponent >= -22 && exponent <= 22) {
+        result = exponent >= 0 ?
+            mantissa * EXACT_POWERS_OF_10[exponent] :
+            mantissa / EXACT_POWERS_OF_10[-exponent];
+        if(negative)
+            result = -result;
+        return p;
+    }
+    // general case: copy the token into a null-terminated string and use the standard routine
+    const char* tokenEnd = anyDigits ? p : std::min(end, begin + 64);
+    std::string token(begin, tokenEnd);
+    const char decimalPoint = localeconv()->decimal_point[0];
+    if(decimalPoint != '.')
+        std::replace(token.begin(), token.end(), '.', decimalPoint);
+    char* parsedEnd;
+    result = strtod(token.c_str(), &parsedEnd);
+    return begin + (parsedEnd - token.c_str());
+}
+
+/// split a line of text into fields separated by any of the characters "#;, \t";
+/// store the pointers to the beginning and end of the first `maxFields` fields,
+/// and return the total number of fields
+int splitTextLine(const char* begin, const char* end, int maxFields, const char* fields[][2])
+{
+    int numFields = 0;
+    const char* p = begin;
+    while(true) {
+        while(p<end && (*p==' ' || *p=='\t' || *p==',' || *p=='#' || *p==';'))
+            p++;
+        if(p>=end)
+            return numFields;
+        const char* fieldBegin = p;
+        while(p<end && !(*p==' ' || *p=='\t' || *p==',' || *p=='#' || *p==';'))
+            p++;
+        if(numFields < maxFields) {
+            fields[numFields][0] = fieldBegin;
+            fields[numFields][1] = p;
+        }
+        numFields++;
+    }
+}
+
+/// maximum number of fields used in a line of a text snapshot
+static const int TEXT_MAX_FIELDS = 9;
+
+/// parse one line of a text snapshot;
+/// return false if this is not a line with particle data (comment, header, too few fields),
+/// otherwise parse the particle if the output pointer is not NULL, and return true
+bool parseTextLine(const char* begin, const char* end,
+    const units::ExternalUnits& conv, ParticleArrayAux::ElemType* output)
+{
+    if(begin<end && utils::isComment(*begin))  // commented line
+        return false;
+    const char* fields[TEXT_MAX_FIELDS][2];
+    int numFields = splitTextLine(begin, end, TEXT_MAX_FIELDS, fields);
+    if(numFields < 4 ||
+        !((*fields[0][0]>='0' && *fields[0][0]<='9') || *fields[0][0]=='-' || *fields[0][0]=='+'))
+        return false;
+    if(!output)
+        return true;
+    double values[TEXT_MAX_FIELDS];
+    int numValues = std::min(numFields, TEXT_MAX_FIELDS);
+    for(int f=0; f<numValues; f++) {
+        if(parseDouble(fields[f][0], fields[f][1], values[f]) == fields[f][0])
+            throw std::invalid_argument("Parse error: \"" + std::string(fields[f][0], fields[f][1]) +
+                "\" does not contain a valid double number");
+    }
+    bool haveVel = numFields >= 7;
+    double particleMass = values[haveVel ? 6 : 3] * conv.massUnit;
+    double stellarMass  = numFields>=8 ? values[7] * conv.massUnit : particleMass;
+    double stellarRadius= numFields>=9 ? values[8] * conv.lengthUnit : 0;
+    *output = ParticleArrayAux::ElemType(ParticleAux(coord::PosVelCar(
+        values[0] * conv.lengthUnit,
+        values[1] * conv.lengthUnit,
+        values[2] * conv.lengthUnit,
+        haveVel ? values[3] * conv.velocityUnit : 0,
+        haveVel ? values[4] * conv.velocityUnit : 0,
+        haveVel ? values[5] * conv.velocityUnit : 0),
+        stellarMass,
+        stellarRadius),
+        particleMass);
+    return true;
+}
+
+/// process all lines in the given range of text, counting the number of particles
+/// and (if output is not NULL) storing them in the output array
+size_t parseTextChunk(const char* begin, const char* end,
+    const units::ExternalUnits& conv, ParticleArrayAux::ElemType* output)
+{
+    size_t count = 0;
+    while(begin < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(begin, '\n', end-begin));
+        if(!lineEnd)
+            lineEnd = end;
+        if(parseTextLine(begin, lineEnd, conv, output ? output+count : NULL))
+            count++;
+        begin = lineEnd+1;
+    }
+    return count;
+}
+
 ParticleArrayAux readSnapshotText(const std::string& fileName, const units::ExternalUnits& conv)
 {
-    std::ifstream strm(fileName.c_str(), std::ios::in);
-    if(!strm) 
+    // map the entire file into memory
+    int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if(fd < 0 || fstat(fd, &fileStat) != 0) {
+        if(fd >= 0)
+            close(fd);
+        throw std::runtime_error("readSnapshotText: cannot read from file "+fileName);
+    }
+    size_t fileSize = fileStat.st_size;
+    void* mapped = fileSize > 0 ? mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if(mapped == MAP_FAILED)
         throw std::runtime_error("readSnapshotText: cannot read from file "+fileName);
-    char firstbyte = strm.peek();
-    if(firstbyte<32)
+    const char* text = static_cast<const char*>(mapped);
+    if(fileSize == 0 || text[0] < 32) {
+        if(mapped)
+            munmap(mapped, fileSize);
         throw std::runtime_error("readSnapshotText: "+fileName+" is not a valid text file");
+    }
+
+    // split the text into chunks aligned at line boundaries
+    // (their number depends only on the file size, not on the number of threads)
+    int numChunks = static_cast<int>(std::max<size_t>(1, fileSize / TEXT_CHUNK_BYTES));
+    std::vector<const char*> chunkBegin(numChunks+1);
+    chunkBegin[0] = text;
+    chunkBegin[numChunks] = text + fileSize;
+    for(int c=1; c<numChunks; c++) {
+        const char* nominal = std::max(chunkBegin[c-1], text + fileSize / numChunks * c);
+        const char* newline = static_cast<const char*>(memchr(nominal, '\n', text + fileSize - nominal));
+        chunkBegin[c] = newline ? newline+1 : text + fileSize;
+    }
+
+    // first pass: count particles in each chunk; second pass: parse them into the output array
+    std::vector<size_t> chunkOffset(numChunks+1, 0);
     ParticleArrayAux points;
-    std::string buffer;
-    std::vector<std::string> fields;
-    while(std::getline(strm, buffer) && !strm.eof())
-    {
-        if(!buffer.empty() && utils::isComment(buffer[0]))  // commented line
-            continue;
-        fields = utils::splitString(buffer, "#;, \t");
-        size_t numFields = fields.size();
-        if(numFields < 4 ||
-            !((fields[0][0]>='0' && fields[0][0]<='9') || fields[0][0]=='-' || fields[0][0]=='+'))
-            continue;
-        bool haveVel = numFields >= 7;
-        double particleMass = utils::toDouble(fields[haveVel ? 6 : 3])  * conv.massUnit;
-        double stellarMass  = numFields>=8 ? utils::toDouble(fields[7]) * conv.massUnit : particleMass;
-        double stellarRadius= numFields>=9 ? utils::toDouble(fields[8]) * conv.lengthUnit : 0;
-        points.add(ParticleAux(coord::PosVelCar(
-            utils::toDouble(fields[0]) * conv.lengthUnit,
-            utils::toDouble(fields[1]) * conv.lengthUnit,
-            utils::toDouble(fields[2]) * conv.lengthUnit,
-            haveVel ? utils::toDouble(fields[3]) * conv.velocityUnit : 0,
-            haveVel ? utils::toDouble(fields[4]) * conv.velocityUnit : 0,
-            haveVel ? utils::toDouble(fields[5]) * conv.velocityUnit : 0),
-            stellarMass,
-            stellarRadius),
-            particleMass);
+    std::string errorMsg;
+    bool stop = false;
+    for(int pass=0; pass<2 && !stop; pass++) {
+        if(pass==1) {
+            for(int c=0; c<numChunks; c++)
+                chunkOffset[c+1] += chunkOffset[c];
+            points.data.assign(chunkOffset[numChunks],
+                ParticleArrayAux::ElemType(ParticleAux(coord::PosVelCar(0,0,0,0,0,0)), 0));
+        }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for(int c=0; c<numChunks; c++) {
+            if(stop) continue;
+            try{
+                if(pass==0)
+                    chunkOffset[c+1] = parseTextChunk(chunkBegin[c], chunkBegin[c+1], conv, NULL);
+                else if(chunkOffset[c+1] > chunkOffset[c])
+                    parseTextChunk(chunkBegin[c], chunkBegin[c+1], conv, &points.data[chunkOffset[c]]);
+            }
+            catch(std::exception& e) {
+                errorMsg = e.what();
+                stop = true;
+            }
+        }
     }
+    munmap(mapped, fileSize);
+    if(!errorMsg.empty())
+        throw std::runtime_error("readSnapshotText: " + errorMsg);
     return points;
 }
 
@@ -159,8 +404,8 @@ public:
         snap.write(reinterpret_cast<const char*>(&val), sizeof(T));
     }
 
-    /// write array of T; ndim - number of dimensions, dim - length of array for each dimension
-    template<typename T> void putArray(const std::string &name, int ndim, const int dim[], const T* data) {
+    /// write the header of an array of T (without the data), and return the number of its elements
+    template<typename T> size_t putArrayHeader(const std::string &name, int ndim, const int dim[]) {
         snap.put(-110);
         snap.put(11);
         snap.put(typeLetter<T>());
@@ -171,9 +416,50 @@ public:
         size_t size=1;
         for(int i=0; i<ndim; i++)
             size *= dim[i];   // compute the array size
+        return size;
+    }
+
+    /// write array of T; ndim - number of dimensions, dim - length of array for each dimension
+    template<typename T> void putArray(const std::string &name, int ndim, const int dim[], const T* data) {
+        size_t size = putArrayHeader<T>(name, ndim, dim);
         snap.write(reinterpret_cast<const char*>(data), size*sizeof(T));
     }
 
+    /// write the header of an array of T and skip the space for its data, which will be filled
+    /// later by putArrayChunk(); return the position of the data in the file
+    template<typename T> std::streamoff reserveArray(const std::string &name, int ndim, const int dim[]) {
+        size_t size = putArrayHeader<T>(name, ndim, dim);
+        std::streamoff offset = snap.tellp();
+        snap.seekp(offset + static_cast<std::streamoff>(size * sizeof(T)));
+        return offset;
+    }
+
+    /// write count elements of an array reserved by reserveArray(), starting from the given element
+    template<typename T> void putArrayChunk(std::streamoff offset, size_t first, size_t count, const T* data) {
+        snap.seekp(offset + static_cast<std::streamoff>(first * sizeof(T)));
+        snap.write(reinterpret_cast<const char*>(data), count*sizeof(T));
+    }
+
+    /// write the snapshot header and open the level containing the particle data
+    void startSnapshot(const std::string& header, int nbody, double time, const units::ExternalUnits& conv) {
+        if(!header.empty())
+            putString("History", header.c_str());
+        startLevel("SnapShot");
+        startLevel("Parameters");
+        putVal("Nobj", nbody);
+        if(isFinite(time))
+            putVal("Time", time / conv.timeUnit);
+        endLevel();
+        startLevel("Particles");
+        putVal("CoordSystem", COORDSYS);
+    }
+
+    /// close the levels opened by startSnapshot()
+    void endSnapshot() {
+        endLevel();
+        endLevel();
+    }
+
     /// begin a new nested array
     void startLevel(const std::string &name) {
         level++;
@@ -212,6 +498,9 @@ public:
 
     /// check if any i/o errors occured
     bool ok() const { return snap.good(); }
+
+    /// flush the data to the file
+    void flush() { snap.flush(); }
 };
 
 template<> char NemoSnapshotWriter::typeLetter<int>()   { return 'i'; }
@@ -235,12 +524,15 @@ template<> void NemoSnapshotWriter::writeParticles<coord::PosCar>(
     putArray("Mass",     1, dim, &mass[0]);
 }
 
-template<> void NemoSnapshotWriter::writeParticles<coord::PosVelCar>(
-    const ParticleArray<coord::PosVelCar>& points, const units::ExternalUnits& conv)
+/// convert positions, velocities and masses of particles into arrays of floats in external units
+void convertParticlesNEMO(const ParticleArray<coord::PosVelCar>& points, const units::ExternalUnits& conv,
+    std::vector<float>& pos, std::vector<float>& vel, std::vector<float>& mass)
 {
-    int nbody = static_cast<int>(points.size()), dim[2] = {nbody, 3};
-    std::vector<float> pos(nbody*3), vel(nbody*3), mass(nbody);
-    for(int i=0; i<nbody; i++) {
+    ptrdiff_t nbody = points.size();
+    pos. resize(nbody*3);
+    vel. resize(nbody*3);
+    mass.resize(nbody);
+    for(ptrdiff_t i=0; i<nbody; i++) {
         pos [i*3  ] = static_cast<float>(points.point(i).x  / conv.lengthUnit);
         pos [i*3+1] = static_cast<float>(points.point(i).y  / conv.lengthUnit);
         pos [i*3+2] = static_cast<float>(points.point(i).z  / conv.lengthUnit);
@@ -249,6 +541,14 @@ template<> void NemoSnapshotWriter::writeParticles<coord::PosVelCar>(
         vel [i*3+2] = static_cast<float>(points.point(i).vz / conv.velocityUnit);
         mass[i]     = static_cast<float>(points.mass (i)    / conv.massUnit);
     }
+}
+
+template<> void NemoSnapshotWriter::writeParticles<coord::PosVelCar>(
+    const ParticleArray<coord::PosVelCar>& points, const units::ExternalUnits& conv)
+{
+    int nbody = static_cast<int>(points.size()), dim[2] = {nbody, 3};
+    std::vector<float> pos, vel, mass;
+    convertParticlesNEMO(points, conv, pos, vel, mass);
     putArray("Position", 2, dim, &pos[0]);
     putArray("Velocity", 2, dim, &vel[0]);
     putArray("Mass",     1, dim, &mass[0]);
@@ -289,20 +589,9 @@ void writeSnapshotNEMO(
     NemoSnapshotWriter snapshotWriter(fileName, append);
     bool result = snapshotWriter.ok();
     if(result) {
-        if(!header.empty())
-            snapshotWriter.putString("History", header.c_str());
-        int nbody = static_cast<int>(points.size());
-        snapshotWriter.startLevel("SnapShot");
-        snapshotWriter.startLevel("Parameters");
-        snapshotWriter.putVal("Nobj", nbody);
-        if(isFinite(time))
-            snapshotWriter.putVal("Time", time / conv.timeUnit);
-        snapshotWriter.endLevel();
-        snapshotWriter.startLevel("Particles");
-        snapshotWriter.putVal("CoordSystem", snapshotWriter.COORDSYS);
+        snapshotWriter.startSnapshot(header, static_cast<int>(points.size()), time, conv);
         snapshotWriter.writeParticles(points, conv);
-        snapshotWriter.endLevel();
-        snapshotWriter.endLevel();
+        snapshotWriter.endSnapshot();
         result = snapshotWriter.ok();
     }
     if(!result)
@@ -310,6 +599,383 @@ void writeSnapshotNEMO(
 }
 
 
+//----- GADGET file format (native implementation) -----//
+
+/// size of the header block in Gadget files
+static const unsigned int GADGET_HEADER_SIZE = 256;
+
+/// number of particle types in Gadget files
+static const int GADGET_NUM_TYPES = 6;
+
+/// number of particles read or written at once by a single thread
+static const size_t GADGET_CHUNK_SIZE = 1048576;
+
+/// reverse the byte order of each of `count` elements of the given size in the array
+void swapBytes(char* data, size_t count, size_t size)
+{
+    for(size_t i=0; i<count; i++)
+        std::reverse(data + i*size, data + (i+1)*size);
+}
+
+/// extract a value of the given type from an array of bytes (possibly with the opposite byte order)
+template<typename T>
+inline T getValue(const char* data, bool swap)
+{
+    char tmp[sizeof(T)];
+    std::copy(data, data + sizeof(T), tmp);
+    if(swap)
+        std::reverse(tmp, tmp + sizeof(T));
+    T value;
+    std::memcpy(&value, tmp, sizeof(T));
+    return value;
+}
+
+/// extract a floating-point value stored in single or double precision (size=4 or 8)
+/// from the array of bytes that has been already converted to the native byte order
+inline double getReal(const char* data, size_t size)
+{
+    if(size == sizeof(float)) {
+        float value;
+        std::memcpy(&value, data, sizeof(float));
+        return value;
+    } else {
+        double value;
+        std::memcpy(&value, data, sizeof(double));
+        return value;
+    }
+}
+
+/** A single file of a Gadget snapshot (format 1 or 2, in any byte order) opened for reading.
+    The constructor reads the header and scans the file to locate the data blocks
+    (positions, velocities and masses), but does not read the data itself;
+    the velocity block may be absent if it is not required;
+    this is done in parallel by several threads with `read()`, which is safe to call concurrently.
+*/
+class GadgetFile {
+public:
+    const std::string fileName;
+    int numPart[GADGET_NUM_TYPES];     ///< number of particles of each type in this file
+    double massPart[GADGET_NUM_TYPES]; ///< mass of particles of each type (0 means variable masses)
+    double time;                       ///< timestamp of the snapshot
+    int numFiles;                      ///< number of files in a multi-file snapshot
+    bool swap;                         ///< whether the byte order differs from the native one
+    /// offsets of data blocks from the beginning of the file (0 if the block is absent)
+    off_t offsetPos, offsetVel, offsetMass;
+    /// size of one real number in data blocks (4 or 8 bytes)
+    size_t sizePos, sizeVel, sizeMass;
+
+    GadgetFile(const std::string& _fileName, bool requireVelocities) :
+        fileName(_fileName), numFiles(1), swap(false),
+        offsetPos(0), offsetVel(0), offsetMass(0), sizePos(0), sizeVel(0), sizeMass(0)
+    {
+        fd = open(fileName.c_str(), O_RDONLY);
+        if(fd < 0)
+            throw std::runtime_error("readSnapshotGadget: cannot read from file "+fileName);
+        try{
+            init(requireVelocities);
+        }
+        catch(...) {
+            close(fd);
+            throw;
+        }
+    }
+
+    ~GadgetFile() { close(fd); }
+
+    /// read `size` bytes at the given offset in the file into the buffer (thread-safe)
+    void read(char* buffer, size_t size, off_t offset) const
+    {
+        while(size > 0) {
+            ssize_t count = pread(fd, buffer, size, offset);
+            if(count <= 0)
+                throw std::runtime_error("readSnapshotGadget: cannot read from file "+fileName);
+            buffer += count;
+            size   -= count;
+            offset += count;
+        }
+    }
+
+    /// total number of particles in this file
+    size_t numParticles() const
+    {
+        size_t sum = 0;
+        for(int t=0; t<GADGET_NUM_TYPES; t++)
+            sum += numPart[t];
+        return sum;
+    }
+
+    /// number of particles that have their masses stored in the mass block
+    size_t numVariableMasses() const
+    {
+        size_t sum = 0;
+        for(int t=0; t<GADGET_NUM_TYPES; t++)
+            if(massPart[t] == 0)
+                sum += numPart[t];
+        return sum;
+    }
+
+private:
+    int fd;  ///< POSIX file descriptor
+    GadgetFile(const GadgetFile&);
+    GadgetFile& operator=(const GadgetFile&);
+
+    /// read a 4-byte block marker at the given offset
+    unsigned int readMarker(off_t offset) const
+    {
+        char buf[4];
+        read(buf, 4, offset);
+        return getValue<unsigned int>(buf, swap);
+    }
+
+    /// determine the file format, read the header and locate the data blocks
+    void init(bool requireVelocities)
+    {
+        off_t fileSize = lseek(fd, 0, SEEK_END);
+        char buf[GADGET_HEADER_SIZE];
+        read(buf, 4, 0);
+        unsigned int first = getValue<unsigned int>(buf, false), firstSwapped = getValue<unsigned int>(buf, true);
+        bool format2 = first == 8 || firstSwapped == 8;
+        swap = format2 ? first != 8 : first != GADGET_HEADER_SIZE;
+        if(!format2 && firstSwapped != GADGET_HEADER_SIZE && swap)
+            throw std::runtime_error("readSnapshotGadget: "+fileName+" is not a valid Gadget file");
+        // scan the sequence of blocks: in format 1, the order of blocks is fixed,
+        // while in format 2 each block is preceded by a small block containing its 4-letter name
+        off_t offset = 0;
+        for(int index=0; offset < fileSize; index++) {
+            std::string name;
+            if(format2) {
+                char label[16];
+                read(label, 16, offset);
+                if(getValue<unsigned int>(label, swap) != 8)
+                    throw std::runtime_error("readSnapshotGadget: corrupted file "+fileName);
+                name = std::string(label+4, 4);
+                offset += 16;
+            } else {
+                static const char* names[5] = {"HEAD", "POS ", "VEL ", "ID  ", "MASS"};
+                if(index >= 5)
+                    break;
+                name = names[index];
+            }
+            unsigned int blockSize = readMarker(offset);
+            if(readMarker(offset + 4 + blockSize) != blockSize)
+                throw std::runtime_error("readSnapshotGadget: corrupted file "+fileName);
+            offset += 4;
+            if(index == 0) {
+                if(name != "HEAD" || blockSize != GADGET_HEADER_SIZE)
+                    throw std::runtime_error("readSnapshotGadget: no header in file "+fileName);
+                read(buf, GADGET_HEADER_SIZE, offset);
+                for(int t=0; t<GADGET_NUM_TYPES; t++) {
+                    numPart [t] = getValue<int>   (buf + t*4, swap);
+                    massPart[t] = getValue<double>(buf + 24 + t*8, swap);
+                    if(numPart[t] < 0)
+                        throw std::runtime_error("readSnapshotGadget: corrupted header in file "+fileName);
+                }
+                time     = getValue<double>(buf + 72, swap);
+                numFiles = std::max(1, getValue<int>(buf + 124, swap));
+            } else if(name == "POS ") {
+                offsetPos = offset;
+                sizePos   = numParticles() > 0 ? blockSize / (3 * numParticles()) : sizeof(float);
+            } else if(name == "VEL ") {
+                offsetVel = offset;
+                sizeVel   = numParticles() > 0 ? blockSize / (3 * numParticles()) : sizeof(float);
+            } else if(name == "MASS") {
+                offsetMass = offset;
+                sizeMass   = numVariableMasses() > 0 ? blockSize / numVariableMasses() : sizeof(float);
+            }
+            offset += blockSize + 4;
+            if(format2 && offsetPos && (offsetVel || !requireVelocities) &&
+                (offsetMass || numVariableMasses() == 0))
+                break;  // no need to scan further
+        }
+        if( (numParticles() > 0 && (offsetPos == 0 || (offsetVel == 0 && requireVelocities))) ||
+            (numVariableMasses() > 0 && offsetMass == 0) ||
+            (sizePos != sizeof(float) && sizePos != sizeof(double)) ||
+            (offsetVel != 0 && sizeVel != sizeof(float) && sizeVel != sizeof(double)) ||
+            (numVariableMasses() > 0 && sizeMass != sizeof(float) && sizeMass != sizeof(double)) )
+            throw std::runtime_error("readSnapshotGadget: missing or invalid data blocks in file "+fileName);
+    }
+};
+
+/// a contiguous range of particles of one type in one file, which is read by a single thread
+struct GadgetReadTask {
+    const GadgetFile* file;
+    int type;             ///< particle type
+    size_t indexInFile;   ///< index of the first particle in the position/velocity blocks
+    size_t indexInMass;   ///< index of the first particle in the mass block (if masses are variable)
+    size_t indexOutput;   ///< index of the first particle in the output array
+    size_t count;         ///< number of particles
+};
+
+/// read the data for one range of particles and store them in the output array
+void readGadgetTask(const GadgetReadTask& task, bool readVelocities,
+    const units::ExternalUnits& conv, std::vector<char>& buffer, ParticleArrayAux& points)
+{
+    const GadgetFile& file = *task.file;
+    const bool varMass = file.massPart[task.type] == 0;
+    std::vector<char> bufVel, bufMass;
+    buffer.resize(task.count * 3 * file.sizePos);
+    file.read(&buffer[0], buffer.size(), file.offsetPos + task.indexInFile * 3 * file.sizePos);
+    if(file.swap)
+        swapBytes(&buffer[0], task.count * 3, file.sizePos);
+    if(readVelocities) {
+        bufVel.resize(task.count * 3 * file.sizeVel);
+        file.read(&bufVel[0], bufVel.size(), file.offsetVel + task.indexInFile * 3 * file.sizeVel);
+        if(file.swap)
+            swapBytes(&bufVel[0], task.count * 3, file.sizeVel);
+    }
+    if(varMass) {
+        bufMass.resize(task.count * file.sizeMass);
+        file.read(&bufMass[0], bufMass.size(), file.offsetMass + task.indexInMass * file.sizeMass);
+        if(file.swap)
+            swapBytes(&bufMass[0], task.count, file.sizeMass);
+    }
+    for(size_t i=0; i<task.count; i++) {
+        const char* pos = &buffer[i * 3 * file.sizePos];
+        const char* vel = readVelocities ? &bufVel[i * 3 * file.sizeVel] : NULL;
+        double mass = (varMass ? getReal(&bufMass[i * file.sizeMass], file.sizeMass) :
+            file.massPart[task.type]) * conv.massUnit;
+        points[task.indexOutput + i] = ParticleArrayAux::ElemType(ParticleAux(coord::PosVelCar(
+            getReal(pos,                   file.sizePos) * conv.lengthUnit,
+            getReal(pos +   file.sizePos,  file.sizePos) * conv.lengthUnit,
+            getReal(pos + 2*file.sizePos,  file.sizePos) * conv.lengthUnit,
+            vel ? getReal(vel,                  file.sizeVel) * conv.velocityUnit : 0,
+            vel ? getReal(vel +   file.sizeVel, file.sizeVel) * conv.velocityUnit : 0,
+            vel ? getReal(vel + 2*file.sizeVel, file.sizeVel) * conv.velocityUnit : 0),
+            /*stellarMass*/ mass, /*stellarRadius*/ 0),
+            mass);
+    }
+}
+
+/// convert the position and velocity of a particle to single precision in external units
+inline void convertParticleGadget(const coord::PosCar& point, const units::ExternalUnits& conv,
+    float pos[3], float vel[3])
+{
+    pos[0] = static_cast<float>(point.x / conv.lengthUnit);
+    pos[1] = static_cast<float>(point.y / conv.lengthUnit);
+    pos[2] = static_cast<float>(point.z / conv.lengthUnit);
+    vel[0] = vel[1] = vel[2] = 0;  // velocities are not available
+}
+
+inline void convertParticleGadget(const coord::PosVelCar& point, const units::ExternalUnits& conv,
+    float pos[3], float vel[3])
+{
+    pos[0] = static_cast<float>(point.x  / conv.lengthUnit);
+    pos[1] = static_cast<float>(point.y  / conv.lengthUnit);
+    pos[2] = static_cast<float>(point.z  / conv.lengthUnit);
+    vel[0] = static_cast<float>(point.vx / conv.velocityUnit);
+    vel[1] = static_cast<float>(point.vy / conv.velocityUnit);
+    vel[2] = static_cast<float>(point.vz / conv.velocityUnit);
+}
+
+/// write a block (with the name label for format 2) containing the data for `count` particles
+/// with the given size per particle, which are produced chunk by chunk by the provided function
+/// (in the native byte order)
+template<typename FillFnc>
+void writeGadgetBlock(std::ofstream& strm, const char* name, size_t count, size_t elemSize,
+    const FillFnc& fill)
+{
+    unsigned int eight = 8, blockSize = static_cast<unsigned int>(count * elemSize);
+    strm.write(reinterpret_cast<const char*>(&eight), 4);
+    strm.write(name, 4);
+    unsigned int nextSize = blockSize + 8;
+    strm.write(reinterpret_cast<const char*>(&nextSize), 4);
+    strm.write(reinterpret_cast<const char*>(&eight), 4);
+    strm.write(reinterpret_cast<const char*>(&blockSize), 4);
+    std::vector<char> buffer;
+    for(size_t start=0; start<count; start+=GADGET_CHUNK_SIZE) {
+        size_t chunk = std::min(GADGET_CHUNK_SIZE, count-start);
+        buffer.resize(chunk * elemSize);
+        fill(start, chunk, &buffer[0]);
+        strm.write(&buffer[0], buffer.size());
+    }
+    strm.write(reinterpret_cast<const char*>(&blockSize), 4);
+}
+
+/// types of data blocks written to a Gadget snapshot
+enum GadgetBlockType { GB_POS, GB_VEL, GB_ID, GB_MASS };
+
+/// helper class for filling the data blocks when writing a Gadget snapshot
+template<typename ParticleT>
+struct GadgetBlockFiller {
+    const ParticleArray<ParticleT>& points;
+    const units::ExternalUnits& conv;
+    const GadgetBlockType block;
+    GadgetBlockFiller(const ParticleArray<ParticleT>& _points, const units::ExternalUnits& _conv,
+        GadgetBlockType _block) :
+        points(_points), conv(_conv), block(_block) {}
+    void operator()(size_t start, size_t count, char* output) const
+    {
+        float* outf = reinterpret_cast<float*>(output);
+        unsigned int* outi = reinterpret_cast<unsigned int*>(output);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for(ptrdiff_t i=0; i<(ptrdiff_t)count; i++) {
+            float pos[3], vel[3];
+            switch(block) {
+                case GB_POS:
+                    convertParticleGadget(points.point(start+i), conv, pos, vel);
+                    std::copy(pos, pos+3, outf + i*3);
+                    break;
+                case GB_VEL:
+                    convertParticleGadget(points.point(start+i), conv, pos, vel);
+                    std::copy(vel, vel+3, outf + i*3);
+                    break;
+                case GB_ID:
+                    outi[i] = static_cast<unsigned int>(start + i + 1);
+                    break;
+                case GB_MASS:
+                    outf[i] = static_cast<float>(points.mass(start+i) / conv.massUnit);
+                    break;
+            }
+        }
+    }
+};
+
+template<typename ParticleT>
+void writeSnapshotGadget(
+    const std::string& fileName,
+    const ParticleArray<ParticleT>& points,
+    const units::ExternalUnits& conv,
+    const std::string& /*header - ignored*/,
+    const double time)
+{
+    // all particles are stored as type 1 (halo) with individual masses;
+    // the file uses format 2 (each block is preceded by its name) in the native byte order
+    size_t nbody = points.size();
+    if(nbody * 3 * sizeof(float) >= 0x80000000u)
+        throw std::runtime_error("writeSnapshotGadget: too many particles for a single Gadget file");
+    char header[GADGET_HEADER_SIZE] = {0};
+    int numPart = static_cast<int>(nbody), numFiles = 1;
+    double timeval = isFinite(time) ? time : 0;
+    std::memcpy(header + 1*4,  &numPart,  4);  // npart[1]
+    std::memcpy(header + 72,   &timeval,  8);  // time
+    std::memcpy(header + 96 + 1*4, &numPart, 4);  // npartTotal[1]
+    std::memcpy(header + 124,  &numFiles, 4);  // num_files
+    std::ofstream strm(fileName.c_str(), std::ios::out | std::ios::binary);
+    if(strm) {
+        unsigned int eight = 8, headerSize = GADGET_HEADER_SIZE, nextSize = GADGET_HEADER_SIZE + 8;
+        strm.write(reinterpret_cast<const char*>(&eight), 4);
+        strm.write("HEAD", 4);
+        strm.write(reinterpret_cast<const char*>(&nextSize), 4);
+        strm.write(reinterpret_cast<const char*>(&eight), 4);
+        strm.write(reinterpret_cast<const char*>(&headerSize), 4);
+        strm.write(header, GADGET_HEADER_SIZE);
+        strm.write(reinterpret_cast<const char*>(&headerSize), 4);
+        writeGadgetBlock(strm, "POS ", nbody, 3 * sizeof(float),
+            GadgetBlockFiller<ParticleT>(points, conv, GB_POS));
+        writeGadgetBlock(strm, "VEL ", nbody, 3 * sizeof(float),
+            GadgetBlockFiller<ParticleT>(points, conv, GB_VEL));
+        writeGadgetBlock(strm, "ID  ", nbody, sizeof(unsigned int),
+            GadgetBlockFiller<ParticleT>(points, conv, GB_ID));
+        writeGadgetBlock(strm, "MASS", nbody, sizeof(float),
+            GadgetBlockFiller<ParticleT>(points, conv, GB_MASS));
+    }
+    if(!strm.good())
+        throw std::runtime_error("writeSnapshotGadget: cannot write to file "+fileName);
+}
+
+
 //----- file formats supported by the UNSIO library -----//
 
 #ifdef HAVE_UNSIO
@@ -357,74 +1023,207 @@ ParticleArrayAux readSnapshotUNSIO(const std::string& fileName,
         throw std::runtime_error("readSnapshotUNSIO: cannot read from file "+fileName);
 }
 
-// write an UNSIO snapshot (essentially, this function is only used for the Gadget format,
-// hence this weird 'halo' argument and the inability to store extra attributes)
-template<typename ParticleT>
-bool writeParticlesUNSIO(
-    uns::CSnapshotInterfaceOut& file,
-    const ParticleArray<ParticleT>& points,
-    const units::ExternalUnits& conv)
+#endif
+    
+
+//----- streaming output -----//
+
+/// the common interface of format-specific implementations of SnapshotStreamWriter
+class BaseStreamWriterImpl {
+public:
+    virtual ~BaseStreamWriterImpl() {}
+    /// write a chunk of particles, the first of which has the given index in the entire snapshot
+    virtual void write(const ParticleArray<coord::PosVelCar>& chunk, size_t firstIndex) = 0;
+    /// flush the data and check for errors
+    virtual bool ok() = 0;
+};
+
+/// text format: particles are appended to the file one after another
+class TextStreamWriterImpl: public BaseStreamWriterImpl {
+    std::ofstream strm;
+    const units::ExternalUnits conv;
+public:
+    TextStreamWriterImpl(const std::string& fileName, const units::ExternalUnits& _conv,
+        const std::string& header, const double time) :
+        strm(fileName.c_str(), std::ios::out), conv(_conv)
+    {
+        if(strm)
+            writeTextHeader<coord::PosVelCar>(strm, conv, header, time);
+    }
+    virtual void write(const ParticleArray<coord::PosVelCar>& chunk, size_t /*firstIndex*/) {
+        for(size_t indx=0; indx<chunk.size(); indx++)
+            strm << formatParticle<coord::PosVelCar>(chunk[indx], conv);
+    }
+    virtual bool ok() {
+        strm.flush();
+        return strm.good();
+    }
+};
+
+/// NEMO format: the arrays of positions, velocities and masses are reserved in the file
+/// at the beginning, and each chunk is written into the corresponding segments of these arrays
+class NemoStreamWriterImpl: public BaseStreamWriterImpl {
+    NemoSnapshotWriter snapshotWriter;
+    const units::ExternalUnits conv;
+    std::streamoff offsetPos, offsetVel, offsetMass;  ///< positions of the arrays in the file
+public:
+    NemoStreamWriterImpl(const std::string& fileName, size_t numParticles,
+        const units::ExternalUnits& _conv, const std::string& header, const double time) :
+        snapshotWriter(fileName), conv(_conv)
+    {
+        int nbody = static_cast<int>(numParticles), dim[2] = {nbody, 3};
+        if(static_cast<size_t>(nbody) != numParticles)
+            throw std::runtime_error("writeSnapshotNEMO: too many particles");
+        snapshotWriter.startSnapshot(header, nbody, time, conv);
+        offsetPos  = snapshotWriter.reserveArray<float>("Position", 2, dim);
+        offsetVel  = snapshotWriter.reserveArray<float>("Velocity", 2, dim);
+        offsetMass = snapshotWriter.reserveArray<float>("Mass",     1, dim);
+        snapshotWriter.endSnapshot();
+    }
+    virtual void write(const ParticleArray<coord::PosVelCar>& chunk, size_t firstIndex) {
+        if(chunk.size() == 0)
+            return;
+        std::vector<float> pos, vel, mass;
+        convertParticlesNEMO(chunk, conv, pos, vel, mass);
+        snapshotWriter.putArrayChunk(offsetPos,  firstIndex*3, pos. size(), &pos [0]);
+        snapshotWriter.putArrayChunk(offsetVel,  firstIndex*3, vel. size(), &vel [0]);
+        snapshotWriter.putArrayChunk(offsetMass, firstIndex,   mass.size(), &mass[0]);
+    }
+    virtual bool ok() {
+        snapshotWriter.flush();
+        return snapshotWriter.ok();
+    }
+};
+
+}  // internal namespace
+
+
+SnapshotStreamWriter::SnapshotStreamWriter(
+    const std::string& _fileName,
+    size_t _numParticles,
+    const std::string &fileFormat,
+    const units::ExternalUnits& unitConverter,
+    const std::string& header,
+    const double time)
+:
+    fileName(_fileName), numParticles(_numParticles), numParticlesWritten(0), impl(NULL)
 {
-    int nbody = static_cast<int>(points.size());
-    std::vector<float> pos(nbody*3), vel(nbody*3), mass(nbody);
-    for(int i=0; i<nbody; i++) {
-        pos[i*3]  = static_cast<float>(points.point(i).x  / conv.lengthUnit);
-        pos[i*3+1]= static_cast<float>(points.point(i).y  / conv.lengthUnit);
-        pos[i*3+2]= static_cast<float>(points.point(i).z  / conv.lengthUnit);
-        vel[i*3]  = static_cast<float>(points.point(i).vx / conv.velocityUnit);
-        vel[i*3+1]= static_cast<float>(points.point(i).vy / conv.velocityUnit);
-        vel[i*3+2]= static_cast<float>(points.point(i).vz / conv.velocityUnit);
-        mass[i]   = static_cast<float>(points.mass (i)    / conv.massUnit);
-    }
-    return
-    file.setData("halo","pos", nbody, &(pos.front()), true) > 0  &&
-    file.setData("halo","vel", nbody, &(vel.front()), true) > 0  &&
-    file.setData("halo","mass",nbody, &(mass.front()),true) > 0  &&
-    file.save() > 0;
-}
-
-// specialization of the above function for the case when only coordinates are available
-template<> inline bool writeParticlesUNSIO<coord::PosCar>(
-    uns::CSnapshotInterfaceOut& file,
-    const ParticleArray<coord::PosCar>& points,
-    const units::ExternalUnits& conv)
-{
-    int nbody = static_cast<int>(points.size());
-    std::vector<float> pos(nbody*3), mass(nbody);
-    for(int i=0; i<nbody; i++) {
-        pos[i*3]  = static_cast<float>(points.point(i).x  / conv.lengthUnit);
-        pos[i*3+1]= static_cast<float>(points.point(i).y  / conv.lengthUnit);
-        pos[i*3+2]= static_cast<float>(points.point(i).z  / conv.lengthUnit);
-        mass[i]   = static_cast<float>(points.mass (i)    / conv.massUnit);
+    if(fileFormat.empty() || fileName.empty())
+        throw std::runtime_error("SnapshotStreamWriter: file name or format is empty");
+    if(tolower(fileFormat[0])=='t')
+        impl = new TextStreamWriterImpl(fileName, unitConverter, header, time);
+    else if(tolower(fileFormat[0])=='n')
+        impl = new NemoStreamWriterImpl(fileName, numParticles, unitConverter, header, time);
+    else
+        throw std::runtime_error("SnapshotStreamWriter: file format not supported");
+    if(!static_cast<BaseStreamWriterImpl*>(impl)->ok()) {
+        delete static_cast<BaseStreamWriterImpl*>(impl);
+        throw std::runtime_error("SnapshotStreamWriter: cannot write to file "+fileName);
     }
-    return
-    file.setData("halo","pos", nbody, &(pos.front()), true) > 0  &&
-    file.setData("halo","mass",nbody, &(mass.front()),true) > 0  &&
-    file.save() > 0;
 }
 
-template<typename ParticleT>
-void writeSnapshotUNSIO(
+SnapshotStreamWriter::~SnapshotStreamWriter()
+{
+    delete static_cast<BaseStreamWriterImpl*>(impl);
+}
+
+void SnapshotStreamWriter::add(const ParticleArray<coord::PosVelCar>& chunk)
+{
+    if(numParticlesWritten + chunk.size() > numParticles)
+        throw std::runtime_error("SnapshotStreamWriter: number of particles exceeds the declared one");
+    static_cast<BaseStreamWriterImpl*>(impl)->write(chunk, numParticlesWritten);
+    numParticlesWritten += chunk.size();
+}
+
+void SnapshotStreamWriter::finish()
+{
+    if(!static_cast<BaseStreamWriterImpl*>(impl)->ok())
+        throw std::runtime_error("SnapshotStreamWriter: cannot write to file "+fileName);
+    if(numParticlesWritten != numParticles)
+        throw std::runtime_error("SnapshotStreamWriter: only " + utils::toString(numParticlesWritten) +
+            " out of " + utils::toString(numParticles) + " particles have been written to "+fileName);
+}
+
+
+ParticleArrayAux readSnapshotGadget(
     const std::string& fileName,
-    const ParticleArray<ParticleT>& points,
     const units::ExternalUnits& conv,
-    const std::string& /*header - ignored*/,
-    const double time,
-    const char* type)
+    unsigned int particleTypes,
+    bool readVelocities)
 {
-    uns::CunsOut output(fileName.c_str(), type);
-    bool result = true;
-    if(isFinite(time))
-        result &= output.snapshot->setData("time", static_cast<float>(time));
-    result &= writeParticlesUNSIO<ParticleT>(*output.snapshot, points, conv);
-    if(!result) 
-        throw std::runtime_error("writeSnapshotUNSIO: cannot write to file "+fileName);
-}
+    // open the first (or the only) file and determine the number of files
+    std::vector<shared_ptr<GadgetFile> > files;
+    files.push_back(shared_ptr<GadgetFile>(new GadgetFile(fileName, readVelocities)));
+    int numFiles = files[0]->numFiles;
+    if(numFiles > 1) {
+        // multi-file snapshot: the files are named base.0, base.1, ..., and fileName is the first one
+        if(fileName.size() < 2 || fileName.substr(fileName.size()-2) != ".0")
+            throw std::runtime_error("readSnapshotGadget: "+fileName+" is a part of a multi-file snapshot, "
+                "the name of the first file (ending in .0) should be provided");
+        std::string baseName = fileName.substr(0, fileName.size()-2);
+        for(int f=1; f<numFiles; f++)
+            files.push_back(shared_ptr<GadgetFile>(
+                new GadgetFile(baseName + "." + utils::toString(f), readVelocities)));
+    }
 
-#endif
-    
-}  // internal namespace
+    // split the particles of selected types in all files into tasks of moderate size
+    std::vector<GadgetReadTask> tasks;
+    size_t numOutput = 0;
+    for(int f=0; f<numFiles; f++) {
+        const GadgetFile& file = *files[f];
+        size_t indexInFile = 0, indexInMass = 0;
+        for(int t=0; t<GADGET_NUM_TYPES; t++) {
+            size_t count = file.numPart[t];
+            if((particleTypes >> t) & 1) {
+                for(size_t start=0; start<count; start+=GADGET_CHUNK_SIZE) {
+                    GadgetReadTask task;
+                    task.file        = &file;
+                    task.type        = t;
+                    task.indexInFile = indexInFile + start;
+                    task.indexInMass = indexInMass + start;
+                    task.indexOutput = numOutput + start;
+                    task.count       = std::min(GADGET_CHUNK_SIZE, count-start);
+                    tasks.push_back(task);
+                }
+                numOutput += count;
+            }
+            indexInFile += count;
+            if(file.massPart[t] == 0)
+                indexInMass += count;
+        }
+    }
+    utils::msg(utils::VL_DEBUG, "readSnapshotGadget", "Reading " + utils::toString(numOutput) +
+        " particles from " + utils::toString(numFiles) + " file(s) " + fileName);
 
+    // read the data in parallel
+    ParticleArrayAux points;
+    points.data.assign(numOutput, ParticleArrayAux::ElemType(ParticleAux(coord::PosVelCar(0,0,0,0,0,0)), 0));
+    int numTasks = tasks.size();
+    std::string errorMsg;
+    bool stop = false;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        std::vector<char> buffer;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for(int i=0; i<numTasks; i++) {
+            if(stop) continue;
+            try{
+                readGadgetTask(tasks[i], readVelocities, conv, buffer, points);
+            }
+            catch(std::exception& e) {
+                errorMsg = e.what();
+                stop = true;
+            }
+        }
+    }
+    if(!errorMsg.empty())
+        throw std::runtime_error(errorMsg);
+    return points;
+}
 
 // 'readSnapshot' always returns the richest possible particle flavour (ParticleAux), which
 // can then be 'downgraded' to any desired level and converted to a different coordinate system.
@@ -433,22 +1232,33 @@ ParticleArrayAux readSnapshot(
     const units::ExternalUnits& unitConverter)
 {
     std::ifstream strm(fileName.c_str(), std::ios::in);
-    if(!strm)
+    if(!strm) {
+        // a multi-file Gadget snapshot may be specified by the common part of the file names
+        std::ifstream strm0((fileName+".0").c_str(), std::ios::in);
+        if(strm0)
+            return readSnapshotGadget(fileName+".0", unitConverter);
         throw std::runtime_error("readSnapshot: cannot read from "+fileName);
+    }
     char buffer[8];
     strm.read(buffer, 8);
     strm.close();
-    if( (buffer[0]==-110 &&  // NEMO signature: open block of a particular type
-        (buffer[2]=='c' || buffer[2]=='i' || buffer[2]=='f' || buffer[2]=='d' || buffer[2]=='(')) ||
+    if( buffer[0]==-110 &&  // NEMO signature: open block of a particular type
+        (buffer[2]=='c' || buffer[2]=='i' || buffer[2]=='f' || buffer[2]=='d' || buffer[2]=='(') )
+    {
+#ifdef HAVE_UNSIO
+        return readSnapshotUNSIO(fileName, unitConverter);
+#endif
+    }
+    else if(
         // GADGET signature (depending on byte order and version)
         (buffer[0]==8 && buffer[1]==0 && buffer[2]==0 && buffer[3]==0) ||
         (buffer[0]==0 && buffer[1]==1 && buffer[2]==0 && buffer[3]==0) ||
         (buffer[0]==0 && buffer[1]==0 && buffer[2]==8 && buffer[3]==0) ||
-        (buffer[0]==0 && buffer[1]==0 && buffer[2]==0 && buffer[3]==1) )
+        (buffer[0]==0 && buffer[1]==0 && buffer[2]==0 && buffer[3]==1) ||
+        (buffer[0]==0 && buffer[1]==0 && buffer[2]==0 && buffer[3]==8) ||
+        (buffer[0]==0 && buffer[1]==0 && buffer[2]==1 && buffer[3]==0) )
     {
-#ifdef HAVE_UNSIO
-        return readSnapshotUNSIO(fileName, unitConverter);  // NEMO or Gadget
-#endif
+        return readSnapshotGadget(fileName, unitConverter);
     }
     else if(buffer[0]>=32)
     {
@@ -477,12 +1287,10 @@ inline void writeSnapshot(
     {
         writeSnapshotNEMO(fileName, particles, unitConverter, header, time, append);
     }
-#ifdef HAVE_UNSIO
     else if(tolower(fileFormat[0])=='g')
     {
-        writeSnapshotUNSIO(fileName, particles, unitConverter, header, time, "gadget2");
+        writeSnapshotGadget(fileName, particles, unitConverter, header, time);
     }
-#endif
     else
         throw std::runtime_error("writeSnapshot: file format not recognized");
 }
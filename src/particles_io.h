@@ -5,6 +5,8 @@
 
     The routines 'readSnapshot' and 'writeSnapshot' provide the top-level interface
     to a variety of file formats (Text, NEMO, Gadget).
+    Text and Gadget formats are read and written natively, NEMO format is written natively
+    but can be read only if the library is compiled with UNSIO support.
 */
 
 #pragma once
@@ -23,6 +25,26 @@ ParticleArrayAux readSnapshot(
     const std::string& fileName,
     const units::ExternalUnits& unitConverter = units::ExternalUnits());
 
+/** Read an N-body snapshot in the Gadget format (format 1 or 2, in either byte order,
+    with single- or double-precision data) without relying on external libraries.
+    The data blocks are read in parallel, directly converting the values to the output array.
+    \param[in]  fileName  is the file to read; a multi-file snapshot is read entirely
+    if the name of its first file (ending in ".0") is provided;
+    \param[in]  unitConverter  is the instance of unit conversion object (may be a trivial one);
+    \param[in]  particleTypes  is the bit mask of Gadget particle types (0-5) to read
+    (e.g., 2 means only the type 1 - halo particles; default is all types);
+    \param[in]  readVelocities  if false, the velocity block is not read (and may be absent from the file),
+    and velocities are set to zero;
+    \returns    a new instance of ParticleArray containing the particles of the selected types
+    (ordered by file, and then by type within each file).
+    \throw  std::runtime_error if the file(s) could not be read or have invalid structure.
+*/
+ParticleArrayAux readSnapshotGadget(
+    const std::string& fileName,
+    const units::ExternalUnits& unitConverter = units::ExternalUnits(),
+    unsigned int particleTypes = 63,
+    bool readVelocities = true);
+
 /** Write an N-body snapshot in the given format.
     \param[in]  fileName is the file to write;
     \param[in]  particles  is the array of particles to write;
@@ -48,4 +70,58 @@ void writeSnapshot(
     const double time=NAN,
     const bool append=false);
 
+/** Write an N-body snapshot sequentially in chunks, without keeping all particles in memory.
+    This class is a particle sink that can be passed to the streaming variants of sampling routines;
+    each chunk is written to the file as soon as it arrives.
+    The total number of particles must be known in advance (it is stored in the file header
+    in some formats), and the sum of chunk sizes must be equal to it.
+    Only the formats that can be written incrementally are supported: Text and Nemo.
+    After all particles have been added, finish() should be called to check for errors;
+    the file is also closed (without the checks) when the object is destroyed.
+*/
+class SnapshotStreamWriter: public IParticleSink<coord::PosVelCar> {
+public:
+    /** open the file and write the header.
+        \param[in]  fileName is the file to write;
+        \param[in]  numParticles  is the total number of particles that will be written;
+        \param[in]  fileFormat  is the string specifying the output file format
+        (only the first letter matters, case-insensitive: 't' - Text, 'n' - Nemo);
+        \param[in]  unitConverter, header, time  have the same meaning as in writeSnapshot().
+        \throw  std::runtime_error if the format is not supported or the file could not be written.
+    */
+    SnapshotStreamWriter(
+        const std::string& fileName,
+        size_t numParticles,
+        const std::string &fileFormat="Text",
+        const units::ExternalUnits& unitConverter = units::ExternalUnits(),
+        const std::string& header="",
+        const double time=NAN);
+
+    ~SnapshotStreamWriter();
+
+    /** write the next chunk of particles.
+        \throw  std::runtime_error if the total number of particles exceeds the declared one,
+        or in case of i/o errors.
+    */
+    virtual void add(const ParticleArray<coord::PosVelCar>& chunk);
+
+    /** flush the file and check that all particles have been written.
+        \throw  std::runtime_error if fewer particles than declared have been written,
+        or in case of i/o errors.
+    */
+    void finish();
+
+    /// return the number of particles written so far
+    size_t numWritten() const { return numParticlesWritten; }
+
+private:
+    const std::string fileName;
+    const size_t numParticles;
+    size_t numParticlesWritten;
+    void* impl;  ///< opaque implementation details
+    // disable copying
+    SnapshotStreamWriter(const SnapshotStreamWriter&);
+    SnapshotStreamWriter& operator=(const SnapshotStreamWriter&);
+};
+
 }  // namespace
@@ -2,11 +2,16 @@
 #include "math_core.h"
 #include "math_specfunc.h"
 #include <cmath>
+#include <stdexcept>
 
 namespace potential{
 
-void Plummer::evalDeriv(double r,
-    double* potential, double* deriv, double* deriv2) const
+namespace{
+// The evaluation kernels of analytic potentials, shared between the individual potential classes
+// and the CompositeAnalytic class (which is implemented in this file so that they could be inlined)
+
+inline void evalPlummer(double mass, double scaleRadius, double r,
+    double* potential, double* deriv, double* deriv2)
 {
     double invrsq = mass?  1. / (pow_2(r) + pow_2(scaleRadius)) : 0;  // if mass=0, output 0
     double pot = -mass * sqrt(invrsq);
@@ -18,21 +23,8 @@ void Plummer::evalDeriv(double r,
         *deriv2 = pot * (2 * pow_2(r * invrsq) - pow_2(scaleRadius * invrsq));
 }
 
-double Plummer::densitySph(const coord::PosSph &pos, double /*time*/) const
-{
-    double invrsq = 1. / (pow_2(pos.r) + pow_2(scaleRadius));
-    return 0.75/M_PI * mass * pow_2(scaleRadius * invrsq) * sqrt(invrsq);
-}
-
-double Plummer::enclosedMass(double r) const
-{
-    if(scaleRadius==0)
-        return mass;
-    return mass / pow_3(sqrt(pow_2(scaleRadius/r) + 1));
-}
-
-void Isochrone::evalDeriv(double r,
-    double* potential, double* deriv, double* deriv2) const
+inline void evalIsochrone(double mass, double scaleRadius, double r,
+    double* potential, double* deriv, double* deriv2)
 {
     double rb  = sqrt(pow_2(r) + pow_2(scaleRadius));
     double brb = scaleRadius + rb;
@@ -45,8 +37,8 @@ void Isochrone::evalDeriv(double r,
         *deriv2 = pot * (2*pow_2(r / (rb * brb)) - pow_2(scaleRadius / (rb * brb)) * (1 + scaleRadius / rb));
 }
 
-void NFW::evalDeriv(double r,
-    double* potential, double* deriv, double* deriv2) const
+inline void evalNFW(double mass, double scaleRadius, double r,
+    double* potential, double* deriv, double* deriv2)
 {
     double rrel = r / scaleRadius;
     double ln_over_r = r==INFINITY ? 0 :
@@ -63,8 +55,8 @@ void NFW::evalDeriv(double r,
             (2*ln_over_r - (2*scaleRadius + 3*r) / pow_2(scaleRadius+r) ) / pow_2(r) );
 }
 
-void MiyamotoNagai::evalCyl(const coord::PosCyl &pos,
-    double* potential, coord::GradCyl* deriv, coord::HessCyl* deriv2, double /*time*/) const
+inline void evalMiyamotoNagai(double mass, double scaleRadiusA, double scaleRadiusB,
+    const coord::PosCyl &pos, double* potential, coord::GradCyl* deriv, coord::HessCyl* deriv2)
 {
     double zb    = sqrt(pow_2(pos.z) + pow_2(scaleRadiusB));
     double azb2  = pow_2(scaleRadiusA + zb);
@@ -89,8 +81,8 @@ void MiyamotoNagai::evalCyl(const coord::PosCyl &pos,
     }
 }
 
-void Logarithmic::evalCar(const coord::PosCar &pos,
-    double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double /*time*/) const
+inline void evalLogarithmic(double sigma2, double coreRadius2, double p2, double q2,
+    const coord::PosCar &pos, double* potential, coord::GradCar* deriv, coord::HessCar* deriv2)
 {
     double m2 = coreRadius2 + pow_2(pos.x) + pow_2(pos.y)/p2 + pow_2(pos.z)/q2;
     if(potential)
@@ -110,8 +102,8 @@ void Logarithmic::evalCar(const coord::PosCar &pos,
     }
 }
 
-void Harmonic::evalCar(const coord::PosCar &pos,
-    double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double /*time*/) const
+inline void evalHarmonic(double Omega2, double p2, double q2,
+    const coord::PosCar &pos, double* potential, coord::GradCar* deriv, coord::HessCar* deriv2)
 {
     if(potential)
         *potential = 0.5*Omega2 * (pow_2(pos.x) + pow_2(pos.y)/p2 + pow_2(pos.z)/q2);
@@ -128,6 +120,57 @@ void Harmonic::evalCar(const coord::PosCar &pos,
     }
 }
 
+}  // internal namespace
+
+void Plummer::evalDeriv(double r,
+    double* potential, double* deriv, double* deriv2) const
+{
+    evalPlummer(mass, scaleRadius, r, potential, deriv, deriv2);
+}
+
+double Plummer::densitySph(const coord::PosSph &pos, double /*time*/) const
+{
+    double invrsq = 1. / (pow_2(pos.r) + pow_2(scaleRadius));
+    return 0.75/M_PI * mass * pow_2(scaleRadius * invrsq) * sqrt(invrsq);
+}
+
+double Plummer::enclosedMass(double r) const
+{
+    if(scaleRadius==0)
+        return mass;
+    return mass / pow_3(sqrt(pow_2(scaleRadius/r) + 1));
+}
+
+void Isochrone::evalDeriv(double r,
+    double* potential, double* deriv, double* deriv2) const
+{
+    evalIsochrone(mass, scaleRadius, r, potential, deriv, deriv2);
+}
+
+void NFW::evalDeriv(double r,
+    double* potential, double* deriv, double* deriv2) const
+{
+    evalNFW(mass, scaleRadius, r, potential, deriv, deriv2);
+}
+
+void MiyamotoNagai::evalCyl(const coord::PosCyl &pos,
+    double* potential, coord::GradCyl* deriv, coord::HessCyl* deriv2, double /*time*/) const
+{
+    evalMiyamotoNagai(mass, scaleRadiusA, scaleRadiusB, pos, potential, deriv, deriv2);
+}
+
+void Logarithmic::evalCar(const coord::PosCar &pos,
+    double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double /*time*/) const
+{
+    evalLogarithmic(sigma2, coreRadius2, p2, q2, pos, potential, deriv, deriv2);
+}
+
+void Harmonic::evalCar(const coord::PosCar &pos,
+    double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double /*time*/) const
+{
+    evalHarmonic(Omega2, p2, q2, pos, potential, deriv, deriv2);
+}
+
 
 void KeplerBinaryParams::keplerOrbit(double t, double bhX[], double bhY[], double bhVX[], double bhVY[]) const
 {
@@ -202,4 +245,150 @@ void KeplerBinary::evalCar(const coord::PosCar &pos,
     }
 }
 
+//----- Composite potential with analytic components -----//
+
+CompositeAnalytic::CompositeAnalytic(const std::vector<PtrPotential>& components) :
+    Composite(components)
+{
+    for(size_t i=0; i<components.size(); i++) {
+        const BasePotential* pot = components[i].get();
+        if(const Plummer* p = dynamic_cast<const Plummer*>(pot)) {
+            ParamSph par = { p->mass, p->scaleRadius };
+            plummer.push_back(par);
+        } else if(const Isochrone* p = dynamic_cast<const Isochrone*>(pot)) {
+            ParamSph par = { p->mass, p->scaleRadius };
+            isochrone.push_back(par);
+        } else if(const NFW* p = dynamic_cast<const NFW*>(pot)) {
+            ParamSph par = { p->mass, p->scaleRadius };
+            nfw.push_back(par);
+        } else if(const MiyamotoNagai* p = dynamic_cast<const MiyamotoNagai*>(pot)) {
+            ParamMN par = { p->mass, p->scaleRadiusA, p->scaleRadiusB };
+            mn.push_back(par);
+        } else if(const Logarithmic* p = dynamic_cast<const Logarithmic*>(pot)) {
+            ParamCar par = { p->sigma2, p->coreRadius2, p->p2, p->q2 };
+            logHarm.push_back(par);
+        } else if(const Harmonic* p = dynamic_cast<const Harmonic*>(pot)) {
+            ParamCar par = { p->Omega2, NAN, p->p2, p->q2 };
+            logHarm.push_back(par);
+        } else
+            throw std::invalid_argument(std::string("CompositeAnalytic: unsupported component ") +
+                pot->name());
+    }
+}
+
+bool CompositeAnalytic::isSupported(const BasePotential& pot)
+{
+    return
+        dynamic_cast<const Plummer*>(&pot) || dynamic_cast<const Isochrone*>(&pot) ||
+        dynamic_cast<const NFW*>(&pot) || dynamic_cast<const MiyamotoNagai*>(&pot) ||
+        dynamic_cast<const Logarithmic*>(&pot) || dynamic_cast<const Harmonic*>(&pot);
+}
+
+void CompositeAnalytic::evalCar(const coord::PosCar &pos,
+    double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double /*time*/) const
+{
+    // intermediate quantities shared by all components
+    double R2 = pow_2(pos.x) + pow_2(pos.y), R = sqrt(R2), r = sqrt(R2 + pow_2(pos.z));
+    double Phi = 0, tmpPhi, tmpD, tmpD2;
+    double* outPhi = potential ? &tmpPhi : NULL;
+    double* outD   = deriv || deriv2 ? &tmpD : NULL;
+    double* outD2  = deriv2 ? &tmpD2 : NULL;
+
+    // sum up the derivatives by spherical radius for all spherical components
+    double dr = 0, dr2 = 0;
+    for(size_t i=0; i<plummer.size(); i++) {
+        evalPlummer(plummer[i].mass, plummer[i].scaleRadius, r, outPhi, outD, outD2);
+        if(outPhi) Phi += tmpPhi;
+        if(outD)   dr  += tmpD;
+        if(outD2)  dr2 += tmpD2;
+    }
+    for(size_t i=0; i<isochrone.size(); i++) {
+        evalIsochrone(isochrone[i].mass, isochrone[i].scaleRadius, r, outPhi, outD, outD2);
+        if(outPhi) Phi += tmpPhi;
+        if(outD)   dr  += tmpD;
+        if(outD2)  dr2 += tmpD2;
+    }
+    for(size_t i=0; i<nfw.size(); i++) {
+        evalNFW(nfw[i].mass, nfw[i].scaleRadius, r, outPhi, outD, outD2);
+        if(outPhi) Phi += tmpPhi;
+        if(outD)   dr  += tmpD;
+        if(outD2)  dr2 += tmpD2;
+    }
+
+    // same for the derivatives in cylindrical coordinates for all axisymmetric components
+    coord::GradCyl gradCyl, sumGradCyl;
+    coord::HessCyl hessCyl, sumHessCyl;
+    sumGradCyl.dR = sumGradCyl.dz = sumGradCyl.dphi = 0;
+    sumHessCyl.dR2 = sumHessCyl.dz2 = sumHessCyl.dRdz = 0;
+    if(!mn.empty()) {
+        const coord::PosCyl posCyl(R, pos.z, 0);
+        for(size_t i=0; i<mn.size(); i++) {
+            evalMiyamotoNagai(mn[i].mass, mn[i].scaleRadiusA, mn[i].scaleRadiusB, posCyl,
+                outPhi, outD ? &gradCyl : NULL, outD2 ? &hessCyl : NULL);
+            if(outPhi) Phi += tmpPhi;
+            if(outD) {
+                sumGradCyl.dR += gradCyl.dR;
+                sumGradCyl.dz += gradCyl.dz;
+            }
+            if(outD2) {
+                sumHessCyl.dR2  += hessCyl.dR2;
+                sumHessCyl.dz2  += hessCyl.dz2;
+                sumHessCyl.dRdz += hessCyl.dRdz;
+            }
+        }
+    }
+
+    // convert the derivatives to Cartesian coordinates:
+    // spherical part: dPhi/dx_i = Phi' n_i,  d2Phi/dx_i dx_j = (Phi'' - Phi'/r) n_i n_j + Phi'/r delta_ij,
+    // where n is the unit vector in the direction of x; analogous expressions for the cylindrical part
+    // in the x,y plane, plus vertical derivatives. At r=0 or R=0, Phi'/r is replaced by its limit Phi''
+    double invr = r>0 ? 1/r : 0, invR = R>0 ? 1/R : 0;
+    double nx = pos.x * invr, ny = pos.y * invr, nz = pos.z * invr;
+    double mx = pos.x * invR, my = pos.y * invR;
+    if(deriv) {
+        deriv->dx = dr * nx + sumGradCyl.dR * mx;
+        deriv->dy = dr * ny + sumGradCyl.dR * my;
+        deriv->dz = dr * nz + sumGradCyl.dz;
+    }
+    if(deriv2) {
+        double dr_r = r>0 ? dr * invr : dr2, dR_R = R>0 ? sumGradCyl.dR * invR : sumHessCyl.dR2;
+        double sphA = dr2 - dr_r, cylA = sumHessCyl.dR2 - dR_R;
+        deriv2->dx2  = sphA * nx * nx + dr_r + cylA * mx * mx + dR_R;
+        deriv2->dy2  = sphA * ny * ny + dr_r + cylA * my * my + dR_R;
+        deriv2->dz2  = sphA * nz * nz + dr_r + sumHessCyl.dz2;
+        deriv2->dxdy = sphA * nx * ny + cylA * mx * my;
+        deriv2->dydz = sphA * ny * nz + sumHessCyl.dRdz * my;
+        deriv2->dxdz = sphA * nx * nz + sumHessCyl.dRdz * mx;
+    }
+
+    // components that are evaluated directly in Cartesian coordinates
+    coord::GradCar gradCar;
+    coord::HessCar hessCar;
+    for(size_t i=0; i<logHarm.size(); i++) {
+        const ParamCar& par = logHarm[i];
+        if(isFinite(par.coreRadius2))
+            evalLogarithmic(par.sigma2, par.coreRadius2, par.p2, par.q2, pos,
+                outPhi, deriv ? &gradCar : NULL, deriv2 ? &hessCar : NULL);
+        else
+            evalHarmonic(par.sigma2, par.p2, par.q2, pos,
+                outPhi, deriv ? &gradCar : NULL, deriv2 ? &hessCar : NULL);
+        if(outPhi) Phi += tmpPhi;
+        if(deriv) {
+            deriv->dx += gradCar.dx;
+            deriv->dy += gradCar.dy;
+            deriv->dz += gradCar.dz;
+        }
+        if(deriv2) {
+            deriv2->dx2  += hessCar.dx2;
+            deriv2->dy2  += hessCar.dy2;
+            deriv2->dz2  += hessCar.dz2;
+            deriv2->dxdy += hessCar.dxdy;
+            deriv2->dydz += hessCar.dydz;
+            deriv2->dxdz += hessCar.dxdz;
+        }
+    }
+    if(potential)
+        *potential = Phi;
+}
+
 }  // namespace potential
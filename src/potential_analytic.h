@@ -5,9 +5,12 @@
 */
 #pragma once
 #include "potential_base.h"
+#include "potential_composite.h"
 
 namespace potential{
 
+class CompositeAnalytic;
+
 /** Spherical Plummer potential:
     \f$  \Phi(r) = - M / \sqrt{r^2 + b^2}  \f$. */
 class Plummer: public BasePotentialSphericallySymmetric{
@@ -19,6 +22,7 @@ public:
     virtual double enclosedMass(const double radius) const;
     virtual double totalMass() const { return mass; }
 private:
+    friend class CompositeAnalytic;
     const double mass;         ///< total mass  (M)
     const double scaleRadius;  ///< scale radius of the Plummer model  (b)
 
@@ -41,6 +45,7 @@ public:
     static const char* myName() { static const char* text = "Isochrone"; return text; }
     virtual double totalMass() const { return mass; }
 private:
+    friend class CompositeAnalytic;
     const double mass;         ///< total mass  (M)
     const double scaleRadius;  ///< scale radius of the Isochrone model  (b)
     virtual void evalDeriv(double r,
@@ -57,6 +62,7 @@ public:
     static const char* myName() { static const char* text = "NFW"; return text; }
     virtual double totalMass() const { return INFINITY; }
 private:
+    friend class CompositeAnalytic;
     const double mass;         ///< normalization factor  (M);  equals to mass enclosed within ~5.3r_s
     const double scaleRadius;  ///< scale radius of the NFW model  (r_s)
 
@@ -75,6 +81,7 @@ public:
     static const char* myName() { static const char* text = "MiyamotoNagai"; return text; }
     virtual double totalMass() const { return mass; }
 private:
+    friend class CompositeAnalytic;
     const double mass;         ///< total mass  (M)
     const double scaleRadiusA; ///< first scale radius  (A),  determines the extent in the disk plane
     const double scaleRadiusB; ///< second scale radius (B),  determines the vertical extent
@@ -96,6 +103,7 @@ public:
     static const char* myName() { static const char* text = "Logarithmic"; return text; }
     virtual double totalMass() const { return INFINITY; }
 private:
+    friend class CompositeAnalytic;
     const double sigma2;       ///< squared asymptotic circular velocity (sigma)
     const double coreRadius2;  ///< squared core radius (r_c)
     const double p2;           ///< squared y/x axis ratio (p)
@@ -117,6 +125,7 @@ public:
     static const char* myName() { static const char* text = "Harmonic"; return text; }
     virtual double totalMass() const { return INFINITY; }
 private:
+    friend class CompositeAnalytic;
     const double Omega2;       ///< squared oscillation frequency (Omega)
     const double p2;           ///< squared y/x axis ratio (p)
     const double q2;           ///< squared z/x axis ratio (q)
@@ -172,4 +181,52 @@ private:
     virtual double densityCar(const coord::PosCar &, double) const { return 0; }
 };
 
+
+/** A composite potential consisting only of analytic components of the following types:
+    Plummer, Isochrone, NFW, MiyamotoNagai, Logarithmic and Harmonic.
+    It behaves exactly as the generic Composite potential (and can be accessed as such,
+    e.g. to retrieve individual components), but its evaluation does not involve any virtual
+    function calls or coordinate conversions for individual components: the parameters of
+    components are stored in separate arrays for each type, and the evaluation kernels are inlined.
+    The derivatives w.r.t. spherical radius are summed up for all spherical components,
+    and similarly the derivatives in cylindrical coordinates for axisymmetric components,
+    before converting them to Cartesian coordinates only once.
+    The potential factory uses this class automatically for composite potentials whose
+    components are all of the supported types.
+*/
+class CompositeAnalytic: public Composite, coord::IScalarFunction<coord::Car> {
+public:
+    /** construct from the provided array of components;
+        throw std::invalid_argument if any of them is not of a supported type */
+    explicit CompositeAnalytic(const std::vector<PtrPotential>& components);
+
+    /** check whether the given potential can be a component of this class */
+    static bool isSupported(const BasePotential& pot);
+
+private:
+    /// parameters of spherical components (mass and scale radius)
+    struct ParamSph { double mass, scaleRadius; };
+    /// parameters of Miyamoto-Nagai components
+    struct ParamMN  { double mass, scaleRadiusA, scaleRadiusB; };
+    /// parameters of Logarithmic (coreRadius2=squared core radius) or Harmonic (coreRadius2=NAN)
+    struct ParamCar { double sigma2, coreRadius2, p2, q2; };
+    std::vector<ParamSph> plummer, isochrone, nfw;
+    std::vector<ParamMN> mn;
+    std::vector<ParamCar> logHarm;
+
+    virtual void evalCar(const coord::PosCar &pos,
+        double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double time) const;
+    virtual void evalCyl(const coord::PosCyl &pos,
+        double* potential, coord::GradCyl* deriv, coord::HessCyl* deriv2, double time) const {
+        coord::evalAndConvert<coord::Car, coord::Cyl>(*this, pos, potential, deriv, deriv2, time);
+    }
+    virtual void evalSph(const coord::PosSph &pos,
+        double* potential, coord::GradSph* deriv, coord::HessSph* deriv2, double time) const {
+        coord::evalAndConvert<coord::Car, coord::Sph>(*this, pos, potential, deriv, deriv2, time);
+    }
+    virtual void evalScalar(const coord::PosCar& pos,
+        double* val=NULL, coord::GradCar* deriv=NULL, coord::HessCar* deriv2=NULL, double time=0) const
+    {  evalCar(pos, val, deriv, deriv2, time);  }
+};
+
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 */
 #pragma once
 #include "coord.h"
+#include "utils_counters.h"
 
 /** Classes and auxiliary routines related to creation and manipulation of 
     density models and gravitational potential models.
@@ -155,14 +156,17 @@ public:
     void eval(const coord::PosCar &pos,
         double* potential=NULL, coord::GradCar* deriv=NULL, coord::HessCar* deriv2=NULL,
         double time=0) const {
+        COUNTER_POTENTIAL_EVAL(name());
         return evalCar(pos, potential, deriv, deriv2, time); }
     void eval(const coord::PosCyl &pos,
         double* potential=NULL, coord::GradCyl* deriv=NULL, coord::HessCyl* deriv2=NULL,
         double time=0) const {
+        COUNTER_POTENTIAL_EVAL(name());
         return evalCyl(pos, potential, deriv, deriv2, time); }
     void eval(const coord::PosSph &pos,
         double* potential=NULL, coord::GradSph* deriv=NULL, coord::HessSph* deriv2=NULL,
         double time=0) const {
+        COUNTER_POTENTIAL_EVAL(name());
         return evalSph(pos, potential, deriv, deriv2, time); }
 
     /** Shorthand for evaluating the value of potential at a given point in any coordinate system */
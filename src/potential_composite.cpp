@@ -1,7 +1,16 @@
 #include "potential_composite.h"
+#include "potential_multipole.h"
+#include "potential_utils.h"
+#include "potential_cylspline.h"
 #include "math_core.h"
+#include "utils.h"
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
 #include <alloca.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // utility snippet for allocating temporary storage either on stack (if small) or on heap otherwise
 #define ALLOC(NPOINTS, TYPE, NAME) \
@@ -185,6 +194,40 @@ inline void searchInterp(
     }
 }
 
+
+/** atomic operations on the variables shared between threads without locking
+    (the accesses are followed or preceded by a full memory fence where the order matters) */
+template<typename T>
+inline T atomicLoad(const T& var)
+{
+    T result;
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+    result = var;
+    return result;
+}
+
+template<typename T>
+inline void atomicStore(T& var, T value)
+{
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+    var = value;
+}
+
+template<typename T>
+inline T atomicAdd(T& var, T value)
+{
+    T result;
+#ifdef _OPENMP
+#pragma omp atomic capture
+#endif
+    result = var += value;
+    return result;
+}
+
 }  // namespace
 
 
@@ -385,7 +428,8 @@ Evolving::Evolving(const std::vector<double> _times,
     const std::vector<PtrPotential> _instances,
     bool _interpLinear)
 :
-    times(_times), instances(_instances), interpLinear(_interpLinear)
+    times(_times), instances(_instances), interpLinear(_interpLinear),
+    cacheSize(0), readAhead(false), numAccess(0)
 {
     if(times.size() != instances.size())
         throw std::length_error("Evolving: input arrays are not equal in length");
@@ -396,19 +440,147 @@ Evolving::Evolving(const std::vector<double> _times,
             throw std::invalid_argument("Evolving: Times must be sorted in increasing order");
 }
 
+Evolving::Evolving(const std::vector<double> _times,
+    const PtrSnapshotLoader& _loader,
+    bool _interpLinear,
+    unsigned int _cacheSize,
+    bool _readAhead)
+:
+    times(_times), instances(_times.size()), interpLinear(_interpLinear),
+    loader(_loader), cacheSize(std::max<unsigned int>(_cacheSize, _readAhead ? 3 : 2)),
+    readAhead(_readAhead), cached(_times.size(), NULL), numUsers(_times.size(), 0),
+    lastAccess(_times.size(), 0), numAccess(0)
+{
+    if(!loader)
+        throw std::invalid_argument("Evolving: snapshot loader must be provided");
+    if(times.size() == 0)
+        throw std::invalid_argument("Evolving: empty list of potentials");
+    for(size_t i=1; i<times.size(); i++)
+        if(!(times[i] > times[i-1]))
+            throw std::invalid_argument("Evolving: Times must be sorted in increasing order");
+}
+
+class Evolving::InstancePin {
+    const Evolving& owner;
+    const ptrdiff_t index;
+public:
+    /// the pinned instance (in the eager mode, simply the element of the array of instances)
+    const BasePotential* instance;
+    InstancePin(const Evolving& _owner, ptrdiff_t _index) :
+        owner(_owner), index(_index),
+        instance(owner.loader ? owner.acquireInstance(index) : owner.instances[index].get()) {}
+    ~InstancePin() { if(owner.loader) owner.releaseInstance(index); }
+private:
+    InstancePin(const InstancePin&);
+    InstancePin& operator=(const InstancePin&);
+};
+
+const BasePotential* Evolving::acquireInstance(ptrdiff_t index) const
+{
+    // pin the entry before looking it up: the fence orders the increment of the user count
+    // before the read of the pointer, and pairs with the fence in publishInstance between
+    // unpublishing an evicted entry and checking its user count, so that an instance seen here
+    // cannot be released until this thread unpins it
+    atomicAdd(numUsers[index], 1);
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+    atomicStore(lastAccess[index], atomicAdd(numAccess, static_cast<unsigned long long>(1)));
+    const BasePotential* instance = atomicLoad(cached[index]);
+    if(instance)
+        return instance;   // cache hit: no locking
+
+    try{
+        // an evicted entry may still be held by other threads: then just publish it again
+#ifdef _OPENMP
+#pragma omp critical(EvolvingCache)
+#endif
+        {
+            if(instances[index])
+                instance = publishInstance(index, instances[index]);
+        }
+        if(instance)
+            return instance;
+
+        // load the missing instance outside the critical section, so that other threads could use
+        // the instances already in the cache in the meantime (if two threads simultaneously need
+        // the same instance, it will be loaded twice, but only one copy is retained in the cache)
+        PtrPotential loaded = loader->load(index), ahead;
+        if(readAhead && index+1 < (ptrdiff_t)times.size() && !atomicLoad(cached[index+1]))
+            ahead = loader->load(index+1);
+#ifdef _OPENMP
+#pragma omp critical(EvolvingCache)
+#endif
+        {
+            if(ahead)
+                publishInstance(index+1, ahead);
+            instance = publishInstance(index, loaded);
+        }
+        return instance;
+    }
+    catch(...) {
+        releaseInstance(index);
+        throw;
+    }
+}
+
+void Evolving::releaseInstance(ptrdiff_t index) const
+{
+    // the fence completes all accesses to the instance before it may be released by another thread
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+    atomicAdd(numUsers[index], -1);
+}
+
+const BasePotential* Evolving::publishInstance(ptrdiff_t index, const PtrPotential& instance) const
+{
+    if(!instances[index])
+        instances[index] = instance;
+    atomicStore(cached[index], static_cast<const BasePotential*>(instances[index].get()));
+    // evict the least recently used entries other than the one just published
+    size_t numCached = 0;
+    for(size_t i=0; i<cached.size(); i++)
+        numCached += cached[i] ? 1 : 0;
+    while(numCached > cacheSize) {
+        ptrdiff_t oldest = -1;
+        for(size_t i=0; i<cached.size(); i++)
+            if(cached[i] && (ptrdiff_t)i != index &&
+                (oldest < 0 || atomicLoad(lastAccess[i]) < atomicLoad(lastAccess[oldest])))
+                oldest = i;
+        if(oldest < 0)
+            break;
+        atomicStore(cached[oldest], static_cast<const BasePotential*>(NULL));
+        numCached--;
+    }
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+    // release the evicted instances that are not used by any thread;
+    // the remaining ones will be released by one of the subsequent calls
+    for(size_t i=0; i<cached.size(); i++)
+        if(instances[i] && !cached[i] && atomicLoad(numUsers[i]) == 0)
+            instances[i].reset();
+    return instances[index].get();
+}
+
 void Evolving::evalCar(const coord::PosCar &pos,
     double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double time) const
 {
     ptrdiff_t index;
     double weight;
     searchInterp(time, times, interpLinear, /*output*/ index, weight);
-    instances[index]->eval(pos, potential, deriv, deriv2, time);
+    // in the lazy mode, pin the instances until the end of this routine,
+    // so that they are not deallocated if evicted from the cache by another thread
+    InstancePin pin1(*this, index);
+    pin1.instance->eval(pos, potential, deriv, deriv2, time);
     if(weight!=1) {
         // evaluate the potential at the other time stamp and interpolate between them
         double pot;
         coord::GradCar grad;
         coord::HessCar hess;
-        instances[index+1]->eval(pos, potential? &pot : NULL, deriv? &grad : NULL, deriv2? &hess : NULL);
+        InstancePin pin2(*this, index+1);
+        pin2.instance->eval(pos, potential? &pot : NULL, deriv? &grad : NULL, deriv2? &hess : NULL);
         if(potential)
             *potential = weight * (*potential) + (1-weight) * pot;
         if(deriv)
@@ -423,10 +595,516 @@ double Evolving::densityCar(const coord::PosCar &pos, double time) const
     ptrdiff_t index;
     double weight;
     searchInterp(time, times, interpLinear, /*output*/ index, weight);
-    double result = instances[index]->density(pos);
-    if(weight!=1)
-        result = weight * result + (1-weight) * instances[index+1]->density(pos);
+    InstancePin pin1(*this, index);
+    double result = pin1.instance->density(pos);
+    if(weight!=1) {
+        InstancePin pin2(*this, index+1);
+        result = weight * result + (1-weight) * pin2.instance->density(pos);
+    }
     return result;
 }
 
+
+namespace {
+/// append the values of a matrix to the flattened array, and record its size
+inline void flattenBlock(const math::Matrix<double>& src,
+    std::vector<double>& flat, std::vector<size_t>& sizes)
+{
+    sizes.push_back(src.size());
+    flat.insert(flat.end(), src.data(), src.data() + src.size());
+}
+
+inline void flattenBlock(const std::vector<double>& src,
+    std::vector<double>& flat, std::vector<size_t>& sizes)
+{
+    sizes.push_back(src.size());
+    flat.insert(flat.end(), src.begin(), src.end());
+}
+
+/** compute the weights of snapshots for interpolation in time:
+    \param[in]  time  is the time of interpolation;
+    \param[in]  times  is the array of timestamps;
+    \param[in]  cubic  determines whether to use cubic Hermite or linear interpolation;
+    \param[out] first  is the index of the first snapshot used in the interpolation;
+    \param[out] count  is the number of consecutive snapshots starting from first (between 1 and 4),
+    all of them lie within the array of timestamps;
+    \param[out] weights  are the weights of these snapshots.
+*/
+void timeInterpWeights(double time, const std::vector<double>& times, bool cubic,
+    ptrdiff_t& first, ptrdiff_t& count, double weights[4])
+{
+    ptrdiff_t size = times.size();
+    std::fill(weights, weights+4, 0.);
+    ptrdiff_t index = math::binSearch(time, &times.front(), size);
+    if(index<0 || index>=size-1) {   // outside the range of timestamps - take the boundary snapshot
+        first = std::max<ptrdiff_t>(0, std::min<ptrdiff_t>(index, size-1));
+        count = 1;
+        weights[0] = 1;
+        return;
+    }
+    double h = times[index+1] - times[index], x = (time - times[index]) / h;
+    if(!cubic) {
+        first = index;
+        count = 2;
+        weights[0] = 1-x;
+        weights[1] = x;
+        return;
+    }
+    // cubic Hermite interpolation on the segment [index, index+1]: the derivatives at each node
+    // are estimated by finite differences between the adjacent nodes (one-sided at the endpoints),
+    // and are linear combinations of values at nodes index-1..index+2, clamped to the valid range
+    double h00 = (1+2*x) * pow_2(1-x), h10 = x * pow_2(1-x), h01 = x*x * (3-2*x), h11 = x*x * (x-1);
+    first = std::max<ptrdiff_t>(index-1, 0);
+    count = std::min<ptrdiff_t>(index+2, size-1) - first + 1;
+    double *w0 = weights + (index-first);   // weights of nodes index and index+1
+    w0[0] += h00;
+    w0[1] += h01;
+    // derivative at node index, multiplied by h
+    if(index>0) {
+        double d = h / (times[index+1] - times[index-1]);
+        w0[ 1] += h10 * d;
+        w0[-1] -= h10 * d;
+    } else {
+        w0[1] += h10;
+        w0[0] -= h10;
+    }
+    // derivative at node index+1, multiplied by h
+    if(index+2<size) {
+        double d = h / (times[index+2] - times[index]);
+        w0[2] += h11 * d;
+        w0[0] -= h11 * d;
+    } else {
+        w0[1] += h11;
+        w0[0] -= h11;
+    }
+}
+}  // internal namespace
+
+EvolvingExpansion::EvolvingExpansion(const std::vector<double>& _times,
+    const std::vector<PtrPotential>& instances, bool _interpCubic)
+:
+    times(_times), isMultipole(false), interpCubic(_interpCubic), sym(coord::ST_SPHERICAL), numCoefs(0)
+{
+    if(times.size() != instances.size())
+        throw std::length_error("EvolvingExpansion: input arrays are not equal in length");
+    if(times.size() == 0)
+        throw std::invalid_argument("EvolvingExpansion: empty list of potentials");
+    for(size_t i=1; i<times.size(); i++)
+        if(!(times[i] > times[i-1]))
+            throw std::invalid_argument("EvolvingExpansion: Times must be sorted in increasing order");
+    isMultipole = dynamic_cast<const Multipole*>(instances[0].get()) != NULL;
+    for(size_t s=0; s<instances.size(); s++) {
+        std::vector<double> flat, g1, g2;
+        std::vector<size_t> sizes, groups;
+        const Multipole* mul = dynamic_cast<const Multipole*>(instances[s].get());
+        const CylSpline* cyl = dynamic_cast<const CylSpline*>(instances[s].get());
+        if(isMultipole && mul) {
+            std::vector<std::vector<double> > Phi, dPhi;
+            mul->getCoefs(g1, Phi, dPhi);
+            for(size_t i=0; i<Phi.size(); i++)
+                flattenBlock(Phi[i], flat, sizes);
+            for(size_t i=0; i<dPhi.size(); i++)
+                flattenBlock(dPhi[i], flat, sizes);
+            groups.push_back(Phi.size());
+            groups.push_back(dPhi.size());
+        } else if(!isMultipole && cyl) {
+            std::vector<math::Matrix<double> > Phi, dPhidR, dPhidz;
+            cyl->getCoefs(g1, g2, Phi, dPhidR, dPhidz);
+            for(size_t i=0; i<Phi.size(); i++)
+                flattenBlock(Phi[i], flat, sizes);
+            for(size_t i=0; i<dPhidR.size(); i++)
+                flattenBlock(dPhidR[i], flat, sizes);
+            for(size_t i=0; i<dPhidz.size(); i++)
+                flattenBlock(dPhidz[i], flat, sizes);
+            groups.push_back(Phi.size());
+            groups.push_back(dPhidR.size());
+            groups.push_back(dPhidz.size());
+        } else
+            throw std::invalid_argument("EvolvingExpansion: all potentials must be of the same type, "
+                "either Multipole or CylSpline");
+        if(s==0) {
+            grid1 = g1;
+            grid2 = g2;
+            blockSizes = sizes;
+            groupSizes = groups;
+            numCoefs   = flat.size();
+            coefs.reserve(numCoefs * times.size());
+        } else if(!sameGrid(g1, grid1) || !sameGrid(g2, grid2) || sizes != blockSizes || groups != groupSizes)
+            throw std::invalid_argument("EvolvingExpansion: potential at time "+
+                utils::toString(times[s])+" has a different grid or order of expansion");
+        coefs.insert(coefs.end(), flat.begin(), flat.end());
+        sym = static_cast<coord::SymmetryType>(sym & instances[s]->symmetry());
+    }
+    // allocate the per-thread cache
+#ifdef _OPENMP
+    cache.resize(std::max(omp_get_max_threads(), omp_get_num_procs()));
+    for(size_t i=0; i<cache.size(); i++) {
+        omp_lock_t* lock = new omp_lock_t;
+        omp_init_lock(lock);
+        cache[i].lock = lock;
+    }
+#else
+    cache.resize(1);
+#endif
+}
+
+EvolvingExpansion::~EvolvingExpansion()
+{
+#ifdef _OPENMP
+    for(size_t i=0; i<cache.size(); i++) {
+        omp_lock_t* lock = static_cast<omp_lock_t*>(cache[i].lock);
+        omp_destroy_lock(lock);
+        delete lock;
+    }
+#endif
+}
+
+PtrPotential EvolvingExpansion::interpolateInstance(double time) const
+{
+    // blend the coefficients of the snapshots with nonzero weights
+    ptrdiff_t first, count;
+    double weights[4];
+    timeInterpWeights(time, times, interpCubic, /*output*/ first, count, weights);
+    std::vector<double> flat(numCoefs, 0.);
+    for(ptrdiff_t k=0; k<count; k++) {
+        const double* src = &coefs[(first+k) * numCoefs];
+        for(size_t c=0; c<numCoefs; c++)
+            flat[c] += weights[k] * src[c];
+    }
+
+    // construct the expansion from the flattened array of blended coefficients
+    const double* flatCoefs = &flat[0];
+    size_t block = 0;
+    if(isMultipole) {
+        std::vector<std::vector<double> > Phi(groupSizes[0]), dPhi(groupSizes[1]);
+        for(size_t i=0; i<Phi.size(); i++, block++) {
+            Phi[i].assign(flatCoefs, flatCoefs + blockSizes[block]);
+            flatCoefs += blockSizes[block];
+        }
+        for(size_t i=0; i<dPhi.size(); i++, block++) {
+            dPhi[i].assign(flatCoefs, flatCoefs + blockSizes[block]);
+            flatCoefs += blockSizes[block];
+        }
+        return PtrPotential(new Multipole(grid1, Phi, dPhi));
+    } else {
+        std::vector<math::Matrix<double> > arrays[3];
+        for(int g=0; g<3; g++) {
+            arrays[g].resize(groupSizes[g]);
+            for(size_t i=0; i<groupSizes[g]; i++, block++) {
+                if(blockSizes[block] == 0)
+                    continue;   // an empty (identically zero) harmonic term
+                arrays[g][i] = math::Matrix<double>(grid1.size(), grid2.size());
+                std::copy(flatCoefs, flatCoefs + blockSizes[block], arrays[g][i].data());
+                flatCoefs += blockSizes[block];
+            }
+        }
+        return PtrPotential(new CylSpline(grid1, grid2, arrays[0], arrays[1], arrays[2]));
+    }
+}
+
+PtrPotential EvolvingExpansion::getInstance(double time) const
+{
+    // each thread uses its own cache entry, so that normally there is no contention for its lock;
+    // in nested parallel regions the thread index is not unique, so the cache is not used
+    ptrdiff_t thread = 0;
+#ifdef _OPENMP
+    thread = omp_get_level() > 1 ? -1 : omp_get_thread_num();
+#endif
+    CacheEntry* entry = thread >= 0 && thread < (ptrdiff_t)cache.size() ? &cache[thread] : NULL;
+#ifdef _OPENMP
+    // the entry may be in use by a thread with the same index from another team: then bypass the cache
+    if(entry && !omp_test_lock(static_cast<omp_lock_t*>(entry->lock)))
+        entry = NULL;
+#endif
+    PtrPotential pot;
+    if(entry && entry->pot && entry->time == time)
+        pot = entry->pot;
+    else {
+        try{
+            pot = interpolateInstance(time);
+        }
+        catch(...) {
+#ifdef _OPENMP
+            if(entry)
+                omp_unset_lock(static_cast<omp_lock_t*>(entry->lock));
+#endif
+            throw;
+        }
+        if(entry) {
+            entry->time = time;
+            entry->pot  = pot;
+        }
+    }
+#ifdef _OPENMP
+    if(entry)
+        omp_unset_lock(static_cast<omp_lock_t*>(entry->lock));
+#endif
+    return pot;
+}
+
+void EvolvingExpansion::evalCar(const coord::PosCar &pos,
+    double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double time) const
+{
+    getInstance(time)->eval(pos, potential, deriv, deriv2);
+}
+
+double EvolvingExpansion::densityCar(const coord::PosCar &pos, double time) const
+{
+    return getInstance(time)->density(pos);
+}
+
+//----- Tabulated potential -----//
+
+namespace {
+
+/// construct the grid in one coordinate from the nodes on the positive half-axis (starting from zero):
+/// if the potential is reflection-symmetric in this coordinate, add two mirrored nodes at negative
+/// values (to impose the correct boundary condition at zero), otherwise mirror the entire grid
+std::vector<double> tabulatedGrid(const std::vector<double>& half, bool mirror)
+{
+    std::vector<double> grid;
+    for(size_t i = mirror ? std::min<size_t>(2, half.size()-1) : half.size()-1; i>0; i--)
+        grid.push_back(-half[i]);
+    grid.insert(grid.end(), half.begin(), half.end());
+    return grid;
+}
+
+/// compute the potential at the given array of points in parallel, and optionally
+/// the characteristic scale of its variation  max(|Phi|, |r dPhi/dr|)  used to normalize the errors
+void evalPotentialParallel(const BasePotential& pot, const std::vector<coord::PosCar>& points,
+    /*output*/ std::vector<double>& values, std::vector<double>* scales=NULL)
+{
+    int numPoints = points.size();
+    values.resize(numPoints);
+    if(scales)
+        scales->resize(numPoints);
+    std::string errorMsg;
+    utils::CtrlBreakHandler cbrk;  // catch Ctrl-Break keypress
+    bool stop = false;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for(int i=0; i<numPoints; i++) {
+        if(stop) continue;
+        if(cbrk.triggered()) stop = true;
+        try{
+            if(scales) {
+                coord::GradCar grad;
+                pot.eval(points[i], &values[i], &grad);
+                scales->at(i) = fmax(fabs(values[i]), fabs(
+                    points[i].x * grad.dx + points[i].y * grad.dy + points[i].z * grad.dz));
+            } else
+                values[i] = pot.value(points[i]);
+        }
+        catch(std::exception& e) {
+            errorMsg = e.what();
+            stop = true;
+        }
+    }
+    if(cbrk.triggered())
+        throw std::runtime_error("Keyboard interrupt");
+    if(!errorMsg.empty())
+        throw std::runtime_error("TabulatedPotential: " + errorMsg);
+}
+
+}  // internal namespace
+
+TabulatedPotential::TabulatedPotential(const PtrPotential& _pot, double rmin, double _rmax,
+    double eps, unsigned int gridSize, unsigned int maxGridSize)
+:
+    pot(_pot), rmax(_rmax), maxRelError(NAN)
+{
+    if(!pot)
+        throw std::invalid_argument("TabulatedPotential: empty input potential");
+    if(!(rmin>0 && rmax>rmin && eps>0 && gridSize>=4 && maxGridSize>=gridSize))
+        throw std::invalid_argument("TabulatedPotential: invalid grid parameters");
+    coord::SymmetryType sym = pot->symmetry();
+    mirror[0] = isXReflSymmetric(sym);
+    mirror[1] = isYReflSymmetric(sym);
+    mirror[2] = isZReflSymmetric(sym);
+
+    // nodes of the grid on the positive half-axis in each coordinate
+    std::vector<double> half[3];
+    for(int d=0; d<3; d++)
+        half[d] = math::createNonuniformGrid(gridSize, rmin, rmax, true);
+
+    // the spline stores 8 numbers per node, and the grid in a coordinate without reflection symmetry
+    // covers both half-axes, so the table may become quite large at the maximum grid size
+    double maxMemory = 8. * sizeof(double);
+    for(int d=0; d<3; d++)
+        maxMemory *= mirror[d] ? maxGridSize + 2 : 2 * maxGridSize - 1;
+    if(maxMemory > 256. * 1024 * 1024)
+        utils::msg(utils::VL_WARNING, "TabulatedPotential", "The interpolation table may occupy up to " +
+            utils::toString(maxMemory / 1024 / 1024, 4) + " MB if refined to the maximum grid size " +
+            utils::toString(maxGridSize) + "; consider reducing maxGridSize");
+
+    // coordinates of the distinct (not mirrored) nodes in the previous refinement pass
+    // and the potential values computed at them, which are reused in the next pass
+    std::vector<double> prevUnique[3], prevValues;
+
+    while(true) {
+        // 1. compute the potential at grid nodes, skipping the mirrored nodes (if any)
+        // and the nodes already present in the previous pass
+        std::vector<double> grid[3];
+        std::vector<int> prevIndex[3];  // index of each distinct node in the previous pass, or -1
+        int offset[3];  // number of nodes at negative coordinates that are mirror copies
+        for(int d=0; d<3; d++) {
+            grid[d]   = tabulatedGrid(half[d], mirror[d]);
+            offset[d] = mirror[d] ? grid[d].size() - half[d].size() : 0;
+            for(size_t i=offset[d]; i<grid[d].size(); i++) {
+                std::vector<double>::const_iterator prev =
+                    std::lower_bound(prevUnique[d].begin(), prevUnique[d].end(), grid[d][i]);
+                prevIndex[d].push_back(prev != prevUnique[d].end() && *prev == grid[d][i] ?
+                    prev - prevUnique[d].begin() : -1);
+            }
+        }
+        const int
+            nx = grid[0].size(), ux = nx - offset[0],
+            ny = grid[1].size(), uy = ny - offset[1],
+            nz = grid[2].size(), uz = nz - offset[2],
+            py = prevUnique[1].size(), pz = prevUnique[2].size();
+        std::vector<coord::PosCar> points;
+        std::vector<int> pointIndex;   // index of each new point in the array of distinct nodes
+        unsigned int numReused = 0;
+        std::vector<double> uniqueValues(ux * uy * uz);
+        for(int i=0; i<ux; i++)
+            for(int j=0; j<uy; j++)
+                for(int k=0; k<uz; k++) {
+                    int pi = prevIndex[0][i], pj = prevIndex[1][j], pk = prevIndex[2][k];
+                    if(pi >= 0 && pj >= 0 && pk >= 0) {
+                        uniqueValues[(i * uy + j) * uz + k] = prevValues[(pi * py + pj) * pz + pk];
+                        numReused++;
+                    } else {
+                        points.push_back(coord::PosCar(
+                            grid[0][i+offset[0]], grid[1][j+offset[1]], grid[2][k+offset[2]]));
+                        pointIndex.push_back((i * uy + j) * uz + k);
+                    }
+                }
+        std::vector<double> newValues;
+        evalPotentialParallel(*pot, points, newValues);
+        for(size_t p=0; p<points.size(); p++)
+            uniqueValues[pointIndex[p]] = newValues[p];
+        for(int d=0; d<3; d++)
+            prevUnique[d].assign(grid[d].begin() + offset[d], grid[d].end());
+        std::vector<double> values(nx * ny * nz);
+        for(int i=0; i<nx; i++) {
+            // index of the node with the same absolute value of coordinate if it is a mirror copy
+            int ui = i < offset[0] ? 2 * offset[0] - i : i;
+            for(int j=0; j<ny; j++) {
+                int uj = j < offset[1] ? 2 * offset[1] - j : j;
+                for(int k=0; k<nz; k++) {
+                    int uk = k < offset[2] ? 2 * offset[2] - k : k;
+                    double val = uniqueValues[((ui-offset[0]) * uy + uj-offset[1]) * uz + uk-offset[2]];
+                    if(!isFinite(val))
+                        throw std::runtime_error("TabulatedPotential: potential is not finite at "
+                            "x=" + utils::toString(grid[0][i]) + ", y=" + utils::toString(grid[1][j]) +
+                            ", z=" + utils::toString(grid[2][k]));
+                    values[(i * ny + j) * nz + k] = val;
+                }
+            }
+        }
+        spl = math::CubicSpline3d(grid[0], grid[1], grid[2], values);
+        prevValues.swap(uniqueValues);
+
+        // 2. estimate the interpolation error in each interval of the grid in each coordinate
+        // at the points halfway between nodes in this coordinate and at (every other) nodes
+        // in the remaining two coordinates, where the spline is exact in these two coordinates
+        std::vector<int> testDim, testInt;   // coordinate and the interval index for each test point
+        points.clear();
+        for(int d=0; d<3; d++) {
+            int d1 = (d+1) % 3, d2 = (d+2) % 3;
+            for(size_t k=0; k<half[d].size()-1; k++) {
+                double mid = 0.5 * (half[d][k] + half[d][k+1]);
+                for(int sign = 1; sign >= (mirror[d] ? 1 : -1); sign -= 2)
+                    for(size_t i1 = offset[d1]; i1 < grid[d1].size(); i1 += 2)
+                        for(size_t i2 = offset[d2]; i2 < grid[d2].size(); i2 += 2) {
+                            double xyz[3];
+                            xyz[d]  = sign * mid;
+                            xyz[d1] = grid[d1][i1];
+                            xyz[d2] = grid[d2][i2];
+                            points.push_back(coord::PosCar(xyz[0], xyz[1], xyz[2]));
+                            testDim.push_back(d);
+                            testInt.push_back(k);
+                        }
+            }
+        }
+        std::vector<double> testValues, testScales;
+        evalPotentialParallel(*pot, points, testValues, &testScales);
+        std::vector<double> intervalError[3];
+        for(int d=0; d<3; d++)
+            intervalError[d].assign(half[d].size()-1, 0.);
+        maxRelError = 0;
+        for(size_t p=0; p<points.size(); p++) {
+            double err = fabs(spl.value(points[p].x, points[p].y, points[p].z) - testValues[p]) /
+                (testScales[p]>0 ? testScales[p] : 1);
+            if(!(err <= intervalError[testDim[p]][testInt[p]]))  // also catches NAN
+                intervalError[testDim[p]][testInt[p]] = err;
+            maxRelError = fmax(maxRelError, err);
+        }
+        utils::msg(utils::VL_DEBUG, "TabulatedPotential", "Grid size " +
+            utils::toString(nx) + "*" + utils::toString(ny) + "*" + utils::toString(nz) +
+            ", max relative error " + utils::toString(maxRelError) +
+            ", potential values reused at " + utils::toString(numReused) + " nodes");
+
+        // 3. bisect the intervals with the largest error exceeding the tolerance,
+        // as long as the grid size is within the limit
+        bool refined = false, limited = false;
+        for(int d=0; d<3; d++) {
+            std::vector<std::pair<double, size_t> > bad;
+            for(size_t k=0; k<intervalError[d].size(); k++)
+                if(!(intervalError[d][k] <= eps))
+                    bad.push_back(std::make_pair(-intervalError[d][k], k));
+            size_t numAdd = std::min<size_t>(bad.size(), maxGridSize - half[d].size());
+            limited |= numAdd < bad.size();
+            if(numAdd == 0)
+                continue;
+            std::sort(bad.begin(), bad.end());
+            for(size_t b=0; b<numAdd; b++) {
+                size_t k = bad[b].second;
+                half[d].push_back(0.5 * (half[d][k] + half[d][k+1]));
+            }
+            std::sort(half[d].begin(), half[d].end());
+            refined = true;
+        }
+        if(!refined) {
+            if(limited)
+                utils::msg(utils::VL_WARNING, "TabulatedPotential",
+                    "Could not attain the required accuracy " + utils::toString(eps) +
+                    " with the maximum grid size " + utils::toString(maxGridSize) +
+                    "; the actual max relative error is " + utils::toString(maxRelError));
+            break;
+        }
+    }
+}
+
+void TabulatedPotential::evalCar(const coord::PosCar &pos,
+    double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double time) const
+{
+    if(!(fabs(pos.x) <= rmax && fabs(pos.y) <= rmax && fabs(pos.z) <= rmax)) {
+        // outside the grid use the original potential
+        pot->eval(pos, potential, deriv, deriv2, time);
+        return;
+    }
+    // for reflection-symmetric coordinates, the grid covers only the positive half-axis
+    double sx = mirror[0] && pos.x < 0 ? -1 : 1,
+           sy = mirror[1] && pos.y < 0 ? -1 : 1,
+           sz = mirror[2] && pos.z < 0 ? -1 : 1;
+    double der[3], der2[6];
+    spl.evalDeriv(pos.x * sx, pos.y * sy, pos.z * sz,
+        potential, deriv ? der : NULL, deriv2 ? der2 : NULL);
+    if(deriv) {
+        deriv->dx = der[0] * sx;
+        deriv->dy = der[1] * sy;
+        deriv->dz = der[2] * sz;
+    }
+    if(deriv2) {
+        deriv2->dx2  = der2[0];
+        deriv2->dy2  = der2[1];
+        deriv2->dz2  = der2[2];
+        deriv2->dxdy = der2[3] * sx * sy;
+        deriv2->dydz = der2[4] * sy * sz;
+        deriv2->dxdz = der2[5] * sx * sz;
+    }
+}
+
 } // namespace potential
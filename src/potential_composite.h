@@ -174,11 +174,49 @@ private:
 };
 
 
+/** Prototype of a class that provides the potential associated with the given timestamp on demand,
+    used by the Evolving potential in the lazy-loading mode */
+class BaseSnapshotLoader {
+public:
+    virtual ~BaseSnapshotLoader() {}
+    /// create the potential for the given index in the list of timestamps
+    virtual PtrPotential load(size_t index) const = 0;
+};
+
+/// shared pointer to a snapshot loader
+typedef shared_ptr<const BaseSnapshotLoader> PtrSnapshotLoader;
+
+/** A time-dependent potential represented by a sequence of potentials at different timestamps,
+    which are either interpolated linearly in time or taken from the nearest timestamp.
+    The potentials may be provided all at once (eager mode), or loaded on demand by a user-provided
+    loader (lazy mode): in the latter case, only a limited number of most recently used instances
+    are kept in memory, and the least recently used ones are discarded when the cache is full.
+    Optionally, when a new instance is loaded, the next one in the order of increasing time is loaded
+    at the same time (read-ahead), so that the following bracket is already in the cache.
+    Instances already in the cache are retrieved without locking: a thread pins the cache entry
+    while evaluating it, and an entry evicted by another thread in the meantime is released only
+    after all its users have unpinned it. Loading and eviction are serialized by a critical section.
+*/
 class Evolving: public BasePotentialCar {
 public:
+    /// construct from the list of timestamps and the corresponding potentials (eager mode)
     Evolving(const std::vector<double> _times,
         const std::vector<PtrPotential> _instances,
         bool _interpLinear=false);
+
+    /** construct from the list of timestamps and a loader that provides the corresponding
+        potentials on demand (lazy mode);
+        \param[in]  cacheSize  is the maximum number of instances kept in memory simultaneously
+        (should be at least 2, or 3 if readAhead is enabled; smaller values are increased);
+        \param[in]  readAhead  determines whether to load the next instance (in the order of
+        increasing time), whenever a new instance needs to be loaded.
+    */
+    Evolving(const std::vector<double> _times,
+        const PtrSnapshotLoader& _loader,
+        bool _interpLinear=false,
+        unsigned int cacheSize=8,
+        bool readAhead=false);
+
     virtual coord::SymmetryType symmetry() const { return coord::ST_NONE; }  // in general...
     virtual const char* name() const { return myName(); };
     static const char* myName() { static const char* text = "Evolving"; return text; }
@@ -186,10 +224,118 @@ public:
 private:
     /// array of time stamps for a time-dependent potential
     std::vector<double> times;
-    /// array of potentials corresponding to each moment of time (possibly just one)
-    std::vector<PtrPotential> instances;
+    /// array of potentials corresponding to each moment of time (possibly just one);
+    /// in the lazy mode, only the elements currently held in the cache are non-empty
+    mutable std::vector<PtrPotential> instances;
     /// use linear or nearest-point interpolation of a time-dependent potential
     bool interpLinear;
+    /// loader of instances in the lazy mode (empty in the eager mode)
+    PtrSnapshotLoader loader;
+    /// maximum number of instances kept in memory in the lazy mode
+    unsigned int cacheSize;
+    /// whether to load the next instance in advance
+    bool readAhead;
+    /// in the lazy mode, raw pointers to the instances currently published in the cache
+    /// (NULL if not loaded or evicted), which are read by all threads without locking
+    mutable std::vector<const BasePotential*> cached;
+    /// number of threads currently using each instance (an evicted instance is released only
+    /// when this number drops to zero)
+    mutable std::vector<int> numUsers;
+    /// the time of the last access to each instance (counted in the number of accesses)
+    mutable std::vector<unsigned long long> lastAccess;
+    /// total number of accesses to the cache
+    mutable unsigned long long numAccess;
+
+    /// helper class that pins a cache entry for the duration of its lifetime
+    class InstancePin;
+
+    /// retrieve the instance for the given index in the lazy mode and pin it in the cache,
+    /// loading it if necessary; each call must be paired with a call to releaseInstance
+    const BasePotential* acquireInstance(ptrdiff_t index) const;
+
+    /// unpin the instance acquired by a previous call to acquireInstance
+    void releaseInstance(ptrdiff_t index) const;
+
+    /// put the instance into the cache and evict the least recently used ones if the cache
+    /// is full (must be called from within the critical section)
+    const BasePotential* publishInstance(ptrdiff_t index, const PtrPotential& instance) const;
+
+    virtual void evalCar(const coord::PosCar &pos,
+        double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double time) const;
+    virtual double densityCar(const coord::PosCar &pos, double time) const;
+};
+
+
+/** A time-dependent potential represented by a sequence of Multipole or CylSpline expansions
+    with identical grids, which are interpolated in time in the space of coefficients.
+    Unlike the Evolving potential with linear interpolation, which evaluates two instances of
+    potential and blends the results, here the coefficients of all snapshots are stored in
+    a single contiguous array, and the interpolation in time (linear or cubic Hermite, the latter
+    providing a continuous time derivative at snapshot boundaries) is performed on the coefficients,
+    constructing a single instance of the expansion for the given time.
+    This instance is cached separately for each thread, so that subsequent evaluations at the same
+    time (e.g., for all particles in an N-body simulation with a shared timestep, or for an array
+    of points passed at once) need only one evaluation of the expansion, but each change of time
+    incurs the cost of its construction. Hence this class is not suitable for integrating individual
+    orbits, where every call comes at a different time: the Evolving potential is preferable there.
+    Threads with the same index in different OpenMP teams (e.g., launched concurrently from several
+    Python threads) are prevented from using the same cache entry simultaneously by a lock;
+    the thread that finds the entry already in use simply bypasses the cache.
+    Outside the range of timestamps, the first or the last snapshot is used.
+*/
+class EvolvingExpansion: public BasePotentialCar {
+public:
+    /** construct from the list of timestamps and the corresponding potentials,
+        which all must be either Multipole or CylSpline with identical grids (otherwise an exception
+        is thrown); the coefficients are extracted from these instances, which are not retained.
+        If interpCubic==true, use cubic Hermite interpolation in time, otherwise linear.
+    */
+    EvolvingExpansion(const std::vector<double>& times,
+        const std::vector<PtrPotential>& instances, bool interpCubic=false);
+    ~EvolvingExpansion();
+
+    virtual coord::SymmetryType symmetry() const { return sym; }
+    virtual const char* name() const { return myName(); };
+    static const char* myName() { static const char* text = "EvolvingExpansion"; return text; }
+
+private:
+    /// array of time stamps
+    std::vector<double> times;
+    /// whether the expansion is Multipole (true) or CylSpline (false)
+    bool isMultipole;
+    /// use cubic or linear interpolation in time
+    bool interpCubic;
+    /// common symmetry of all snapshots
+    coord::SymmetryType sym;
+    /// radial and vertical grids (the latter only for CylSpline)
+    std::vector<double> grid1, grid2;
+    /// sizes of individual coefficient blocks in the order they are stored in the flattened array
+    std::vector<size_t> blockSizes;
+    /// number of blocks in each group of coefficient arrays (Phi, dPhi, ...)
+    std::vector<size_t> groupSizes;
+    /// flattened coefficients of all snapshots: numCoefs values for each snapshot stored contiguously
+    std::vector<double> coefs;
+    size_t numCoefs;
+
+    /// the instance of expansion constructed for the most recent time, separately for each thread
+    struct CacheEntry {
+        double time;
+        PtrPotential pot;
+        /// OpenMP lock guarding the entry (an opaque pointer, so that the layout of this class
+        /// does not depend on whether the including code is compiled with OpenMP)
+        void* lock;
+        CacheEntry() : time(NAN), lock(NULL) {}
+    };
+    mutable std::vector<CacheEntry> cache;
+
+    // the locks are owned by this object, so it cannot be copied
+    EvolvingExpansion(const EvolvingExpansion&);
+    EvolvingExpansion& operator=(const EvolvingExpansion&);
+
+    /// return the expansion constructed for the given time (possibly taken from the cache)
+    PtrPotential getInstance(double time) const;
+    /// construct the expansion for the given time by interpolating the coefficients
+    PtrPotential interpolateInstance(double time) const;
 
     virtual void evalCar(const coord::PosCar &pos,
         double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double time) const;
@@ -197,6 +343,73 @@ private:
 };
 
 
+/** A wrapper that replaces an expensive potential (e.g., a triaxial Dehnen or Ferrers model,
+    which involve numerical integration in each call, or a user-defined potential implemented
+    in another language) by a 3d cubic spline interpolated from its values on a Cartesian grid.
+    The grid in each coordinate consists of zero plus nonuniformly spaced nodes between rmin
+    and rmax; it is initially uniform in log-scaled coordinate and then adaptively refined
+    by bisecting the intervals in which the interpolation error, measured at the midpoints
+    between nodes, exceeds the required relative accuracy. The error is normalized by
+    the local scale of the potential  max(|Phi|, |r dPhi/dr|),  which is meaningful also
+    for potentials that cross zero (e.g., Logarithmic).
+    If the potential is symmetric with respect to reflection in any of the coordinates,
+    the grid in this coordinate covers only the positive half-axis (plus two mirrored nodes
+    to impose the correct boundary condition at zero), reducing the size of the table.
+    The values at grid nodes are computed in parallel, and the values at nodes retained from
+    the previous refinement pass are reused.
+    Outside the grid (at |x|, |y| or |z| > rmax), the original potential is used;
+    the density is always taken from the original potential.
+    The potential is assumed to be time-independent (it is tabulated at time 0).
+*/
+class TabulatedPotential: public BasePotentialCar {
+public:
+    /// the instance of the original potential
+    const PtrPotential pot;
+
+    /** construct the interpolation table for the given potential.
+        \param[in]  pot  is the original potential;
+        \param[in]  rmin  is the innermost nonzero node of the initial grid in each coordinate;
+        \param[in]  rmax  is the outer boundary of the grid in each coordinate;
+        \param[in]  eps   is the required relative accuracy of the interpolated potential;
+        \param[in]  gridSize  is the initial number of nodes covering the half-axis;
+        \param[in]  maxGridSize  is the maximum number of nodes in the half-axis after refinement;
+        if the required accuracy could not be attained within this limit, a warning is printed;
+        a warning is also printed if the table could exceed 256 MB at this grid size (e.g.,
+        a potential without reflection symmetries at the default maxGridSize may take ~500 MB).
+        \throw  std::invalid_argument if the parameters are incorrect.
+    */
+    TabulatedPotential(const PtrPotential& pot, double rmin, double rmax,
+        double eps=1e-5, unsigned int gridSize=20, unsigned int maxGridSize=100);
+
+    virtual coord::SymmetryType symmetry() const { return pot->symmetry(); }
+    virtual const char* name() const { return myName(); };
+    static const char* myName() { static const char* text = "TabulatedPotential"; return text; }
+    virtual double totalMass() const { return pot->totalMass(); }
+
+    /// maximum relative error of the interpolated potential at the midpoints between grid nodes
+    double maxError() const { return maxRelError; }
+
+    /// the interpolating spline (the grids include the mirrored nodes at negative coordinates)
+    const math::CubicSpline3d& spline() const { return spl; }
+
+private:
+    const double rmax;        ///< extent of the grid in each coordinate
+    bool mirror[3];           ///< whether the potential is reflection-symmetric in each coordinate
+    math::CubicSpline3d spl;  ///< 3d spline interpolator for the potential
+    double maxRelError;       ///< estimated accuracy of interpolation
+
+    virtual void evalCar(const coord::PosCar &pos,
+        double* potential, coord::GradCar* deriv, coord::HessCar* deriv2, double time) const;
+
+    virtual double densityCar(const coord::PosCar &pos, double time) const
+    { return pot->density(pos, time); }
+    virtual double densityCyl(const coord::PosCyl &pos, double time) const
+    { return pot->density(pos, time); }
+    virtual double densitySph(const coord::PosSph &pos, double time) const
+    { return pot->density(pos, time); }
+};
+
+
 class UniformAcceleration: public BasePotentialCar {
 public:
     /// initialize from a triplet of splines representing time-dependent acceleration
@@ -986,7 +986,8 @@ CylSpline::CylSpline(
     const std::vector<double> &gridz_orig,
     const std::vector< math::Matrix<double> > &Phi,
     const std::vector< math::Matrix<double> > &dPhidR,
-    const std::vector< math::Matrix<double> > &dPhidz)
+    const std::vector< math::Matrix<double> > &dPhidz,
+    bool singlePrecision)
 {
     unsigned int sizeR = gridR_orig.size(), sizez = gridz_orig.size(), sizez_orig = sizez;
     int mmax  = (Phi.size()-1)/2;  // index of the m=0 term
@@ -1037,6 +1038,7 @@ CylSpline::CylSpline(
     // temporary matrices of scaled potential and derivatives used to construct 2d splines
     math::Matrix<double> val(sizeR, sizez), derR(sizeR, sizez), derz(sizeR, sizez);
     math::Matrix<double> val0, derR0, derz0;   // copies of these matrices for the m=0 term
+    double maxError = 0;  // relative error introduced by storing the coefficients in single precision
 
     // loop over azimuthal harmonic indices (m)
     for(int im=0; im<=2*mmax; im++) {
@@ -1102,10 +1104,14 @@ CylSpline::CylSpline(
             derz0 = derz;
         }
         if(nontrivial || m==0) {  // only construct splines if they are not identically zero or m=0
-            spl[mm] = haveDerivs ?
-                math::PtrInterpolator2d(new math::QuinticSpline2d(gridR, gridz, val, derR, derz)) :
-                math::PtrInterpolator2d(new math::CubicSpline2d(gridR, gridz, val,
-                    /*regularize*/false, /*dPhi/dR at R=0*/0, /*other derivs unspecified*/NAN, NAN, NAN));
+            math::BaseInterpolator2d* interp = haveDerivs ?
+                static_cast<math::BaseInterpolator2d*>(
+                new math::QuinticSpline2d(gridR, gridz, val, derR, derz)) :
+                new math::CubicSpline2d(gridR, gridz, val,
+                    /*regularize*/false, /*dPhi/dR at R=0*/0, /*other derivs unspecified*/NAN, NAN, NAN);
+            spl[mm].reset(interp);
+            if(singlePrecision)
+                maxError = std::max(maxError, interp->reducePrecision());
             // check if this non-trivial harmonic breaks any symmetry
             if(m!=0)  // no z-rotation symmetry because m!=0 coefs are non-zero
                 mysym &= ~coord::ST_ZROTATION;
@@ -1118,6 +1124,9 @@ CylSpline::CylSpline(
         }
     }
     sym = static_cast<coord::SymmetryType>(mysym);
+    if(singlePrecision)
+        utils::msg(utils::VL_DEBUG, "CylSpline",
+            "Single-precision storage of coefficients: max relative error=" + utils::toString(maxError));
 }
 
 void CylSpline::evalCyl(const coord::PosCyl &pos,
@@ -1144,8 +1153,13 @@ void CylSpline::evalCyl(const coord::PosCyl &pos,
 
     // value and derivatives (in scaled coords) of the m=0 term, which are later used
     // to scale the other terms after we have performed the Fourier transform on all of them
+    // all harmonics share the same grid, so the cell found for the m=0 term is reused for others,
+    // and if an orbit integrator is active, the search starts from the cell found at its previous step
+    math::CellHintCache* hints = math::CellHintCache::active();
+    math::CellHint2d localHint;
+    math::CellHint2d& hint = hints ? hints->get(this) : localHint;
     double Phi0, dPhi0dR, dPhi0dz, d2Phi0dR2, d2Phi0dRdz, d2Phi0dz2;
-    spl[mmax]->evalDeriv(Rscaled, zscaled,
+    spl[mmax]->evalDeriv(Rscaled, zscaled, hint,
         needPhi  ?   &Phi0     : NULL, 
         needGrad ?  &dPhi0dR   : NULL,
         needGrad ?  &dPhi0dz   : NULL,
@@ -1206,7 +1220,7 @@ void CylSpline::evalCyl(const coord::PosCyl &pos,
         double Phi_m;
         coord::GradCyl dPhi_m;
         coord::HessCyl d2Phi_m;
-        spl[mm]->evalDeriv(Rscaled, zscaled,
+        spl[mm]->evalDeriv(Rscaled, zscaled, hint,
             needPhi  ?   &Phi_m      : NULL, 
             needGrad ?  &dPhi_m.dR   : NULL,
             needGrad ?  &dPhi_m.dz   : NULL,
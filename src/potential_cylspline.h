@@ -184,13 +184,17 @@ public:
         of Phi at grid nodes, employing 2d cubic spline interpolation for each m term.
         If derivatives are provided, then the interpolation is based on quintic splines,
         improving the accuracy.
+        \param[in]  singlePrecision  (optional, default false) whether to store the coefficients
+        of interpolating splines in single precision, halving their memory footprint
+        (the introduced relative error, typically ~1e-7, is reported in the debug log).
     */
     CylSpline(
         const std::vector<double> &gridR,
         const std::vector<double> &gridz,
         const std::vector< math::Matrix<double> > &Phi,
         const std::vector< math::Matrix<double> > &dPhidR = std::vector< math::Matrix<double> >(),
-        const std::vector< math::Matrix<double> > &dPhidz = std::vector< math::Matrix<double> >() );
+        const std::vector< math::Matrix<double> > &dPhidz = std::vector< math::Matrix<double> >(),
+        bool singlePrecision = false);
 
     virtual const char* name() const { return myName(); }
     static const char* myName() { static const char* text = "CylSpline"; return text; }
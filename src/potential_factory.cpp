@@ -9,6 +9,7 @@
 #include "potential_multipole.h"
 #include "potential_perfect_ellipsoid.h"
 #include "potential_spheroid.h"
+#include "potential_utils.h"
 #include "particles_io.h"
 #include "math_core.h"
 #include "utils.h"
@@ -132,6 +133,7 @@ struct AllParam
     unsigned int nmax;       ///< order of radial expansion for BasisSet (actual number of terms is nmax+1)
     double eta;              ///< shape parameters of basis functions for BasisSet (0.5-CB, 1.0-HO, etc.)
     double r0;               ///< scale radius of the basis functions for BasisSet
+    bool singlePrecision;    ///< whether to store spline coefficients of Multipole and CylSpline as float
     std::string file;        ///< name of file with coordinates of points, or coefficients of expansion
     std::string center;      ///< coordinates of the center offset or the name of a file with these offsets
     /// default constructor initializes the fields to some reasonable values
@@ -145,7 +147,7 @@ struct AllParam
         modulationAmplitude(0.), cutoffStrength(2.), sersicIndex(NAN), W0(NAN), trunc(1.),
         binary_q(0), binary_sma(0), binary_ecc(0), binary_phase(0),
         gridSizeR(25), gridSizez(25), rmin(0), rmax(0), zmin(0), zmax(0),
-        lmax(6), mmax(6), smoothing(1.), nmax(12), eta(1.0), r0(0)
+        lmax(6), mmax(6), smoothing(1.), nmax(12), eta(1.0), r0(0), singlePrecision(false)
     {};
     /// convert to KeplerBinaryParams
     operator KeplerBinaryParams() const
@@ -191,6 +193,19 @@ PotentialType getPotentialTypeByName(const std::string& name)
     return PT_INVALID;
 }
 
+/// create a composite potential from the given components, using the specialized
+/// CompositeAnalytic class if all of them are of the supported analytic types
+PtrPotential createComposite(const std::vector<PtrPotential>& components)
+{
+    bool analytic = true;
+    for(size_t i=0; i<components.size(); i++)
+        analytic &= CompositeAnalytic::isSupported(*components[i]);
+    if(analytic)
+        return PtrPotential(new CompositeAnalytic(components));
+    else
+        return PtrPotential(new Composite(components));
+}
+
 } // internal namespace
 
 // return the type of symmetry by its name, or ST_DEFAULT if unavailable
@@ -302,6 +317,7 @@ AllParam parseParam(const utils::KeyValueMap& kvmap, const units::ExternalUnits&
     param.eta                 = kvmap.getDouble("eta",  param.eta);
     param.r0                  = kvmap.getDouble("r0",   param.r0)
                               * conv.lengthUnit;
+    param.singlePrecision     = kvmap.getBool(  "singlePrecision", param.singlePrecision);
 
     // tweak: if 'type' is Plummer or NFW, but axis ratio is not unity or a cutoff radius is provided,
     // replace it with an equivalent Spheroid model, because the dedicated potential models
@@ -577,7 +593,7 @@ PtrPotential createMultipoleFromCoefs(std::vector<std::string>& lines,
         math::blas_dmul(pow_2(converter.velocityUnit), coefsPhi[i]);
         math::blas_dmul(pow_2(converter.velocityUnit)/converter.lengthUnit, coefsdPhi[i]);
     }
-    return PtrPotential(new Multipole(gridr, coefsPhi, coefsdPhi));
+    return PtrPotential(new Multipole(gridr, coefsPhi, coefsdPhi, params.singlePrecision));
 }
 
 /// parse the array of coefficients and create a CylSpline potential
@@ -617,7 +633,7 @@ PtrPotential createCylSplineFromCoefs(std::vector<std::string>& lines,
         math::blas_dmul(pow_2(converter.velocityUnit)/converter.lengthUnit, dPhidR[i]);
         math::blas_dmul(pow_2(converter.velocityUnit)/converter.lengthUnit, dPhidz[i]);
     }
-    return PtrPotential(new CylSpline(gridR, gridz, Phi, dPhidR, dPhidz));
+    return PtrPotential(new CylSpline(gridR, gridz, Phi, dPhidR, dPhidz, params.singlePrecision));
 }
 
 /// parse the array of coefficients and create a SphericalHarmonic density
@@ -978,6 +994,28 @@ public:
 //        ------------------------------------------------------------------------
 ///@{
 
+/** if requested in the parameters, re-create a Multipole or CylSpline potential
+    with the coefficients of its interpolating splines stored in single precision;
+    other potentials are returned unchanged */
+PtrPotential applySinglePrecision(const AllParam& param, const PtrPotential& pot)
+{
+    if(!param.singlePrecision)
+        return pot;
+    if(const Multipole* mul = dynamic_cast<const Multipole*>(pot.get())) {
+        std::vector<double> radii;
+        std::vector<std::vector<double> > Phi, dPhi;
+        mul->getCoefs(radii, Phi, dPhi);
+        return PtrPotential(new Multipole(radii, Phi, dPhi, /*singlePrecision*/ true));
+    }
+    if(const CylSpline* cyl = dynamic_cast<const CylSpline*>(pot.get())) {
+        std::vector<double> gridR, gridz;
+        std::vector<math::Matrix<double> > Phi, dPhidR, dPhidz;
+        cyl->getCoefs(gridR, gridz, Phi, dPhidR, dPhidz);
+        return PtrPotential(new CylSpline(gridR, gridz, Phi, dPhidR, dPhidz, /*singlePrecision*/ true));
+    }
+    return pot;
+}
+
 /// create potential expansion of a given type from a set of point masses
 PtrPotential createPotentialExpansionFromParticles(const AllParam& param,
     const particles::ParticleArray<coord::PosCyl>& particles)
@@ -987,12 +1025,12 @@ PtrPotential createPotentialExpansionFromParticles(const AllParam& param,
         return BasisSet::create(particles, param.symmetryType, param.lmax, param.mmax,
             param.nmax, param.eta, param.r0);
     case PT_MULTIPOLE:
-        return Multipole::create(particles, param.symmetryType, param.lmax, param.mmax,
-            param.gridSizeR, param.rmin, param.rmax, param.smoothing);
+        return applySinglePrecision(param, Multipole::create(particles, param.symmetryType,
+            param.lmax, param.mmax, param.gridSizeR, param.rmin, param.rmax, param.smoothing));
     case PT_CYLSPLINE:
-        return CylSpline::create(particles, param.symmetryType, param.mmax,
-            param.gridSizeR, param.rmin, param.rmax,
-            param.gridSizez, param.zmin, param.zmax);
+        return applySinglePrecision(param, CylSpline::create(particles, param.symmetryType,
+            param.mmax, param.gridSizeR, param.rmin, param.rmax,
+            param.gridSizez, param.zmin, param.zmax));
     default:
         throw std::invalid_argument("Unknown potential expansion type");
     }
@@ -1087,12 +1125,12 @@ PtrPotential createPotentialExpansionFromSource(const AllParam& param, const Sou
         return BasisSet::create(source, param.lmax, param.mmax,
             param.nmax, param.eta, param.r0);
     case PT_MULTIPOLE:
-        return Multipole::create(source, param.lmax, param.mmax,
-            param.gridSizeR, param.rmin, param.rmax);
+        return applySinglePrecision(param, Multipole::create(source, param.lmax, param.mmax,
+            param.gridSizeR, param.rmin, param.rmax));
     case PT_CYLSPLINE:
-        return CylSpline::create(source, param.mmax,
+        return applySinglePrecision(param, CylSpline::create(source, param.mmax,
             param.gridSizeR, param.rmin, param.rmax,
-            param.gridSizez, param.zmin, param.zmax);
+            param.gridSizez, param.zmin, param.zmax));
     default: throw std::invalid_argument("Unknown potential expansion type");
     }
 }
@@ -1176,6 +1214,24 @@ PtrPotential createPotentialExpansion(
         "in density=..., or a table of coefficients (when loading from a file)");
 }
 
+/// loader of potentials from INI files for the Evolving potential in the lazy mode
+class SnapshotFileLoader: public BaseSnapshotLoader {
+    const std::vector<std::string> fileNames;
+    const units::ExternalUnits converter;
+public:
+    SnapshotFileLoader(const std::vector<std::string>& _fileNames, const units::ExternalUnits& _converter) :
+        fileNames(_fileNames), converter(_converter) {}
+    virtual PtrPotential load(size_t index) const
+    {
+        try {
+            return potential::readPotential(fileNames.at(index), converter);
+        }
+        catch(std::exception& e) {
+            throw std::runtime_error("Error reading the potential from "+fileNames[index]+": "+e.what());
+        }
+    }
+};
+
 /// create a time-dependent list of potentials
 static PtrPotential createEvolvingPotential(
     const utils::KeyValueMap& kvmap, const units::ExternalUnits& converter)
@@ -1194,7 +1250,14 @@ static PtrPotential createEvolvingPotential(
             "Evolving potential needs a list of timestamps and filenames after the line 'Timestamps'");
 
     bool interpLinear = kvmap.getBoolAlt("interpLinear", "linearInterp", false);
-    std::vector<std::string> fields;
+    bool lazyLoad     = kvmap.getBool("lazyLoad", false);
+    std::string interpCoefs = kvmap.getString("interpCoefs");
+    if(!interpCoefs.empty() && !utils::stringsEqual(interpCoefs, "linear") &&
+        !utils::stringsEqual(interpCoefs, "cubic"))
+        throw std::invalid_argument("Evolving potential: interpCoefs must be 'linear' or 'cubic'");
+    if(!interpCoefs.empty() && lazyLoad)
+        throw std::invalid_argument("Evolving potential: interpCoefs and lazyLoad are incompatible");
+    std::vector<std::string> fields, fileNames;
     std::vector<double> times;
     std::vector<PtrPotential> potentials;
     // attempt to parse the remaining lines in this INI section
@@ -1208,13 +1271,24 @@ static PtrPotential createEvolvingPotential(
             !((fields[0][0]>='0' && fields[0][0]<='9') || fields[0][0]=='-' || fields[0][0]=='+'))
             continue;
         times.push_back(utils::toDouble(fields[0]) * converter.timeUnit);
-        try {
-            potentials.push_back(potential::readPotential(fields[1], converter));
-        }
-        catch(std::exception& e) {
-            throw std::runtime_error("Error reading the potential from "+fields[1]+": "+e.what());
-        }
+        fileNames.push_back(fields[1]);
+    }
+    PtrSnapshotLoader loader(new SnapshotFileLoader(fileNames, converter));
+    if(lazyLoad) {
+        // check that all files exist at the beginning, rather than discover it halfway through
+        for(size_t index=0; index<fileNames.size(); index++)
+            if(!utils::fileExists(fileNames[index]))
+                throw std::runtime_error("Evolving potential: file "+fileNames[index]+" does not exist");
+        // the potentials will be loaded on demand, and only a limited number of them kept in memory
+        return PtrPotential(new Evolving(times, loader, interpLinear,
+            kvmap.getInt("cacheSize", 8), kvmap.getBool("readAhead", false)));
     }
+    for(size_t index=0; index<fileNames.size(); index++)
+        potentials.push_back(loader->load(index));
+    if(!interpCoefs.empty())
+        // interpolate the coefficients of Multipole or CylSpline expansions with identical grids
+        return PtrPotential(new EvolvingExpansion(times, potentials,
+            utils::stringsEqual(interpCoefs, "cubic")));
     return PtrPotential(new Evolving(times, potentials, interpLinear));
 }
 
@@ -1540,7 +1614,7 @@ PtrPotential createPotential(
         // each bunch either has just one potential component, or produces a composite potential
         PtrPotential bunchPotential = bunch->componentsPot.size()==1 ?
             bunch->componentsPot[0] :
-            PtrPotential(new Composite(bunch->componentsPot));
+            createComposite(bunch->componentsPot);
         // finally, if there is a nontrivial center offset, wrap the bunch into a Shifted potential
         if(!bunch->center.empty())
             bunchPotential = createOffset<Shifted>(bunch->center, converter, bunchPotential);
@@ -1552,7 +1626,7 @@ PtrPotential createPotential(
     if(bunchPotentials.size() == 1)
         return bunchPotentials[0];
     else
-        return PtrPotential(new Composite(bunchPotentials));
+        return createComposite(bunchPotentials);
 }
 
 // create a potential from a single set of parameters
@@ -1708,4 +1782,224 @@ bool writeDensity(const std::string& fileName, const BaseDensity& dens,
     return strm.good();
 }
 
+namespace{
+/// recursively collect the components of a composite potential into a flat list
+void collectComponents(const PtrPotential& pot, std::vector<PtrPotential>& components)
+{
+    const Composite* comp = dynamic_cast<const Composite*>(pot.get());
+    if(comp) {
+        for(unsigned int i=0; i<comp->size(); i++)
+            collectComponents(comp->component(i), components);
+    } else
+        components.push_back(pot);
+}
+
+/// add the array src multiplied by 1 to dest, extending the latter if necessary
+template<typename ArrayT>
+void addArray(const ArrayT& src, ArrayT& dest)
+{
+    if(src.size() == 0)
+        return;
+    if(dest.size() == 0) {
+        dest = src;
+        return;
+    }
+    assert(dest.size() == src.size());
+    for(size_t i=0; i<src.size(); i++)
+        dest.data()[i] += src.data()[i];
+}
+
+/// sum up several Multipole potentials with identical radial grids
+PtrPotential sumMultipole(const std::vector<PtrPotential>& comps)
+{
+    std::vector<double> radii;
+    std::vector<std::vector<double> > sumPhi, sumdPhi;
+    for(size_t c=0; c<comps.size(); c++) {
+        std::vector<std::vector<double> > Phi, dPhi;
+        dynamic_cast<const Multipole&>(*comps[c]).getCoefs(radii, Phi, dPhi);
+        // the index of each (l,m) term is the same regardless of lmax, so that the arrays with
+        // smaller lmax just need to be padded to the largest size
+        if(sumPhi.size() < Phi.size()) {
+            sumPhi. resize(Phi.size());
+            sumdPhi.resize(Phi.size());
+        }
+        for(size_t i=0; i<Phi.size(); i++) {
+            addArray(Phi [i], sumPhi [i]);
+            addArray(dPhi[i], sumdPhi[i]);
+        }
+    }
+    for(size_t i=0; i<sumPhi.size(); i++) {
+        if(sumPhi [i].empty()) sumPhi [i].assign(radii.size(), 0.);
+        if(sumdPhi[i].empty()) sumdPhi[i].assign(radii.size(), 0.);
+    }
+    return PtrPotential(new Multipole(radii, sumPhi, sumdPhi));
+}
+
+/// sum up several CylSpline potentials with identical grids
+PtrPotential sumCylSpline(const std::vector<PtrPotential>& comps)
+{
+    std::vector<double> gridR, gridz;
+    std::vector<math::Matrix<double> > sumPhi, sumdPhidR, sumdPhidz;
+    bool useDerivs = true;
+    int mmax = 0;
+    for(size_t c=0; c<comps.size(); c++) {
+        std::vector<math::Matrix<double> > Phi, dPhidR, dPhidz;
+        dynamic_cast<const CylSpline&>(*comps[c]).getCoefs(gridR, gridz, Phi, dPhidR, dPhidz);
+        useDerivs &= !dPhidR.empty() && !dPhidz.empty();
+        int mmaxc = Phi.size() / 2;
+        if(mmaxc > mmax) {
+            // re-center the accumulated arrays (the m=0 term is stored at index mmax)
+            std::vector<math::Matrix<double> > tmpPhi(2*mmaxc+1), tmpdPhidR(2*mmaxc+1), tmpdPhidz(2*mmaxc+1);
+            for(size_t i=0; i<sumPhi.size(); i++) {
+                tmpPhi   [i+mmaxc-mmax] = sumPhi[i];
+                if(i<sumdPhidR.size()) tmpdPhidR[i+mmaxc-mmax] = sumdPhidR[i];
+                if(i<sumdPhidz.size()) tmpdPhidz[i+mmaxc-mmax] = sumdPhidz[i];
+            }
+            sumPhi.swap(tmpPhi);
+            sumdPhidR.swap(tmpdPhidR);
+            sumdPhidz.swap(tmpdPhidz);
+            mmax = mmaxc;
+        }
+        if(sumPhi.empty()) {
+            sumPhi.resize(1);
+            sumdPhidR.resize(1);
+            sumdPhidz.resize(1);
+        }
+        for(size_t i=0; i<Phi.size(); i++) {
+            addArray(Phi[i], sumPhi[i+mmax-mmaxc]);
+            if(i<dPhidR.size()) addArray(dPhidR[i], sumdPhidR[i+mmax-mmaxc]);
+            if(i<dPhidz.size()) addArray(dPhidz[i], sumdPhidz[i+mmax-mmaxc]);
+        }
+    }
+    if(!useDerivs) {   // at least one component was constructed without derivatives
+        sumdPhidR.clear();
+        sumdPhidz.clear();
+    } else {
+        // the set of non-empty terms in derivative arrays must be the same as in Phi
+        for(size_t i=0; i<sumPhi.size(); i++)
+            if(sumPhi[i].size() != 0) {
+                if(sumdPhidR[i].size() == 0)
+                    sumdPhidR[i] = math::Matrix<double>(sumPhi[i].rows(), sumPhi[i].cols(), 0.);
+                if(sumdPhidz[i].size() == 0)
+                    sumdPhidz[i] = math::Matrix<double>(sumPhi[i].rows(), sumPhi[i].cols(), 0.);
+            }
+    }
+    return PtrPotential(new CylSpline(gridR, gridz, sumPhi, sumdPhidR, sumdPhidz));
+}
+
+/// re-expand the sum of several Multipole potentials with different grids into a new one
+PtrPotential resampleMultipole(const std::vector<PtrPotential>& comps)
+{
+    int lmax = 0, mmax = 0;
+    double rmin = INFINITY, rmax = 0, minLogStep = INFINITY;
+    for(size_t c=0; c<comps.size(); c++) {
+        std::vector<double> radii;
+        std::vector<std::vector<double> > Phi, dPhi;
+        dynamic_cast<const Multipole&>(*comps[c]).getCoefs(radii, Phi, dPhi);
+        for(int l=0; (l+1)*(l+1) <= (int)Phi.size(); l++)
+            for(int m=-l; m<=l; m++) {
+                const std::vector<double>& coefs = Phi[l*(l+1)+m];
+                for(size_t i=0; i<coefs.size(); i++)
+                    if(coefs[i] != 0) {
+                        lmax = std::max(lmax, l);
+                        mmax = std::max(mmax, abs(m));
+                        break;
+                    }
+            }
+        rmin = std::min(rmin, radii.front());
+        rmax = std::max(rmax, radii.back());
+        minLogStep = std::min(minLogStep, log(radii.back() / radii.front()) / (radii.size()-1));
+    }
+    // the new grid has the same resolution as the finest of the input grids
+    unsigned int gridSize = static_cast<unsigned int>(ceil(log(rmax / rmin) / minLogStep)) + 1;
+    return Multipole::create(Composite(comps), lmax, mmax, gridSize, rmin, rmax);
+}
+
+/// re-expand the sum of several CylSpline potentials with different grids into a new one
+PtrPotential resampleCylSpline(const std::vector<PtrPotential>& comps)
+{
+    int mmax = 0;
+    unsigned int gridSizeR = 0, gridSizez = 0;
+    double Rmin = INFINITY, Rmax = 0, zmin = INFINITY, zmax = 0;
+    for(size_t c=0; c<comps.size(); c++) {
+        std::vector<double> gridR, gridz;
+        std::vector<math::Matrix<double> > Phi, dPhidR, dPhidz;
+        dynamic_cast<const CylSpline&>(*comps[c]).getCoefs(gridR, gridz, Phi, dPhidR, dPhidz);
+        mmax = std::max<int>(mmax, Phi.size() / 2);
+        // grid in R starts at 0, and the grid in z either starts at 0 or is symmetric about 0
+        std::vector<double>::const_iterator zpos = std::upper_bound(gridz.begin(), gridz.end(), 0.);
+        if(gridR.size() < 2 || zpos == gridz.end())
+            continue;
+        Rmin = std::min(Rmin, gridR[1]);
+        Rmax = std::max(Rmax, gridR.back());
+        zmin = std::min(zmin, *zpos);
+        zmax = std::max(zmax, gridz.back());
+        gridSizeR = std::max<unsigned int>(gridSizeR, gridR.size());
+        gridSizez = std::max<unsigned int>(gridSizez, gridz.end() - zpos + 1);
+    }
+    if(!(Rmin < INFINITY && zmin < INFINITY))
+        throw std::runtime_error("flattenPotential: cannot determine the grid for resampling "
+            "CylSpline components");
+    return CylSpline::create(Composite(comps), mmax, gridSizeR, Rmin, Rmax, gridSizez, zmin, zmax);
+}
+}  // internal namespace
+
+PtrPotential flattenPotential(const PtrPotential& pot, bool resample)
+{
+    if(!dynamic_cast<const Composite*>(pot.get()))
+        return pot;
+    std::vector<PtrPotential> components, result;
+    collectComponents(pot, components);
+    // groups of Multipole and CylSpline components with identical grids
+    std::vector<std::vector<PtrPotential> > groupsMul, groupsCyl;
+    std::vector<std::vector<double> > gridsMul, gridsCylR, gridsCylz;
+    for(size_t c=0; c<components.size(); c++) {
+        const Multipole* mul = dynamic_cast<const Multipole*>(components[c].get());
+        const CylSpline* cyl = dynamic_cast<const CylSpline*>(components[c].get());
+        std::vector<double> gridR, gridz;
+        std::vector<std::vector<double> > tmp1, tmp2;
+        std::vector<math::Matrix<double> > tmp3, tmp4, tmp5;
+        if(mul) {
+            mul->getCoefs(gridR, tmp1, tmp2);
+            size_t g = 0;
+            while(g < gridsMul.size() && !sameGrid(gridsMul[g], gridR))
+                g++;
+            if(g == gridsMul.size()) {
+                gridsMul.push_back(gridR);
+                groupsMul.push_back(std::vector<PtrPotential>());
+            }
+            groupsMul[g].push_back(components[c]);
+        } else if(cyl) {
+            cyl->getCoefs(gridR, gridz, tmp3, tmp4, tmp5);
+            size_t g = 0;
+            while(g < gridsCylR.size() && !(sameGrid(gridsCylR[g], gridR) && sameGrid(gridsCylz[g], gridz)))
+                g++;
+            if(g == gridsCylR.size()) {
+                gridsCylR.push_back(gridR);
+                gridsCylz.push_back(gridz);
+                groupsCyl.push_back(std::vector<PtrPotential>());
+            }
+            groupsCyl[g].push_back(components[c]);
+        } else
+            result.push_back(components[c]);
+    }
+    std::vector<PtrPotential> summedMul, summedCyl;
+    for(size_t g=0; g<groupsMul.size(); g++)
+        summedMul.push_back(groupsMul[g].size() == 1 ? groupsMul[g][0] : sumMultipole(groupsMul[g]));
+    for(size_t g=0; g<groupsCyl.size(); g++)
+        summedCyl.push_back(groupsCyl[g].size() == 1 ? groupsCyl[g][0] : sumCylSpline(groupsCyl[g]));
+    if(resample && summedMul.size() > 1)
+        summedMul.assign(1, resampleMultipole(summedMul));
+    if(resample && summedCyl.size() > 1)
+        summedCyl.assign(1, resampleCylSpline(summedCyl));
+    // the expansions go first, followed by the remaining components
+    result.insert(result.begin(), summedCyl.begin(), summedCyl.end());
+    result.insert(result.begin(), summedMul.begin(), summedMul.end());
+    utils::msg(utils::VL_DEBUG, "flattenPotential", "Reduced the number of components from "+
+        utils::toString((unsigned int)components.size())+" to "+utils::toString((unsigned int)result.size()));
+    if(result.size() == 1)
+        return result[0];
+    return createComposite(result);
+}
+
 }  // namespace potential
@@ -268,6 +268,25 @@ inline bool writePotential(
     return writeDensity(fileName, potential, converter); }
 
 
+/** Fold the components of a composite potential into a smaller number of expansions.
+    All `Multipole` components that share the same radial grid are summed up into a single
+    `Multipole` (the orders of expansion may differ, the result has the largest of them),
+    and all `CylSpline` components with identical grids in R and z are summed into a single
+    `CylSpline`; this is exact up to the interpolation accuracy, since the coefficients of
+    these expansions are linear in the potential.
+    Nested composite potentials are expanded first; all other components (e.g., analytic
+    potentials or `DiskAnsatz`, which are cheap to evaluate) are retained as they are.
+    \param[in] pot  is the input potential; if it is not composite, it is returned unchanged;
+    \param[in] resample  if true, Multipole or CylSpline components with different grids are
+    also combined into a single expansion, by constructing a new one from the sum of these
+    components on a grid covering the union of their extents (this is approximate and costs
+    some time to construct); if false, only components with identical grids are combined.
+    \return    a new composite potential with fewer components, or a single potential
+    if only one component remains.
+*/
+PtrPotential flattenPotential(const PtrPotential& pot, bool resample=false);
+
+
 /** return the symmetry type encoded in the string.
     Spherical, Axisymmetric, Triaxial and None are recognized by the first letter,
     whereas other types must be given by their numerical code.
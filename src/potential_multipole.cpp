@@ -3,6 +3,7 @@
 #include "math_specfunc.h"
 #include "math_spline.h"
 #include "utils.h"
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <cmath>
@@ -50,6 +51,14 @@ static const double SAFETY_FACTOR = 100*DBL_EPSILON;
 /// eliminate multipole terms whose relative amplitude is less than this number
 static const double EPS_COEF = 1e-10;
 
+/// number of particles in one block processed by a single thread when accumulating
+/// the statistics for the radial fits from an N-body snapshot
+static const ptrdiff_t PARTICLE_BLOCK_SIZE = 16384;
+
+/// number of blocks processed in parallel before their statistics are merged (in a fixed order,
+/// so that the result does not depend on the number of threads)
+static const int PARTICLE_BLOCKS_PER_ROUND = 64;
+
 // Helper function to deduce symmetry from the list of non-zero coefficients;
 // combine the array of coefficients at different radii into a single array
 // and then call the corresponding routine from math::.
@@ -196,70 +205,130 @@ void computeSphHarmCoefs(const BaseDensityOrPotential& src,
     }
 }
 
-// transform an N-body snapshot to an array of spherical-harmonic coefficients:
-// for each k-th particle, the array of sph.-harm. functions Y_lm(theta_k, phi_k)
-// is stored in the output array with the following indexing scheme:
-// C_lm(particle_k) = coefs[SphHarmIndices::index(l,m)][k].
-// This saves memory, since only the arrays for harmonic coefficients allowed
-// by the indexing scheme are allocated and returned.
-void computeSphericalHarmonicsFromParticles(
-    const particles::ParticleArray<coord::PosCyl> &particles,
-    const math::SphHarmIndices &ind,
-    std::vector<double> &particleRadii,
-    std::vector< std::vector<double> > &coefs)
+// compute the spherical-harmonic functions Y_lm(theta_k, phi_k) at the position of each particle,
+// one at a time, so that the memory usage does not depend on the number of particles
+class SphHarmParticleEvaluator {
+    const math::SphHarmIndices& ind;
+    const bool needSine;
+    std::vector<double> tmp;  ///< temporary arrays for Legendre and trigonometric functions
+public:
+    explicit SphHarmParticleEvaluator(const math::SphHarmIndices& _ind) :
+        ind(_ind), needSine(ind.mmin()<0), tmp(ind.lmax+2+2*ind.mmax)
+    {
+        tmp[ind.lmax+1] = 1.;  // stores cos(0*phi), which is not computed by trigMultiAngle
+    }
+
+    /** compute the sph.-harm. functions for one particle and store them in the output array
+        with the following indexing scheme: C_lm = output[SphHarmIndices::index(l,m)]
+        (only the elements allowed by the indexing scheme are assigned);
+        \return  the spherical radius of the particle */
+    double operator()(const coord::PosCyl& pos, double output[])
+    {
+        double *leg = &tmp[0], *trig = leg + ind.lmax+1;
+        double r   = sqrt(pow_2(pos.R) + pow_2(pos.z));
+        double tau = pos.z / (r + pos.R);
+        math::trigMultiAngle(pos.phi, ind.mmax, needSine, trig+1 /* start from m=1 */);
+        for(int m=0; m<=ind.mmax; m++) {
+            double mult = 2*M_SQRTPI * (m==0 ? 1 : M_SQRT2);
+            math::sphHarmArray(ind.lmax, m, tau, leg);
+            for(int l=ind.lmin(m); l<=ind.lmax; l+=ind.step)
+                output[ind.index(l, m)] = mult * leg[l-m] * trig[m];
+            if(needSine && m>0)
+                for(int l=ind.lmin(-m); l<=ind.lmax; l+=ind.step)
+                    output[ind.index(l, -m)] = mult * leg[l-m] * trig[ind.mmax+m];
+        }
+        return r;
+    }
+};
+
+// obtain the list of nontrivial l>0 harmonics allowed by the indexing scheme
+// (TODO: this should be made part of math::SphHarmIndices interface!)
+std::vector<unsigned int> nonzeroHarmonics(const math::SphHarmIndices& ind)
 {
-    // allocate space for non-trivial harmonics only (depending on the symmetry)
-    ptrdiff_t nbody = particles.size();
-    particleRadii.resize(nbody);
-    coefs.resize(ind.size());
+    std::vector<bool> used(ind.size(), false);
     for(int m=ind.mmin(); m<=ind.mmax; m++)
         for(int l=ind.lmin(m); l<=ind.lmax; l+=ind.step)
-            coefs[ind.index(l, m)].resize(nbody);
-    bool needSine = ind.mmin()<0;
+            used[ind.index(l, m)] = true;
+    std::vector<unsigned int> result;
+    for(unsigned int c=1; c<ind.size(); c++)
+        if(used[c])
+            result.push_back(c);
+    return result;
+}
+
+// accumulate the sufficient statistics for the radial fits of sph.-harm. terms of an N-body snapshot:
+// the l=0 term is represented by a penalized log-density estimate in log(r) (dataLogDens),
+// and the l>0 terms are fitted by penalized splines in log(r) to the values of Y_lm of particles
+// weighted by their masses (dataHarm, one data set per each element of nonzeroCoefs).
+// Particles are processed in blocks in parallel, and the memory usage is independent of their number.
+void accumulateSphHarmStatistics(
+    const particles::ParticleArray<coord::PosCyl> &particles,
+    const math::SphHarmIndices &ind,
+    const std::vector<unsigned int> &nonzeroCoefs,
+    math::SplineLogDensityData<3> &dataLogDens,
+    math::SplineApproxData &dataHarm)
+{
+    const ptrdiff_t nbody = particles.size();
+    const unsigned int numHarm = nonzeroCoefs.size();
     std::string errorMsg;
     utils::CtrlBreakHandler cbrk;  // catch Ctrl-Break keypress
     bool stop = false;
+    const math::SplineLogDensityData<3> emptyLogDens(dataLogDens.grid, dataLogDens.options);
+    const math::SplineApproxData emptyHarm(dataHarm.grid, numHarm);
+    for(ptrdiff_t roundStart=0; roundStart<nbody && !stop; roundStart +=
+        PARTICLE_BLOCK_SIZE * PARTICLE_BLOCKS_PER_ROUND)
+    {
+        int numBlocks = std::min<ptrdiff_t>(PARTICLE_BLOCKS_PER_ROUND,
+            (nbody - roundStart + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE);
+        std::vector<math::SplineLogDensityData<3> > blockLogDens(numBlocks, emptyLogDens);
+        std::vector<math::SplineApproxData> blockHarm(numBlocks, emptyHarm);
 #ifdef _OPENMP
 #pragma omp parallel
 #endif
-    {
-        // thread-local temporary arrays for Legendre and trigonometric functions
-        std::vector<double> tmp(ind.lmax+2+2*ind.mmax);
-        double *leg = &tmp[0], *trig = leg + ind.lmax+1;
-        trig[0] = 1.;  // stores cos(0*phi), which is not computed by trigMultiAngle
+        {
+            SphHarmParticleEvaluator evaluator(ind);
+            std::vector<double> coefs(ind.size()), yvalues(numHarm+1);
 #ifdef _OPENMP
-#pragma omp for schedule(static)
+#pragma omp for schedule(dynamic)
 #endif
-        for(ptrdiff_t i=0; i<nbody; i++) {
-            if(stop) continue;
-            if(cbrk.triggered()) stop = true;
-            // compute Y_lm for each particle
-            try{
-                const coord::PosCyl& pos = particles.point(i);
-                double r   = sqrt(pow_2(pos.R) + pow_2(pos.z));
-                double tau = pos.z / (r + pos.R);
-                particleRadii[i] = r;
-                math::trigMultiAngle(pos.phi, ind.mmax, needSine, trig+1 /* start from m=1 */);
-                for(int m=0; m<=ind.mmax; m++) {
-                    double mult = 2*M_SQRTPI * (m==0 ? 1 : M_SQRT2);
-                    math::sphHarmArray(ind.lmax, m, tau, leg);
-                    for(int l=ind.lmin(m); l<=ind.lmax; l+=ind.step)
-                        coefs[ind.index(l, m)][i] = mult * leg[l-m] * trig[m];
-                    if(needSine && m>0)
-                        for(int l=ind.lmin(-m); l<=ind.lmax; l+=ind.step)
-                            coefs[ind.index(l, -m)][i] = mult * leg[l-m] * trig[ind.mmax+m];
+            for(int b=0; b<numBlocks; b++) {
+                if(stop) continue;
+                if(cbrk.triggered()) stop = true;
+                try{
+                    ptrdiff_t iend = std::min(nbody, roundStart + (b+1) * PARTICLE_BLOCK_SIZE);
+                    for(ptrdiff_t i = roundStart + b * PARTICLE_BLOCK_SIZE; i < iend; i++) {
+                        double mass = particles.mass(i), r = evaluator(particles.point(i), &coefs[0]);
+                        for(unsigned int h=0; h<numHarm; h++)
+                            yvalues[h] = coefs[nonzeroCoefs[h]];
+                        if(mass == 0) {   // particles with zero mass are ignored in the fits
+                            blockLogDens[b].add(0, 0);
+                            blockHarm[b].add(0, 0, &yvalues[0]);
+                            continue;
+                        }
+                        if(r == 0)
+                            throw std::runtime_error("no massive particles at r=0 allowed");
+                        double logr = log(r);
+                        blockLogDens[b].add(logr, mass);
+                        blockHarm[b].add(logr, mass, &yvalues[0]);
+                    }
+                }
+                catch(std::exception& e) {
+                    errorMsg = e.what();
+                    stop = true;
                 }
-            }
-            catch(std::exception& e) {
-                errorMsg = e.what();
-                stop = true;
             }
         }
+        // merge the statistics of all blocks in a fixed order
+        if(!stop)
+            for(int b=0; b<numBlocks; b++) {
+                dataLogDens.add(blockLogDens[b]);
+                dataHarm.add(blockHarm[b]);
+            }
     }
     if(cbrk.triggered())
         throw std::runtime_error("Keyboard interrupt");
     if(!errorMsg.empty())
-        throw std::runtime_error("computeSphericalHarmonicsFromParticles: " + errorMsg);
+        throw std::runtime_error("computeDensityCoefsSph: " + errorMsg);
 }
 
 
@@ -746,24 +815,16 @@ void computeDensityCoefsSph(
         gridLogRadii[i] = log(gridRadii[i]);
     coefs.assign(ind.size(), std::vector<double>(gridSizeR, 0.));
 
-    // compute the sph-harm coefs at each particle's radius
-    std::vector<std::vector<double> > harmonics(ind.size());
-    std::vector<double> particleRadii;
-    computeSphericalHarmonicsFromParticles(particles, ind, particleRadii, harmonics);
-    size_t nbody = particleRadii.size();
-
-    // convert the radii to log-radii and store particle masses in the {l=0,m=0} harmonic
-    for(size_t i=0; i<nbody; i++) {
-        if((harmonics[0][i] = particles.mass(i)) == 0) continue;   // ignore particles with zero mass
-        if(particleRadii[i] == 0)
-            throw std::runtime_error("computeDensityCoefsSph: no massive particles at r=0 allowed");
-        particleRadii[i] = log(particleRadii[i]);
-    }
+    // accumulate the statistics needed for the radial fits of all harmonic terms in a single pass
+    std::vector<unsigned int> nonzeroCoefs = nonzeroHarmonics(ind);
+    int nonzeroCoefsSize = nonzeroCoefs.size();
+    math::SplineLogDensityData<3> dataLogDens(gridLogRadii,
+        math::FitOptions(math::FO_INFINITE_LEFT | math::FO_INFINITE_RIGHT | math::FO_PENALTY_3RD_DERIV));
+    math::SplineApproxData dataHarm(gridLogRadii, nonzeroCoefsSize);
+    accumulateSphHarmStatistics(particles, ind, nonzeroCoefs, dataLogDens, dataHarm);
 
     // construct the l=0 harmonic using a penalized log-density estimate
-    math::CubicSpline spl0(gridLogRadii, math::splineLogDensity<3>(
-        gridLogRadii, particleRadii, /*weights*/harmonics[0],
-        math::FitOptions(math::FO_INFINITE_LEFT | math::FO_INFINITE_RIGHT | math::FO_PENALTY_3RD_DERIV)));
+    math::CubicSpline spl0(gridLogRadii, math::splineLogDensity<3>(dataLogDens));
     for(unsigned int k=0; k<gridSizeR; k++)
         coefs[0][k] = exp(spl0(gridLogRadii[k])) / (4*M_PI*pow_3(gridRadii[k]));
     if(utils::verbosityLevel >= utils::VL_DEBUG) {
@@ -776,24 +837,16 @@ void computeDensityCoefsSph(
             "Power-law index of density profile: inner="+utils::toString(innerSlope)+
             ", outer="+utils::toString(outerSlope));
     }
-    if(ind.size()==1)
+    if(nonzeroCoefsSize==0)
         return;
 
-    // obtain the list of nontrivial l>0 harmonics
-    // (TODO: this should be made part of math::SphHarmIndices interface!)
-    std::vector<unsigned int> nonzeroCoefs;
-    for(unsigned int c=1; c<ind.size(); c++)
-        if(!harmonics[c].empty())
-            nonzeroCoefs.push_back(c);
-    int nonzeroCoefsSize = nonzeroCoefs.size();
-
     // construct the l>0 terms by fitting a penalized smoothing spline,
     // where the penalty is given for "wiggliness" of the curve.
     // The amount of smoothing is specified through the number of "equivalent degrees of freedom" (EDF),
     // which ranges between 2 (infinite penalty resulting in a straight-line fit)
     // to gridSizeR for the case of zero penalty.
     // we set edf roughly half-way between the two extremes for the default value of smoothing=1
-    math::SplineApprox fitter(gridLogRadii, particleRadii, /*weights*/harmonics[0]);
+    math::SplineApprox fitter(dataHarm);
     double edf = 2 + (gridSizeR-2) / (smoothing+1);
     std::string errorMsg;
     utils::CtrlBreakHandler cbrk;  // catch Ctrl-Break keypress
@@ -805,7 +858,7 @@ void computeDensityCoefsSph(
         if(stop) continue;
         if(cbrk.triggered()) stop = true;
         try{
-            math::CubicSpline splc(gridLogRadii, fitter.fit(harmonics[nonzeroCoefs[h]], edf));
+            math::CubicSpline splc(gridLogRadii, fitter.fit(/*dataSet*/ (unsigned int)h, edf));
             // multiply the coefs by the value of the l=0 term (which is the spherical density estimate)
             for(unsigned int k=0; k<gridSizeR; k++)
                 coefs[nonzeroCoefs[h]][k] = splc(gridLogRadii[k]) * coefs[0][k];
@@ -1159,7 +1212,8 @@ public:
     MultipoleInterp2d(
         const std::vector<double> &radii,
         const std::vector<std::vector<double> > &Phi,
-        const std::vector<std::vector<double> > &dPhi);
+        const std::vector<std::vector<double> > &dPhi,
+        bool singlePrecision=false);
     virtual coord::SymmetryType symmetry() const { return ind.symmetry(); }
     virtual const char* name() const { return "MultipoleInterp2d"; }
 private:
@@ -1267,7 +1321,8 @@ PtrPotential Multipole::create(
 Multipole::Multipole(
     const std::vector<double> &_gridRadii,
     const std::vector<std::vector<double> > &Phi,
-    const std::vector<std::vector<double> > &dPhi) :
+    const std::vector<std::vector<double> > &dPhi,
+    bool singlePrecision) :
     gridRadii(_gridRadii), ind(getIndicesFromCoefs(Phi, dPhi))
 {
     unsigned int gridSizeR = gridRadii.size();
@@ -1284,7 +1339,7 @@ Multipole::Multipole(
     // choose between 1d or 2d splines, depending on the expected efficiency
     impl = ind.lmax <= LMAX_1D_SPLINE ?
         PtrPotential(new MultipoleInterp1d(gridRadii, Phi, dPhi)) :
-        PtrPotential(new MultipoleInterp2d(gridRadii, Phi, dPhi));
+        PtrPotential(new MultipoleInterp2d(gridRadii, Phi, dPhi, singlePrecision));
 
     // determine asymptotic behaviour at small and large radii
     asymptInner = initAsympt(gridRadii, Phi, dPhi, true);
@@ -1619,7 +1674,8 @@ std::vector<double> createGridInTau(unsigned int lmax)
 MultipoleInterp2d::MultipoleInterp2d(
     const std::vector<double> &radii,
     const std::vector< std::vector<double> > &Phi,
-    const std::vector< std::vector<double> > &dPhi) :
+    const std::vector< std::vector<double> > &dPhi,
+    bool singlePrecision) :
     ind(getIndicesFromCoefs(Phi, dPhi)),
     logScaling(true)
 {
@@ -1656,6 +1712,7 @@ MultipoleInterp2d::MultipoleInterp2d(
 
     // loop over azimuthal harmonic indices (m)
     spl.resize(2*ind.mmax+1);
+    double maxError = 0;  // relative error introduced by storing the coefficients in single precision
     for(int mm=0; mm<=ind.mmax-ind.mmin(); mm++) {
         // this weird order ensures that we first process the m=0 term even if there are m<0 terms
         int m = mm<=ind.mmax ? mm : ind.mmax-mm;
@@ -1727,7 +1784,12 @@ MultipoleInterp2d::MultipoleInterp2d(
 
         // establish 2D quintic spline for Phi_m(ln(r), tau)
         spl[m+ind.mmax] = math::QuinticSpline2d(gridR, gridT, Phi_val, Phi_dR, Phi_dT, Phi_dRdT);
+        if(singlePrecision)
+            maxError = std::max(maxError, spl[m+ind.mmax].reducePrecision());
     }
+    if(singlePrecision)
+        utils::msg(utils::VL_DEBUG, "Multipole",
+            "Single-precision storage of coefficients: max relative error=" + utils::toString(maxError));
 }
 
 void MultipoleInterp2d::evalCyl(const coord::PosCyl &pos,
@@ -1761,12 +1823,18 @@ void MultipoleInterp2d::evalCyl(const coord::PosCyl &pos,
     coord::GradSph trGrad;
     coord::HessSph trHess;
 
+    // all harmonics share the same grid, so the cell found for the first one is reused for others,
+    // and if an orbit integrator is active, the search starts from the cell found at its previous step
+    math::CellHintCache* hints = math::CellHintCache::active();
+    math::CellHint2d localHint;
+    math::CellHint2d& hint = hints ? hints->get(this) : localHint;
+
     // compute azimuthal harmonics
     for(int mm=0; mm<nm; mm++) {
         int m = mm + mmin;
         if(ind.lmin(m) > ind.lmax)
             continue;
-        spl[m+ind.mmax].evalDeriv(logr, tau, &Phi[mm],
+        spl[m+ind.mmax].evalDeriv(logr, tau, hint, &Phi[mm],
             numQuantities>=3 ? &dlnr    [mm] : NULL,
             numQuantities>=3 ? &dtau    [mm] : NULL,
             numQuantities==6 ? &dlnr2   [mm] : NULL,
@@ -1922,13 +1990,13 @@ void computePotentialCoefsBSE(
         }
     }
 
-    // 2nd step: compute the spherical-harmonic coefficients at each particle's radius
-    std::vector<std::vector<double> > harmonics(ind.size());
-    std::vector<double> particleRadii;
-    computeSphericalHarmonicsFromParticles(particles, ind, particleRadii, harmonics);
-    ptrdiff_t nbody = particleRadii.size();
-
-    // 3rd step: compute the radial basis-set expansion coefs for each angular harmonic
+    // 2nd step: compute the radial basis-set expansion coefs for each angular harmonic,
+    // evaluating the spherical-harmonic functions at each particle's position on the fly
+    ptrdiff_t nbody = particles.size();
+    std::vector<bool> usedCoefs(ind.size(), false);
+    for(int m=ind.mmin(); m<=ind.mmax; m++)
+        for(int l=ind.lmin(m); l<=ind.lmax; l+=ind.step)
+            usedCoefs[ind.index(l, m)] = true;
     int mstep = (ind.symmetry() & coord::ST_TRIAXIAL) == coord::ST_TRIAXIAL ? 2 : 1;
     bool oddl = (ind.symmetry() & coord::ST_REFLECTION) != coord::ST_REFLECTION;  // use odd l?
 
@@ -1940,8 +2008,10 @@ void computePotentialCoefsBSE(
 #pragma omp parallel
 #endif
     {
-        // thread-local temporary arrays for expansion coefs
+        // thread-local temporary arrays for expansion coefs and sph.-harm. functions of one particle
         std::vector<std::vector<double> > thread_coefs(ind.size(), std::vector<double>(nmax+1, 0.));
+        std::vector<double> harmonics(ind.size());
+        SphHarmParticleEvaluator evaluator(ind);
 #ifdef _OPENMP
 #pragma omp for schedule(static)
 #endif
@@ -1949,7 +2019,7 @@ void computePotentialCoefsBSE(
             if(stop) continue;
             if(cbrk.triggered()) stop = true;
             try{
-                double r = sqrt(pow_2(particles.point(i).R) + pow_2(particles.point(i).z)),
+                double r = evaluator(particles.point(i), &harmonics[0]),
                 s = r / r0,
                 s1eta = math::pow(s, 1/eta),
                 xi = (s1eta-1) / (s1eta+1),
@@ -1972,8 +2042,8 @@ void computePotentialCoefsBSE(
                         P = Q;
                         Q = N;
                         for(int c=cmin; c<=cmax; c+=mstep)
-                            if(!harmonics[c].empty())
-                                thread_coefs[c][n] += Pnl * harmonics[c][i];
+                            if(usedCoefs[c])
+                                thread_coefs[c][n] += Pnl * harmonics[c];
                     }
                 }
             }
@@ -210,10 +210,15 @@ public:
                     and the second is the number of radial grid points;
         \param[in]  dPhi  is the matrix of radial derivatives of harmonic coefs
                     (same size as Phi, each element is  d Phi_{l,m}(r) / dr ).
+        \param[in]  singlePrecision  (optional, default false) whether to store the coefficients
+                    of interpolating splines in single precision, halving their memory footprint;
+                    this only applies to the 2d splines used for lmax>2, and the introduced relative
+                    error (typically ~1e-7) is reported in the debug log.
     */
     Multipole(const std::vector<double> &radii,
         const std::vector<std::vector<double> > &Phi,
-        const std::vector<std::vector<double> > &dPhi);
+        const std::vector<std::vector<double> > &dPhi,
+        bool singlePrecision=false);
 
     /** return the array of spherical-harmonic expansion coefficients.
         \param[out] radii will contain the radii of grid nodes;
@@ -317,6 +317,16 @@ std::vector<double> createInterpolationGrid(const BasePotential& potential, doub
     return grid;
 }
 
+bool sameGrid(const std::vector<double>& grid1, const std::vector<double>& grid2)
+{
+    if(grid1.size() != grid2.size())
+        return false;
+    for(size_t i=0; i<grid1.size(); i++)
+        if(!(fabs(grid1[i] - grid2[i]) <= 1e-12 * fmax(fabs(grid1[i]), fabs(grid2[i]))))
+            return false;
+    return true;
+}
+
 double v_circ(const math::IFunction& potential, double radius)
 {
     if(radius==0)
@@ -138,6 +138,14 @@ void findRoots(const BasePotential& potential, double E,
 */
 std::vector<double> createInterpolationGrid(const BasePotential& potential, double accuracy);
 
+/** Check if two grids of potential expansions coincide up to roundoff errors
+    (the grids of CylSpline are reconstructed from scaled coordinates, so they may differ
+    in the last bits even if created with the same parameters).
+    \param[in]  grid1, grid2  are the two grids;
+    \return  true if they have the same size and all nodes agree to a relative accuracy 1e-12.
+*/
+bool sameGrid(const std::vector<double>& grid1, const std::vector<double>& grid2);
+
 
 /** Interpolator class for faster evaluation of potential and related quantities --
     radius and angular momentum of a circular orbit as functions of energy,
@@ -55,6 +55,7 @@
 #include "units.h"
 #include "utils.h"
 #include "utils_config.h"
+#include "utils_counters.h"
 // text string embedded into the python module as the __version__ attribute
 #define AGAMA_VERSION "1.0 compiled on " __DATE__
 
@@ -307,6 +308,282 @@ inline DataType& pyArrayElem(void* arr, npy_intp ind1, npy_intp ind2, npy_intp i
     return *static_cast<DataType*>(PyArray_GETPTR3(static_cast<PyArrayObject*>(arr), ind1, ind2, ind3));
 }
 
+/** Helper class for calling a user-defined Python function of one argument - a 2d array of
+    shape (N, numVars) - returning an array of N values; used by various wrapper classes that provide
+    the C++ interface for Python functions (density, potential, distribution function, etc.).
+    The Python interpreter may execute only one call at a time, so when the function is evaluated
+    by many OpenMP threads simultaneously, the calls are serialized, and each one pays a fixed
+    overhead of the Python call, which is significant if each thread provides only a few points.
+    To reduce this overhead, the requests from all threads are coalesced: the thread that finds
+    no call in progress takes all pending requests accumulated so far, concatenates their input
+    points into a single array, makes one Python call, and scatters the results back to the
+    requesting threads, which meanwhile wait for the completion of their request.
+    Thus with many threads, while one call is being executed, the requests from other threads
+    pile up and are then processed by a single call, so that the number of calls is much smaller
+    than the number of requests, and the cost is dominated by the vectorized computation inside
+    the Python function rather than the fixed overhead.
+    If the combined call fails (the function raised an exception, or returned a value of a wrong
+    type or shape, e.g. a single number, which is allowed only for a single input point),
+    the requests of this batch are repeated one by one, so that each request has the same outcome
+    as it would have without coalescing, and an error in one of them does not affect the others.
+*/
+class PythonFunctionCaller {
+public:
+    /// status of the call
+    enum Status {
+        CALL_OK,         ///< the call succeeded
+        CALL_FAILED,     ///< the Python function raised an exception
+        CALL_TYPEERROR   ///< the returned value has incorrect type or shape
+    };
+
+    /** create the caller for the given Python function of numVars variables; if allowBool is true,
+        the function may return an array of booleans, otherwise only floats are accepted.
+        The reference count of the function is not modified, so it must be kept by the owner */
+    PythonFunctionCaller(PyObject* _fnc, unsigned int _numVars, bool _allowBool) :
+        fnc(_fnc), numVars(_numVars), allowBool(_allowBool), busy(false)
+    {
+#ifdef _OPENMP
+        omp_init_lock(&queueLock);
+        omp_init_lock(&callLock);
+#pragma omp atomic
+#endif
+        numInstances++;
+    }
+
+    ~PythonFunctionCaller()
+    {
+#ifdef _OPENMP
+        omp_destroy_lock(&queueLock);
+        omp_destroy_lock(&callLock);
+#pragma omp atomic
+#endif
+        numInstances--;
+    }
+
+    /** number of existing instances of this class, i.e. user-defined Python functions that may be
+        called from the C++ code; it is modified and read only through atomic operations,
+        since the callers may be created and destroyed while another thread has released the GIL */
+    static int numInstances;
+
+    /** evaluate the function at npoints input points:
+        input is the flattened array of size npoints*numVars, values receives npoints output values;
+        may be called from any thread, and returns only after the request has been completed.
+    */
+    Status call(size_t npoints, const double input[], double values[]) const
+    {
+        Request req(npoints, input, values);
+#ifdef _OPENMP
+        if(omp_in_parallel()) {
+            omp_set_lock(&queueLock);
+            queue.push_back(&req);
+            while(!req.done) {
+                if(busy) {
+                    // another thread is executing the call: wait until it is finished
+                    // (it holds the callLock until then), and check the status of our request again
+                    omp_unset_lock(&queueLock);
+                    omp_set_lock(&callLock);
+                    omp_unset_lock(&callLock);
+                    omp_set_lock(&queueLock);
+                    continue;
+                }
+                // otherwise become the leader: take all pending requests (including ours) and execute them
+                busy = true;
+                std::vector<Request*> batch;
+                batch.swap(queue);
+                omp_set_lock(&callLock);
+                omp_unset_lock(&queueLock);
+                try{
+                    execute(batch);
+                }
+                catch(std::exception&) {  // should not normally happen, but must not leave the locks held
+                    for(size_t r=0; r<batch.size(); r++)
+                        batch[r]->status = CALL_FAILED;
+                }
+                omp_set_lock(&queueLock);
+                for(size_t r=0; r<batch.size(); r++)
+                    batch[r]->done = true;
+                busy = false;
+                omp_unset_lock(&callLock);
+            }
+            omp_unset_lock(&queueLock);
+            return req.status;
+        }
+#endif
+        // single-threaded case: no need to coalesce the calls
+        std::vector<Request*> batch(1, &req);
+        execute(batch);
+        return req.status;
+    }
+
+private:
+    /// a single request for evaluating the function
+    struct Request {
+        size_t npoints;
+        const double* input;
+        double* values;
+        Status status;
+        bool done;
+        Request(size_t _npoints, const double* _input, double* _values) :
+            npoints(_npoints), input(_input), values(_values), status(CALL_OK), done(false) {}
+    };
+
+    PyObject* fnc;                  ///< the Python function
+    const unsigned int numVars;     ///< number of input variables per point
+    const bool allowBool;           ///< whether the function may return boolean values
+    mutable std::vector<Request*> queue;  ///< pending requests not yet taken by the leader thread
+    mutable bool busy;              ///< whether a call is in progress
+#ifdef _OPENMP
+    mutable omp_lock_t queueLock;   ///< protects the queue and the busy flag
+    mutable omp_lock_t callLock;    ///< held by the leader thread during the call
+#endif
+
+    // the lock objects cannot be copied
+    PythonFunctionCaller(const PythonFunctionCaller&);
+    PythonFunctionCaller& operator=(const PythonFunctionCaller&);
+
+    /// perform a single Python call for all requests in the batch and store the results and status;
+    /// if the combined call fails, repeat it separately for each request
+    void execute(const std::vector<Request*>& batch) const
+    {
+        if(batch.size() == 1) {
+            batch[0]->status = callFunction(batch[0]->npoints, batch[0]->input, batch[0]->values, true);
+            return;
+        }
+        // concatenate the input points of all requests
+        size_t npoints = 0;
+        for(size_t r=0; r<batch.size(); r++)
+            npoints += batch[r]->npoints;
+        std::vector<double> input(npoints * numVars), output(npoints);
+        for(size_t r=0, offset=0; r<batch.size(); offset += batch[r]->npoints * numVars, r++)
+            std::copy(batch[r]->input, batch[r]->input + batch[r]->npoints * numVars,
+                input.begin() + offset);
+        if(callFunction(npoints, &input[0], &output[0], false) == CALL_OK) {
+            // scatter the results back to the requests
+            for(size_t r=0, offset=0; r<batch.size(); offset += batch[r]->npoints, r++) {
+                std::copy(output.begin() + offset, output.begin() + offset + batch[r]->npoints,
+                    batch[r]->values);
+                batch[r]->status = CALL_OK;
+            }
+        } else {
+            for(size_t r=0; r<batch.size(); r++)
+                batch[r]->status = callFunction(
+                    batch[r]->npoints, batch[r]->input, batch[r]->values, true);
+        }
+    }
+
+    /// call the Python function for the given array of points and store the output values;
+    /// if the call raised an exception, its traceback is printed only if printError is true
+    Status callFunction(size_t npoints, const double input[], double values[], bool printError) const
+    {
+        Status status = CALL_OK;
+#ifdef _OPENMP
+#pragma omp critical(PythonAPI)
+#endif
+        {
+            npy_intp dims[]  = { (npy_intp)npoints, numVars };
+            PyObject* args   = PyArray_SimpleNewFromData(2, dims, NPY_DOUBLE, const_cast<double*>(input));
+            PyObject* result = PyObject_CallFunctionObjArgs(fnc, args, NULL);
+            Py_DECREF(args);
+            if(result == NULL) {
+                if(printError)
+                    PyErr_Print();
+                else
+                    PyErr_Clear();
+                status = CALL_FAILED;
+            } else if(PyArray_Check(result) &&
+                PyArray_NDIM((PyArrayObject*)result) == 1 &&
+                PyArray_DIM ((PyArrayObject*)result, 0) == (npy_intp)npoints)
+            {
+                int type = PyArray_TYPE((PyArrayObject*) result);
+                for(size_t p=0; p<npoints; p++) {
+                    switch(type) {
+                        case NPY_DOUBLE: values[p] = pyArrayElem<double>(result, p); break;
+                        case NPY_FLOAT:  values[p] = pyArrayElem<float >(result, p); break;
+                        case NPY_BOOL:   if(allowBool) { values[p] = pyArrayElem<bool>(result, p); break; }
+                        // otherwise fall through to the error case
+                        default: values[p] = NAN; status = CALL_TYPEERROR;
+                    }
+                }
+            }
+            else if(npoints==1 && PyNumber_Check(result)) {
+                // in case of a single input point, the user function might return a single number
+                values[0] = PyFloat_AsDouble(result);
+            }
+            else {
+                status = CALL_TYPEERROR;
+            }
+            Py_XDECREF(result);
+        }
+        return status;
+    }
+};
+int PythonFunctionCaller::numInstances = 0;
+
+/** Lock-type class that releases the global interpreter lock (GIL) for the lifetime of the object,
+    so that other Python threads may run while the C++ code performs lengthy computations.
+    This is done only if there are no user-defined Python functions that the C++ code might need
+    to call (i.e., no instances of PythonFunctionCaller exist), because such calls are made from
+    OpenMP threads that cannot re-acquire the GIL while the thread that started the parallel
+    section keeps holding it; in this case the computation proceeds with the GIL held, as before.
+    The GIL is also kept if the current thread does not hold it (e.g. in nested routines),
+    and always with Python versions older than 3.4 that lack the necessary API.
+    While the GIL is released, the C++ code may not touch any Python objects except through
+    a PythonAPILock (the raw data buffers of NumPy arrays owned by the calling routine are fine).
+*/
+class GILReleaser {
+    PyThreadState* threadState;  ///< saved state of the current thread, or NULL if GIL was not released
+public:
+    GILReleaser() : threadState(NULL)
+    {
+#if PY_VERSION_HEX >= 0x03040000
+        int numCallers;
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+        numCallers = PythonFunctionCaller::numInstances;
+        if(numCallers == 0 && PyGILState_Check())
+            threadState = PyEval_SaveThread();
+#endif
+    }
+    ~GILReleaser()
+    {
+        if(threadState)
+            PyEval_RestoreThread(threadState);
+    }
+    /// whether the GIL was actually released
+    bool released() const { return threadState != NULL; }
+private:
+    GILReleaser(const GILReleaser&);
+    GILReleaser& operator=(const GILReleaser&);
+};
+
+/** Lock-type class that grants the current thread access to the Python C API during a computation
+    that was started by a thread which may have released the GIL (indicated by the argument,
+    see GILReleaser::released()): in this case the GIL is re-acquired for the lifetime of the object.
+    Otherwise the thread that started the computation still holds the GIL, and access from other
+    OpenMP threads must be serialized by the PythonAPI critical section alone.
+    In both cases, the critical section should be entered after constructing this object
+    (acquiring them in the opposite order could lead to a deadlock with another Python thread).
+*/
+class PythonAPILock {
+    const bool acquired;      ///< whether the GIL was acquired by this object
+    PyGILState_STATE state;   ///< state to be restored upon release
+public:
+    explicit PythonAPILock(bool gilReleased) : acquired(gilReleased), state(PyGILState_UNLOCKED)
+    {
+        if(acquired)
+            state = PyGILState_Ensure();
+    }
+    ~PythonAPILock()
+    {
+        if(acquired)
+            PyGILState_Release(state);
+    }
+private:
+    PythonAPILock(const PythonAPILock&);
+    PythonAPILock& operator=(const PythonAPILock&);
+};
+
 /// convert a Python array of floats to std::vector, or return an empty vector in case of error;
 /// if the argument is a string instead of a proper array (e.g. if it comes from an ini file),
 /// it will be parsed as if it were a python expression, like "numpy.linspace(0.,1.,21)"
@@ -748,6 +1025,8 @@ particles::ParticleArray<ParticleT> convertParticles(PyObject* particles_obj)
     and then call its run() method, which returns a Python object containing the results.
     In case of errors during construction (parsing the input or allocating the output),
     no work is done and run() returns NULL, setting a Python exception.
+    The GIL is released during the loop (see GILReleaser), so processPoint() may access
+    the Python C API only through a PythonAPILock constructed with the gilReleased flag.
 */
 class BatchFunction {
 protected:
@@ -757,6 +1036,7 @@ protected:
     npy_intp numPoints;         // number of input points - 0 means a single point, -1 is error
     PyObject* outputObject;     // the Python object returned by the run() method;
                                 // it must be initialized by constructors of derived classes
+    bool gilReleased;           // whether the GIL is released while processing the points
 public:
     /** Constructor of the base class only analyzes the input object, determines the number
         of input points and ensures that the length of each point equals inputLength.
@@ -772,7 +1052,8 @@ public:
         (unless numPoints<0, indicating an error in parsing the input).
     */
     BatchFunction(int inputLength, PyObject* inputObject) :
-        inputPointScalar(NAN), inputArray(NULL), inputBuffer(NULL), numPoints(-1), outputObject(NULL)
+        inputPointScalar(NAN), inputArray(NULL), inputBuffer(NULL), numPoints(-1), outputObject(NULL),
+        gilReleased(false)
     {
         if(inputObject == NULL) {
             PyErr_SetString(PyExc_TypeError, "No input data provided");
@@ -863,19 +1144,21 @@ public:
             return NULL;
         }
 
-        // fast-track for a single input point
+        std::string error;  // store the exception that may occur in the processPoint() function
+        bool interrupted = false;
         if(numPoints <= 1) {
+            // fast-track for a single input point: the GIL is not released,
+            // since the cost of switching threads would exceed the computation itself
             try{
                 processPoint(0);
             }
             catch(std::exception& ex) {
-                Py_DECREF(outputObject);
-                outputObject = NULL;
-                PyErr_SetString(PyExc_RuntimeError, ex.what());
+                error = ex.what();
             }
         } else {
-            std::string error;  // store the exception that may occur in the processPoint() function
             utils::CtrlBreakHandler cbrk;  // catch Ctrl-Break keypress
+            GILReleaser nogil;  // let other Python threads run during the loop
+            gilReleased = nogil.released();
 #ifdef _OPENMP
             if(chunk==0 || numPoints <= abs(chunk))
 #else
@@ -930,17 +1213,17 @@ public:
                 }
             }
 #endif
-            // check for any exceptional circumstances
-            if(cbrk.triggered()) {
-                Py_DECREF(outputObject);
-                outputObject = NULL;
-                PyErr_SetObject(PyExc_KeyboardInterrupt, NULL);
-            }
-            if(!error.empty()) {
-                Py_DECREF(outputObject);
-                outputObject = NULL;
-                PyErr_SetString(PyExc_RuntimeError, error.c_str());
-            }
+            interrupted = cbrk.triggered();
+        }
+        // check for any exceptional circumstances (the GIL is held again at this point)
+        if(interrupted) {
+            Py_DECREF(outputObject);
+            outputObject = NULL;
+            PyErr_SetObject(PyExc_KeyboardInterrupt, NULL);
+        } else if(!error.empty()) {
+            Py_DECREF(outputObject);
+            outputObject = NULL;
+            PyErr_SetString(PyExc_RuntimeError, error.c_str());
         }
         return outputObject;
     }
@@ -1125,8 +1408,10 @@ class DensityWrapper: public potential::BaseDensity{
     PyObject* fnc;
     coord::SymmetryType sym;
     std::string fncname;
+    PythonFunctionCaller caller;
 public:
-    DensityWrapper(PyObject* _fnc, coord::SymmetryType _sym): fnc(_fnc), sym(_sym)
+    DensityWrapper(PyObject* _fnc, coord::SymmetryType _sym):
+        fnc(_fnc), sym(_sym), caller(_fnc, /*numVars*/ 3, /*allowBool*/ false)
     {
         Py_INCREF(fnc);
         fncname = toString(fnc);
@@ -1185,45 +1470,14 @@ public:
         ALLOC(3*npoints, double, xyz)
         for(size_t p=0; p<npoints; p++)
             unconvertPos(pos[p], xyz + p*3);
-        double mult = conv->massUnit / pow_3(conv->lengthUnit);
-        PyObject* result = NULL;
-        bool typeerror   = false;
-#ifdef _OPENMP
-#pragma omp critical(PythonAPI)
-#endif
-        {
-            npy_intp dims[]  = { (npy_intp)npoints, 3};
-            PyObject* args   = PyArray_SimpleNewFromData(2, dims, NPY_DOUBLE, xyz);
-            result = PyObject_CallFunctionObjArgs(fnc, args, NULL);
-            Py_DECREF(args);
-            if(result == NULL) {
-                PyErr_Print();
-            } else if(PyArray_Check(result) &&
-                PyArray_NDIM((PyArrayObject*)result) == 1 &&
-                PyArray_DIM ((PyArrayObject*)result, 0) == (npy_intp)npoints)
-            {
-                int type = PyArray_TYPE((PyArrayObject*) result);
-                for(size_t p=0; p<npoints; p++) {
-                    switch(type) {
-                        case NPY_DOUBLE: values[p] = pyArrayElem<double>(result, p) * mult; break;
-                        case NPY_FLOAT:  values[p] = pyArrayElem<float >(result, p) * mult; break;
-                        default: values[p] = NAN; typeerror = true;
-                    }
-                }
-            }
-            else if(npoints==1 && PyNumber_Check(result)) {
-                // in case of a single input point, the user function might return a single number
-                values[0] = PyFloat_AsDouble(result) * mult;
-            }
-            else {
-                typeerror = true;
-            }
-            Py_XDECREF(result);
-        }
-        if(result == NULL)
+        PythonFunctionCaller::Status status = caller.call(npoints, xyz, values);
+        if(status == PythonFunctionCaller::CALL_FAILED)
             throw std::runtime_error("Call to user-defined density function failed");
-        else if(typeerror)
+        else if(status == PythonFunctionCaller::CALL_TYPEERROR)
             throw std::runtime_error("Invalid data type returned by user-defined density function");
+        double mult = conv->massUnit / pow_3(conv->lengthUnit);
+        for(size_t p=0; p<npoints; p++)
+            values[p] *= mult;
     }
 };
 
@@ -1839,6 +2093,9 @@ static const char* docstringPotential =
     "  mmax=...   order of azimuthal-harmonic expansion (max.index of Fourier coefficient in "
     "phi angle) in Multipole and CylSpline.\n"
     "  smoothing=...   amount of smoothing in Multipole initialized from an N-body snapshot.\n"
+    "  singlePrecision=...   whether to store the spline coefficients of Multipole (with lmax>2) "
+    "and CylSpline in single precision, halving their memory footprint at the expense of "
+    "a relative error ~1e-7 (default False).\n"
     "  nmax=...   order of radial expansion in BasisSet (the number of basis functions is nmax+1).\n"
     "  eta=...    shape parameter of basis functions in BasisSet (default is 1.0, corresponding "
     "to the Hernquist-Ostriker basis set, but values up to 2.0 typically provide better accuracy "
@@ -1893,8 +2150,10 @@ class PotentialWrapper: public potential::BasePotentialCar{
     PyObject* fnc;
     coord::SymmetryType sym;
     std::string fncname;
+    PythonFunctionCaller caller;
 public:
-    PotentialWrapper(PyObject* _fnc, coord::SymmetryType _sym): fnc(_fnc), sym(_sym)
+    PotentialWrapper(PyObject* _fnc, coord::SymmetryType _sym):
+        fnc(_fnc), sym(_sym), caller(_fnc, /*numVars*/ 3, /*allowBool*/ false)
     {
         Py_INCREF(fnc);
         fncname = toString(fnc);
@@ -1946,38 +2205,10 @@ public:
             xyz[d*3+1] = xyz[1] + OFFSETS[d][1] * eps;
             xyz[d*3+2] = xyz[2] + OFFSETS[d][2] * eps;
         }
-        npy_intp dims[]  = {npoints, 3};
-        PyObject *result = NULL;
-        bool typeerror   = false;
-#ifdef _OPENMP
-#pragma omp critical(PythonAPI)
-#endif
-        {
-            PyObject* args = PyArray_SimpleNewFromData(2, dims, NPY_DOUBLE, xyz);
-            result = PyObject_CallFunctionObjArgs(fnc, args, NULL);
-            Py_DECREF(args);
-            if(result == NULL) {
-                PyErr_Print();
-            } else if(PyArray_Check(result) && PyArray_NDIM((PyArrayObject*)result)==1 &&
-                PyArray_DIM((PyArrayObject*)result, 0)==dims[0])
-            {
-                for(int i=0; i<dims[0]; i++) {
-                    switch(PyArray_TYPE((PyArrayObject*) result)) {
-                        case NPY_DOUBLE: val[i] = pyArrayElem<double>(result, i); break;
-                        case NPY_FLOAT:  val[i] = pyArrayElem<float >(result, i); break;
-                        default: typeerror = true;
-                    }
-                }
-            }
-            else if(PyNumber_Check(result) && dims[0]==1)
-                val[0] = PyFloat_AsDouble(result);
-            else
-                typeerror = true;
-            Py_XDECREF(result);
-        }
-        if(result == NULL)
+        PythonFunctionCaller::Status status = caller.call(npoints, xyz, val);
+        if(status == PythonFunctionCaller::CALL_FAILED)
             throw std::runtime_error("Call to user-defined potential function failed");
-        else if(typeerror)
+        else if(status == PythonFunctionCaller::CALL_TYPEERROR)
             throw std::runtime_error("Invalid data type returned by user-defined potential function");
         /*else if(!isFinite(val[0]))
             throw std::runtime_error("Invalid value (" + utils::toString(val[0]) +
@@ -2071,7 +2302,9 @@ potential::PtrPotential Potential_initFromDict(PyObject* namedArgs)
             throw std::invalid_argument("Cannot provide both 'particles' and 'density' arguments");
         if(!params.contains("type"))
             throw std::invalid_argument("Must provide 'type=\"...\"' argument");
-        return potential::createPotential(params, convertParticles<coord::PosCar>(particles_obj), *conv);
+        particles::ParticleArray<coord::PosCar> particles = convertParticles<coord::PosCar>(particles_obj);
+        GILReleaser nogil;  // let other Python threads run while the potential is being constructed
+        return potential::createPotential(params, particles, *conv);
     }
     // check if the list of arguments contains a density object
     // or a string specifying the name of density model
@@ -2087,6 +2320,7 @@ potential::PtrPotential Potential_initFromDict(PyObject* namedArgs)
             if(params.getString("type").empty())
                 throw std::invalid_argument("'type' argument must be provided");
             params.unset("density");
+            GILReleaser nogil;
             return potential::createPotential(params, *dens, *conv);
         } else if(!PyString_Check(dens_obj)) {
             throw std::invalid_argument(
@@ -2103,6 +2337,7 @@ potential::PtrPotential Potential_initFromDict(PyObject* namedArgs)
             if(!params.getString("type").empty()) {
                 // attempt to construct a potential expansion from a user-provided potential model
                 params.unset("potential");
+                GILReleaser nogil;
                 return potential::createPotential(params, *pot, *conv);
             } else
                 // keep the potential as is (a user-defined function)
@@ -2113,6 +2348,7 @@ potential::PtrPotential Potential_initFromDict(PyObject* namedArgs)
                 "(e.g., an instance of Potential class, or a user-defined function of 3 coordinates)");
         }
     }
+    GILReleaser nogil;
     return potential::createPotential(params, *conv);
 }
 
@@ -2121,8 +2357,11 @@ potential::PtrPotential Potential_initFromDict(PyObject* namedArgs)
 potential::PtrPotential Potential_initFromTuple(PyObject* tuple)
 {
     // if we have one string parameter, it could be the name of an INI file
-    if(PyTuple_Size(tuple) == 1 && PyString_Check(PyTuple_GET_ITEM(tuple, 0)))
-        return potential::readPotential(PyString_AsString(PyTuple_GET_ITEM(tuple, 0)), *conv);
+    if(PyTuple_Size(tuple) == 1 && PyString_Check(PyTuple_GET_ITEM(tuple, 0))) {
+        std::string fileName = PyString_AsString(PyTuple_GET_ITEM(tuple, 0));
+        GILReleaser nogil;  // let other Python threads run while the potential is being constructed
+        return potential::readPotential(fileName, *conv);
+    }
     bool onlyPot = true, onlyDict = true;
     std::vector<potential::PtrPotential> components;
     std::vector<utils::KeyValueMap> paramsArr;
@@ -2142,6 +2381,7 @@ potential::PtrPotential Potential_initFromTuple(PyObject* tuple)
         return components.size()==1 ? components[0] :
             potential::PtrPotential(new potential::Composite(components));
     } else if(onlyDict) {
+        GILReleaser nogil;
         return potential::createPotential(paramsArr, *conv);
     } else
         throw std::invalid_argument("Unnamed arguments should contain "
@@ -2507,6 +2747,48 @@ PyObject* Potential_Rperiapo(PyObject* self, PyObject* args)
     return result;
 }
 
+/// fold the components of a composite potential into fewer expansions
+PyObject* Potential_flatten(PyObject* self, PyObject* args, PyObject* namedArgs)
+{
+    static const char* keywords[] = {"resample", NULL};
+    int resample = 0;
+    if(!Potential_isCorrect(self) ||
+        !PyArg_ParseTupleAndKeywords(args, namedArgs, "|i", const_cast<char**>(keywords), &resample))
+        return NULL;
+    try{
+        return createPotentialObject(
+            potential::flattenPotential(((PotentialObject*)self)->pot, resample));
+    }
+    catch(std::exception& e) {
+        PyErr_SetString(PyExc_RuntimeError, (std::string("Error in flatten(): ")+e.what()).c_str());
+        return NULL;
+    }
+}
+
+PyObject* Potential_tabulate(PyObject* self, PyObject* args, PyObject* namedArgs)
+{
+    static const char* keywords[] = {"rmin", "rmax", "eps", "gridSize", "maxGridSize", NULL};
+    double rmin = 0, rmax = 0, eps = 1e-5;
+    int gridSize = 20, maxGridSize = 100;
+    if(!Potential_isCorrect(self) ||
+        !PyArg_ParseTupleAndKeywords(args, namedArgs, "dd|dii", const_cast<char**>(keywords),
+        &rmin, &rmax, &eps, &gridSize, &maxGridSize))
+        return NULL;
+    if(gridSize < 4 || maxGridSize < gridSize) {
+        PyErr_SetString(PyExc_ValueError, "tabulate(): invalid grid size");
+        return NULL;
+    }
+    try{
+        return createPotentialObject(potential::PtrPotential(new potential::TabulatedPotential(
+            ((PotentialObject*)self)->pot, rmin * conv->lengthUnit, rmax * conv->lengthUnit,
+            eps, gridSize, maxGridSize)));
+    }
+    catch(std::exception& e) {
+        PyErr_SetString(PyExc_RuntimeError, (std::string("Error in tabulate(): ")+e.what()).c_str());
+        return NULL;
+    }
+}
+
 static PyMethodDef Potential_methods[] = {
     { "potential", (PyCFunction)Potential_potential, METH_VARARGS | METH_KEYWORDS,
       "Compute potential at a given point or array of points\n"
@@ -2565,6 +2847,28 @@ static PyMethodDef Potential_methods[] = {
       "spherically-symmetric potentials (the minimum/maximum spherical radius that an orbit can "
       "attain), but only approximate values for out-of-plane orbits in non-spherical potentials.\n"
       "Returns: a pair of values (Rperi,Rapo) or a Nx2 array of these values for each input point\n" },
+    { "flatten", (PyCFunction)Potential_flatten, METH_VARARGS | METH_KEYWORDS,
+      "Create a new potential in which the components of a composite potential are folded "
+      "into fewer expansions, to speed up its evaluation: all Multipole components sharing the same "
+      "radial grid are summed into a single Multipole, and all CylSpline components with identical "
+      "grids are summed into a single CylSpline; other components are kept as they are.\n"
+      "Arguments:\n"
+      "  resample (optional, default False) - if True, expansions with different grids are also "
+      "combined by constructing a new expansion on a grid covering all of them (approximate).\n"
+      "Returns: a new Potential object (the original one is not modified)\n" },
+    { "tabulate", (PyCFunction)Potential_tabulate, METH_VARARGS | METH_KEYWORDS,
+      "Create a new potential that interpolates the values of the original one on a 3d grid, "
+      "to speed up the evaluation of expensive potentials (e.g. triaxial Dehnen or Ferrers models, "
+      "or user-defined Python functions). The grid is adaptively refined until the required "
+      "accuracy is reached, and uses the symmetry of the potential to reduce its size; "
+      "outside the grid, the original potential is used.\n"
+      "Arguments:\n"
+      "  rmin - the innermost nonzero node of the initial grid in each coordinate;\n"
+      "  rmax - the extent of the grid in each coordinate;\n"
+      "  eps (optional, default 1e-5) - required relative accuracy of the potential;\n"
+      "  gridSize (optional, default 20) - initial number of nodes in each coordinate on the half-axis;\n"
+      "  maxGridSize (optional, default 100) - maximum number of nodes after refinement.\n"
+      "Returns: a new Potential object (the original one is not modified)\n" },
     { NULL }
 };
 
@@ -2662,8 +2966,10 @@ int ActionFinder_init(PyObject* self, PyObject* args, PyObject* namedArgs)
         PyErr_SetString(PyExc_TypeError, "Argument must be a valid instance of Potential class");
         return -1;
     }
+    bool interpolate = toBool(interp_flag, false);
     try{
-        ((ActionFinderObject*)self)->af = createActionFinder(pot, toBool(interp_flag, false));
+        GILReleaser nogil;  // let other Python threads run while the interpolation tables are constructed
+        ((ActionFinderObject*)self)->af = createActionFinder(pot, interpolate);
         return 0;
     }
     catch(std::exception& e) {
@@ -3028,8 +3334,10 @@ void DistributionFunction_dealloc(DistributionFunctionObject* self)
 class DistributionFunctionWrapper: public df::BaseDistributionFunction{
     NumpyWarningsDisabler lock;
     PyObject* fnc;   ///< Python object providing the __call__ interface to evaluate the DF
+    PythonFunctionCaller caller;
 public:
-    DistributionFunctionWrapper(PyObject* _fnc): fnc(_fnc)
+    DistributionFunctionWrapper(PyObject* _fnc):
+        fnc(_fnc), caller(_fnc, /*numVars*/ 3, /*allowBool*/ false)
     {
         Py_INCREF(fnc);
         utils::msg(utils::VL_DEBUG, "Agama",
@@ -3053,46 +3361,15 @@ public:
         double* act = static_cast<double*>(alloca(npoints * 3 * sizeof(double)));
         for(size_t p=0; p<npoints; p++)
             unconvertActions(J[p], act + p*3);
-        double mult = conv->massUnit / pow_3(conv->velocityUnit * conv->lengthUnit);
-        PyObject* result = NULL;
-        bool typeerror   = false;
-#ifdef _OPENMP
-#pragma omp critical(PythonAPI)
-#endif
-        {
-            npy_intp dims[]  = { (npy_intp)npoints, 3};
-            PyObject* args   = PyArray_SimpleNewFromData(2, dims, NPY_DOUBLE, act);
-            result = PyObject_CallFunctionObjArgs(fnc, args, NULL);
-            Py_DECREF(args);
-            if(result == NULL) {
-                PyErr_Print();
-            } else if(PyArray_Check(result) &&
-                PyArray_NDIM((PyArrayObject*)result) == 1 &&
-                PyArray_DIM ((PyArrayObject*)result, 0) == (npy_intp)npoints)
-            {
-                int type = PyArray_TYPE((PyArrayObject*) result);
-                for(size_t p=0; p<npoints; p++) {
-                    switch(type) {
-                        case NPY_DOUBLE: values[p] = pyArrayElem<double>(result, p) * mult; break;
-                        case NPY_FLOAT:  values[p] = pyArrayElem<float >(result, p) * mult; break;
-                        default: values[p] = NAN; typeerror = true;
-                    }
-                }
-            }
-            else if(npoints==1 && PyNumber_Check(result)) {
-                // in case of a single input point, the user function might return a single number
-                values[0] = PyFloat_AsDouble(result) * mult;
-            }
-            else {
-                typeerror = true;
-            }
-            Py_XDECREF(result);
-        }
-        if(result == NULL)
+        PythonFunctionCaller::Status status = caller.call(npoints, act, values);
+        if(status == PythonFunctionCaller::CALL_FAILED)
             throw std::runtime_error("Call to user-defined distribution function failed");
-        else if(typeerror)
+        else if(status == PythonFunctionCaller::CALL_TYPEERROR)
             throw std::runtime_error(
                 "Invalid data type returned from user-defined distribution function");
+        double mult = conv->massUnit / pow_3(conv->velocityUnit * conv->lengthUnit);
+        for(size_t p=0; p<npoints; p++)
+            values[p] *= mult;
     }
 };
 
@@ -3449,8 +3726,10 @@ PyObject* SelectionFunction_value(SelectionFunctionObject* self, PyObject* args,
 class SelectionFunctionWrapper: public galaxymodel::BaseSelectionFunction{
     NumpyWarningsDisabler lock;
     PyObject* fnc;    ///< Python object providing the selection function
+    PythonFunctionCaller caller;
 public:
-    SelectionFunctionWrapper(PyObject* _fnc): fnc(_fnc)
+    SelectionFunctionWrapper(PyObject* _fnc):
+        fnc(_fnc), caller(_fnc, /*numVars*/ 6, /*allowBool*/ true)
     {
         Py_INCREF(fnc);
         utils::msg(utils::VL_DEBUG, "Agama",
@@ -3473,44 +3752,10 @@ public:
         double* posvel   = static_cast<double*>(alloca(npoints * 6 * sizeof(double)));
         for(size_t p=0; p<npoints; p++)
             unconvertPosVel(points[p], posvel + p*6);
-        PyObject *result = NULL;
-        bool typeerror   = false;
-#ifdef _OPENMP
-#pragma omp critical(PythonAPI)
-#endif
-        {
-            npy_intp dims[]  = { (npy_intp)npoints, 6};
-            PyObject* args   = PyArray_SimpleNewFromData(2, dims, NPY_DOUBLE, posvel);
-            result = PyObject_CallFunctionObjArgs(fnc, args, NULL);
-            Py_DECREF(args);
-            if(result == NULL) {
-                PyErr_Print();
-            } else if(PyArray_Check(result) &&
-                PyArray_NDIM((PyArrayObject*)result) == 1 &&
-                PyArray_DIM ((PyArrayObject*)result, 0) == (npy_intp)npoints)
-            {
-                int type = PyArray_TYPE((PyArrayObject*) result);
-                for(size_t p=0; p<npoints; p++) {
-                    switch(type) {
-                        case NPY_DOUBLE: values[p] = pyArrayElem<double>(result, p); break;
-                        case NPY_FLOAT:  values[p] = pyArrayElem<float >(result, p); break;
-                        case NPY_BOOL:   values[p] = pyArrayElem<bool  >(result, p); break;
-                        default: values[p] = NAN; typeerror = true;
-                    }
-                }
-            }
-            else if(npoints==1 && PyNumber_Check(result)) {
-                // in case of a single input point, the user function might return a single number
-                values[0] = PyFloat_AsDouble(result);
-            }
-            else {
-                typeerror = true;
-            }
-            Py_XDECREF(result);
-        }
-        if(result == NULL)
+        PythonFunctionCaller::Status status = caller.call(npoints, posvel, values);
+        if(status == PythonFunctionCaller::CALL_FAILED)
             throw std::runtime_error("Call to user-defined selection function failed");
-        else if(typeerror)
+        else if(status == PythonFunctionCaller::CALL_TYPEERROR)
             throw std::runtime_error("Invalid data type returned from user-defined selection function");
         // otherwise return the result in values[]
     }
@@ -3860,6 +4105,7 @@ public:
                 std::fill(vel,  vel  + numComponents * 3, NAN);
             if(vel2)
                 std::fill(vel2, vel2 + numComponents * 6, NAN);
+            PythonAPILock lock(gilReleased);
 #ifdef _OPENMP
 #pragma omp critical(PythonAPI)
 #endif
@@ -3963,6 +4209,7 @@ public:
         catch(std::exception& ex) {
             for(unsigned int ic=0; ic<numComponents; ic++)
                 outputBuffer[ip * numComponents + ic] = NAN;
+            PythonAPILock lock(gilReleased);
 #ifdef _OPENMP
 #pragma omp critical(PythonAPI)
 #endif
@@ -4173,6 +4420,7 @@ public:
 
             // create and store Python spline objects in the output arrays
             // (protect from concurrent access to Python API from multiple threads)
+            PythonAPILock lock(gilReleased);
 #ifdef _OPENMP
 #pragma omp critical(PythonAPI)
 #endif
@@ -4195,6 +4443,7 @@ public:
         }
         catch(std::exception& ex) {
             // leave PyNone as the elements of output arrays and issue a warning
+            PythonAPILock lock(gilReleased);
 #ifdef _OPENMP
 #pragma omp critical(PythonAPI)
 #endif
@@ -4720,16 +4969,24 @@ PyObject* SelfConsistentModel_iterate(SelfConsistentModelObject* self)
     }
     if(self->af!=NULL && PyObject_TypeCheck(self->af, &ActionFinderType))
         model.actionFinder = ((ActionFinderObject*)self->af)->af;
+    std::string error;
+    {
+        // let other Python threads run during the iteration (the components of this model
+        // must not be used by these threads, since they are modified in the process)
+        GILReleaser nogil;
+        try {
+            doIteration(model);
+        }
+        catch(std::exception& e) {
+            error = std::string("Error in SelfConsistentModel.iterate(): ") + e.what();
+        }
+    }
     PyObject* result = NULL;
-    try {
-        doIteration(model);
+    if(error.empty()) {
         Py_INCREF(Py_None);
         result = Py_None;
-    }
-    catch(std::exception& e) {
-        PyErr_SetString(PyExc_RuntimeError,
-            (std::string("Error in SelfConsistentModel.iterate(): ")+e.what()).c_str());
-    }
+    } else
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
     // update the total potential and action finder by copying the C++ smart pointers into
     // Python objects; old Python objects are released (and destroyed if no one else uses them)
     Py_XDECREF(self->pot);
@@ -5789,7 +6046,13 @@ PyObject* orbit(PyObject* /*self*/, PyObject* args, PyObject* namedArgs)
     // finally, run the orbit integration
     volatile npy_intp numComplete = 0;
     volatile time_t tprint = time(NULL), tbegin = tprint;
+    std::string error;  // error message from the first failed orbit, if any
     if(!fail) {
+        // let other Python threads run during the integration; the output arrays are owned by
+        // this routine, so their data may be accessed directly, but allocation of new Python objects
+        // needs the GIL to be re-acquired
+        GILReleaser nogil;
+        const bool gilReleased = nogil.released();
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic, 1)
 #endif
@@ -5841,8 +6104,11 @@ PyObject* orbit(PyObject* /*self*/, PyObject* args, PyObject* namedArgs)
 #ifdef _OPENMP
 #pragma omp critical(PythonAPI)
 #endif
-                PyErr_SetString(PyExc_RuntimeError, (std::string("Error in orbit(): ")+e.what()).c_str());
-                fail = true;
+                {   // the Python exception is raised after the loop, when the GIL is held again
+                    if(!fail)
+                        error = std::string("Error in orbit(): ") + e.what();
+                    fail = true;
+                }
             }
             // remaining procedures are trivial and should not raise exceptions
 
@@ -5864,18 +6130,25 @@ PyObject* orbit(PyObject* /*self*/, PyObject* args, PyObject* namedArgs)
                 const npy_intp size = traj.size();
                 npy_intp dims[] = {size, traj_dtype==NPY_CFLOAT || traj_dtype==NPY_CDOUBLE ? 3 : 6};
                 PyObject *time_arr, *traj_arr;
+                {   // avoid concurrent non-readonly access to Python C API
+                    PythonAPILock lock(gilReleased);
 #ifdef _OPENMP
 #pragma omp critical(PythonAPI)
 #endif
-                {   // avoid concurrent non-readonly access to Python C API
-                    time_arr = PyArray_SimpleNew(1, dims,
-                        traj_dtype==NPY_FLOAT || traj_dtype==NPY_CFLOAT ? NPY_FLOAT : NPY_DOUBLE);
-                    traj_arr = PyArray_SimpleNew(2, dims, traj_dtype);
+                    {
+                        time_arr = PyArray_SimpleNew(1, dims,
+                            traj_dtype==NPY_FLOAT || traj_dtype==NPY_CFLOAT ? NPY_FLOAT : NPY_DOUBLE);
+                        traj_arr = PyArray_SimpleNew(2, dims, traj_dtype);
+                        if(!time_arr || !traj_arr) {
+                            PyErr_Clear();  // the exception is raised after the loop
+                            if(!fail)
+                                error = "Error in orbit(): cannot allocate the trajectory arrays";
+                            fail = true;
+                        }
+                    }
                 }
-                if(!time_arr || !traj_arr) {
-                    fail = true;
+                if(!time_arr || !traj_arr)
                     continue;
-                }
 
                 // convert the units and numerical type
                 for(npy_intp index=0; index<size; index++) {
@@ -5944,7 +6217,8 @@ PyObject* orbit(PyObject* /*self*/, PyObject* args, PyObject* namedArgs)
     if(cbrk.triggered()) {
         PyErr_SetObject(PyExc_KeyboardInterrupt, NULL);
         fail = true;
-    }
+    } else if(!error.empty())
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
     if(fail) {
         Py_XDECREF(result);
         return NULL;
@@ -6638,47 +6912,19 @@ PyObject* splineLogDensity(PyObject* /*self*/, PyObject* args, PyObject* namedAr
 class FncWrapper: public math::IFunctionNdim {
     NumpyWarningsDisabler lock;
     const unsigned int nvars;
-    PyObject* fnc;
+    PythonFunctionCaller caller;
 public:
-    FncWrapper(unsigned int _nvars, PyObject* _fnc): nvars(_nvars), fnc(_fnc) {}
+    FncWrapper(unsigned int _nvars, PyObject* _fnc):
+        nvars(_nvars), caller(_fnc, _nvars, /*allowBool*/ true) {}
 
     /// vectorized evaluation of Python function for several points at once
     /// (making sure it invokes Python callback from a single thread at a time)
     virtual void evalmany(const size_t npoints, const double vars[], double values[]) const
     {
-        PyObject* result = NULL;
-        bool typeerror   = false;
-#pragma omp critical(PythonAPI)
-        {
-            npy_intp dims[]  = { (npy_intp)npoints, nvars};
-            PyObject* args   = PyArray_SimpleNewFromData(2, dims, NPY_DOUBLE, const_cast<double*>(vars));
-            result = PyObject_CallFunctionObjArgs(fnc, args, NULL);
-            Py_DECREF(args);
-            if(result == NULL) {
-                PyErr_Print();
-            } else if(PyArray_Check(result) &&
-                PyArray_NDIM((PyArrayObject*)result) == 1 &&
-                PyArray_DIM ((PyArrayObject*)result, 0) == (npy_intp)npoints)
-            {
-                int type = PyArray_TYPE((PyArrayObject*) result);
-                for(size_t p=0; p<npoints; p++) {
-                    switch(type) {
-                        case NPY_DOUBLE: values[p] = pyArrayElem<double>(result, p); break;
-                        case NPY_FLOAT:  values[p] = pyArrayElem<float >(result, p); break;
-                        case NPY_BOOL:   values[p] = pyArrayElem<bool  >(result, p); break;
-                        default: values[p] = NAN; typeerror = true;
-                    }
-                }
-            } else if(PyNumber_Check(result) && npoints==1)
-                // in case of a single input point, may return a single number
-                values[0] = PyFloat_AsDouble(result);
-            else
-                typeerror = true;
-            Py_XDECREF(result);
-        }
-        if(result == NULL)
+        PythonFunctionCaller::Status status = caller.call(npoints, vars, values);
+        if(status == PythonFunctionCaller::CALL_FAILED)
             throw std::runtime_error("Exception occurred inside integrand");
-        else if(typeerror)
+        else if(status == PythonFunctionCaller::CALL_TYPEERROR)
             throw std::runtime_error("Invalid data type returned from user-defined function");
     }
     /// same for one point (not used by integration/sampling routines, but required by the interface)
@@ -6866,12 +7112,107 @@ PyObject* sampleNdim(PyObject* /*self*/, PyObject* args, PyObject* namedArgs)
     }
 }
 
+/// description of instrumentation counters function
+static const char* docstringCounters =
+    "Return the values of instrumentation counters of the main computational routines.\n"
+    "The counters are only available if the library was compiled with -DINSTRUMENT_COUNTERS flag; "
+    "otherwise an empty dictionary is returned.\n"
+    "Arguments:\n"
+    "  reset (optional, default False) - whether to reset all counters to zero "
+    "after retrieving their values.\n"
+    "Returns: a dictionary where keys are the names of counters (types of events, "
+    "or names of potential classes for the number of potential evaluations), "
+    "and values are tuples containing the number of events summed over all threads "
+    "and the total time spent in these events (if applicable, otherwise zero).\n\n"
+    "Example:\n"
+    ">>> agama.counters(reset=True)  # discard previous values\n"
+    ">>> act = agama.ActionFinder(pot)(points)\n"
+    ">>> print(agama.counters())\n";
+
+/// instrumentation counters
+PyObject* counters(PyObject* /*self*/, PyObject* args, PyObject* namedArgs)
+{
+    static const char* keywords[] = {"reset", NULL};
+    int reset = 0;
+    if(!PyArg_ParseTupleAndKeywords(args, namedArgs, "|i", const_cast<char**>(keywords), &reset))
+        return NULL;
+    PyObject* result = PyDict_New();
+    if(!utils::countersEnabled())
+        return result;
+    std::vector<utils::CounterValue> values = utils::getCounters();
+    for(size_t i=0; i<values.size(); i++) {
+        PyObject* item = Py_BuildValue("Kd", values[i].count, values[i].time);
+        PyDict_SetItemString(result, values[i].name.c_str(), item);
+        Py_DECREF(item);
+    }
+    if(reset)
+        utils::resetCounters();
+    return result;
+}
+
+/// default number of OpenMP threads, determined at module initialization
+static int defaultNumThreads = 1;
+
+/// description of setNumThreads function
+static const char* docstringSetNumThreads =
+    "Set the number of OpenMP threads used in parallelized computations started from "
+    "the current Python thread.\n"
+    "The setting applies only to the Python thread that calls this function, so that several "
+    "Python threads running computations concurrently may share the processor cores "
+    "without oversubscription, each one using its own thread budget.\n"
+    "Arguments:\n"
+    "  n - the number of threads (a positive integer), or 0 to restore the default value "
+    "(the number of processor cores or the value of OMP_NUM_THREADS environment variable).\n"
+    "Returns: the previous number of threads "
+    "(always 1 if the library was compiled without OpenMP support, in which case the call has no effect).\n\n"
+    "Example:\n"
+    ">>> def worker(model, points):\n"
+    "...     agama.setNumThreads(4)   # each of the two Python threads uses 4 cores\n"
+    "...     return model.moments(points)\n"
+    ">>> with concurrent.futures.ThreadPoolExecutor(2) as pool:\n"
+    "...     results = list(pool.map(worker, [model1, model2], [points, points]))\n";
+
+/// set the number of OpenMP threads for the current Python thread
+PyObject* setNumThreads(PyObject* /*self*/, PyObject* args)
+{
+    int numThreads = 0;
+    if(!PyArg_ParseTuple(args, "i", &numThreads))
+        return NULL;
+    if(numThreads < 0) {
+        PyErr_SetString(PyExc_ValueError, "Number of threads must be a non-negative integer");
+        return NULL;
+    }
+#ifdef _OPENMP
+    int prevNumThreads = omp_get_max_threads();
+    // the number of threads is a per-thread setting in OpenMP, so it does not affect other Python threads
+    omp_set_num_threads(numThreads > 0 ? numThreads : defaultNumThreads);
+    return Py_BuildValue("i", prevNumThreads);
+#else
+    return Py_BuildValue("i", 1);
+#endif
+}
+
 ///@}
 
 
 
 static const char* docstringModule =
-    "The Python interface for the AGAMA galaxy modelling library";
+    "The Python interface for the AGAMA galaxy modelling library.\n\n"
+    "Most lengthy computations (orbit integration, moments and projections of galaxy models, "
+    "iterations of self-consistent models, construction of potentials and action finders, "
+    "evaluation of actions and other methods applied to arrays of points) release the global "
+    "interpreter lock, so that other Python threads may run concurrently, e.g., several models "
+    "may be computed in parallel from a thread pool, or an asynchronous service may stay responsive. "
+    "This does not happen while any user-defined Python functions (e.g., density or distribution "
+    "function) are wrapped into Agama objects, since the computation may need to call them.\n"
+    "Objects of all classes are immutable after construction and may be used by several threads "
+    "simultaneously, with the exception of SelfConsistentModel and its Components, which must "
+    "not be used by other threads during a call to SelfConsistentModel.iterate(). "
+    "The unit conversion (setUnits/resetUnits) is global and should not be changed while "
+    "computations are running in other threads.\n"
+    "Each Python thread may limit the number of OpenMP threads used in its computations "
+    "by calling setNumThreads(), so that concurrent computations share the processor cores "
+    "without oversubscription.";
 
 /// list of standalone functions exported by the module
 static PyMethodDef module_methods[] = {
@@ -6899,6 +7240,10 @@ static PyMethodDef module_methods[] = {
       METH_VARARGS | METH_KEYWORDS, docstringIntegrateNdim },
     { "sampleNdim",             (PyCFunction)sampleNdim,
       METH_VARARGS | METH_KEYWORDS, docstringSampleNdim },
+    { "counters",               (PyCFunction)counters,
+      METH_VARARGS | METH_KEYWORDS, docstringCounters },
+    { "setNumThreads",                       setNumThreads,
+      METH_VARARGS,                 docstringSetNumThreads },
     { NULL }
 };
 
@@ -6944,6 +7289,9 @@ PyInit_agama(void)
     };
 
     PyEval_InitThreads();
+#ifdef _OPENMP
+    defaultNumThreads = omp_get_max_threads();
+#endif
     thismodule = PyModule_Create(&moduledef);
     if(!thismodule) return NULL;
     PyModule_AddStringConstant(thismodule, "__version__", AGAMA_VERSION);
@@ -61,8 +61,13 @@ public:
     virtual ~BaseRagaTask() {}
 
     /** Create an instance of a runtime function for the given particle
-        and attach it to the orbit integrator for that particle */
-    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex) = 0;
+        and attach it to the orbit integrator for that particle;
+        orbitLength is the duration of integration of this particle, which equals the episode length
+        unless the multi-rate scheme is used (see RagaCore), in which case it may be a power-of-two
+        multiple of the latter (the orbit integration for the entire interval is performed in the current episode,
+        and the particle is skipped in the subsequent episodes covered by this interval) */
+    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex,
+        double orbitLength) = 0;
 
     /** Prepare for the upcoming episode that begins at timeStart and lasts for episodeLength */
     virtual void startEpisode(double timeStart, double episodeLength) = 0;
@@ -152,7 +152,8 @@ RagaTaskBinary::RagaTaskBinary(
         ", eccentricity=" + utils::toString(bh.ecc));        
 }
 
-void RagaTaskBinary::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex)
+void RagaTaskBinary::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex,
+    double /*orbitLength*/)
 {
     orbint.addRuntimeFnc(orbit::PtrRuntimeFnc(new RuntimeBinary(
         orbint, *ptrPot, bh, encounters[particleIndex])));
@@ -94,7 +94,8 @@ public:
         const particles::ParticleArrayAux& particles,
         const potential::PtrPotential& ptrPot,
         potential::KeplerBinaryParams& bh);
-    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex);
+    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex,
+        double orbitLength);
     virtual void startEpisode(double timeStart, double episodeLength);
     virtual void finishEpisode();
     virtual const char* name() const { return "BinaryBH     "; }
@@ -4,6 +4,8 @@
 #include "potential_multipole.h"
 #include "potential_factory.h"
 #include "potential_composite.h"
+#include "potential_utils.h"
+#include "potential_analytic.h"
 #include "math_core.h"
 #include "particles_io.h"
 #include <fstream>
@@ -88,34 +90,116 @@ void RagaCore::initPotentialFromParticles()
         /*output*/Ekin, Epot);
 }
 
+std::vector<unsigned int> assignEpisodeLevels(const potential::BasePotential& pot,
+    const std::vector<double>& energies, unsigned int& numLevels)
+{
+    ptrdiff_t nbody = energies.size();
+    std::vector<unsigned int> stepFactor(nbody, 1);
+    if(numLevels <= 1 || nbody == 0) {
+        numLevels = 1;
+        return stepFactor;
+    }
+    // orbital period is a monotonic function of energy, and particles are sorted in energy,
+    // so the boundaries between levels can be found by bisection, evaluating the characteristic
+    // period only O(numLevels log N) times
+    double Tmin = potential::T_circ(pot, energies[0]);
+    if(!(Tmin > 0 && Tmin < INFINITY)) {
+        // could not determine the periods - fall back to the single-rate scheme
+        numLevels = 1;
+        return stepFactor;
+    }
+    ptrdiff_t begin = 0;
+    for(unsigned int level=1; level<numLevels; level++) {
+        double Tlevel = Tmin * (1u << level);
+        // find the first particle with period exceeding Tlevel (or non-finite, e.g. unbound)
+        ptrdiff_t lo = begin, hi = nbody;
+        while(lo < hi) {
+            ptrdiff_t mid = (lo + hi) / 2;
+            if(potential::T_circ(pot, energies[mid]) < Tlevel)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for(ptrdiff_t ip=lo; ip<nbody; ip++)
+            stepFactor[ip] *= 2;
+        begin = lo;
+    }
+    return stepFactor;
+}
+
 void RagaCore::doEpisode(double episodeLength)
 {
     if(!ptrPot)
         throw std::runtime_error("Raga: potential is not initialized");
     if(!(episodeLength > 0))
         return;
-    utils::msg(utils::VL_MESSAGE, "Raga",
-        "Starting episode at time " + utils::toString(paramsRaga.timeCurr));
-    std::time_t wallClockStartEpisode = std::time(NULL);
-
-    int numtasks = tasks.size();
-    for(int task=0; task<numtasks; task++)
-        tasks[task]->startEpisode(paramsRaga.timeCurr, episodeLength);
 
     // compute energies of all particles
     ptrdiff_t nbody = particles.size();
-    std::vector< std::pair<double, ptrdiff_t> > particleOrder(nbody);
+    std::vector< std::pair<double, ptrdiff_t> > particleEnergy(nbody);
     for(ptrdiff_t ip=0; ip<nbody; ip++) {
         const coord::PosVelCar& point = particles.point(ip);
         double E = ptrPot->value(point, paramsRaga.timeCurr) +
             bh.potential(point, paramsRaga.timeCurr) +
             (pow_2(point.vx) + pow_2(point.vy) + pow_2(point.vz)) * 0.5;
-        particleOrder[ip].first = E;
-        particleOrder[ip].second = ip;
+        particleEnergy[ip].first = E;
+        particleEnergy[ip].second = ip;
     }
     // sort particles in energy, so that the most tightly bound ones
     // are processed first, because it may take longer
-    std::sort(particleOrder.begin(), particleOrder.end());
+    std::sort(particleEnergy.begin(), particleEnergy.end());
+    std::vector<ptrdiff_t> particleOrder(nbody);
+    for(ptrdiff_t ip=0; ip<nbody; ip++)
+        particleOrder[ip] = particleEnergy[ip].second;
+
+    // assign the duration of orbit segment (in units of the shortest one) to each particle
+    unsigned int numLevels = std::max(1u, paramsRaga.numEpisodeLevels);
+    std::vector<unsigned int> stepFactor(nbody, 1);
+    if(numLevels > 1 && nbody > 0) {
+        // orbital periods are estimated in the spherically-averaged total potential (stars + BH)
+        std::vector<potential::PtrPotential> comp(1, ptrPot);
+        if(bh.mass!=0) comp.push_back(potential::PtrPotential(new potential::Plummer(bh.mass, 0)));
+        std::vector<double> energies(nbody);
+        for(ptrdiff_t ip=0; ip<nbody; ip++)
+            energies[ip] = particleEnergy[ip].first;
+        stepFactor = assignEpisodeLevels(potential::Composite(comp), energies, numLevels);
+        if(numLevels == 1)
+            utils::msg(utils::VL_WARNING, "Raga",
+                "Cannot determine orbital periods, multi-rate scheme is disabled for this episode");
+        else if(utils::verbosityLevel >= utils::VL_DEBUG) {
+            std::string counts;
+            for(unsigned int factor=1; factor < (1u << numLevels); factor*=2)
+                counts += (factor>1 ? ", " : "") + utils::toString(
+                    std::count(stepFactor.begin(), stepFactor.end(), factor));
+            utils::msg(utils::VL_DEBUG, "Raga", "Number of particles at each level: " + counts);
+        }
+    }
+
+    unsigned int numSub = 1u << (numLevels-1);
+    for(unsigned int sub=0; sub<numSub; sub++)
+        doSubEpisode(episodeLength / numSub, sub, particleOrder, stepFactor);
+}
+
+void RagaCore::doSubEpisode(double episodeLength, unsigned int subIndex,
+    const std::vector<ptrdiff_t>& particleOrder, const std::vector<unsigned int>& stepFactor)
+{
+    utils::msg(utils::VL_MESSAGE, "Raga",
+        "Starting episode at time " + utils::toString(paramsRaga.timeCurr));
+    std::time_t wallClockStartEpisode = std::time(NULL);
+
+    int numtasks = tasks.size();
+    for(int task=0; task<numtasks; task++)
+        tasks[task]->startEpisode(paramsRaga.timeCurr, episodeLength);
+
+    // select the particles whose orbit segment starts at this sub-episode
+    ptrdiff_t nbody = particleOrder.size();
+    std::vector< std::pair<ptrdiff_t, double> > active;
+    active.reserve(nbody);
+    for(ptrdiff_t ip=0; ip<nbody; ip++) {
+        ptrdiff_t index = particleOrder[ip];
+        if(subIndex % stepFactor[ip] == 0 && particles.mass(index) != 0)  // skip zero-mass particles
+            active.push_back(std::make_pair(index, episodeLength * stepFactor[ip]));
+    }
 
     orbit::OrbitIntParams orbitIntParams;
     orbitIntParams.accuracy = paramsRaga.accuracy;
@@ -129,30 +213,30 @@ void RagaCore::doEpisode(double episodeLength)
         potential::PtrPotential(new potential::Composite(potComponents)) :
         ptrPot;
 
+    ptrdiff_t nactive = active.size();
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic,1)
 #endif
-    for(ptrdiff_t ip=0; ip<nbody; ip++) {
-        ptrdiff_t index = particleOrder[ip].second;
-        if(particles.mass(index) != 0) {   // run only non-zero-mass particles
-            orbit::OrbitIntegrator<coord::Car> orbint(*ptrTotalPot, /*Omega*/0, orbitIntParams);
-            for(int task=0; task<numtasks; task++)
-                tasks[task]->createRuntimeFnc(orbint, index);
-            orbint.init(particles.point(index));
-            coord::PosVelCar endposvel = orbint.run(episodeLength);
-            particles[index].first = particles::ParticleAux(
-                /* replace the initial position/velocity with that at the end of the episode */
-                endposvel,
-                /* keep the original extended particle attributes */
-                particles.point(index).stellarMass,
-                particles.point(index).stellarRadius);
-        }
+    for(ptrdiff_t ia=0; ia<nactive; ia++) {
+        ptrdiff_t index = active[ia].first;
+        double orbitLength = active[ia].second;
+        orbit::OrbitIntegrator<coord::Car> orbint(*ptrTotalPot, /*Omega*/0, orbitIntParams);
+        for(int task=0; task<numtasks; task++)
+            tasks[task]->createRuntimeFnc(orbint, index, orbitLength);
+        orbint.init(particles.point(index));
+        coord::PosVelCar endposvel = orbint.run(orbitLength);
+        particles[index].first = particles::ParticleAux(
+            /* replace the initial position/velocity with that at the end of the orbit segment */
+            endposvel,
+            /* keep the original extended particle attributes */
+            particles.point(index).stellarMass,
+            particles.point(index).stellarRadius);
     }   // end parallel for
 
     double wallClockDurationEpisode = std::max(1., difftime(std::time(NULL), wallClockStartEpisode));
     utils::msg(utils::VL_MESSAGE, "Raga",
-        utils::toString(nbody) + " particles, " +
-        utils::toString(nbody / wallClockDurationEpisode) + " orbits/s");
+        utils::toString(nactive) + " particles, " +
+        utils::toString(nactive / wallClockDurationEpisode) + " orbits/s");
 
     std::ofstream strmLog;
     if(!paramsRaga.fileLog.empty())
@@ -197,6 +281,12 @@ void RagaCore::init(const utils::KeyValueMap& config)
     paramsRaga.timeCurr       = config.getDouble("timeInit", paramsRaga.timeCurr);
     paramsRaga.episodeLength  = config.getDouble("episodeLength", paramsRaga.timeEnd-paramsRaga.timeCurr);
     paramsRaga.updatePotential= config.getBool  ("updatePotential", paramsRaga.updatePotential);
+    paramsRaga.numEpisodeLevels = std::max(1, config.getInt("numEpisodeLevels", paramsRaga.numEpisodeLevels));
+    if(paramsRaga.numEpisodeLevels > 1 && bh.sma > 0) {
+        // the evolution of the binary BH requires all particles to be integrated in each episode
+        utils::msg(utils::VL_MESSAGE, "Raga", "Multi-rate scheme is disabled for a binary black hole");
+        paramsRaga.numEpisodeLevels = 1;
+    }
     if(!paramsRaga.updatePotential)
         utils::msg(utils::VL_MESSAGE, "Raga", "Potential update is disabled ([Raga]/updatePotential)");
     if(!paramsRaga.fileLog.empty()) {
@@ -222,6 +312,9 @@ void RagaCore::init(const utils::KeyValueMap& config)
         std::max(1, config.getInt("numSamplesPerEpisode", paramsRelaxation.numSamplesPerEpisode));
     paramsRelaxation.coulombLog       = config.getDouble("coulombLog", paramsRelaxation.coulombLog);
     paramsRelaxation.gridSizeDF       = config.getInt   ("gridSizeDF", paramsRelaxation.gridSizeDF);
+    paramsRelaxation.kickSteps        = std::max(1,
+        config.getInt("relaxationKickSteps", paramsRelaxation.kickSteps));
+    paramsRelaxation.kickFraction     = config.getDouble("relaxationKickFraction", paramsRelaxation.kickFraction);
     paramsLosscone.captureMassFraction= config.getDouble("captureMassFraction", paramsLosscone.captureMassFraction);
     paramsLosscone.speedOfLight       =
     paramsBinary.  speedOfLight       = config.getDouble("speedOfLight", paramsBinary.speedOfLight);
@@ -38,6 +38,19 @@
     - Additionally, there are fixed global parameters for each task and for RagaCore itself;
     these parameters are read from the INI file and do not change during the simulation.
     They also determine which tasks are created for the particular simulation.
+
+    Optionally, the episodes may be organized in a hierarchical (multi-rate) scheme:
+    particles are binned by their orbital period, estimated from the energy at the beginning
+    of the episode, and each bin is assigned an orbit segment whose duration is a power-of-two
+    fraction of the episode length: the most tightly bound particles use the shortest segments,
+    and each doubling of the orbital period doubles the segment length, up to the entire episode.
+    The episode is then split into sub-episodes of the shortest segment length, and the tasks
+    perform their global updates (potential, relaxation model, etc.) after each sub-episode,
+    while only the particles whose segment starts at the given sub-episode are integrated
+    (for the entire duration of their segment); the remaining ones keep the data collected
+    during their current segment. In this way the inner regions, which evolve on a shorter
+    timescale, are updated frequently, while the slowly evolving outer parts are not
+    re-integrated unnecessarily. At the end of the entire episode all particles are synchronized.
 */
 #pragma once
 #include "raga_base.h"
@@ -61,12 +74,24 @@ struct ParamsRaga {
     std::string fileInput;      ///< input file name (initial conditions for the simulation)
     std::string fileLog;        ///< file name for logging the global parameters of the simulation
     bool initPotentialExternal; ///< whether the initial potential is set externally or from particles
+    unsigned int numEpisodeLevels; ///< number of levels in the multi-rate scheme (1 means disabled)
     ParamsRaga() :              /// set default parameters
         accuracy(1e-8), maxNumSteps(1e8), updatePotential(false),
-        timeCurr(0), timeEnd(0), episodeLength(0), initPotentialExternal(false)
+        timeCurr(0), timeEnd(0), episodeLength(0), initPotentialExternal(false), numEpisodeLevels(1)
     {}
 };
 
+/** assign the durations of orbit segments in the multi-rate episode scheme.
+    \param[in]  pot  is the (spherically-averaged) potential used to estimate orbital periods;
+    \param[in]  energies  are the particle energies sorted in increasing order;
+    \param[in,out]  numLevels  is the requested number of levels in the scheme; it is reset to 1
+    if the periods cannot be determined (e.g., the most bound particle is unbound);
+    \return  the duration of orbit segment of each particle in units of the shortest one:
+    a power of two not exceeding 2^(numLevels-1), non-decreasing with energy.
+*/
+std::vector<unsigned int> assignEpisodeLevels(const potential::BasePotential& pot,
+    const std::vector<double>& energies, unsigned int& numLevels);
+
 /// the driver class performing the actual simulation
 class RagaCore {
 public:
@@ -90,8 +115,22 @@ public:
 
     void initPotentialFromParticles();
 
-    /** perform one complete episode */
+    /** perform one complete episode, after which all particles are synchronized in time;
+        in the multi-rate scheme, it is split into 2^(numEpisodeLevels-1) shorter episodes */
     void doEpisode(double episodeLength);
+
+private:
+    /** perform one (sub-)episode of the given length, integrating the orbits of particles
+        whose orbit segment starts at this sub-episode.
+        \param[in]  episodeLength  is the duration of the sub-episode;
+        \param[in]  subIndex  is the index of this sub-episode within the entire episode;
+        \param[in]  particleOrder  is the list of particle indices sorted by energy;
+        \param[in]  stepFactor  is the duration of orbit segment of each particle (indexed in the same
+        way as particleOrder) in units of episodeLength; it is a power of two, and the particle is
+        integrated only in sub-episodes whose index is a multiple of this factor.
+    */
+    void doSubEpisode(double episodeLength, unsigned int subIndex,
+        const std::vector<ptrdiff_t>& particleOrder, const std::vector<unsigned int>& stepFactor);
 };
 
 }  // namespace
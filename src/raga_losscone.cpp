@@ -120,7 +120,8 @@ RagaTaskLosscone::RagaTaskLosscone(
         ", accreted mass fraction=" + utils::toString(params.captureMassFraction));
 }
 
-void RagaTaskLosscone::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex)
+void RagaTaskLosscone::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex,
+    double /*orbitLength*/)
 {
     double Mbh0 = bh.sma==0 ? bh.mass / (1 + bh.q) : bh.mass;
     double Mbh1 = bh.sma==0 ? bh.mass / (1 + bh.q) * bh.q : 0;
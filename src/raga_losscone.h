@@ -119,7 +119,8 @@ public:
         const ParamsLosscone& params,
         particles::ParticleArrayAux& particles,
         potential::KeplerBinaryParams& bh);
-    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex);
+    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex,
+        double orbitLength);
     virtual void startEpisode(double timeStart, double episodeLength);
     virtual void finishEpisode();
     virtual const char* name() const { return "LossCone       "; }
@@ -4,6 +4,7 @@
 #include "utils.h"
 #include "math_core.h"
 #include <cmath>
+#include <algorithm>
 
 namespace raga {
 
@@ -32,22 +33,29 @@ RagaTaskPotential::RagaTaskPotential(
     utils::msg(utils::VL_DEBUG, "RagaTaskPotential", "Potential update is enabled");
 }
 
-void RagaTaskPotential::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int index)
+void RagaTaskPotential::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int index,
+    double orbitLength)
 {
+    ParticleArrayType::iterator first =
+        particleTrajectories.data.begin() + params.numSamplesPerEpisode * index;
+    ParticleArrayType::iterator last  = first + params.numSamplesPerEpisode;
+    // erase the samples recorded for this particle in the previous episode(s)
+    std::fill(first, last,
+        particles::ParticleArray<coord::PosCyl>::ElemType(coord::PosCyl(NAN, NAN, NAN), NAN));
     orbint.addRuntimeFnc(orbit::PtrRuntimeFnc(new RuntimePotential(
-        orbint,
-        episodeLength / params.numSamplesPerEpisode,
-        particleTrajectories.data.begin() + params.numSamplesPerEpisode * index,
-        particleTrajectories.data.begin() + params.numSamplesPerEpisode * (index+1) )));
+        orbint, orbitLength / params.numSamplesPerEpisode, first, last)));
 }
 
 void RagaTaskPotential::startEpisode(double timeStart, double length)
 {
     episodeStart  = timeStart;
     episodeLength = length;
+    // samples are erased only for particles that are integrated in this episode (in createRuntimeFnc);
+    // in the multi-rate scheme, the remaining ones retain the samples from their current orbit segment
     unsigned int nbody = particles.size();
-    particleTrajectories.data.assign(nbody * params.numSamplesPerEpisode,
-        particles::ParticleArray<coord::PosCyl>::ElemType(coord::PosCyl(NAN, NAN, NAN), NAN));
+    if(particleTrajectories.size() != nbody * params.numSamplesPerEpisode)
+        particleTrajectories.data.assign(nbody * params.numSamplesPerEpisode,
+            particles::ParticleArray<coord::PosCyl>::ElemType(coord::PosCyl(NAN, NAN, NAN), NAN));
     // output the potential (if needed) at the start of the first episode
     if(prevOutputTime == -INFINITY && !params.outputFilename.empty()) {
         prevOutputTime = episodeStart;
@@ -66,21 +74,21 @@ void RagaTaskPotential::finishEpisode()
     }
 
     // eliminate samples with zero mass or undetermined coordinates:
-    // scan the array and squeeze it towards the head
-    ParticleArrayType::iterator src = particleTrajectories.data.begin(); // where to take elements from
-    ParticleArrayType::iterator dest = src;  // where to store the elements (dest <= src always)
-    while(src != particleTrajectories.data.end()) {
+    // copy only the valid samples into a temporary array, keeping the original one intact,
+    // since its content may be reused in the next episode(s) in the multi-rate scheme
+    particles::ParticleArray<coord::PosCyl> validSamples;
+    validSamples.data.reserve(particleTrajectories.size());
+    for(ParticleArrayType::const_iterator src = particleTrajectories.data.begin();
+        src != particleTrajectories.data.end(); ++src)
+    {
         if(isFinite(src->first.R) && src->second > 0)
-            *(dest++) = *src;
-        ++src;
+            validSamples.data.push_back(*src);
     }
-    // shrink the array to retain only valid samples
-    particleTrajectories.data.erase(dest, particleTrajectories.data.end());
     utils::msg(utils::VL_DEBUG, "RagaTaskPotential",
-        "Retained "+utils::toString(particleTrajectories.size())+" samples");
+        "Retained "+utils::toString(validSamples.size())+" samples");
 
     // update the potential
-    ptrPot = potential::Multipole::create(particleTrajectories,
+    ptrPot = potential::Multipole::create(validSamples,
         params.symmetry, params.lmax, params.lmax, params.gridSizeR, params.rmin, params.rmax);
 
     // write out the new potential (if needed)
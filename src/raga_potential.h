@@ -110,7 +110,8 @@ public:
         const ParamsPotential& params,
         const particles::ParticleArrayAux& particles,
         potential::PtrPotential& ptrPot);
-    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex);
+    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex,
+        double orbitLength);
     virtual void startEpisode(double timeStart, double episodeLength);
     virtual void finishEpisode();
     virtual const char* name() const { return "PotentialUpdate"; }
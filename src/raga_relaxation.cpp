@@ -8,6 +8,7 @@
 #include "math_core.h"
 #include "math_random.h"
 #include <cassert>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 
@@ -57,7 +58,20 @@ bool RuntimeRelaxation::processTimestep(double tbegin, double tend)
             "Phi="+utils::toString(Phi)+", v="+utils::toString(vel)+
             "; dt="+utils::toString(timestep)+", dE="+utils::toString(dEdt * timestep) );
 
-    // 2d. assign the random (gaussian) velocity perturbation
+    // 2d. accumulate the drift and diffusion coefficients integrated over the timestep,
+    // and decide whether the accumulated perturbation should be applied now
+    accDrift  += dvpar / vel * timestep;
+    accDiffPar+= dv2par * timestep;
+    accDiffPer+= dv2per * timestep;
+    bool applyKick =
+        ++numStepsSinceKick >= kickSteps ||
+        (kickFraction > 0 && accDiffPar + accDiffPer >= pow_2(kickFraction * vel)) ||
+        // last timestep of the orbit segment: the pending perturbation must not be lost
+        tend >= orbitLength * (1 - 1e-10);
+    if(!applyKick)
+        return true;
+
+    // 2e. assign the random (gaussian) velocity perturbation
     // initialize the PRNG state vector, using the current position-velocity
     // as the source of "randomness", with an unique seed for each orbit
     double data[6];
@@ -65,10 +79,12 @@ bool RuntimeRelaxation::processTimestep(double tbegin, double tend)
     math::PRNGState state = math::hash(data, 6, seed);
     double rand1, rand2;  // two normally distributed numbers
     math::getNormalRandomNumbers(/*output*/ rand1, rand2, /*PRNGState*/ &state);
-    double deltavpar = rand1 * sqrt(dv2par * timestep) + dvpar / vel * timestep;
-    double deltavper = rand2 * sqrt(dv2per * timestep);
+    double deltavpar = rand1 * sqrt(accDiffPar) + accDrift;
+    double deltavper = rand2 * sqrt(accDiffPer);
+    accDrift = accDiffPar = accDiffPer = 0;
+    numStepsSinceKick = 0;
 
-    // 2e. add the perturbations to the velocity
+    // 2f. add the perturbations to the velocity
     double uper[3];  // unit vector perpendicular to velocity
     double vmag =    // magnitude of the current velocity vector
         math::getRandomPerpendicularVector(
@@ -81,7 +97,8 @@ bool RuntimeRelaxation::processTimestep(double tbegin, double tend)
             (data[d+3] / vmag) * deltavpar +
             uper[d] * deltavper;
 
-    // 2f. update the internal state of the orbit integrator with the new velocity
+    // 2g. update the internal state of the orbit integrator with the new velocity
+    // (the ODE solver retains its current timestep estimate, so this is not a full restart)
     orbint.init(coord::PosVelCar(data));
     return true;  // integration may continue
 }
@@ -276,11 +293,20 @@ RagaTaskRelaxation::RagaTaskRelaxation(
     prevOutputTime(-INFINITY)
 {
     utils::msg(utils::VL_DEBUG, "RagaTaskRelaxation",
-        "Initialized with ln Lambda="+utils::toString(params.coulombLog));
+        "Initialized with ln Lambda="+utils::toString(params.coulombLog)+
+        (params.kickSteps>1 || params.kickFraction>0 ?
+        ", velocity perturbations applied every "+utils::toString(params.kickSteps)+" timesteps"+
+        (params.kickFraction>0 ? " or after accumulating "+utils::toString(params.kickFraction)+
+        " of velocity" : "") : ""));
 }
 
-void RagaTaskRelaxation::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int index)
+void RagaTaskRelaxation::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int index,
+    double orbitLength)
 {
+    std::vector<double>::iterator first = particle_h.begin() + params.numSamplesPerEpisode * index;
+    std::vector<double>::iterator last  = first + params.numSamplesPerEpisode;
+    // erase the samples recorded for this particle in the previous episode(s)
+    std::fill(first, last, NAN);
     orbint.addRuntimeFnc(orbit::PtrRuntimeFnc(new RuntimeRelaxation(
         orbint,
         *ptrPotSph,
@@ -288,11 +314,14 @@ void RagaTaskRelaxation::createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, un
         params.coulombLog,
         particles.point(index).stellarMass,
         // interval of time between storing the output samples
-        episodeLength / params.numSamplesPerEpisode,
+        orbitLength / params.numSamplesPerEpisode,
         // first and last index of the output sample
-        particle_h.begin() + params.numSamplesPerEpisode * index,
-        particle_h.begin() + params.numSamplesPerEpisode * (index+1),
-        index  // seed for the orbit-local PRNG
+        first,
+        last,
+        index,  // seed for the orbit-local PRNG
+        orbitLength,
+        params.kickSteps,
+        params.kickFraction
     )));
 }
 
@@ -305,25 +334,28 @@ void RagaTaskRelaxation::startEpisode(double timeStart, double length)
         // compute the values of phase volume h for each particle
         potential::PhaseVolume phasevol((potential::PotentialWrapper(*ptrPotSph)));
         ptrdiff_t nbody = particles.size();
+        std::vector<double> initial_h (nbody);
         std::vector<double> particle_m(nbody);
         std::vector<double> stellar_m (nbody);
-        particle_h.resize(nbody);
         for(ptrdiff_t i=0; i<nbody; i++) {
-            particle_h[i] = phasevol(totalEnergy(*ptrPotSph, particles.point(i)));
+            initial_h [i] = phasevol(totalEnergy(*ptrPotSph, particles.point(i)));
             particle_m[i] = particles.mass(i);
             stellar_m [i] = particles.mass(i) * particles.point(i).stellarMass;
         }
         // create the relaxation model and write it to a file (if needed)
         ptrRelaxationModel = createAndWriteRelaxationModel(
-            *ptrPotSph, particle_h, particle_m, stellar_m, params.gridSizeDF,
+            *ptrPotSph, initial_h, particle_m, stellar_m, params.gridSizeDF,
             params.outputFilename.empty() ? "" : params.outputFilename + utils::toString(timeStart),
             params.header);
         prevOutputTime = timeStart;
     }
     episodeStart  = timeStart;
     episodeLength = length;
-    // prepare space for storing samples of phase volume of all particles during the upcoming episode
-    particle_h.assign(particles.size() * params.numSamplesPerEpisode, NAN);    
+    // prepare space for storing samples of phase volume of all particles during the upcoming episode;
+    // samples are erased only for particles that are integrated in this episode (in createRuntimeFnc),
+    // and in the multi-rate scheme, the remaining ones retain the samples from their current orbit segment
+    if(particle_h.size() != particles.size() * params.numSamplesPerEpisode)
+        particle_h.assign(particles.size() * params.numSamplesPerEpisode, NAN);
 }
 
 void RagaTaskRelaxation::finishEpisode()
@@ -340,6 +372,9 @@ void RagaTaskRelaxation::finishEpisode()
             stellar_m [i * params.numSamplesPerEpisode + j] = mass * mstar;
         }
     }
+    // the array of samples is compacted during the construction of the model,
+    // so pass a copy and keep the original one for possible reuse in the next episode(s)
+    std::vector<double> sample_h(particle_h);
 
     // check if need to write out the relaxation model
     double time = episodeStart+episodeLength;
@@ -352,7 +387,7 @@ void RagaTaskRelaxation::finishEpisode()
     // create a new relaxation model for the sphericalized version of the current potential
     ptrPotSph = createSphericalPotential(*ptrPot, bh.mass);
     ptrRelaxationModel = createAndWriteRelaxationModel(
-        *ptrPotSph, particle_h, particle_m, stellar_m, params.gridSizeDF,
+        *ptrPotSph, sample_h, particle_m, stellar_m, params.gridSizeDF,
         outputFilename, params.header);
 }
 
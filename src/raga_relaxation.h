@@ -45,6 +45,10 @@
     The runtime function performs two independent tasks:
     - adds perturbations to the particle velocity after each timestep, which depend
     on the potential and kinetic energy through the model for diffusion coefficients.
+    Optionally, the drift and diffusion coefficients may be accumulated over several timesteps
+    and applied together, either after a fixed number of timesteps or once the accumulated
+    perturbation reaches a given fraction of the velocity (i.e., a fraction of the local
+    relaxation time has passed); this reduces the cost of re-initializing the ODE solver.
     - collects samples of particle energy (or, rather, phase volume h(E)) at regular
     intervals of time during the episode, which are used to recompute the DF and
     the diffusion model at the end of episode. This is analogous to the way that
@@ -93,7 +97,10 @@ public:
         double _outputTimestep,
         const std::vector<double>::iterator& _outputFirst,
         const std::vector<double>::iterator& _outputLast,
-        unsigned int _seed)
+        unsigned int _seed,
+        double _orbitLength,
+        unsigned int _kickSteps,
+        double _kickFraction)
     :
         BaseRuntimeFnc(orbint),
         potentialSph(_potentialSph),
@@ -104,7 +111,12 @@ public:
         outputFirst(_outputFirst),
         outputLast (_outputLast),
         outputIter (_outputFirst),
-        seed(_seed)
+        seed(_seed),
+        orbitLength(_orbitLength),
+        kickSteps(_kickSteps),
+        kickFraction(_kickFraction),
+        numStepsSinceKick(0),
+        accDrift(0), accDiffPar(0), accDiffPer(0)
     {}
     virtual bool processTimestep(double tbegin, double tend);
 private:
@@ -147,6 +159,23 @@ private:
     
     /** seed for the orbit-local pseudo-random number generator */
     unsigned int seed;
+
+    /** duration of the orbit integration: the pending perturbation is applied at its end */
+    const double orbitLength;
+
+    /** the velocity perturbation is applied once in this number of timesteps */
+    const unsigned int kickSteps;
+
+    /** if nonzero, the velocity perturbation is applied (before kickSteps timesteps have passed)
+        once the accumulated r.m.s. perturbation reaches this fraction of the current velocity */
+    const double kickFraction;
+
+    /** number of timesteps since the last velocity perturbation */
+    unsigned int numStepsSinceKick;
+
+    /** drift and diffusion coefficients for the parallel and perpendicular components of
+        velocity, integrated over time since the last velocity perturbation */
+    double accDrift, accDiffPar, accDiffPer;
 };
 
 /** Fixed global parameters of this task */
@@ -170,9 +199,19 @@ struct ParamsRelaxation {
     /// optional header written in the output file
     std::string header;
 
+    /// number of timesteps of the orbit integrator between successive velocity perturbations
+    /// (the perturbations are accumulated in between and applied together, which reduces
+    /// the number of re-initializations of the ODE solver)
+    unsigned int kickSteps;
+
+    /// if nonzero, the accumulated velocity perturbation is applied as soon as its r.m.s. value
+    /// reaches this fraction of the current velocity, even before kickSteps timesteps have passed
+    double kickFraction;
+
     /// set defaults
     ParamsRelaxation() :
-        numSamplesPerEpisode(1), coulombLog(0), gridSizeDF(25), outputInterval(0)
+        numSamplesPerEpisode(1), coulombLog(0), gridSizeDF(25), outputInterval(0),
+        kickSteps(1), kickFraction(0)
     {}
 };
 
@@ -184,7 +223,8 @@ public:
         const particles::ParticleArrayAux& particles,
         const potential::PtrPotential& ptrPot,
         const potential::KeplerBinaryParams& bh);
-    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex);
+    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator& orbint, unsigned int particleIndex,
+        double orbitLength);
     virtual void startEpisode(double timeStart, double episodeLength);
     virtual void finishEpisode();
     virtual const char* name() const { return "Relaxation     "; }
@@ -47,7 +47,7 @@ public:
     RagaTaskTrajectory(
         const ParamsTrajectory& params,
         const particles::ParticleArrayAux& particles);
-    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator&, unsigned int) {}  // does nothing
+    virtual void createRuntimeFnc(orbit::BaseOrbitIntegrator&, unsigned int, double) {}  // does nothing
     virtual void startEpisode(double timeStart, double episodeLength);
     virtual void finishEpisode();
     virtual const char* name() const { return "SnapshotOutput "; }
@@ -143,8 +143,11 @@ typedef shared_ptr<const PhaseVolume>   PtrPhaseVolume;
 namespace actions{
 
 class BaseActionFinder;
+class BaseActionMapper;
 /// shared pointer to an action finder object
 typedef shared_ptr<const BaseActionFinder> PtrActionFinder;
+/// shared pointer to an action mapper object
+typedef shared_ptr<const BaseActionMapper> PtrActionMapper;
 
 }  // namespace actions
 
@@ -43,7 +43,6 @@ void OmniCoords::GCAfromGCY()
 
 void OmniCoords::LSRfromGCA()
 {
-    static double z=0.,s=0.,c=1.;
     rv[3][0] = Rsun-rv[4](0);   // note switch in sign
     rv[3][1] =-rv[4](1);        //       ditto
     rv[3][2] = rv[4](2)-zsun;
@@ -51,13 +50,7 @@ void OmniCoords::LSRfromGCA()
     rv[3][4] = vcsun-rv[4](4);
     rv[3][5] = rv[4](5);
     if(zsun) { // need to rotate a bit for GC to have rv[3][2]=0
-	double t;
-	if(z!=zsun) {
-	    z = zsun;
-	    t = hypot(zsun,Rsun);
-	    s = zsun/t;
-	    c = Rsun/t;
-	}
+	double t = hypot(zsun,Rsun), s = zsun/t, c = Rsun/t;
 	t      = rv[3](0);
 	rv[3][0] = c*t - s*rv[3](2);
 	rv[3][2] = s*t + c*rv[3](2);
@@ -70,16 +63,9 @@ void OmniCoords::LSRfromGCA()
 
 void OmniCoords::GCAfromLSR()
 {
-    static double z=0.,s=0.,c=1.;
     if(zsun) { // need to rotate a bit for GC to have rv[3][2]=0
         vec6 in=rv[3];
-	double t;
-	if(z!=zsun) {
-	    z = zsun;
-	    t = hypot(zsun,Rsun);
-	    s = zsun/t;
-	    c = Rsun/t;
-	}
+	double t = hypot(zsun,Rsun), s = zsun/t, c = Rsun/t;
  	t     = in(0);
 	in[0] = c*t + s*in(2);
 	in[2] =-s*t + c*in(2);
@@ -16,7 +16,7 @@
 
 namespace torus {
 
-double trapzd(double(*func)(double), const double, const double, const int);
+double trapzd(double(*func)(double), const double, const double, const int, double&);
 double polint(double*, double*, const int, const double, double&, double&);
 double qromb(double(*func)(double), const double, 
 	     const double, const double = 1.e-6);
@@ -27,10 +27,11 @@ void   kstwo(double*, int, double*, int, double&, double&);
 
 
 
+// the running value of the integral is kept in the last argument
+// (rather than in a static variable, so that it may be used from several threads)
 template <class C>
 double trapzd(const C* const o, double(C::*func)(double) const,
-	      const double a, const double b,const int n) {
-  static double s;
+	      const double a, const double b,const int n, double& s) {
 
   if(n==1)
     return (s=0.5*(b-a)*(o->*func)(a)+(o->*func)(b));
@@ -54,11 +55,11 @@ double qromb(const C* const o, double(C::*func)(double) const, const double a,
 {
   const double EPS = 1.e-6;
   const int JMAX=20, JMAXP = JMAX+1, K=5;
-  double ss,dss, s[JMAX], h[JMAXP], s_t[K], h_t[K];
+  double ss,dss, s[JMAX], h[JMAXP], s_t[K], h_t[K], st=0;
   
   h[0]=1.;
   for(int j=1; j<=JMAX;j++) {
-    s[j-1] = trapzd(o,func,a,b,j);
+    s[j-1] = trapzd(o,func,a,b,j,st);
     if(j>=K) {
       for(int i=0;i<K;i++) {
 	h_t[i] = h[j-K+i];
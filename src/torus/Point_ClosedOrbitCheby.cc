@@ -384,12 +384,6 @@ void PoiClosedOrbit::set_parameters(Potential *Phi, const Actions J) {
   delete[] yzfull;
 }
 
-// various numbers needed for Derivatives() 
-double R,z,r,th,th2,ir,costh,sinth,pr,pth,xpp,ypp,zpp,dx,dy,dz,d2x,d2y,d2z,
-  rt,tht,prt,ptht;
-double drtdr, drtdth, dthtdr, dthtdth;
-double dthdtht, dthdrt, drdtht, drdrt;
-
 PoiClosedOrbit::PoiClosedOrbit(const double* param) {
   set_parameters(param);
 }
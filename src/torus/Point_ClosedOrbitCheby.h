@@ -70,6 +70,11 @@ class PoiClosedOrbit : public PoiTra {
   double thmaxforactint;  // used to find the action
   Cheby vr2, drdth2, pth2;//         ''
   double actint(double) const;
+  // various numbers set by Forward()/Backward() and needed by Derivatives()
+  mutable double R,z,r,th,th2,ir,costh,sinth,pr,pth,xpp,ypp,zpp,
+    dx,dy,dz,d2x,d2y,d2z, rt,tht,prt,ptht;
+  mutable double drtdr, drtdth, dthtdr, dthtdth;
+  mutable double dthdtht, dthdrt, drdtht, drdrt;
 // ROUTINES USED TO FIND THE TRANSFORM -----------------------------------------
   // Integrate orbit over Pi in th_z & store output
   void do_orbit       (PSPD, double, Potential*, double*, double*, double*, 
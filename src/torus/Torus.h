@@ -73,6 +73,8 @@ private:
   GenFnc	GF;                           // Generating function (J,thT->JT)
   AngMap	AM;                           // Angle Mapping (th->thT)
   bool useNewAngMap;  // choice of the method for angle mapping (old/new)
+  mutable double RforSOS;                     // scratch state of the root-finders
+  mutable PSPD   Jtroot;                      // used by SOS() and SOS_z()
 
   Angles      mirror_Angles(Angles,double) const; 
   // For given angles & coord phi, find angles giving same x, -vR, -vz, vphi  
@@ -403,6 +405,26 @@ in the given */
 // used as initial guess and are changed in order to fit the torus in the given
 // potential.
 
+    int          WarmFit  	   (Actions,              // Actions
+				    Potential*,		  // galactic potential
+				    const Torus&,	  // converged torus with
+							  //    nearby actions
+				    const double  =0.003, // goal for |dJ|/|J|
+				    const int     =600,   // max. number of Sn
+				    const int     =150,	  // max. iterations
+				    const int     =12,    // max. SN tailorings 
+				    const int     =3,	  // overdetermination
+				    const int     =16,	  // min. # of cells
+							  //	for angle fit
+				    const int     =200,   // max. # of steps
+							  //    on av. per cell
+				    const int     =12,    // min. # of theta
+							  //    per dim 
+				    const int     =0);	  // error output?
+// as AutoFit, but the toy map, generating function and frequencies of the
+// given torus are used as the initial guess; if this fit does not succeed
+// (or the given torus uses a point transform), falls back to AutoFit.
+
 
  /*    int          ManualHalfFit   (Potential*,  // galactic potential */
 /* 			    const double  =0.001, // goal for |dJ|/|J| */
@@ -984,6 +1006,35 @@ inline int Torus::AutoFit(Actions Jin, Potential *Phi, const double tol,
 }
 
 
+inline int Torus::WarmFit(Actions Jin, Potential *Phi, const Torus& guess,
+			  const double tol, 
+			  const int Max, const int Mit, const int Nta, 
+			  const int Over, const int Ncl,
+			  const int ipc, const int Nth, const int err)
+{
+  // a torus fitted with a point transform is a poor starting point
+  // for the generic fit used here
+  if(!guess.PT || !guess.TM || guess.PT->NumberofParameters())
+    return AutoFit(Jin,Phi,tol,Max,Mit,Nta,Over,Ncl,ipc,Nth,err);
+  SetMaps(guess.TP(),guess.SN(),guess.AP());
+  J = Jin;
+  E = 0.;
+  Om = guess.Om;
+  dc = 0.;
+  GenPar SN=GF.parameters();
+  AngPar AP=AM.parameters();
+  int F = AllFit(J,Phi,tol,Max,Mit,Over,Ncl,*PT,*TM,SN,AP,
+		 Om,E,dc,0,false,Nta,ipc,E,Nth,err,useNewAngMap);
+  if(F) {
+    if(err) cerr << "WarmFit failed, using AutoFit\n";
+    return AutoFit(Jin,Phi,tol,Max,Mit,Nta,Over,Ncl,ipc,Nth,err);
+  }
+  GF.set_parameters(SN);
+  AM.set_parameters(AP);
+  FindLimits();
+  return F;
+}
+
 
 /* inline int Torus::ManualHalfFit(Potential* Phi, const double tol, const int Max, */
 /* 				const int Mit, const int Nta, const int Nth,  */
@@ -167,26 +167,36 @@ namespace {
 volatile bool ctrlBreakTriggered;
 /// signal handler installed during lengthy computations that triggers the flag
 void customCtrlBreakHandler(int) { ctrlBreakTriggered = true; }
-/// a stack of previous signal handlers restored after the computation is finished
-std::vector<void(*)(int)> prevCtrlBreakHandler;
+/// the signal handler that was active before the custom one was installed
+void(*prevCtrlBreakHandler)(int);
+/// number of existing instances of CtrlBreakHandler, possibly in different threads
+int numCtrlBreakHandlers = 0;
 }
 
 CtrlBreakHandler::CtrlBreakHandler()
 {
-    // this class could be instantiated multiple times in nested routines,
-    // but the break flag is cleared only for the outermost one.
-    if(prevCtrlBreakHandler.empty())
+    // this class could be instantiated multiple times in nested routines or in several threads,
+    // but the custom handler is installed and the break flag is cleared only by the first instance
+#ifdef _OPENMP
+#pragma omp critical(CtrlBreakHandler)
+#endif
+    if(numCtrlBreakHandlers++ == 0) {
         ctrlBreakTriggered = false;
-    // store the previous signal handler on the stack, and set the new one
-    prevCtrlBreakHandler.push_back(signal(SIGINT, customCtrlBreakHandler));
+        prevCtrlBreakHandler = signal(SIGINT, customCtrlBreakHandler);
+    }
 }
 
 CtrlBreakHandler::~CtrlBreakHandler()
 {
-    // restore the previous handler once the instance of the class is destroyed
-    assert(!prevCtrlBreakHandler.empty());       // it must have been set in the constructor
-    signal(SIGINT, prevCtrlBreakHandler.back()); // restore the previous handler
-    prevCtrlBreakHandler.pop_back();             // and eliminate it from the stack
+    // restore the previous handler once the last instance of the class is destroyed
+#ifdef _OPENMP
+#pragma omp critical(CtrlBreakHandler)
+#endif
+    {
+        assert(numCtrlBreakHandlers > 0);  // it must have been incremented in the constructor
+        if(--numCtrlBreakHandlers == 0)
+            signal(SIGINT, prevCtrlBreakHandler);
+    }
 }
 
 bool CtrlBreakHandler::triggered() { return ctrlBreakTriggered; }
@@ -74,7 +74,8 @@ std::string stacktrace();
     exception, which then will be dealt within the script (or simply ignored in an interactive
     session).
 
-    It is safe to instantiate this class multiple times, in nested routines.
+    It is safe to instantiate this class multiple times, in nested routines or in different threads:
+    the custom handler is installed by the first instance and removed by the last one.
 */
 class CtrlBreakHandler {
 public:
@@ -0,0 +1,129 @@
+#include "utils_counters.h"
+#include "utils.h"
+#include <cstring>
+#include <ctime>
+#include <map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace utils {
+
+namespace {
+
+/// names of counter types, in the same order as in the CounterType enum
+static const char* counterNames[CNT_NUM] = {
+    "potential evaluations",
+    "actions",
+    "action/angle mappings",
+    "ODE steps",
+    "ODE rejected steps",
+    "integrateNdim calls",
+    "integrateNdim function evaluations",
+    "sampleNdim calls",
+    "sampleNdim trial points" };
+
+/// list of slots of all threads that have used the counters (never deallocated,
+/// so that the values accumulated by threads that have already finished are not lost)
+std::vector<CounterSlot*> allSlots;
+
+}  // internal namespace
+
+namespace internal {
+
+COUNTER_THREAD_LOCAL CounterSlot* threadCounterSlot = NULL;
+
+CounterSlot* createCounterSlot()
+{
+    CounterSlot* slot = new CounterSlot();
+    std::memset(slot, 0, sizeof(CounterSlot));
+#ifdef _OPENMP
+#pragma omp critical(utilsCounters)
+#endif
+    allSlots.push_back(slot);
+    threadCounterSlot = slot;
+    return slot;
+}
+
+double counterTime()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return std::clock() * 1.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+}  // namespace internal
+
+bool countersEnabled()
+{
+#ifdef INSTRUMENT_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<CounterValue> getCounters()
+{
+    std::vector<CounterValue> result;
+    for(int c=0; c<CNT_NUM; c++)
+        result.push_back(CounterValue(counterNames[c], 0, 0));
+    // potential classes are aggregated by name (not by pointer, which may differ between slots)
+    std::map<std::string, size_t> potIndex;
+    for(size_t s=0; s<allSlots.size(); s++) {
+        const CounterSlot& slot = *allSlots[s];
+        for(int c=0; c<CNT_NUM; c++) {
+            result[c].count += slot.count[c];
+            result[c].time  += slot.time [c];
+        }
+        for(int p=0; p<=slot.numPotClasses; p++) {
+            std::string name = p<slot.numPotClasses ? slot.potName[p] : "other";
+            if(p==slot.numPotClasses && slot.potCount[CounterSlot::MAX_POT_CLASSES] == 0)
+                continue;
+            unsigned long long count = p<slot.numPotClasses ?
+                slot.potCount[p] : slot.potCount[CounterSlot::MAX_POT_CLASSES];
+            std::map<std::string, size_t>::const_iterator iter = potIndex.find(name);
+            if(iter == potIndex.end()) {
+                potIndex[name] = result.size();
+                result.push_back(CounterValue(name, count, 0));
+            } else
+                result[iter->second].count += count;
+        }
+    }
+    return result;
+}
+
+void resetCounters()
+{
+    for(size_t s=0; s<allSlots.size(); s++) {
+        CounterSlot& slot = *allSlots[s];
+        for(int c=0; c<CNT_NUM; c++) {
+            slot.count[c] = 0;
+            slot.time [c] = 0;
+        }
+        for(int p=0; p<=CounterSlot::MAX_POT_CLASSES; p++)
+            slot.potCount[p] = 0;
+        // the list of potential names is retained, since they are static strings
+    }
+}
+
+std::string countersReport()
+{
+    if(!countersEnabled())
+        return "Instrumentation counters are disabled (compile with -DINSTRUMENT_COUNTERS)\n";
+    std::vector<CounterValue> counters = getCounters();
+    std::string result;
+    for(size_t i=0; i<counters.size(); i++) {
+        if(counters[i].count == 0)
+            continue;
+        result += (i<CNT_NUM ? "" : "  ") + counters[i].name + ": " + toString(counters[i].count);
+        if(counters[i].time > 0)
+            result += " (" + toString(counters[i].time) + " s)";
+        result += '\n';
+    }
+    return result;
+}
+
+}  // namespace
@@ -0,0 +1,150 @@
+/** \file    utils_counters.h
+    \brief   Lightweight per-thread counters of hot-path operations
+    \author  Eugene Vasiliev
+    \date    2026
+
+    This module provides a simple instrumentation facility for finding out where the time is spent
+    in a given computation, without resorting to an external profiler.
+    It counts (and in some cases, times) the calls to the main work units of the library:
+    evaluations of potentials (separately for each potential class), computation of actions
+    and the inverse mapping from actions/angles to position/velocity,
+    steps (accepted and rejected) of the 8th-order Runge-Kutta ODE solver, function evaluations
+    in multidimensional integration and trial points in multidimensional sampling.
+
+    The instrumentation is disabled by default and has zero overhead in this case;
+    to enable it, add the flag -DINSTRUMENT_COUNTERS to CXXFLAGS in Makefile.local
+    (it should be applied both to the library and to any programs using it, since some of
+    the counters are placed in inline functions in header files).
+    Each thread accumulates the counts in its own private storage, so that no synchronization
+    is needed in the hot path; the values from all threads are summed up when the report is requested.
+    The routines getCounters() and resetCounters() should be called outside parallel sections.
+*/
+#pragma once
+#include <string>
+#include <vector>
+
+namespace utils {
+
+/// types of events monitored by the instrumentation counters
+enum CounterType {
+    CNT_POTENTIAL_EVAL,     ///< evaluations of BasePotential::eval (total for all classes)
+    CNT_ACTIONS,            ///< computations of actions (with or without angles) by action finders
+                            ///< and standalone action routines (Isochrone, Spherical, Staeckel, Fudge)
+    CNT_ACTION_MAP,         ///< mappings from action/angle to position/velocity by action mappers
+                            ///< (Torus, TorusGrid) and standalone routines (mapIsochrone, mapSpherical)
+    CNT_ODE_STEP,           ///< accepted steps of the DOP853 ODE solver
+    CNT_ODE_REJECTED,       ///< rejected steps of the DOP853 ODE solver
+    CNT_INTEGRATE_NDIM,     ///< calls to integrateNdim
+    CNT_INTEGRATE_NDIM_EVAL,///< function evaluations in integrateNdim
+    CNT_SAMPLE_NDIM,        ///< calls to sampleNdim
+    CNT_SAMPLE_NDIM_POINT,  ///< trial points (function evaluations) in sampleNdim
+    CNT_NUM                 ///< total number of counter types (not a real counter)
+};
+
+/// aggregated value of a single counter
+struct CounterValue {
+    std::string name;       ///< name of the counter (or the potential class)
+    unsigned long long count;  ///< number of events summed over all threads
+    double time;            ///< total wall-clock time in seconds summed over all threads (0 if not timed)
+    CounterValue(const std::string& _name, unsigned long long _count, double _time) :
+        name(_name), count(_count), time(_time) {}
+};
+
+/// return true if the instrumentation is enabled at compile time
+bool countersEnabled();
+
+/** return the values of all counters summed over all threads:
+    first the counters from the CounterType list, then the number of potential evaluations
+    for each potential class (only those that have been used), in the order of first use */
+std::vector<CounterValue> getCounters();
+
+/// reset all counters to zero
+void resetCounters();
+
+/// return a human-readable table of all nonzero counters
+std::string countersReport();
+
+/// per-thread storage of counters (not to be used directly)
+struct CounterSlot {
+    static const int MAX_POT_CLASSES = 63;
+    unsigned long long count[CNT_NUM];
+    double time[CNT_NUM];
+    const char* potName[MAX_POT_CLASSES+1];  ///< the last element collects all remaining classes
+    unsigned long long potCount[MAX_POT_CLASSES+1];
+    int numPotClasses;
+    char padding[64];  ///< avoid false sharing of cache lines between slots of different threads
+};
+
+namespace internal {
+
+#ifdef _MSC_VER
+#define COUNTER_THREAD_LOCAL __declspec(thread)
+#else
+#define COUNTER_THREAD_LOCAL __thread
+#endif
+
+/// pointer to the slot of the current thread (NULL until the first use)
+extern COUNTER_THREAD_LOCAL CounterSlot* threadCounterSlot;
+
+/// allocate and register the slot for the current thread
+CounterSlot* createCounterSlot();
+
+/// wall-clock time used in timing the events
+double counterTime();
+
+/// return the slot of the current thread
+inline CounterSlot& counterSlot()
+{
+    CounterSlot* slot = threadCounterSlot;
+    return slot ? *slot : *createCounterSlot();
+}
+
+/// count one evaluation of a potential with the given class name
+/// (the name is assumed to be a static string, and is compared by pointer)
+inline void countPotentialEval(const char* name)
+{
+    CounterSlot& slot = counterSlot();
+    slot.count[CNT_POTENTIAL_EVAL]++;
+    for(int i=0; i<slot.numPotClasses; i++)
+        if(slot.potName[i] == name) {
+            slot.potCount[i]++;
+            return;
+        }
+    if(slot.numPotClasses < CounterSlot::MAX_POT_CLASSES) {
+        slot.potName [slot.numPotClasses] = name;
+        slot.potCount[slot.numPotClasses] = 1;
+        slot.numPotClasses++;
+    } else
+        slot.potCount[CounterSlot::MAX_POT_CLASSES]++;
+}
+
+/// accumulates the time spent between its construction and destruction into the given counter,
+/// and increments the number of events
+class CounterTimer {
+    const CounterType type;
+    const double timeStart;
+public:
+    explicit CounterTimer(CounterType _type) : type(_type), timeStart(counterTime()) {}
+    ~CounterTimer() {
+        CounterSlot& slot = counterSlot();
+        slot.count[type]++;
+        slot.time [type] += counterTime() - timeStart;
+    }
+};
+
+}  // namespace internal
+
+}  // namespace
+
+#ifdef INSTRUMENT_COUNTERS
+/// increment the counter of the given type (one of CounterType values) by the given amount
+#define COUNTER_ADD(type, num) (utils::internal::counterSlot().count[utils::type] += (num))
+/// count one evaluation of the potential with the given class name
+#define COUNTER_POTENTIAL_EVAL(name) utils::internal::countPotentialEval(name)
+/// count one event of the given type and time it until the end of the current scope
+#define COUNTER_TIMER(type) utils::internal::CounterTimer counterTimer_##type(utils::type)
+#else
+#define COUNTER_ADD(type, num)
+#define COUNTER_POTENTIAL_EVAL(name)
+#define COUNTER_TIMER(type)
+#endif
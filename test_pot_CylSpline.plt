@@ -0,0 +1,19 @@
+set term pdf enhanced size 15cm,10cm
+set output 'test_pot_CylSpline.pdf'
+set logscale
+set xrange [1e-7:1e9]
+set yrange [1e-16:1e-4]
+set format x '10^{%T}'
+set format y '10^{%T}'
+set multiplot layout 2,2
+plot 'test_pot_CylSpline.dat' u 2:(abs($3/$2-1)) w l title 'Rcirc(E),root', \
+  '' u 2:(abs($4/$2-1)) w l title 'Rcirc(E),interp', \
+  '' u 2:(abs($8/$2-1)) w l title 'Rcirc(Lz),root', \
+  '' u 2:(abs($9/$2-1)) w l title 'Rcirc(Lz),interp'
+plot '' u 2:(abs($6/$5-1)) w l title 'Lcirc(E),root', \
+  '' u 2:(abs($7/$5-1)) w l title 'Lcirc(E),interp'
+plot '' u 2:(abs($10/$2-1)) w l title 'Rmax(E),root', \
+  '' u 2:(abs($11/$2-1)) w l title 'Rmax(E),interp'
+plot '' u 2:(abs($15/$12-1)) w l title 'Phi(r),interp', \
+  '' u 2:(abs($16/$13-1)) w l title 'dPhi/dr,interp', \
+  '' u 2:(abs($17/$14-1)) w l title 'rho,interp'
@@ -0,0 +1,437 @@
+/** \file   benchmark.cpp
+    \brief  Standing performance benchmark suite
+    \author Eugene Vasiliev
+    \date   2026
+
+    This program measures the throughput of the main computational kernels of the library:
+    potential evaluation for various potential types, action finders, DF evaluation,
+    computation of DF moments, orbit integration with targets, N-dimensional sampling,
+    and N-body snapshot input/output.
+    Each benchmark is repeated until it takes at least the prescribed amount of time,
+    and its throughput (operations per second) is reported on the screen and written
+    into a machine-readable JSON file.
+    If a baseline file (in the same format, produced by an earlier run) is provided,
+    the results are compared with it, and the program returns a non-zero exit code
+    if any benchmark is slower than the baseline by more than the given tolerance.
+    Command-line arguments (all optional, in the form key=value):
+    threads=1    - number of OpenMP threads used in the parallel sections;
+    duration=0.5 - minimum duration of each benchmark in seconds;
+    output=bench_output.json   - file for storing the results;
+    baseline=    - file with the baseline results for comparison (skipped if not provided;
+    if the file is provided but does not exist, this is reported as an error);
+    tolerance=0.2  - max allowed relative decrease in throughput w.r.t. the baseline;
+    filter=      - run only the benchmarks whose name contains this substring.
+    This program is built and run by `make bench`, which compares the results with
+    tests/bench_baseline.json. The baseline is machine-specific and is not distributed with the code:
+    it should be created on the reference machine by running `make bench` once (this run fails
+    because the baseline is missing, but still writes the results) and then `make bench-baseline`,
+    which stores the results of the last run as the new baseline.
+*/
+#include "potential_factory.h"
+#include "potential_analytic.h"
+#include "potential_composite.h"
+#include "actions_staeckel.h"
+#include "actions_spherical.h"
+#include "actions_isochrone.h"
+#include "df_factory.h"
+#include "galaxymodel_base.h"
+#include "galaxymodel_densitygrid.h"
+#include "galaxymodel_target.h"
+#include "math_sample.h"
+#include "math_random.h"
+#include "math_core.h"
+#include "particles_io.h"
+#include "utils.h"
+#include "utils_config.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <ctime>
+#include <cmath>
+#include <map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// wall-clock time in seconds (CPU time if OpenMP is not available)
+double wallTime()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return std::clock() * 1.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+/// minimum duration of each benchmark in seconds
+double minDuration = 0.5;
+
+/// accumulator for the results of computations, preventing them from being optimized away
+volatile double sink = 0;
+
+/// Prototype of a single benchmark: performs a fixed amount of work in each call to run(),
+/// returning the number of elementary operations performed
+class BaseBenchmark {
+public:
+    virtual ~BaseBenchmark() {}
+    virtual const char* name() const = 0;
+    virtual size_t run() = 0;
+};
+
+/// result of a single benchmark
+struct BenchResult {
+    std::string name;
+    size_t ops;
+    double seconds;
+    double opsPerSec() const { return ops / seconds; }
+};
+
+/// run the benchmark repeatedly until it takes at least minDuration seconds
+BenchResult measure(BaseBenchmark& bench)
+{
+    BenchResult result;
+    result.name = bench.name();
+    result.ops  = bench.run();   // warm-up run (also initializes any lazily constructed tables)
+    result.ops  = 0;
+    double tbegin = wallTime();
+    do {
+        result.ops += bench.run();
+        result.seconds = wallTime() - tbegin;
+    } while(result.seconds < minDuration);
+    return result;
+}
+
+/// an array of random points (position/velocity) roughly following a spheroidal distribution
+std::vector<coord::PosVelCar> makePoints(size_t count, double scale)
+{
+    std::vector<coord::PosVelCar> points(count);
+    math::PRNGState state = 42;
+    for(size_t i=0; i<count; i++) {
+        double r = scale * math::random(&state) / (1.01 - math::random(&state)), dir[3], vel[3];
+        math::getRandomUnitVector(dir, &state);
+        math::getRandomUnitVector(vel, &state);
+        double v = 0.7 / sqrt(sqrt(1 + r*r)) * math::random(&state);
+        points[i] = coord::PosVelCar(r*dir[0], r*dir[1], r*dir[2] * 0.5, v*vel[0], v*vel[1], v*vel[2]);
+    }
+    return points;
+}
+
+//----- potential evaluation -----//
+class BenchPotential: public BaseBenchmark {
+    const std::string label;
+    const potential::PtrPotential pot;
+    const std::vector<coord::PosVelCar> points;
+public:
+    BenchPotential(const std::string& _label, const potential::PtrPotential& _pot) :
+        label("potential_eval/" + _label), pot(_pot), points(makePoints(10000, 2.)) {}
+    virtual const char* name() const { return label.c_str(); }
+    virtual size_t run() {
+        double sum = 0;
+        for(size_t i=0; i<points.size(); i++) {
+            double Phi;
+            coord::GradCar grad;
+            pot->eval(points[i], &Phi, &grad);
+            sum += Phi + grad.dx;
+        }
+        sink = sum;
+        return points.size();
+    }
+};
+
+//----- action finders -----//
+class BenchActionFinder: public BaseBenchmark {
+    const std::string label;
+    const actions::BaseActionFinder& af;
+    std::vector<coord::PosVelCyl> points;
+public:
+    BenchActionFinder(const std::string& _label, const actions::BaseActionFinder& _af,
+        const potential::BasePotential& pot) :
+        label("actions/" + _label), af(_af)
+    {
+        // retain only bound points
+        std::vector<coord::PosVelCar> pts = makePoints(2000, 1.);
+        for(size_t i=0; i<pts.size(); i++)
+            if(totalEnergy(pot, pts[i]) < 0)
+                points.push_back(toPosVelCyl(pts[i]));
+    }
+    virtual const char* name() const { return label.c_str(); }
+    virtual size_t run() {
+        double sum = 0;
+        for(size_t i=0; i<points.size(); i++) {
+            actions::Actions act = af.actions(points[i]);
+            sum += act.Jz;
+        }
+        sink = sum;
+        return points.size();
+    }
+};
+
+class BenchActionsIsochrone: public BaseBenchmark {
+    std::vector<coord::PosVelCyl> points;
+public:
+    BenchActionsIsochrone() {
+        potential::Isochrone pot(1., 1.);
+        std::vector<coord::PosVelCar> pts = makePoints(10000, 1.);
+        for(size_t i=0; i<pts.size(); i++)
+            if(totalEnergy(pot, pts[i]) < 0)
+                points.push_back(toPosVelCyl(pts[i]));
+    }
+    virtual const char* name() const { return "actions/Isochrone"; }
+    virtual size_t run() {
+        double sum = 0;
+        for(size_t i=0; i<points.size(); i++)
+            sum += actions::actionsIsochrone(1., 1., points[i]).Jr;
+        sink = sum;
+        return points.size();
+    }
+};
+
+//----- DF evaluation -----//
+class BenchDF: public BaseBenchmark {
+    const df::PtrDistributionFunction df;
+    std::vector<actions::Actions> acts;
+    std::vector<double> values;
+public:
+    BenchDF(const df::PtrDistributionFunction& _df) : df(_df), acts(100000), values(acts.size())
+    {
+        math::PRNGState state = 42;
+        for(size_t i=0; i<acts.size(); i++)
+            acts[i] = actions::Actions(
+                -log(math::random(&state)), -log(math::random(&state)), log(math::random(&state)));
+    }
+    virtual const char* name() const { return "df_evalmany/DoublePowerLaw"; }
+    virtual size_t run() {
+        df->evalmany(acts.size(), &acts[0], false, &values[0]);
+        return acts.size();
+    }
+};
+
+//----- DF moments -----//
+class BenchMoments: public BaseBenchmark {
+    const galaxymodel::GalaxyModel& model;
+public:
+    BenchMoments(const galaxymodel::GalaxyModel& _model) : model(_model) {}
+    virtual const char* name() const { return "computeMoments"; }
+    virtual size_t run() {
+        const int NPOINTS = 8;
+        for(int i=0; i<NPOINTS; i++) {
+            double dens;
+            coord::VelCar vel;
+            coord::Vel2Car vel2;
+            galaxymodel::computeMoments(model, coord::PosCar(0.25*(i+1), 0.1*i, 0.05*i),
+                &dens, &vel, &vel2);
+        }
+        return NPOINTS;
+    }
+};
+
+//----- orbit integration with targets -----//
+class BenchOrbitTarget: public BaseBenchmark {
+    const potential::PtrPotential pot;
+    const galaxymodel::TargetDensitySphHarm target;
+    std::vector<coord::PosVelCar> ics;
+    std::vector<galaxymodel::StorageNumT> output;
+public:
+    BenchOrbitTarget(const potential::PtrPotential& _pot) :
+        pot(_pot), target(4, 4, math::createExpGrid(20, 0.01, 20.))
+    {
+        std::vector<coord::PosVelCar> pts = makePoints(200, 1.);
+        for(size_t i=0; i<pts.size(); i++)
+            if(totalEnergy(*pot, pts[i]) < 0)
+                ics.push_back(pts[i]);
+        output.resize(ics.size() * target.numCoefs());
+    }
+    virtual const char* name() const { return "orbit_integration_with_target"; }
+    virtual size_t run() {
+        ptrdiff_t norbits = ics.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for(ptrdiff_t i=0; i<norbits; i++) {
+            orbit::OrbitIntegrator<coord::Car> orbint(*pot);
+            orbint.addRuntimeFnc(orbit::PtrRuntimeFnc(new galaxymodel::RuntimeFncTarget(
+                orbint, target, &output[i * target.numCoefs()])));
+            orbint.init(ics[i]);
+            orbint.run(100.);
+        }
+        return norbits;
+    }
+};
+
+//----- N-dimensional sampling -----//
+class GaussianNdim: public math::IFunctionNdim {
+public:
+    virtual void eval(const double vars[], double values[]) const {
+        values[0] = exp(-0.5 * (pow_2(vars[0]) + pow_2(vars[1]/0.5) + pow_2(vars[2]/0.25))) *
+            (1 + 0.5 * sin(4*vars[0]));
+    }
+    virtual unsigned int numVars()   const { return 3; }
+    virtual unsigned int numValues() const { return 1; }
+};
+
+class BenchSampleNdim: public BaseBenchmark {
+public:
+    virtual const char* name() const { return "sampleNdim"; }
+    virtual size_t run() {
+        const size_t NSAMPLES = 100000;
+        const double xlower[3] = {-5, -5, -5}, xupper[3] = {5, 5, 5};
+        math::Matrix<double> samples;
+        math::sampleNdim(GaussianNdim(), xlower, xupper, NSAMPLES, samples);
+        return NSAMPLES;
+    }
+};
+
+//----- snapshot input/output -----//
+class BenchSnapshotIO: public BaseBenchmark {
+    particles::ParticleArrayCar particles;
+    const std::string fileName;
+public:
+    BenchSnapshotIO() : fileName("benchmark_snapshot.txt") {
+        std::vector<coord::PosVelCar> pts = makePoints(100000, 1.);
+        for(size_t i=0; i<pts.size(); i++)
+            particles.add(pts[i], 1./pts.size());
+    }
+    ~BenchSnapshotIO() { std::remove(fileName.c_str()); }
+    virtual const char* name() const { return "snapshot_io/Text"; }
+    virtual size_t run() {
+        particles::writeSnapshot(fileName, particles, "Text");
+        particles::ParticleArrayAux loaded = particles::readSnapshot(fileName);
+        return loaded.size() == particles.size() ? particles.size() : 0;
+    }
+};
+
+/// write the results in the JSON format
+void writeJSON(const std::string& fileName, int numThreads, const std::vector<BenchResult>& results)
+{
+    std::ofstream strm(fileName.c_str());
+    strm << "{\n  \"threads\": " << numThreads << ",\n  \"benchmarks\": [\n";
+    for(size_t i=0; i<results.size(); i++)
+        strm << "    {\"name\": \"" << results[i].name <<
+            "\", \"ops\": " << results[i].ops <<
+            ", \"seconds\": " << utils::toString(results[i].seconds, 8) <<
+            ", \"ops_per_sec\": " << utils::toString(results[i].opsPerSec(), 8) <<
+            "}" << (i+1<results.size() ? "," : "") << "\n";
+    strm << "  ]\n}\n";
+    if(!strm)
+        throw std::runtime_error("Cannot write to "+fileName);
+}
+
+/// read the throughput of each benchmark from a JSON file written by writeJSON
+/// (a minimal parser that only understands the format produced by this program)
+std::map<std::string, double> readJSON(const std::string& fileName)
+{
+    std::map<std::string, double> result;
+    std::ifstream strm(fileName.c_str());
+    std::string line;
+    while(std::getline(strm, line)) {
+        size_t posName = line.find("\"name\": \""), posOps = line.find("\"ops_per_sec\": ");
+        if(posName == std::string::npos || posOps == std::string::npos)
+            continue;
+        posName += 9;
+        std::string name = line.substr(posName, line.find('"', posName) - posName);
+        result[name] = utils::toDouble(line.substr(posOps + 15));
+    }
+    return result;
+}
+
+}  // internal namespace
+
+int main(int argc, const char* argv[])
+{
+    utils::KeyValueMap args(argc-1, argv+1);
+    int numThreads         = args.getInt   ("threads", 1);
+    minDuration            = args.getDouble("duration", minDuration);
+    std::string outputFile = args.getString("output", "bench_output.json");
+    std::string baselineFile = args.getString("baseline");
+    std::string filter     = args.getString("filter");
+    double tolerance       = args.getDouble("tolerance", 0.2);
+#ifdef _OPENMP
+    omp_set_num_threads(numThreads);
+#else
+    numThreads = 1;
+#endif
+
+    // construct the models used in the benchmarks
+    potential::PtrPotential potMul = potential::createPotential(utils::KeyValueMap(
+        "type=Multipole density=Dehnen gamma=1 scaleRadius=1 axisRatioZ=0.8 lmax=8"));
+    potential::PtrPotential potCyl = potential::createPotential(utils::KeyValueMap(
+        "type=CylSpline density=Disk surfaceDensity=0.5 scaleRadius=1 scaleHeight=0.1 "
+        "gridSizeR=25 gridSizeZ=25 mmax=0"));
+    potential::PtrPotential potNFW(new potential::NFW(1., 2.));
+    potential::PtrPotential potMN (new potential::MiyamotoNagai(0.5, 1., 0.2));
+    std::vector<potential::PtrPotential> comps;
+    comps.push_back(potMul);
+    comps.push_back(potCyl);
+    comps.push_back(potNFW);
+    potential::PtrPotential potComp(new potential::Composite(comps));
+    potential::PtrPotential potIso(new potential::Isochrone(1., 1.));
+    actions::ActionFinderAxisymFudge afFudge(potComp, /*interpolate*/false);
+    actions::ActionFinderAxisymFudge afFudgeInterp(potComp, /*interpolate*/true);
+    actions::ActionFinderSpherical afSph(*potIso);
+    df::PtrDistributionFunction df = df::createDistributionFunction(utils::KeyValueMap(
+        "type=DoublePowerLaw norm=1 J0=1 slopeIn=1.5 slopeOut=5"));
+    galaxymodel::GalaxyModel model(*potIso, afSph, *df);
+
+    // list of benchmarks
+    std::vector<shared_ptr<BaseBenchmark> > benchmarks;
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchPotential("Multipole", potMul)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchPotential("CylSpline", potCyl)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchPotential("Composite", potComp)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchPotential("NFW", potNFW)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchPotential("MiyamotoNagai", potMN)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchActionFinder("Fudge", afFudge, *potComp)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(
+        new BenchActionFinder("FudgeInterpolated", afFudgeInterp, *potComp)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchActionFinder("Spherical", afSph, *potIso)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchActionsIsochrone()));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchDF(df)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchMoments(model)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchOrbitTarget(potComp)));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchSampleNdim()));
+    benchmarks.push_back(shared_ptr<BaseBenchmark>(new BenchSnapshotIO()));
+
+    // run the benchmarks
+    std::vector<BenchResult> results;
+    for(size_t b=0; b<benchmarks.size(); b++) {
+        if(!filter.empty() && std::string(benchmarks[b]->name()).find(filter) == std::string::npos)
+            continue;
+        results.push_back(measure(*benchmarks[b]));
+        std::cout << results.back().name << std::string(
+            std::max<int>(1, 40-results.back().name.size()), ' ') <<
+            utils::pp(results.back().opsPerSec(), 10) << " ops/s\n";
+    }
+    writeJSON(outputFile, numThreads, results);
+    std::cout << "Results written to " << outputFile << "\n";
+
+    // compare with the baseline
+    if(baselineFile.empty()) {
+        std::cout << "No baseline results to compare with\n";
+        return 0;
+    }
+    if(!utils::fileExists(baselineFile)) {
+        std::cout << "\033[1;31mBaseline file " << baselineFile << " does not exist\033[0m; "
+            "run `make bench-baseline` to store the results of this run as the baseline\n";
+        return 1;
+    }
+    std::map<std::string, double> baseline = readJSON(baselineFile);
+    bool ok = true;
+    for(size_t i=0; i<results.size(); i++) {
+        std::map<std::string, double>::const_iterator iter = baseline.find(results[i].name);
+        if(iter == baseline.end() || !(iter->second > 0))
+            continue;
+        double ratio = results[i].opsPerSec() / iter->second;
+        bool regressed = ratio < 1 - tolerance;
+        ok &= !regressed;
+        if(regressed || utils::verbosityLevel >= utils::VL_DEBUG)
+            std::cout << results[i].name << ": " << utils::pp(ratio, 6) << " of baseline" <<
+                (regressed ? " \033[1;31m**\033[0m\n" : "\n");
+    }
+    if(ok)
+        std::cout << "\033[1;32mNO REGRESSIONS\033[0m\n";
+    else
+        std::cout << "\033[1;31mSOME BENCHMARKS REGRESSED\033[0m\n";
+    return ok ? 0 : 1;
+}
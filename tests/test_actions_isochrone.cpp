@@ -29,6 +29,7 @@ bool test_isochrone(const coord::PosVelCyl& initial_conditions, const char* titl
     const double epst = 1e-9;  // accuracy of reverse transformation (pv=>aa=>pv) for isochrone
     const double epss = 1e-7;  // accuracy of reverse transformation for spherical a/a mapping
     const double epsi = 1e-6;  // accuracy of reverse transformation for interpolated spherical mapping
+    const double epsg = 2e-7;  // accuracy of interpolated radial action w.r.t. the exact spherical one
     const double epsf = 1e-7;  // accuracy of frequency determination
     const double M = 2.7;      // mass and
     const double b = 0.6;      // scale radius of Isochrone potential
@@ -41,8 +42,10 @@ bool test_isochrone(const coord::PosVelCyl& initial_conditions, const char* titl
     std::vector< std::pair<coord::PosVelCar, double> > traj = orbit::integrateTraj(
         toPosVelCar(initial_conditions), total_time, timestep, pot, /*Omega*/0, params);
     actions::ActionFinderSpherical actGrid(pot);  // interpolation-based action finder/mapper
-    actions::ActionStat statI, statS, statF, statG;
-    actions::ActionAngles aaI, aaF, aaS, aaG;
+    // same in float, with the grid refined adaptively
+    actions::ActionFinderSpherical actGridSP(pot, /*singlePrecision*/ true, /*accuracy*/ 1e-3);
+    actions::ActionStat statI, statS, statF, statG, statP;
+    actions::ActionAngles aaI, aaF, aaS, aaG, aaP;
     actions::Frequencies frI, frF, frS, frG, frIinv, frSinv;
     math::Averager statfrIr, statfrIz, statH, statE;
     double errSinv=0, errGinv=0;
@@ -51,6 +54,7 @@ bool test_isochrone(const coord::PosVelCyl& initial_conditions, const char* titl
     bool reversible_iso = true;   // forward-reverse transform for isochrone gives the original point
     bool reversible_sph = true;   // same for spherical a/a finder/mapper
     bool reversible_grid= true;   // same for grid-interpolated spherical a/a finder/mapper
+    bool reversible_sp  = true;   // same for the single-precision adaptive finder/mapper
     bool deriv_iso_ok   = true;   // finite-difference derivs agree with analytic ones
     bool deriv_grid_ok  = true;   // same for the derivs of grid-interpolated a/a mapper
     std::ofstream strm;
@@ -68,11 +72,13 @@ bool test_isochrone(const coord::PosVelCyl& initial_conditions, const char* titl
         aaF = actions::actionAnglesAxisymFudge(pot, point, ifd, &frF);
         aaS = actions::actionAnglesSpherical(pot, point, &frS);
         aaG = actGrid. actionAngles(point, &frG);
+        aaP = actGridSP.actionAngles(point);
         statH.add(actions::computeHamiltonianSpherical(pot, aaI));  // find H(J)
         statI.add(aaI);
         statF.add(aaF);
         statS.add(aaS);
         statG.add(aaG);
+        statP.add(aaP);
         statfrIr.add(frI.Omegar);
         statfrIz.add(frI.Omegaz);
         actions::Angles anewF, anewI, anewS;
@@ -114,6 +120,7 @@ bool test_isochrone(const coord::PosVelCyl& initial_conditions, const char* titl
             math::fcmp(frG.Omegaphi, frSinv.Omegaphi, epsi) == 0;
         errGinv+=pow_2(pinv.R-point.R)+pow_2(pinv.z-point.z)+pow_2(pinv.phi-point.phi)+
         pow_2(pinv.vR-point.vR)+pow_2(pinv.vz-point.vz)+pow_2(pinv.vphi-point.vphi);
+        reversible_sp &= equalPosVel(toPosVelCyl(actGridSP.map(aaP)), point, epsi);
 
         // inverse transformation for Isochrone with derivs
         actions::DerivAct<coord::SphMod> ac;
@@ -206,11 +213,17 @@ bool test_isochrone(const coord::PosVelCyl& initial_conditions, const char* titl
     statI.finish();
     statS.finish();
     statG.finish();
+    statP.finish();
     statF.finish();
 
     bool dispI_ok = statI.rms.Jr<epsd && statI.rms.Jz<epsd && statI.rms.Jphi<epsd;
     bool dispS_ok = statS.rms.Jr<epsd && statS.rms.Jz<epsd && statS.rms.Jphi<epsd;
     bool dispG_ok = statG.rms.Jr<epsd && statG.rms.Jz<epsd && statG.rms.Jphi<epsd;
+    bool dispP_ok = statP.rms.Jr<epsd && statP.rms.Jz<epsd && statP.rms.Jphi<epsd;
+    // the interpolated actions, in double or single precision, must agree with the exact ones
+    double Ltot = statS.avg.Jz + fabs(statS.avg.Jphi);
+    bool compareSG = fabs(statS.avg.Jr-statG.avg.Jr) < epsg * (statS.avg.Jr + Ltot);
+    bool compareSP = fabs(statS.avg.Jr-statP.avg.Jr) < epsg * (statS.avg.Jr + Ltot);
     bool dispF_ok = statF.rms.Jr<epsd && statF.rms.Jz<epsd && statF.rms.Jphi<epsd;
     bool compareIF =
              fabs(statI.avg.Jr-statF.avg.Jr)<epsr
@@ -288,9 +301,18 @@ bool test_isochrone(const coord::PosVelCyl& initial_conditions, const char* titl
     ",  Jphi="<<utils::pp(statG.avg.Jphi, 6)<<" +- "<<utils::pp(statG.rms.Jphi, 7)<<
     //",  rmserrInverse="<<utils::pp(sqrt(errGinv/traj.size()),7) <<
     (dispG_ok?"":" \033[1;31m**\033[0m")<<
+    (compareSG?"":" \033[1;31mNOT EQUAL\033[0m ")<<
     (reversible_grid?"":" \033[1;31mNOT INVERTIBLE\033[0m ")<<
     (deriv_grid_ok?"":" \033[1;31mDERIVS INCONSISTENT\033[0m ")<<std::endl;
 
+    std::cout << "Interp.SP"
+    ":  Jr="  <<utils::pp(statP.avg.Jr,  14)<<" +- "<<utils::pp(statP.rms.Jr,   7)<<
+    ",  Jz="  <<utils::pp(statP.avg.Jz,  14)<<" +- "<<utils::pp(statP.rms.Jz,   7)<<
+    ",  Jphi="<<utils::pp(statP.avg.Jphi, 6)<<" +- "<<utils::pp(statP.rms.Jphi, 7)<<
+    (dispP_ok?"":" \033[1;31m**\033[0m")<<
+    (compareSP?"":" \033[1;31mNOT EQUAL\033[0m ")<<
+    (reversible_sp?"":" \033[1;31mNOT INVERTIBLE\033[0m ")<<std::endl;
+
 #ifdef PERFTEST
     clock = std::clock();
     for(size_t i=0; i<npoints*ncycles; i++)
@@ -342,8 +364,8 @@ bool test_isochrone(const coord::PosVelCyl& initial_conditions, const char* titl
     (compareIF?"":" \033[1;31mNOT EQUAL\033[0m ")<<
     (freq_ok?"":" \033[1;31mFREQS NOT CONST\033[0m ")<<
     (anglesMonotonic?"":" \033[1;31mANGLES NON-MONOTONIC\033[0m ")<<std::endl;
-    return dispI_ok && dispS_ok && dispG_ok && dispF_ok
-        && reversible_iso && reversible_sph && reversible_grid
+    return dispI_ok && dispS_ok && dispG_ok && dispP_ok && dispF_ok && compareSG && compareSP
+        && reversible_iso && reversible_sph && reversible_grid && reversible_sp
         && HofJ_ok && compareIF && freq_ok && deriv_iso_ok && deriv_grid_ok && anglesMonotonic;
 }
 
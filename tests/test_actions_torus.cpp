@@ -117,6 +117,44 @@ int main(int argc, const char* argv[]) {
     actions::ActionMapperTorus mapper(*pot, acts);
     actions::ActionFinderAxisymFudge finder(pot, false);
     allok &= test_actions(*pot, finder, mapper, acts);
+    // a small library of tori with neighbouring actions: the first one is fitted from scratch,
+    // and the remaining ones start from its parameters
+    std::vector<actions::Actions> libacts(4, acts);
+    libacts[1].Jr   *= 1.1;
+    libacts[2].Jz   *= 1.1;
+    libacts[3].Jphi *= 1.05;
+    std::vector<int> status;
+    clock_t clockStart = std::clock();
+    std::vector<actions::PtrActionMapper> library =
+        actions::createTorusLibrary(*pot, libacts, 0.003, &status);
+    std::cout << "Torus library of " << library.size() << " tori created in " <<
+        (std::clock()-clockStart)*1.0/CLOCKS_PER_SEC << " CPU seconds\n";
+    for(size_t i=0; i<library.size(); i++) {
+        allok &= status[i] == 0;
+        allok &= test_actions(*pot, finder, *library[i], libacts[i]);
+    }
+    // interpolated torus mapper on a coarse grid enclosing the given actions
+    std::vector<double> gridJr(2), gridJz(2), gridJphi(2);
+    gridJr  [0] = acts.Jr   * 0.9;  gridJr  [1] = acts.Jr   * 1.1;
+    gridJz  [0] = acts.Jz   * 0.9;  gridJz  [1] = acts.Jz   * 1.1;
+    gridJphi[0] = acts.Jphi * 0.95; gridJphi[1] = acts.Jphi * 1.05;
+    actions::ActionMapperTorusGrid gridMapper(*pot, gridJr, gridJz, gridJphi);
+    allok &= gridMapper.numNotConverged() == 0;
+    allok &= test_actions(*pot, finder, gridMapper, acts);
+    // batched mapping should give identical results to the one-by-one mapping,
+    // and the points outside the grid should produce NAN
+    std::vector<actions::ActionAngles> aa(NUM_ANGLE_SAMPLES+1);
+    for(unsigned int i=0; i<=NUM_ANGLE_SAMPLES; i++)
+        aa[i] = actions::ActionAngles(actions::Actions(acts.Jr * (0.9 + 0.2*i/NUM_ANGLE_SAMPLES),
+            acts.Jz, acts.Jphi), actions::Angles(i*0.1, i*0.2, i*0.3));
+    aa[NUM_ANGLE_SAMPLES].Jr = acts.Jr * 1.2;
+    std::vector<coord::PosVelCyl> xv(aa.size());
+    gridMapper.mapMany(aa.size(), &aa[0], &xv[0]);
+    for(unsigned int i=0; i<NUM_ANGLE_SAMPLES; i++) {
+        coord::PosVelCyl p = gridMapper.map(aa[i]);
+        allok &= p.R == xv[i].R && p.z == xv[i].z && p.vR == xv[i].vR && p.vphi == xv[i].vphi;
+    }
+    allok &= !isFinite(xv[NUM_ANGLE_SAMPLES].R);
     if(allok)
         std::cout << "\033[1;32mALL TESTS PASSED\033[0m\n";
     else
@@ -12,8 +12,10 @@
 */
 #include "coord.h"
 #include "debug_utils.h"
+#include "math_random.h"
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 
 const double eps=1e-14;  // accuracy of comparison
@@ -326,6 +328,176 @@ bool test_inf()
     test_inf<coord::Car, coord::Sph>(0, 0, INFINITY);
 }
 
+/// two values are equal up to roundoff relative to the given scale (or to their magnitude),
+/// or both are NAN
+bool sameValue(double a, double b, double scale=0)
+{
+    return a==b || (a!=a && b!=b) || fabs(a-b) <= eps * fmax(scale, fmax(fabs(a), fabs(b)));
+}
+
+/// compare the batched conversion of an array of points with the conversion of each point separately
+template<typename srcCS, typename destCS>
+bool test_conv_array(const double points[][6], int npoints)
+{
+    std::vector<double> src(npoints*6), dest(npoints*6);
+    const double* srcArr[6];
+    double* destArr[6];
+    for(int k=0; k<6; k++) {
+        srcArr[k]  = &src [k*npoints];
+        destArr[k] = &dest[k*npoints];
+        for(int n=0; n<npoints; n++)
+            src[k*npoints+n] = points[n][k];
+    }
+    bool ok = true;
+    for(int withVel=0; withVel<=1; withVel++) {
+        if(!withVel)
+            srcArr[3] = srcArr[4] = srcArr[5] = destArr[3] = destArr[4] = destArr[5] = NULL;
+        else
+            for(int k=3; k<6; k++) {
+                srcArr[k]  = &src [k*npoints];
+                destArr[k] = &dest[k*npoints];
+            }
+        coord::toPosVelArray<srcCS, destCS>(npoints, srcArr, destArr);
+        for(int n=0; n<npoints; n++) {
+            // components that are differences of larger terms are compared with an absolute
+            // tolerance, scaled by the magnitude of position and velocity of the point
+            double scale = 0, result[6];
+            for(int k=0; k<6; k++)
+                scale = fmax(scale, fabs(points[n][k]));
+            if(withVel)
+                coord::toPosVel<srcCS, destCS>(coord::PosVelT<srcCS>(points[n])).unpack_to(result);
+            else
+                coord::PosVelT<destCS>(coord::toPos<srcCS, destCS>(coord::PosVelT<srcCS>(points[n])),
+                    coord::VelT<destCS>(0, 0, 0)).unpack_to(result);
+            for(int k=0; k<(withVel ? 6 : 3); k++)
+                ok &= sameValue(result[k], dest[k*npoints+n], scale);
+        }
+    }
+    if(!ok)
+        std::cout << "Batched conversion " << srcCS::name() << " => " << destCS::name() << " failed\n";
+    return ok;
+}
+
+/** create an array of random points spanning several blocks of the batched conversion routines
+    (including an incomplete last block), and put the given special points (which require
+    the scalar fix-up) at various places, including the boundaries between blocks */
+std::vector<double> makeTestArray(int npoints, const double special[][6], int nspecial,
+    double maxR, bool angles)
+{
+    std::vector<double> points(npoints*6);
+    for(int n=0; n<npoints; n++) {
+        for(int k=0; k<6; k++)
+            points[n*6+k] = (2*math::random()-1) * (k<3 ? maxR : 3);
+        if(angles) {   // first coordinate is non-negative, and second/third are angles
+            points[n*6]  = fabs(points[n*6]);
+            points[n*6+1]= M_PI * math::random();
+            points[n*6+2]= 4 * points[n*6+2];
+        }
+    }
+    const int places[] = {0, 1, 255, 256, 257, 511, 512, 700, npoints-2, npoints-1};
+    const int nplaces = sizeof(places) / sizeof(places[0]);
+    for(int i=0; i<nplaces; i++)
+        for(int k=0; k<6; k++)
+            points[places[i]*6+k] = special[i % nspecial][k];
+    return points;
+}
+
+/// batched conversion of a large array of points mixed with degenerate ones
+template<typename srcCS, typename destCS>
+bool test_conv_array_large(const double special[][6], int nspecial, bool angles)
+{
+    const int npoints = 1000;   // almost four blocks of 256 points
+    std::vector<double> points = makeTestArray(npoints, special, nspecial, 5., angles);
+    return test_conv_array<srcCS, destCS>(reinterpret_cast<const double(*)[6]>(&points[0]), npoints);
+}
+
+/// batched conversion Cyl => ProlSph with derivatives, compared with the scalar routine
+bool test_prol_array()
+{
+    const coord::ProlSph cs(1.6);
+    const double special[][6] = {
+        {0, 1, 2, 0, 0, 0},     // z axis
+        {1, 0, 3, 0, 0, 0},     // equatorial plane
+        {0, 0, 0, 0, 0, 0},     // origin
+        {2, -2, -1, 0, 0, 0} }; // negative z
+    const int npoints = 1000;
+    std::vector<double> points = makeTestArray(npoints, special, 4, 5., false);
+    std::vector<double> src(npoints*3), dest(npoints*3), deriv(npoints*4);
+    const double* srcArr[3];
+    double* destArr[3];
+    double* derivArr[4];
+    for(int k=0; k<3; k++) {
+        srcArr [k] = &src [k*npoints];
+        destArr[k] = &dest[k*npoints];
+        for(int n=0; n<npoints; n++)
+            src[k*npoints+n] = k==0 ? fabs(points[n*6]) : points[n*6+k];
+    }
+    for(int k=0; k<4; k++)
+        derivArr[k] = &deriv[k*npoints];
+    bool ok = true;
+    for(int withDeriv=0; withDeriv<=1; withDeriv++) {
+        coord::toPosProlSphArray(npoints, srcArr, cs, destArr, withDeriv ? derivArr : NULL);
+        for(int n=0; n<npoints; n++) {
+            coord::PosDerivT<coord::Cyl, coord::ProlSph> der;
+            const coord::PosProlSph pp = coord::toPosDeriv<coord::Cyl, coord::ProlSph>(
+                coord::PosCyl(src[n], src[npoints+n], src[2*npoints+n]), cs, withDeriv ? &der : NULL);
+            ok &= sameValue(pp.lambda, dest[n]) && sameValue(pp.nu, dest[npoints+n]) &&
+                pp.phi == dest[2*npoints+n];
+            if(withDeriv)
+                ok &= sameValue(der.dlambdadR, deriv[n]) && sameValue(der.dlambdadz, deriv[npoints+n]) &&
+                    sameValue(der.dnudR, deriv[2*npoints+n]) && sameValue(der.dnudz, deriv[3*npoints+n]);
+        }
+    }
+    // the degenerate point lambda = nu = Delta^2 (R=0, |z|=Delta) in the last block must be detected
+    src[npoints-3] = 0;
+    src[2*npoints-3] = -sqrt(cs.Delta2);
+    bool thrown = false;
+    try{
+        coord::toPosProlSphArray(npoints, srcArr, cs, destArr, derivArr);
+    }
+    catch(std::runtime_error&) {
+        thrown = true;
+    }
+    if(!ok)
+        std::cout << "Batched conversion Cyl => ProlSph failed\n";
+    if(!thrown)
+        std::cout << "Batched conversion Cyl => ProlSph did not detect a degenerate point\n";
+    return ok && thrown;
+}
+
+/// batched rotations compared with the rotation of each point separately
+bool test_rotation_array()
+{
+    const coord::Orientation orientation(1.47, 2.58, 3.69);
+    const double special[][6] = { {0, 0, 0, 0, 0, 0} };
+    const int npoints = 1000;
+    std::vector<double> points = makeTestArray(npoints, special, 1, 5., false);
+    std::vector<double> src(npoints*3), rot(npoints*3), inv(npoints*3);
+    const double *srcArr[3], *rotArrC[3];
+    double *rotArr[3], *invArr[3];
+    for(int k=0; k<3; k++) {
+        srcArr[k] = &src[k*npoints];
+        rotArr[k] = &rot[k*npoints];
+        rotArrC[k]= rotArr[k];
+        invArr[k] = &inv[k*npoints];
+        for(int n=0; n<npoints; n++)
+            src[k*npoints+n] = points[n*6+k];
+    }
+    orientation.toRotated(npoints, srcArr, rotArr);
+    orientation.fromRotated(npoints, rotArrC, invArr);
+    bool ok = true;
+    for(int n=0; n<npoints; n++) {
+        double vec[3] = {src[n], src[npoints+n], src[2*npoints+n]}, res[3];
+        double scale = sqrt(pow_2(vec[0]) + pow_2(vec[1]) + pow_2(vec[2]));
+        orientation.toRotated(vec, res);
+        for(int k=0; k<3; k++)
+            ok &= sameValue(res[k], rot[k*npoints+n], scale) && sameValue(vec[k], inv[k*npoints+n], scale);
+    }
+    if(!ok)
+        std::cout << "Batched rotation failed\n";
+    return ok;
+}
+
 /// define test suite in terms of points for various coord systems
 const int numtestpoints=5;
 const double posvel_car[numtestpoints][6] = {
@@ -347,6 +519,27 @@ const double posvel_sph[numtestpoints][6] = {   // order: R, theta, phi
     {1,3.14159, 2, 1, 2, 1e-4},   // point almost along z axis, vphi must be small, but vtheta is non-zero
     {0, 2,-1, 2, 0, 0}};  // point at origin with nonzero velocity in R
 
+/// points that are converted by the scalar routine in the batched conversions
+const int numspecial=5;
+const double special_car[numspecial][6] = {
+    {0, 0, 1, 2, 3, 4},           // z axis
+    {0, 0, 0,-1,-2,-3},           // origin
+    {INFINITY, 0, 0, 1, 0, 0},    // infinite coordinate
+    {NAN, 1, 2, 3, 4, 5},         // undefined coordinate
+    {0, 0,-2, 0, 0, 1}};          // negative z axis
+const double special_cyl[numspecial][6] = {   // order: R, z, phi
+    {0, 2, 0, 0,-1, 0},           // z axis
+    {0, 0, 0, 1,-2, 0},           // origin
+    {1, 2, 1e10, 1, 2, 3},        // angle too large for the vectorized sincos
+    {1, 2, INFINITY, 1, 2, 3},    // infinite angle
+    {INFINITY, 1, 2, 0, 0, 0}};   // infinite radius
+const double special_sph[numspecial][6] = {   // order: r, theta, phi
+    {1, 0, 0,-1, 0, 0},           // z axis
+    {0, 2,-1, 2, 0, 0},           // origin
+    {1, 2, -1e10, 1, 2, 3},       // angle too large for the vectorized sincos
+    {1, NAN, 1, 1, 2, 3},         // undefined angle
+    {INFINITY, 1, 2, 0, 0, 0}};   // infinite radius
+
 int main() {
     bool passed=true;
     passed &= test_prol();  // testing a certain bugfix
@@ -375,6 +568,21 @@ int main() {
         passed &= test_conv_posvel<coord::Sph, coord::Car>(pvsph);
         passed &= test_conv_posvel<coord::Sph, coord::Cyl>(pvsph);
     }
+    passed &= test_conv_array<coord::Car, coord::Cyl>(posvel_car, numtestpoints);
+    passed &= test_conv_array<coord::Car, coord::Sph>(posvel_car, numtestpoints);
+    passed &= test_conv_array<coord::Cyl, coord::Car>(posvel_cyl, numtestpoints);
+    passed &= test_conv_array<coord::Cyl, coord::Sph>(posvel_cyl, numtestpoints);
+    passed &= test_conv_array<coord::Sph, coord::Car>(posvel_sph, numtestpoints);
+    passed &= test_conv_array<coord::Sph, coord::Cyl>(posvel_sph, numtestpoints);
+    // large arrays spanning several blocks, mixed with points that need the scalar fix-up
+    passed &= test_conv_array_large<coord::Car, coord::Cyl>(special_car, numspecial, false);
+    passed &= test_conv_array_large<coord::Car, coord::Sph>(special_car, numspecial, false);
+    passed &= test_conv_array_large<coord::Cyl, coord::Car>(special_cyl, numspecial, false);
+    passed &= test_conv_array_large<coord::Cyl, coord::Sph>(special_cyl, numspecial, false);
+    passed &= test_conv_array_large<coord::Sph, coord::Car>(special_sph, numspecial, true);
+    passed &= test_conv_array_large<coord::Sph, coord::Cyl>(special_sph, numspecial, true);
+    passed &= test_prol_array();
+    passed &= test_rotation_array();
     std::cout << " ======= Testing conversion of gradients and hessians =======\n";
     for(int n=0; n<numtestpoints; n++) {
         coord::PosCar pcar = coord::PosVelCar(posvel_car[n]);
@@ -11,10 +11,15 @@
     or just spherical) there are additional checks (e.g. that the mixed velocity moments are zero),
     and some computations are compared between different orientations of the coordinate system.
     Finally, we compare the results with analytic expressions for the spherical isotropic Plummer model.
+    In addition, we check that the streaming generation of an N-body model (positions sampled in chunks,
+    velocities assigned on the fly, and particles written directly to a file) agrees with the usual one.
     There are three test cases - isotropic Plummer, spherical anisotropic Plummer, and flattened and
     rotating DoublePowerLaw DF (all in a spherical potential, but this shouldn't be a limiting factor).
 */
 #include "galaxymodel_base.h"
+#include "galaxymodel_velocitysampler.h"
+#include "particles_io.h"
+#include "math_random.h"
 #include "potential_analytic.h"
 #include "df_halo.h"
 #include "df_spherical.h"
@@ -24,6 +29,8 @@
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <iterator>
 
 bool test(double a, double b, double eps, const char* label)
 {
@@ -551,10 +558,106 @@ bool test(const galaxymodel::GalaxyModel& model, const std::string& name,
 }
 
 
+/// generate an N-body model in the streaming mode and write it to a file, then read it back,
+/// compare the positions with those produced by the non-streaming routine, and check the virial ratio
+/// relative deviation between two numbers (zero if they are both zero)
+inline double relDev(double a, double b)
+{
+    return a == b ? 0 : fabs(a - b) / fmax(fabs(a), fabs(b));
+}
+
+/// maximum relative deviation between positions, velocities and masses of two snapshots
+template<typename ParticleT>
+double maxRelDev(const particles::ParticleArrayAux& a, const particles::ParticleArray<ParticleT>& b)
+{
+    double maxdev = 0;
+    for(size_t i=0; i<a.size(); i++) {
+        const coord::PosVelCar &p = a.point(i), &q = b.point(i);
+        maxdev = fmax(maxdev, fmax(fmax(relDev(p.x, q.x), relDev(p.y, q.y)), relDev(p.z, q.z)));
+        maxdev = fmax(maxdev, fmax(fmax(relDev(p.vx, q.vx), relDev(p.vy, q.vy)), relDev(p.vz, q.vz)));
+        maxdev = fmax(maxdev, relDev(a.mass(i), b.mass(i)));
+    }
+    return maxdev;
+}
+
+/// read the entire content of a file into a string
+std::string readFile(const std::string& fileName)
+{
+    std::ifstream strm(fileName.c_str(), std::ios::in | std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(strm), std::istreambuf_iterator<char>());
+}
+
+bool testStreaming(const potential::BasePotential& pot)
+{
+    const size_t nbody = 200000;
+    const std::string fileName = "test_galaxymodel_stream.txt", fileName2 = "test_galaxymodel_stream2.txt";
+    math::randomize(42);
+    particles::ParticleArray<coord::PosCar> points(galaxymodel::sampleDensity(pot, nbody));
+    double Mtrue = 0;
+    for(size_t i=0; i<points.size(); i++)
+        Mtrue += points.mass(i);
+    math::randomize(42);
+    particles::ParticleCollector<coord::PosVelCar> collector;
+    {
+        galaxymodel::VelocityAssigner assigner(pot, pot, collector);
+        galaxymodel::sampleDensity(pot, nbody, assigner);
+    }
+    math::randomize(42);
+    {
+        particles::SnapshotStreamWriter writer(fileName, nbody, "Text");
+        galaxymodel::VelocityAssigner assigner(pot, pot, writer);
+        galaxymodel::sampleDensity(pot, nbody, assigner);
+        writer.finish();
+    }
+    particles::ParticleArrayAux snap = particles::readSnapshot(fileName);
+    std::remove(fileName.c_str());
+    // write the same snapshot in the Gadget format and read it back (single-precision values)
+    particles::writeSnapshot(fileName, snap, "Gadget");
+    particles::ParticleArrayAux snapg = particles::readSnapshot(fileName);
+    std::remove(fileName.c_str());
+    // the streamed NEMO file must be identical to the one written at once from the collected particles
+    math::randomize(42);
+    {
+        particles::SnapshotStreamWriter writer(fileName, nbody, "Nemo");
+        galaxymodel::VelocityAssigner assigner(pot, pot, writer);
+        galaxymodel::sampleDensity(pot, nbody, assigner);
+        writer.finish();
+    }
+    particles::writeSnapshot(fileName2, collector.particles, "Nemo");
+    std::string nemoStream = readFile(fileName), nemoFull = readFile(fileName2);
+    std::remove(fileName.c_str());
+    std::remove(fileName2.c_str());
+    bool oknemo = !nemoStream.empty() && nemoStream == nemoFull;
+    bool ok = oknemo && snap.size() == nbody && snapg.size() == nbody && collector.particles.size() == nbody;
+    // text output keeps 8 significant digits, Gadget output is in single precision,
+    // so both should reproduce the values to a relative accuracy of ~1e-7
+    double maxdevg = ok ? maxRelDev(snapg, snap) : NAN;
+    double maxdevc = ok ? maxRelDev(snap, collector.particles) : NAN;
+    double maxdev = 0, Mtot = 0, Ekin = 0, Epot = 0;
+    for(size_t i=0; ok && i<nbody; i++) {
+        const coord::PosVelCar& p = snap.point(i);
+        maxdev = fmax(maxdev, fmax(fmax(relDev(p.x, points.point(i).x), relDev(p.y, points.point(i).y)),
+            relDev(p.z, points.point(i).z)));
+        Mtot += snap.mass(i);
+        Ekin += snap.mass(i) * 0.5 * (pow_2(p.vx) + pow_2(p.vy) + pow_2(p.vz));
+        Epot += snap.mass(i) * 0.5 * pot.value(p);
+    }
+    ok &= maxdev < 1e-7 && maxdevc < 1e-7 && maxdevg < 1e-7 &&
+        relDev(Mtot, Mtrue) < 1e-7 && fabs(2*Ekin / Epot + 1) < 0.02;
+    std::cout << "Streaming N-body model: " << snap.size() << " particles, M=" << Mtot <<
+        ", 2T/W=" << (2*Ekin / Epot) << ", max.relative deviation of positions from non-streaming model: " <<
+        maxdev << ", of all values from collected particles: " << maxdevc <<
+        ", after Gadget i/o: " << maxdevg << ", NEMO streaming output " <<
+        (oknemo ? "matches" : "differs from") << " the non-streaming one" <<
+        (ok ? "\n" : " \033[1;31m**\033[0m\n");
+    return ok;
+}
+
 int main()
 {
     bool ok = true;
     potential::Plummer pot(1, 1);
+    ok &= testStreaming(pot);
     actions::ActionFinderSpherical af(pot);
 
     std::cout << "\033[1m  Spherical isotropic Plummer model  \033[0m\n";
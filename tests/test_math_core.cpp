@@ -8,6 +8,10 @@
 #include <iomanip>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 int numEval=0;
 
 class test1: public math::IFunctionNoDeriv{
@@ -151,6 +155,18 @@ public:
 };
 #endif
 
+// collects the output of sampleNdim in the streaming mode
+class ChunkCollector: public math::ISampleSink {
+public:
+    std::vector<double> data;
+    size_t numChunks;
+    ChunkCollector() : numChunks(0) {}
+    virtual void add(const math::Matrix<double>& chunk) {
+        data.insert(data.end(), chunk.data(), chunk.data() + chunk.size());
+        numChunks++;
+    }
+};
+
 // test functions for estimating the accuracy of Gauss-Legendre integration
 class test_GL_powerlaw: public math::IFunctionNoDeriv{
 public:
@@ -349,6 +365,65 @@ int main()
     ok &= maxerrk < 2e-15 || err();
     std::cout << "\n";
 
+    // counter-based random streams: known-answer test of the Philox4x32-10 bijection
+    // (reference values from the Random123 distribution), and consistency between
+    // random access, block generation and sequential access
+    {
+        // convert the expected 32-bit output words into a double, as done internally
+        struct { double operator()(uint64_t hi, uint64_t lo) const {
+            return ((hi << 21) ^ (lo >> 11)) / 9007199254740992.; } } toDouble;
+        math::RandomStream rng0(0, 0), rng1(0x299f31d0a4093822ull, 0x0370734413198a2eull);
+        bool okkat =
+            rng0.uniform(0) == toDouble(0x6627e8d5, 0xe169c58d) &&
+            rng0.uniform(1) == toDouble(0xbc57ac4c, 0x9b00dbd8);
+        const int NUM = 101;
+        double uni[NUM], nrm[NUM], nrm1[NUM];
+        rng1.uniform(7, NUM, uni);
+        rng1.normal (7, NUM, nrm);
+        int numMismatch = 0;
+        double sum = 0, sum2 = 0;
+        for(int i=0; i<NUM; i++) {
+            numMismatch += uni[i] != rng1.uniform(7+i);
+            rng1.normal(7+i, 1, nrm1+i);
+            numMismatch += nrm[i] != nrm1[i];
+        }
+        rng1.position = 7;
+        for(int i=0; i<NUM; i++)
+            numMismatch += uni[i] != rng1.next();
+        // basic statistics of a longer sequence
+        std::vector<double> big(100000);
+        rng0.normal(0, big.size(), &big[0]);
+        for(size_t i=0; i<big.size(); i++) {
+            sum  += big[i];
+            sum2 += pow_2(big[i]);
+        }
+        sum  /= big.size();
+        sum2 /= big.size();
+        std::cout << "Counter-based PRNG: known-answer test " << (okkat ? "passed" : "failed") <<
+            ", " << numMismatch << " mismatches between access methods, "
+            "normal variates: mean=" << sum << ", variance=" << sum2 << "\n";
+        ok &= (okkat && numMismatch == 0 && fabs(sum) < 0.01 && fabs(sum2-1) < 0.02) || err();
+    }
+
+    // binary search with and without hints should give identical results
+    {
+        const int NGRID = 50;
+        double grid[NGRID];
+        for(int i=0; i<NGRID; i++)
+            grid[i] = exp(0.1*i) - 1;
+        ptrdiff_t hint = -1;
+        int numMismatch = 0;
+        for(int k=0; k<20000; k++) {
+            // a point moving smoothly back and forth across the grid, including its ends and outside
+            double x = (grid[NGRID-1] + 2) * (0.5 + 0.6 * sin(k * 0.003)) - 1;
+            if(k%1000 == 0)
+                x = grid[k/1000 % NGRID];  // exactly at a grid node
+            numMismatch += math::binSearch(x, grid, NGRID) != math::binSearch(x, grid, NGRID, hint);
+        }
+        std::cout << "Hinted binary search: " << numMismatch << " mismatches\n";
+        ok &= numMismatch == 0 || err();
+    }
+
     // integration routines
     const double toler = 1e-6;
     double exact = (M_PI*2/3), error=0, result;
@@ -506,6 +581,28 @@ int main()
             fout << points(i,0) << "\t" << points(i,1) << "\t" << points(i,2) << "\n";
     }
 
+    // streaming output of sampleNdim: the samples must be identical to the matrix output
+    // produced with the same random seed, and must not depend on the number of threads
+    {
+        ChunkCollector collector;
+        math::randomize(1);
+        sampleNdim(fnc8, fnc8.ymin, fnc8.ymax, 150000, points);
+        math::randomize(1);
+#ifdef _OPENMP
+        int numThreads = omp_get_max_threads();
+        omp_set_num_threads(1);
+#endif
+        sampleNdim(fnc8, fnc8.ymin, fnc8.ymax, 150000, collector);
+#ifdef _OPENMP
+        omp_set_num_threads(numThreads);
+#endif
+        bool same = collector.data.size() == points.size() &&
+            std::equal(collector.data.begin(), collector.data.end(), points.data());
+        std::cout << "Streaming sampleNdim: " << collector.numChunks << " chunks, output is " <<
+            (same ? "identical to" : "different from") << " the matrix variant\n";
+        ok &= same || err();
+    }
+
 #if 0
     // test the accuracy of fixed-order (n) Gauss-Legendre quadrature in integrating a power-law function in radius
     for(double p=-40; p<=40; p+=1.77) {
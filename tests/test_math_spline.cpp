@@ -10,6 +10,7 @@
 #include <cmath>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <cassert>
 
@@ -263,6 +264,22 @@ bool testPenalizedSplineFit()
     std::cout << "case B: RMS=" << rms2 << ", EDF=" << edf2 << "\n";
     ok &= rms2<1.0 && edf2>=2 && edf2<NNODES+2;
 
+    // the same fits using the statistics accumulated incrementally in two separate parts, then merged
+    math::SplineApproxData data1(xnodes, 2), data2(xnodes, 2);
+    for(int i=0; i<NPOINTS; i++) {
+        double yvalues[2] = {yvalues1[i], yvalues2[i]};
+        (i%2 ? data1 : data2).add(xvalues[i], 1.0, yvalues);
+    }
+    data1.add(data2);
+    math::SplineApprox apprd(data1);
+    std::vector<double> fitd1 = apprd.fit(/*dataSet*/ 0u, edf1, &rmsw), fita1 = appr.fit(yvalues1, edf1);
+    apprd.fitOversmooth(/*dataSet*/ 1u, .5, NULL, &edfw);
+    double maxdev = 0;
+    for(size_t k=0; k<xnodes.size(); k++)
+        maxdev = fmax(maxdev, fabs(fitd1[k] - fita1[k]));
+    std::cout << "accumulated data: RMS=" << rmsw << ", EDF=" << edfw << ", max.deviation=" << maxdev << "\n";
+    ok &= math::fcmp(rmsw, rms1, 1e-8) == 0 && math::fcmp(edfw, edf2, 1e-3) == 0 && maxdev < 1e-8;
+
     // test the weighted regression:
     // split some of the input points into four identical ones,
     // and assign them a four times smaller weight
@@ -459,6 +476,17 @@ bool testPenalizedSplineDensity()
     math::CubicSpline spl3t(grid,
         math::splineLogDensity<3>(grid, xvalues, weights,
         math::FitOptions( OPTIONS | math::FO_PENALTY_3RD_DERIV)));  // with penalty for 3rd deriv
+    // the same penalized estimate from the statistics of samples accumulated in two parts, then merged
+    math::SplineLogDensityData<3> data1(grid, OPTIONS), data2(grid, OPTIONS);
+    for(unsigned int i=0; i<xvalues.size(); i++)
+        (i%2 ? data1 : data2).add(xvalues[i], weights[i]);
+    data1.add(data2);
+    math::CubicSpline spl3d(grid, math::splineLogDensity<3>(data1, SMOOTHING));
+    double maxdev = 0;
+    for(int j=0; j<NCHECK; j++)
+        maxdev = fmax(maxdev, fabs(spl3d(testgrid[j]) - spl3p(testgrid[j])));
+    std::cout << "Accumulated-data estimate: max.deviation from the penalized cubic = " << maxdev << '\n';
+    ok &= maxdev < 1e-4;
     double logLtrue=0, logL1=0, logL3o=0, logL3p=0, logL3t=0, logL3s=0;
     for(unsigned int i=0; i<xvalues.size(); i++) {
         // evaluate the likelihood of the sampled points against the true underlying density
@@ -1184,6 +1212,55 @@ bool test2dSpline()
         sumerrq < 1.e-4 && sumerrqder < 7.e-4 && sumerrqder2 < 0.006 &&
         sumerrm < 6.e-5 && sumerrmder < 3.e-4 && sumerrmder2 < 0.003;
 
+    //----------- test the single-precision storage of spline coefficients -------------//
+    math::CubicSpline2d cub2f(cub2d);
+    math::QuinticSpline2d qui2f(qui2d);
+    double errc = cub2f.reducePrecision(), errq = qui2f.reducePrecision(), devc = 0, devq = 0;
+    for(int i=0; i<=NN; i++) {
+        double x = (XMAX-XMIN)*(i*1./NN)+XMIN;
+        for(int j=0; j<=NN; j++) {
+            double y = (YMAX-YMIN)*(j*1./NN)+YMIN, c, cx, q, qx, cf, cfx, qf, qfx;
+            cub2d.evalDeriv(x, y, &c,  &cx);
+            cub2f.evalDeriv(x, y, &cf, &cfx);
+            qui2d.evalDeriv(x, y, &q,  &qx);
+            qui2f.evalDeriv(x, y, &qf, &qfx);
+            devc = fmax(devc, fmax(fabs(cf-c), 0.1*fabs(cfx-cx)));
+            devq = fmax(devq, fmax(fabs(qf-q), 0.1*fabs(qfx-qx)));
+        }
+    }
+    std::cout << "Single-precision storage: reported error in cubic spline: " + utils::pp(errc, 8) +
+        ", quintic spline: " + utils::pp(errq, 8) + "; max deviation in cubic spline: " +
+        utils::pp(devc, 8) + ", quintic spline: " + utils::pp(devq, 8) + "\n";
+    ok &= cub2f.singlePrecision() && qui2f.singlePrecision() && !cub2d.singlePrecision() &&
+        errc > 0 && errc < 1e-6 && errq > 0 && errq < 1e-6 && devc < 1e-5 && devq < 1e-5;
+
+    //----------- test the evaluation with a cell hint on a non-uniform grid -------------//
+    std::vector<double> xirr(xval), yirr(yval);
+    for(int i=1; i<NNODESX-1; i++)
+        xirr[i] += 0.1 * (XMAX-XMIN) / NNODESX * sin(i*2.);
+    for(int j=1; j<NNODESY-1; j++)
+        yirr[j] += 0.1 * (YMAX-YMIN) / NNODESY * sin(j*3.);
+    math::CubicSpline2d cubirr(xirr, yirr, fval);
+    math::QuinticSpline2d quiirr(xirr, yirr, fval, fderx, fdery);
+    math::CellHint2d hint;  // shared between the two splines, which have the same grid
+    int numMismatch = 0;
+    for(int k=0; k<=NN*NN; k++) {
+        // a point moving along a smooth curve that crosses the grid cells back and forth
+        double x = (XMAX-XMIN) * (0.5 + 0.55 * sin(k * 0.01)) + XMIN;
+        double y = (YMAX-YMIN) * (0.5 + 0.45 * cos(k * 0.007)) + YMIN;
+        double c, cx, cy, q, qx, qy, ch, chx, chy, qh, qhx, qhy;
+        cubirr.evalDeriv(x, y, &c, &cx, &cy);
+        quiirr.evalDeriv(x, y, &q, &qx, &qy);
+        cubirr.evalDeriv(x, y, hint, &ch, &chx, &chy);
+        quiirr.evalDeriv(x, y, hint, &qh, &qhx, &qhy);
+        // compare the bit patterns, since NAN values are expected outside the grid
+        numMismatch += memcmp(&c, &ch, sizeof(double)) || memcmp(&cx, &chx, sizeof(double)) ||
+            memcmp(&cy, &chy, sizeof(double)) || memcmp(&q, &qh, sizeof(double)) ||
+            memcmp(&qx, &qhx, sizeof(double)) || memcmp(&qy, &qhy, sizeof(double));
+    }
+    std::cout << "Evaluation with a cell hint: " << numMismatch << " mismatches\n";
+    ok &= numMismatch == 0;
+
     //----------- test the performance of 2d spline calculation -------------//
     std::cout <<"Linear interpolator:      " + evalSpline2d<0>(lin2d) + " eval/s\n";
     std::cout <<"Cubic   spline w/o deriv: " + evalSpline2d<0>(cub2d) + ", 1st deriv: " +
@@ -1193,6 +1270,39 @@ bool test2dSpline()
     return ok;
 }
 
+//----------- test the O(1) cell lookup for grids generated by standard routines ------------//
+bool testGridLocator()
+{
+    std::cout << "\033[1;33mGrid cell locator\033[0m: ";
+    std::vector<std::vector<double> > grids;
+    grids.push_back(math::createUniformGrid(37, -1.234, 5.678));
+    grids.push_back(math::createExpGrid(50, 1e-3, 1e4));
+    grids.push_back(math::createNonuniformGrid(40, 0.01, 100, true));
+    grids.push_back(math::createSymmetricGrid(41, 0.01, 100));
+    std::vector<double> grid = math::createNonuniformGrid(30, 0.02, 50, true);
+    for(size_t i=0; i<grid.size(); i++)
+        grid[i] = asinh(grid[i] / 0.7);   // the same as in CylSpline
+    grids.push_back(grid);
+    grids.push_back(math::createNonuniformGrid(25, 0.1, 100, false));  // not an analytic law
+    bool ok = true;
+    for(size_t g=0; g<grids.size(); g++) {
+        const std::vector<double>& gr = grids[g];
+        math::GridLocator loc(gr);
+        int numMismatch = 0;
+        double xmin = gr.front(), xmax = gr.back(), margin = (xmax-xmin) * 0.1;
+        for(int k=0; k<=10000; k++) {
+            double x = k<=1000 ?
+                xmin - margin + (xmax - xmin + 2*margin) * k / 1000 :  // uniformly spaced points
+                gr[k % gr.size()] * (k%3 == 0 ? 1 : 1 + (k%3 == 1 ? 1e-15 : -1e-15)); // near nodes
+            numMismatch += loc(x, &gr[0], gr.size()) != math::binSearch(x, &gr[0], gr.size());
+        }
+        std::cout << numMismatch << " ";
+        ok &= numMismatch == 0;
+    }
+    std::cout << "mismatches with binSearch\n";
+    return ok;
+}
+
 //----------- test 3d interpolation ------------//
 bool test3dSpline()
 {
@@ -1282,6 +1392,49 @@ bool test3dSpline()
         ", difference between cubic spline and B-spline: " << utils::pp(sumsqerr_s, 8) << "\n";
     ok &= sumsqerr_l<0.04 && sumsqerr_c<0.01 && sumsqerr_s<1e-15;
 
+    // test the derivatives of the 3d cubic spline against finite differences
+    double maxerr_d = 0;
+    const double H = 1e-5;
+    for(int n=0; n<100; n++) {
+        double x = (n*0.618034 - floor(n*0.618034)) * xval.back() * 0.99 + H,
+               y = (n*0.414214 - floor(n*0.414214)) * yval.back() * 0.99 + H,
+               z = (n*0.732051 - floor(n*0.732051)) * zval.back() * 0.99 + H;
+        double val, der[3], der2[6];
+        spl3d.evalDeriv(x, y, z, &val, der, der2);
+        double dx[3], dxp[3], dxm[3], dyp[3], dym[3];
+        spl3d.evalDeriv(x+H, y, z, NULL, dxp);
+        spl3d.evalDeriv(x-H, y, z, NULL, dxm);
+        spl3d.evalDeriv(x, y+H, z, NULL, dyp);
+        spl3d.evalDeriv(x, y-H, z, NULL, dym);
+        dx[0] = (spl3d.value(x+H, y, z) - spl3d.value(x-H, y, z)) / (2*H);
+        dx[1] = (spl3d.value(x, y+H, z) - spl3d.value(x, y-H, z)) / (2*H);
+        dx[2] = (spl3d.value(x, y, z+H) - spl3d.value(x, y, z-H)) / (2*H);
+        double fd2[6] = {
+            (dxp[0]-dxm[0]) / (2*H), (dyp[1]-dym[1]) / (2*H), 0,
+            (dxp[1]-dxm[1]) / (2*H), (dyp[2]-dym[2]) / (2*H), (dxp[2]-dxm[2]) / (2*H) };
+        fd2[2] = (spl3d.value(x, y, z+H) - 2*val + spl3d.value(x, y, z-H)) / (H*H);
+        maxerr_d = fmax(maxerr_d, fabs(val - spl3d.value(x, y, z)));
+        for(int d=0; d<3; d++)
+            maxerr_d = fmax(maxerr_d, fabs(der[d] - dx[d]));
+        for(int d=0; d<6; d++)
+            maxerr_d = fmax(maxerr_d, fabs(der2[d] - fd2[d]) * (d==2 ? 1e-3 : 1));
+    }
+    std::cout << "Max error in derivatives of 3d cubic spline: " << utils::pp(maxerr_d, 8) << "\n";
+    ok &= maxerr_d < 1e-5;
+
+    // test the single-precision storage of coefficients
+    math::CubicSpline3d spl3f(spl3d);
+    double err_f = spl3f.reducePrecision(), maxdev_f = 0;
+    for(int n=0; n<1000; n++) {
+        double x = (n*0.618034 - floor(n*0.618034)) * xval.back(),
+               y = (n*0.414214 - floor(n*0.414214)) * yval.back(),
+               z = (n*0.732051 - floor(n*0.732051)) * zval.back();
+        maxdev_f = fmax(maxdev_f, fabs(spl3d.value(x, y, z) - spl3f.value(x, y, z)));
+    }
+    std::cout << "Single-precision storage: reported error: " << utils::pp(err_f, 8) <<
+        ", max deviation: " << utils::pp(maxdev_f, 8) << "\n";
+    ok &= spl3f.singlePrecision() && err_f > 0 && err_f < 1e-6 && maxdev_f < 1e-5;
+
     // test performance of various interpolators
     double RATE = 1.0 * pow_3(NNN+1) * CLOCKS_PER_SEC;
     clock_t clk = std::clock();
@@ -1504,6 +1657,7 @@ int main()
     ok &= testMonoSpline() || printFail("Monotonic spline interpolation");
     ok &= test1dSpline() || printFail("1d spline");
     ok &= test2dSpline() || printFail("2d spline");
+    ok &= testGridLocator() || printFail("Grid cell locator");
     ok &= test3dSpline() || printFail("3d spline");
     if(ok)
         std::cout << "\033[1;32mALL TESTS PASSED\033[0m\n";
@@ -0,0 +1,355 @@
+/** \file    test_particles_io.cpp
+    \author  Eugene Vasiliev
+    \date    2026
+
+    Test the native reader of Gadget snapshots: files in format 1 and 2, in the native and
+    the opposite byte order, with single- and double-precision data, multi-file snapshots,
+    selection of particle types, and files without the velocity block.
+    The test files are constructed byte by byte, independently of the snapshot writer.
+    Also test the parsing of numbers and lines in text snapshots (including the independence
+    of the current locale), and the round trip of a text snapshot larger than one parsing chunk.
+*/
+#include "particles_io.h"
+#include "math_random.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <clocale>
+
+/// number of particle types in Gadget files
+const int NTYPES = 6;
+
+/// the layout of a test snapshot file
+struct GadgetLayout {
+    bool format2;     ///< format 2 (named blocks) or 1 (fixed order of blocks)
+    bool swap;        ///< whether to use the byte order opposite to the native one
+    bool doublePrec;  ///< whether to store data in double precision
+    bool writeVel;    ///< whether to write the velocity block
+};
+
+/// append a value to the output buffer, possibly reversing its byte order
+template<typename T>
+void put(std::string& buf, T value, bool swap)
+{
+    char tmp[sizeof(T)];
+    std::memcpy(tmp, &value, sizeof(T));
+    if(swap)
+        std::reverse(tmp, tmp + sizeof(T));
+    buf.append(tmp, sizeof(T));
+}
+
+/// append a floating-point value in single or double precision
+void putReal(std::string& buf, double value, const GadgetLayout& layout)
+{
+    if(layout.doublePrec)
+        put<double>(buf, value, layout.swap);
+    else
+        put<float>(buf, static_cast<float>(value), layout.swap);
+}
+
+/// append a data block enclosed in size markers, preceded by the name block in format 2
+void putBlock(std::string& buf, const char* name, const std::string& data, const GadgetLayout& layout)
+{
+    if(layout.format2) {
+        put<unsigned int>(buf, 8, layout.swap);
+        buf.append(name, 4);
+        put<unsigned int>(buf, data.size() + 8, layout.swap);
+        put<unsigned int>(buf, 8, layout.swap);
+    }
+    put<unsigned int>(buf, data.size(), layout.swap);
+    buf.append(data);
+    put<unsigned int>(buf, data.size(), layout.swap);
+}
+
+/// values of a test particle with the given global index, exactly representable in single precision
+coord::PosVelCar testPoint(int k)
+{
+    return coord::PosVelCar(0.25 + k * 0.5, -0.125 * k, k, 1 + 0.75 * k, -2 - 0.25 * k, 0.0625 * k);
+}
+
+double testMass(int k, int type, const double massPart[])
+{
+    return massPart[type] != 0 ? massPart[type] : 0.5 + 0.125 * k;
+}
+
+/// write one file of a snapshot; particles of each type are numbered consecutively from firstIndex
+void writeGadgetFile(const std::string& fileName, const GadgetLayout& layout,
+    const int numPart[], const double massPart[], int numFiles, int firstIndex)
+{
+    std::string header, pos, vel, ids, mass;
+    for(int t=0; t<NTYPES; t++)
+        put<int>(header, numPart[t], layout.swap);
+    for(int t=0; t<NTYPES; t++)
+        put<double>(header, massPart[t], layout.swap);
+    put<double>(header, /*time*/ 1.5, layout.swap);
+    put<double>(header, /*redshift*/ 0, layout.swap);
+    put<int>(header, /*flag_sfr*/ 0, layout.swap);
+    put<int>(header, /*flag_feedback*/ 0, layout.swap);
+    for(int t=0; t<NTYPES; t++)
+        put<int>(header, /*npartTotal - not used*/ 0, layout.swap);
+    put<int>(header, /*flag_cooling*/ 0, layout.swap);
+    put<int>(header, numFiles, layout.swap);
+    header.resize(256, 0);
+    for(int t=0, k=firstIndex; t<NTYPES; t++) {
+        for(int i=0; i<numPart[t]; i++, k++) {
+            coord::PosVelCar p = testPoint(k);
+            putReal(pos, p.x, layout);
+            putReal(pos, p.y, layout);
+            putReal(pos, p.z, layout);
+            putReal(vel, p.vx, layout);
+            putReal(vel, p.vy, layout);
+            putReal(vel, p.vz, layout);
+            put<int>(ids, k, layout.swap);
+            if(massPart[t] == 0)
+                putReal(mass, testMass(k, t, massPart), layout);
+        }
+    }
+    std::string buf;
+    putBlock(buf, "HEAD", header, layout);
+    putBlock(buf, "POS ", pos, layout);
+    if(layout.writeVel)
+        putBlock(buf, "VEL ", vel, layout);
+    putBlock(buf, "ID  ", ids, layout);
+    if(!mass.empty())
+        putBlock(buf, "MASS", mass, layout);
+    std::ofstream strm(fileName.c_str(), std::ios::binary);
+    strm.write(buf.data(), buf.size());
+}
+
+/// compare the snapshot with the expected particles (global indices and types),
+/// all values are exactly representable, so the comparison is exact
+bool checkSnapshot(const particles::ParticleArrayAux& snap, const std::vector<int>& indices,
+    const std::vector<int>& types, const double massPart[], bool haveVel)
+{
+    if(snap.size() != indices.size())
+        return false;
+    for(size_t i=0; i<snap.size(); i++) {
+        coord::PosVelCar p = snap.point(i), q = testPoint(indices[i]);
+        if(!haveVel)
+            q.vx = q.vy = q.vz = 0;
+        if(p.x != q.x || p.y != q.y || p.z != q.z || p.vx != q.vx || p.vy != q.vy || p.vz != q.vz ||
+            snap.mass(i) != testMass(indices[i], types[i], massPart))
+            return false;
+    }
+    return true;
+}
+
+bool report(const char* name, bool ok)
+{
+    std::cout << name << (ok ? "\n" : " \033[1;31m**\033[0m\n");
+    return ok;
+}
+
+/// write a text file with the given content and read it back as a snapshot
+particles::ParticleArrayAux readText(const std::string& fileName, const std::string& content)
+{
+    std::ofstream strm(fileName.c_str(), std::ios::binary);
+    strm << content;
+    strm.close();
+    try{
+        particles::ParticleArrayAux result = particles::readSnapshot(fileName);
+        std::remove(fileName.c_str());
+        return result;
+    }
+    catch(...) {
+        std::remove(fileName.c_str());
+        throw;
+    }
+}
+
+/// check that numbers in various notations are parsed exactly as strtod does in the "C" locale
+bool testParseNumbers(const char* locale)
+{
+    static const char* tokens[] = {
+        "0", "-0.0", "000123.4500", "0.000000000000000000000012345", "+.5", "5.", ".25e1",
+        "1.5e3", "1.5E-3", "-2.5e+22", "7e-23", "1e-300", "4.9e-324", "1e-400",
+        "1.7976931348623157e308", "1e400", "123456789012345", "1234567890123456",
+        "3.14159265358979323846", "12345678901234567890123", "0.12345678901234567890e5",
+        "inf", "-inf", "Infinity", "nan" };
+    const int numTokens = sizeof(tokens) / sizeof(tokens[0]);
+    // expected values are computed in the "C" locale
+    std::vector<double> expected(numTokens);
+    for(int i=0; i<numTokens; i++)
+        expected[i] = strtod(tokens[i], NULL);
+    // each token is placed in the second column, so that the line is recognized as particle data
+    std::string content;
+    for(int i=0; i<numTokens; i++)
+        content += std::string("1 ") + tokens[i] + " 2 3\n";
+    bool setlocaleok = locale == NULL || setlocale(LC_NUMERIC, locale) != NULL;
+    if(!setlocaleok) {
+        std::cout << "Parsing numbers in locale " << locale << ": skipped (locale not available)\n";
+        return true;
+    }
+    particles::ParticleArrayAux snap = readText("test_particles_io.txt", content);
+    setlocale(LC_NUMERIC, "C");
+    bool ok = snap.size() == (size_t)numTokens;
+    for(int i=0; ok && i<numTokens; i++) {
+        double value = snap.point(i).y;
+        ok &= (value == expected[i] && (value != 0 || 1/value == 1/expected[i])) ||
+            (value != value && expected[i] != expected[i]);
+        if(!ok)
+            std::cout << tokens[i] << " => " << value << " instead of " << expected[i] << "\n";
+    }
+    std::cout << "Parsing numbers in locale " << (locale ? locale : "C") << ": " << numTokens << " values" <<
+        (ok ? "\n" : " \033[1;31m**\033[0m\n");
+    return ok;
+}
+
+/// check the recognition of comment and header lines, separators and the last line without newline
+bool testParseLines()
+{
+    std::string content =
+        "#time: 1.5\n"
+        "# a comment line\n"
+        "x\ty\tz\tvx\tvy\tvz\tmass\n"
+        "\n"
+        "1;2;3;4;5;6;7\n"
+        "1,2,3,0.5\r\n"
+        "too few fields\n"
+        "  \t-1 2 3 4 5 6 7 8 9 # trailing comment\n"
+        "2 3 4 5";
+    particles::ParticleArrayAux snap = readText("test_particles_io.txt", content);
+    bool ok = snap.size() == 4 &&
+        snap.point(0).x ==  1 && snap.point(0).vz == 6 && snap.mass(0) == 7 && snap.point(0).stellarMass == 7 &&
+        snap.point(1).z ==  3 && snap.point(1).vx == 0 && snap.mass(1) == 0.5 &&
+        snap.point(2).x == -1 && snap.mass(2) == 7 && snap.point(2).stellarMass == 8 &&
+        snap.point(2).stellarRadius == 9 &&
+        snap.point(3).x ==  2 && snap.point(3).z == 4 && snap.mass(3) == 5;
+    // a line with an invalid number is an error
+    bool okerr = false;
+    try{
+        readText("test_particles_io.txt", "1 2 3 4\n1 2 x3 4\n");
+    }
+    catch(std::runtime_error&) {
+        okerr = true;
+    }
+    ok &= okerr;
+    std::cout << "Parsing lines of a text snapshot: " << snap.size() << " particles" <<
+        (ok ? "\n" : " \033[1;31m**\033[0m\n");
+    return ok;
+}
+
+/// write and read back a text snapshot that is larger than one parsing chunk (4 MB)
+bool testTextRoundTrip()
+{
+    const size_t nbody = 100000;
+    const std::string fileName = "test_particles_io.txt";
+    math::randomize(42);
+    particles::ParticleArrayAux points;
+    for(size_t i=0; i<nbody; i++) {
+        double x = math::random() - 0.5, y = (math::random() - 0.5) * 1e-10, z = (math::random() - 0.5) * 1e10;
+        points.add(particles::ParticleAux(coord::PosVelCar(x, y, z, -x, -y, -z),
+            /*stellarMass*/ math::random(), /*stellarRadius*/ math::random()), math::random());
+    }
+    particles::writeSnapshot(fileName, points, "Text", units::ExternalUnits(), "header line", 2.5);
+    std::ifstream strm(fileName.c_str(), std::ios::binary | std::ios::ate);
+    size_t fileSize = strm.tellg();
+    strm.close();
+    particles::ParticleArrayAux snap = particles::readSnapshot(fileName);
+    std::remove(fileName.c_str());
+    bool ok = snap.size() == nbody && fileSize > 8000000;
+    double maxdev = 0;
+    for(size_t i=0; ok && i<nbody; i++) {
+        const particles::ParticleAux &p = snap.point(i), &q = points.point(i);
+        const double a[9] = {p.x, p.y, p.z, p.vx, p.vy, p.vz, snap.mass(i), p.stellarMass, p.stellarRadius};
+        const double b[9] = {q.x, q.y, q.z, q.vx, q.vy, q.vz, points.mass(i), q.stellarMass, q.stellarRadius};
+        for(int k=0; k<9; k++)
+            maxdev = fmax(maxdev, fabs(a[k] - b[k]) / fabs(b[k]));
+    }
+    // values are printed with 8 significant digits
+    ok &= maxdev < 1e-7;
+    std::cout << "Text snapshot round trip: " << snap.size() << " particles, file size " << fileSize <<
+        " bytes, max.relative deviation " << maxdev << (ok ? "\n" : " \033[1;31m**\033[0m\n");
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    ok &= testParseNumbers(NULL);
+    ok &= testParseNumbers("de_DE.UTF-8");
+    ok &= testParseLines();
+    ok &= testTextRoundTrip();
+
+    // a two-file snapshot with three particle types, one of them with fixed masses
+    const int numPart[2][NTYPES] = { {3, 4, 0, 0, 2, 0}, {1, 0, 0, 0, 3, 0} };
+    const double massPart[NTYPES] = {0, 0.5, 0, 0, 0, 0};
+    const std::string baseName = "test_particles_io.gadget";
+    GadgetLayout layouts[4] = {
+        // format2, swap, doublePrec, writeVel
+        { false,  true,  true,  true },
+        { false,  false, false, true },
+        { true,   true,  false, true },
+        { true,   false, true,  true } };
+    for(int l=0; l<4; l++) {
+        const GadgetLayout& layout = layouts[l];
+        writeGadgetFile(baseName+".0", layout, numPart[0], massPart, 2, 0);
+        writeGadgetFile(baseName+".1", layout, numPart[1], massPart, 2, 9);
+        // expected order of particles: by file, then by type
+        std::vector<int> indAll, typeAll, indSel, typeSel;
+        for(int f=0, k=0; f<2; f++)
+            for(int t=0; t<NTYPES; t++)
+                for(int i=0; i<numPart[f][t]; i++, k++) {
+                    indAll.push_back(k);
+                    typeAll.push_back(t);
+                    if(t==1 || t==4) {
+                        indSel.push_back(k);
+                        typeSel.push_back(t);
+                    }
+                }
+        std::string name = std::string("Gadget format ") + (layout.format2 ? "2" : "1") +
+            (layout.swap ? ", swapped bytes" : ", native bytes") +
+            (layout.doublePrec ? ", double precision" : ", single precision");
+        // the multi-file snapshot may be read by the name of its first file or by the common part
+        ok &= report((name + ": all particles").c_str(), checkSnapshot(
+            particles::readSnapshot(baseName), indAll, typeAll, massPart, true));
+        ok &= report((name + ": types 1 and 4").c_str(), checkSnapshot(
+            particles::readSnapshotGadget(baseName+".0", units::ExternalUnits(), (1<<1) | (1<<4)),
+            indSel, typeSel, massPart, true));
+        ok &= report((name + ": without velocities").c_str(), checkSnapshot(
+            particles::readSnapshotGadget(baseName+".0", units::ExternalUnits(), 63, false),
+            indAll, typeAll, massPart, false));
+        // a single file of a multi-file snapshot is not accepted
+        bool okname = false;
+        try{
+            particles::readSnapshotGadget(baseName+".1");
+        }
+        catch(std::runtime_error&) {
+            okname = true;
+        }
+        ok &= report((name + ": second file of a multi-file snapshot is rejected").c_str(), okname);
+    }
+    std::remove((baseName+".1").c_str());
+
+    // a single-file snapshot without the velocity block can be read only if velocities are not needed
+    GadgetLayout noVel = { true, false, false, false };
+    writeGadgetFile(baseName+".0", noVel, numPart[0], massPart, 1, 0);
+    std::vector<int> indices, types;
+    for(int t=0, k=0; t<NTYPES; t++)
+        for(int i=0; i<numPart[0][t]; i++, k++) {
+            indices.push_back(k);
+            types.push_back(t);
+        }
+    ok &= report("Gadget format 2 without velocities: positions and masses", checkSnapshot(
+        particles::readSnapshotGadget(baseName+".0", units::ExternalUnits(), 63, false),
+        indices, types, massPart, false));
+    bool okvel = false;
+    try{
+        particles::readSnapshotGadget(baseName+".0");
+    }
+    catch(std::runtime_error&) {
+        okvel = true;
+    }
+    ok &= report("Gadget format 2 without velocities: reading velocities fails", okvel);
+    std::remove((baseName+".0").c_str());
+
+    if(ok)
+        std::cout << "\033[1;32mALL TESTS PASSED\033[0m\n";
+    else
+        std::cout << "\033[1;31mSOME TESTS FAILED\033[0m\n";
+    return 0;
+}
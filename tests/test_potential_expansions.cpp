@@ -4,6 +4,7 @@
 #include "math_spline.h"
 #include "particles_io.h"
 #include "potential_analytic.h"
+#include "potential_composite.h"
 #include "potential_cylspline.h"
 #include "potential_dehnen.h"
 #include "potential_disk.h"
@@ -296,6 +297,112 @@ bool testBlob(const potential::BaseDensity& approx, const DensityBlob& blob)
     return ok;
 }
 
+/// compare the interpolation of expansion coefficients in time with the linear interpolation
+/// of the potentials themselves: they must agree at timestamps (up to the accuracy of recovering
+/// the coefficients from the snapshots) and approximately halfway between them
+bool testEvolvingExpansion(bool multipole)
+{
+    std::vector<double> times;
+    std::vector<PtrPotential> snapshots;
+    for(int i=0; i<3; i++) {
+        const potential::Dehnen snap(1. + 0.2*i, 1. + 0.3*i, 0.5, 0.8, 0.6);
+        times.push_back(i * 1.5);
+        snapshots.push_back(multipole ?
+            potential::Multipole::create(static_cast<const potential::BaseDensity&>(snap),
+                4, 4, 20, 0.01, 100.) :
+            potential::CylSpline::create(static_cast<const potential::BaseDensity&>(snap),
+                4, 20, 0.05, 50., 20, 0.02, 20.));
+    }
+    const potential::EvolvingExpansion linear(times, snapshots, /*interpCubic*/ false);
+    const potential::EvolvingExpansion cubic (times, snapshots, /*interpCubic*/ true);
+    const potential::Evolving evolving(times, snapshots, /*interpLinear*/ true);
+    double maxdifNode = 0, maxdifMid = 0, maxdifCubic = 0;
+    const double testTimes[] = {-1., 0., 0.75, 1.5, 2.25, 3., 4.};
+    const bool atNode[] = {true, true, false, true, false, true, true};
+    for(int t=0; t<7; t++) {
+        for(int n=0; n<100; n++) {
+            coord::PosCar pos = coord::toPosCar(coord::PosSph(pow(10., math::random()*3-1.5),
+                acos(math::random()*2-1), math::random()*2*M_PI));
+            double v1, v2, v3, d1, d2, d3;
+            coord::GradCar g1, g2, g3;
+            coord::HessCar h1, h2, h3;
+            linear.  eval(pos, &v1, &g1, &h1, testTimes[t]);
+            evolving.eval(pos, &v2, &g2, &h2, testTimes[t]);
+            cubic.   eval(pos, &v3, &g3, &h3, testTimes[t]);
+            d1 = linear.  density(pos, testTimes[t]);
+            d2 = evolving.density(pos, testTimes[t]);
+            d3 = cubic.   density(pos, testTimes[t]);
+            double gnorm = sqrt(pow_2(g2.dx) + pow_2(g2.dy) + pow_2(g2.dz));
+            double dif = fmax(fabs(v1-v2) / fabs(v2),
+                fabs(g1.dx-g2.dx) / gnorm + fabs(g1.dy-g2.dy) / gnorm + fabs(g1.dz-g2.dz) / gnorm);
+            if(atNode[t]) {
+                maxdifNode = fmax(maxdifNode, dif);
+                // cubic interpolation coincides with the linear one at timestamps
+                maxdifCubic = fmax(maxdifCubic, fmax(fabs(v3-v1) / fabs(v1),
+                    fabs(g3.dx-g1.dx) / gnorm + fabs(g3.dy-g1.dy) / gnorm + fabs(g3.dz-g1.dz) / gnorm));
+            } else
+                maxdifMid  = fmax(maxdifMid, dif);
+            if(!isFinite(v1 + g1.dx + g1.dy + g1.dz + h1.dx2 + d1 + d2 +
+                v3 + g3.dx + g3.dy + g3.dz + h3.dx2 + d3))
+                maxdifCubic = INFINITY;
+        }
+    }
+    bool ok = maxdifNode < 1e-10 && maxdifMid < 1e-3 && maxdifCubic < 1e-12;
+    std::cout << "EvolvingExpansion of " << (multipole ? "Multipole" : "CylSpline") <<
+        " vs. Evolving: max relative difference at timestamps=" << maxdifNode <<
+        ", between timestamps=" << maxdifMid <<
+        "; cubic vs. linear at timestamps=" << maxdifCubic << (ok ? "\n" : "\033[1;31m **\033[0m\n");
+    return ok;
+}
+
+/// check that the flattened composite potential reproduces the potential and force of the original one
+bool testFlatten()
+{
+    const potential::Dehnen dens1(1., 1., 0.5, 0.8, 0.6), dens2(0.5, 3., 1.0, 0.9, 0.7);
+    const potential::BaseDensity &src1 = dens1, &src2 = dens2;
+    std::vector<PtrPotential> comps;
+    comps.push_back(potential::Multipole::create(src1, 6, 6, 24, 0.01, 100.));
+    comps.push_back(potential::Multipole::create(src2, 4, 2, 24, 0.01, 100.));
+    comps.push_back(potential::Multipole::create(src2, 4, 4, 30, 0.02, 200.));  // different grid
+    comps.push_back(potential::CylSpline::create(src1, 4, 20, 0.05, 50., 20, 0.02, 20.));
+    comps.push_back(potential::CylSpline::create(src2, 2, 20, 0.05, 50., 20, 0.02, 20.));
+    comps.push_back(PtrPotential(new potential::Plummer(0.3, 0.5)));
+    // nest one composite potential into another
+    std::vector<PtrPotential> inner(comps.begin()+3, comps.end());
+    std::vector<PtrPotential> outer(comps.begin(), comps.begin()+3);
+    outer.push_back(PtrPotential(new potential::Composite(inner)));
+    PtrPotential orig(new potential::Composite(outer));
+    PtrPotential flat = potential::flattenPotential(orig);
+    PtrPotential resampled = potential::flattenPotential(orig, /*resample*/ true);
+    const potential::Composite* cflat = dynamic_cast<const potential::Composite*>(flat.get());
+    const potential::Composite* cres  = dynamic_cast<const potential::Composite*>(resampled.get());
+    // two Multipoles (one of them summed), one CylSpline, one Plummer; then one of each type
+    bool ok = cflat && cflat->size() == 4 && cres && cres->size() == 3;
+    double maxdifFlat = 0, maxdifRes = 0;
+    for(int n=0; n<1000; n++) {
+        coord::PosCar pos = coord::toPosCar(coord::PosSph(pow(10., math::random()*3-1.5),
+            acos(math::random()*2-1), math::random()*2*M_PI));
+        double v0, v1, v2;
+        coord::GradCar g0, g1, g2;
+        orig->eval(pos, &v0, &g0);
+        flat->eval(pos, &v1, &g1);
+        resampled->eval(pos, &v2, &g2);
+        double gnorm = sqrt(pow_2(g0.dx) + pow_2(g0.dy) + pow_2(g0.dz));
+        maxdifFlat = fmax(maxdifFlat, fmax(fabs(v1-v0) / fabs(v0),
+            sqrt(pow_2(g1.dx-g0.dx) + pow_2(g1.dy-g0.dy) + pow_2(g1.dz-g0.dz)) / gnorm));
+        maxdifRes  = fmax(maxdifRes,  fmax(fabs(v2-v0) / fabs(v0),
+            sqrt(pow_2(g2.dx-g0.dx) + pow_2(g2.dy-g0.dy) + pow_2(g2.dz-g0.dz)) / gnorm));
+    }
+    // the sum of expansions is not exact because of the log-scaling of the m=0 or l=0 terms,
+    // but the difference should be well below the accuracy of the expansions themselves
+    ok &= maxdifFlat < 2e-4 && maxdifRes < 1e-2;
+    std::cout << "Flattened composite potential: " << (cflat ? cflat->size() : 1) <<
+        " components, max relative difference in potential/force=" << maxdifFlat <<
+        "; resampled: " << (cres ? cres->size() : 1) << " components, max difference=" << maxdifRes <<
+        (ok ? "\n" : "\033[1;31m **\033[0m\n");
+    return ok;
+}
+
 int main() {
     bool ok=true;
 
@@ -482,6 +589,11 @@ int main() {
     ok &= testBlob(*potential::CylSpline::create(test7z, 6, 10, 0.1, 1.0, 20, 0.1, 2.0), test7z);
     ok &= testBlob(*potential::CylSpline::create(test7d, 6, 15, 0.1, 1.5, 15, 0.1, 1.5), test7d);
 
+    std::cout << "--- Testing the interpolation of expansion coefficients in time ---\n";
+    ok &= testEvolvingExpansion(true);
+    ok &= testEvolvingExpansion(false);
+    ok &= testFlatten();
+
     if(ok)
         std::cout << "\033[1;32mALL TESTS PASSED\033[0m\n";
     else
@@ -1,6 +1,7 @@
 #include "potential_composite.h"
 #include "potential_cylspline.h"
 #include "potential_multipole.h"
+#include "potential_analytic.h"
 #include "potential_factory.h"
 #include "potential_utils.h"
 #include "utils.h"
@@ -228,6 +229,178 @@ bool testPotentialAtPoint(const potential::BasePotential& potential,
     return ok;
 }
 
+/// compare the tabulated potential with the original one at random points inside the grid
+bool testTabulatedPotential(const potential::PtrPotential& pot, double rmax)
+{
+    potential::TabulatedPotential tab(pot, rmax*1e-3, rmax, 1e-6);
+    double maxerrPhi = 0, maxerrForce = 0;
+    for(int n=0; n<1000; n++) {
+        coord::PosCar pos(
+            (n*0.618034 - floor(n*0.618034) - 0.5) * 2 * rmax,
+            (n*0.414214 - floor(n*0.414214) - 0.5) * 2 * rmax,
+            (n*0.732051 - floor(n*0.732051) - 0.5) * 2 * rmax);
+        double Phi, PhiT;
+        coord::GradCar grad, gradT;
+        pot->eval(pos, &Phi, &grad);
+        tab. eval(pos, &PhiT, &gradT);
+        maxerrPhi   = fmax(maxerrPhi, fabs(Phi - PhiT) / fabs(Phi));
+        maxerrForce = fmax(maxerrForce, sqrt(
+            (pow_2(grad.dx - gradT.dx) + pow_2(grad.dy - gradT.dy) + pow_2(grad.dz - gradT.dz)) /
+            (pow_2(grad.dx) + pow_2(grad.dy) + pow_2(grad.dz)) ) );
+    }
+    bool ok = true;
+    std::cout << "\033[1;33m Tabulated " << pot->name() << " \033[0m: grid size " <<
+        tab.spline().xvalues().size() << "*" << tab.spline().yvalues().size() << "*" <<
+        tab.spline().zvalues().size() << ", estimated max error " << tab.maxError() <<
+        ", actual errors: Phi=" + checkLess(maxerrPhi, 1e-5, ok) +
+        ", force=" + checkLess(maxerrForce, 1e-3, ok) + "\n";
+    return ok;
+}
+
+/// compare the potential, force and force derivatives of two potentials, accumulating the max deviation
+/// relative to the magnitude of the corresponding quantity
+void compareEval(const potential::BasePotential& pot1, const potential::BasePotential& pot2,
+    const coord::PosCar& pos, double& maxdif)
+{
+    double v1, v2;
+    coord::GradCar g1, g2;
+    coord::HessCar h1, h2;
+    pot1.eval(pos, &v1, &g1, &h1);
+    pot2.eval(pos, &v2, &g2, &h2);
+    if(pos.x == 0 && pos.y == 0) {
+        // on the z axis, the generic conversion of derivatives from cylindrical coordinates
+        // yields a spurious nonzero d2Phi/dxdy for axisymmetric components, whereas all test
+        // potentials are reflection-symmetric in x and y, so that the mixed derivatives must vanish
+        h2.dxdy = h2.dydz = h2.dxdz = 0;
+    }
+    double gnorm = fabs(g2.dx) + fabs(g2.dy) + fabs(g2.dz);
+    double hnorm = fabs(h2.dx2) + fabs(h2.dy2) + fabs(h2.dz2) + fabs(h2.dxdy) + fabs(h2.dydz) + fabs(h2.dxdz);
+    double dif = fmax(fabs(v1 - v2) / fabs(v2), fmax(
+        (fabs(g1.dx - g2.dx) + fabs(g1.dy - g2.dy) + fabs(g1.dz - g2.dz)) / fmax(gnorm, 1e-300),
+        (fabs(h1.dx2 - h2.dx2) + fabs(h1.dy2 - h2.dy2) + fabs(h1.dz2 - h2.dz2) +
+        fabs(h1.dxdy - h2.dxdy) + fabs(h1.dydz - h2.dydz) + fabs(h1.dxdz - h2.dxdz)) / fmax(hnorm, 1e-300)));
+    if(!(dif <= maxdif))  // also catches NAN
+        maxdif = dif;
+}
+
+/// compare the specialized composite of analytic potentials with a generic composite of the same components
+bool testCompositeAnalytic()
+{
+    std::vector<potential::PtrPotential> comps;
+    comps.push_back(potential::PtrPotential(new potential::Plummer(1.0, 0.5)));
+    comps.push_back(potential::PtrPotential(new potential::Isochrone(2.0, 1.5)));
+    comps.push_back(potential::PtrPotential(new potential::NFW(3.0, 4.0)));
+    comps.push_back(potential::PtrPotential(new potential::MiyamotoNagai(1.5, 2.0, 0.3)));
+    comps.push_back(potential::PtrPotential(new potential::MiyamotoNagai(0.5, 0.0, 0.8)));
+    comps.push_back(potential::PtrPotential(new potential::Logarithmic(0.7, 0.2, 0.9, 0.6)));
+    comps.push_back(potential::PtrPotential(new potential::Harmonic(0.1, 0.8, 0.5)));
+    const potential::CompositeAnalytic fast(comps);
+    const potential::Composite generic(comps);
+    double maxdifGeneric = 0, maxdifAxis = 0, maxdifOrigin = 0;
+    for(int n=0; n<1000; n++) {
+        double r = pow(10., (n*0.618034 - floor(n*0.618034)) * 6 - 3);
+        coord::PosSph pos(r, acos((n*0.414214 - floor(n*0.414214)) * 2 - 1),
+            (n*0.732051 - floor(n*0.732051)) * 2*M_PI);
+        compareEval(fast, generic, coord::toPosCar(pos), maxdifGeneric);
+        // points on the z axis (R=0)
+        if(n%10 == 0)
+            compareEval(fast, generic, coord::PosCar(0, 0, n%20 == 0 ? r : -r), maxdifAxis);
+    }
+    // the origin (r=0): the NFW force derivatives are infinite there, so it is excluded from this test
+    std::vector<potential::PtrPotential> compsCored(comps);
+    compsCored.erase(compsCored.begin() + 2);
+    compareEval(potential::CompositeAnalytic(compsCored), potential::Composite(compsCored),
+        coord::PosCar(0, 0, 0), maxdifOrigin);
+    bool ok = maxdifGeneric < 1e-12 && maxdifAxis < 1e-12 && maxdifOrigin < 1e-12;
+    std::cout << "CompositeAnalytic vs. Composite: max relative difference at generic points=" <<
+        maxdifGeneric << ", at R=0: " << maxdifAxis << ", at r=0: " << maxdifOrigin <<
+        (ok ? "\n" : " \033[1;31m**\033[0m\n");
+    return ok;
+}
+
+/// loader of snapshots for the lazy Evolving potential that records the number of loads of each one
+class CountingLoader: public potential::BaseSnapshotLoader {
+public:
+    mutable std::vector<int> numLoads;
+    explicit CountingLoader(size_t numSnapshots) : numLoads(numSnapshots, 0) {}
+    virtual potential::PtrPotential load(size_t index) const
+    {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+        numLoads[index]++;
+        return potential::PtrPotential(new potential::Plummer(index+1., 1.));
+    }
+    int total() const
+    {
+        int sum = 0;
+        for(size_t i=0; i<numLoads.size(); i++)
+            sum += numLoads[i];
+        return sum;
+    }
+};
+
+/// check the eviction of least recently used snapshots, the read-ahead, and the concurrent use
+/// of the lazy Evolving potential against the one with all snapshots loaded in advance
+bool testLazyEvolving()
+{
+    const int numSnapshots = 10;
+    std::vector<double> times(numSnapshots);
+    std::vector<potential::PtrPotential> instances(numSnapshots);
+    for(int i=0; i<numSnapshots; i++) {
+        times[i] = i;
+        instances[i].reset(new potential::Plummer(i+1., 1.));
+    }
+    bool ok = true;
+    const coord::PosCar origin(0, 0, 0);
+
+    // nearest-snapshot interpolation with the cache size 3:
+    // the access sequence 0,1,2,0,3 evicts snapshot 1, then accessing 0,1,2 evicts 2 and 3
+    shared_ptr<const CountingLoader> loader(new CountingLoader(numSnapshots));
+    potential::Evolving lru(times, loader, /*interpLinear*/ false, /*cacheSize*/ 3);
+    const int sequence[] = {0, 1, 2, 0, 3, 0, 1, 2};
+    const int expectedTotal[] = {1, 2, 3, 3, 4, 4, 5, 6};
+    bool okLRU = true;
+    for(int k=0; k<8; k++) {
+        okLRU &= lru.value(origin, sequence[k]) == -(sequence[k]+1.);
+        okLRU &= loader->total() == expectedTotal[k];
+    }
+    okLRU &= loader->numLoads[0] == 1 && loader->numLoads[1] == 2 &&
+        loader->numLoads[2] == 2 && loader->numLoads[3] == 1;
+    std::cout << "Lazy Evolving potential: LRU eviction " << (okLRU ? "OK" : "\033[1;31mFAILED\033[0m");
+    ok &= okLRU;
+
+    // read-ahead loads the next snapshot together with the requested one
+    loader.reset(new CountingLoader(numSnapshots));
+    potential::Evolving ahead(times, loader, /*interpLinear*/ false, /*cacheSize*/ 3, /*readAhead*/ true);
+    ahead.value(origin, 0.);
+    bool okAhead = loader->numLoads[0] == 1 && loader->numLoads[1] == 1 && loader->total() == 2;
+    ahead.value(origin, 1.);
+    okAhead &= loader->total() == 2;
+    std::cout << ", read-ahead " << (okAhead ? "OK" : "\033[1;31mFAILED\033[0m");
+    ok &= okAhead;
+
+    // concurrent evaluation with a minimal cache, which constantly evicts snapshots still in use
+    loader.reset(new CountingLoader(numSnapshots));
+    potential::Evolving lazy(times, loader, /*interpLinear*/ true, /*cacheSize*/ 2);
+    potential::Evolving eager(times, instances, /*interpLinear*/ true);
+    const int numPoints = 10000;
+    int numFail = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic,16) reduction(+:numFail)
+#endif
+    for(int n=0; n<numPoints; n++) {
+        coord::PosCar pos(n*0.618034 - floor(n*0.618034), n*0.414214 - floor(n*0.414214), 0.5);
+        double time = (n*0.732051 - floor(n*0.732051)) * (numSnapshots-1);
+        if(lazy.value(pos, time) != eager.value(pos, time))
+            numFail++;
+    }
+    std::cout << ", concurrent use " << (numFail==0 ? "OK" : "\033[1;31mFAILED\033[0m") <<
+        " (" << loader->total() << " loads for " << numPoints << " points)\n";
+    ok &= numFail==0;
+    return ok;
+}
+
 potential::PtrPotential make_galpot(const char* params)
 {
     const char* params_file="test_galpot_params.pot";
@@ -319,6 +492,10 @@ int main() {
             allok &= testPotentialAtPoint(*pots[ip], coord::PosVelSph(posvel_sph[ic]));
         }
     }
+    allok &= testTabulatedPotential(pots[3], 20.); // MiyamotoNagai
+    allok &= testTabulatedPotential(pots[5], 2.);  // Ferrers
+    allok &= testCompositeAnalytic();
+    allok &= testLazyEvolving();
     if(allok)
         std::cout << "\033[1;32mALL TESTS PASSED\033[0m\n";
     else
@@ -0,0 +1,112 @@
+/** \file    test_raga.cpp
+    \author  Eugene Vasiliev
+    \date    2026
+
+    Test the multi-rate episode scheme of the Monte Carlo code Raga:
+    the assignment of particles to levels according to their orbital periods,
+    the fallback to the single-rate scheme when the periods cannot be determined,
+    and the equivalence of a multi-rate episode and a single-rate one in a static potential
+    (every particle must be advanced by exactly the episode length in both cases).
+*/
+#include "raga_core.h"
+#include "potential_analytic.h"
+#include "potential_utils.h"
+#include <iostream>
+#include <cmath>
+
+/// check the level assignment for a given array of sorted energies
+bool testLevels(const potential::BasePotential& pot, const std::vector<double>& energies,
+    unsigned int numLevelsInput, unsigned int numLevelsExpected)
+{
+    unsigned int numLevels = numLevelsInput;
+    std::vector<unsigned int> stepFactor = raga::assignEpisodeLevels(pot, energies, numLevels);
+    bool ok = numLevels == numLevelsExpected && stepFactor.size() == energies.size();
+    unsigned int maxFactor = 1u << (numLevels-1);
+    double Tmin = numLevels > 1 ? potential::T_circ(pot, energies[0]) : NAN;
+    std::vector<unsigned int> count(numLevels, 0);
+    for(size_t i=0; ok && i<energies.size(); i++) {
+        unsigned int f = stepFactor[i];
+        // must be a power of two not exceeding the maximum, and non-decreasing with energy
+        ok &= f >= 1 && f <= maxFactor && (f & (f-1)) == 0 && (i==0 || f >= stepFactor[i-1]);
+        for(unsigned int l=0; l<numLevels; l++)
+            if(f == 1u << l) count[l]++;
+        if(numLevels == 1)
+            continue;
+        // the period must lie within the range assigned to this level
+        double T = potential::T_circ(pot, energies[i]);
+        if(f > 1)
+            ok &= !(T < Tmin * f);
+        if(f < maxFactor)
+            ok &= T < Tmin * f * 2;
+    }
+    std::cout << "numLevels=" << numLevelsInput << " => " << numLevels << ", particles per level:";
+    for(unsigned int l=0; l<numLevels; l++)
+        std::cout << ' ' << count[l];
+    std::cout << (ok ? "\n" : " \033[1;31m**\033[0m\n");
+    return ok;
+}
+
+/// run one episode with the given number of levels and return the final particle coordinates
+std::vector<coord::PosVelCar> runEpisode(const potential::PtrPotential& pot,
+    const particles::ParticleArrayAux& particles, double episodeLength, unsigned int numLevels)
+{
+    raga::RagaCore core;
+    core.ptrPot = pot;
+    core.particles = particles;
+    core.paramsRaga.numEpisodeLevels = numLevels;
+    core.paramsRaga.episodeLength = episodeLength;
+    core.doEpisode(episodeLength);
+    std::vector<coord::PosVelCar> result(particles.size());
+    for(size_t i=0; i<particles.size(); i++)
+        result[i] = core.particles.point(i);
+    if(fabs(core.paramsRaga.timeCurr - episodeLength) > 1e-15 * episodeLength)
+        result.clear();   // signal of error: the time was not advanced correctly
+    return result;
+}
+
+int main()
+{
+    bool allok = true;
+    potential::PtrPotential pot(new potential::Plummer(1., 1.));
+
+    // energies spanning a range of periods, plus a few unbound particles at the end
+    std::vector<double> energies;
+    for(int i=0; i<200; i++)
+        energies.push_back(-0.99 + 0.98 * i / 199);
+    energies.push_back(0.);
+    energies.push_back(0.5);
+    allok &= testLevels(*pot, energies, 1, 1);
+    allok &= testLevels(*pot, energies, 3, 3);
+    allok &= testLevels(*pot, energies, 5, 5);
+    // all particles unbound: the periods cannot be determined, must fall back to a single level
+    allok &= testLevels(*pot, std::vector<double>(10, 0.1), 4, 1);
+
+    // a multi-rate episode in a static potential without tasks must produce the same result
+    // as a single-rate one, since each particle is advanced by the same total time
+    particles::ParticleArrayAux particles;
+    const int nbody = 40;
+    for(int i=0; i<nbody; i++) {
+        double r = 0.05 * pow(400., i / (nbody-1.)), v = potential::v_circ(*pot, r);
+        particles.add(particles::ParticleAux(coord::PosVelCar(r, 0, 0, 0.1*v, 0.8*v, 0.3*v)), 1./nbody);
+    }
+    double episodeLength = 5.;
+    std::vector<coord::PosVelCar> single = runEpisode(pot, particles, episodeLength, 1);
+    std::vector<coord::PosVelCar> multi  = runEpisode(pot, particles, episodeLength, 4);
+    double maxdev = 0;
+    bool ok = single.size() == (size_t)nbody && multi.size() == (size_t)nbody;
+    for(int i=0; ok && i<nbody; i++) {
+        double r = sqrt(pow_2(single[i].x) + pow_2(single[i].y) + pow_2(single[i].z));
+        maxdev = fmax(maxdev, sqrt(pow_2(single[i].x - multi[i].x) + pow_2(single[i].y - multi[i].y) +
+            pow_2(single[i].z - multi[i].z)) / r);
+    }
+    ok &= maxdev < 1e-5;
+    std::cout << "Multi-rate vs single-rate episode: max relative deviation in position=" << maxdev <<
+        (ok ? "\n" : " \033[1;31m**\033[0m\n");
+    allok &= ok;
+
+    if(allok)
+        std::cout << "\033[1;32mALL TESTS PASSED\033[0m\n";
+    else
+        std::cout << "\033[1;31mSOME TESTS FAILED\033[0m\n";
+    return 0;
+}
@@ -2,10 +2,13 @@
     \date    2016-2017
     \author  Eugene Vasiliev
 
-    Test the number-to-string conversion routine and the ini-file manipulation routines
+    Test the number-to-string conversion routine, the ini-file manipulation routines,
+    and the instrumentation counters
 */
 #include "utils.h"
 #include "utils_config.h"
+#include "utils_counters.h"
+#include "potential_analytic.h"
 #include "math_core.h"
 #include "math_random.h"
 #include <iostream>
@@ -193,10 +196,35 @@ bool test_ini_file()
     return ok;
 }
 
+bool test_counters()
+{
+    // evaluate the potential in parallel and check that the per-thread counters add up correctly
+    potential::Plummer pot(1., 1.);
+    const int NPOINTS = 10000;
+    utils::resetCounters();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for(int i=0; i<NPOINTS; i++)
+        pot.value(coord::PosCar(i*0.001, 0, 0));
+    std::vector<utils::CounterValue> counters = utils::getCounters();
+    unsigned long long expected = utils::countersEnabled() ? NPOINTS : 0, countPlummer = 0;
+    for(size_t i=utils::CNT_NUM; i<counters.size(); i++)
+        if(counters[i].name == potential::Plummer::myName())
+            countPlummer = counters[i].count;
+    bool ok = counters.size() >= utils::CNT_NUM &&
+        counters[utils::CNT_POTENTIAL_EVAL].count == expected && countPlummer == expected;
+    if(utils::countersEnabled())
+        std::cout << utils::countersReport();
+    utils::resetCounters();
+    ok &= utils::getCounters()[utils::CNT_POTENTIAL_EVAL].count == 0;
+    return ok;
+}
+
 int main()
 {
-    std::cout << "Test string formatting and INI file routines\n";
-    if(test_number_conversion() && test_ini_file())
+    std::cout << "Test string formatting, INI file routines and instrumentation counters\n";
+    if(test_number_conversion() && test_ini_file() && test_counters())
         std::cout << "\033[1;32mALL TESTS PASSED\033[0m\n";
     else
         std::cout << "\033[1;31mSOME TESTS FAILED\033[0m\n";